@@ -1,2 +1,9 @@
 $VULKAN_SDK/bin/glslangValidator -V $1/vertex.vert     -o $1/vert.spv
-$VULKAN_SDK/bin/glslangValidator -V $1/fragment.frag   -o $1/frag.spv
\ No newline at end of file
+$VULKAN_SDK/bin/glslangValidator -V $1/fragment.frag   -o $1/frag.spv
+$VULKAN_SDK/bin/glslangValidator -V $1/grid.vert       -o $1/grid_vert.spv
+$VULKAN_SDK/bin/glslangValidator -V $1/grid.frag       -o $1/grid_frag.spv
+$VULKAN_SDK/bin/glslangValidator -V $1/line.vert       -o $1/line_vert.spv
+$VULKAN_SDK/bin/glslangValidator -V $1/line.frag       -o $1/line_frag.spv
+$VULKAN_SDK/bin/glslangValidator -V $1/splat.comp      -o $1/splat_comp.spv
+$VULKAN_SDK/bin/glslangValidator -V $1/splat_resolve.vert -o $1/splat_resolve_vert.spv
+$VULKAN_SDK/bin/glslangValidator -V $1/splat_resolve.frag -o $1/splat_resolve_frag.spv
@@ -2,10 +2,15 @@
 #extension GL_ARB_separate_shader_objects : enable
 
 layout(location = 0) in vec4 fragColor;
+layout(location = 1) flat in uint pickId;
+
 layout(location = 0) out vec4 outColor;
+// Dropped unless picking added the id attachment
+layout(location = 1) out uint outId;
 
 
 void main()
 {
 	outColor = fragColor;
+	outId = pickId;
 }
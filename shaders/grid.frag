@@ -0,0 +1,94 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+struct ViewData {
+    mat4 view;
+    mat4 proj;
+    vec4 rect;
+};
+
+layout(std430, binding = 1) readonly buffer ViewTable {
+    ViewData views[];
+};
+
+
+layout(location = 0) in vec3 nearPoint;
+layout(location = 1) in vec3 farPoint;
+layout(location = 2) flat in int viewIndex;
+
+layout(location = 0) out vec4 outColor;
+
+
+// Smallest cell, in pixels, before the grid moves to the next level
+const float MIN_CELL_PIXELS = 8.0;
+
+const vec3 LINE_COLOR = vec3(0.55);
+const vec3 X_AXIS_COLOR = vec3(0.85, 0.25, 0.25);
+const vec3 Y_AXIS_COLOR = vec3(0.25, 0.85, 0.25);
+
+
+// Coverage of the lines of a grid with the given cell size, antialiased over
+// about one pixel
+float gridLines(vec2 p, vec2 derivative, float cell)
+{
+	vec2 coord = p / cell;
+	vec2 width = derivative / cell;
+	vec2 line = abs(fract(coord - 0.5) - 0.5) / max(width, vec2(1e-6));
+
+	return 1.0 - min(min(line.x, line.y), 1.0);
+}
+
+void main()
+{
+	// The grid lies in the z = 0 plane of the model
+	float t = -nearPoint.z / (farPoint.z - nearPoint.z);
+
+	if (t <= 0.0)
+		discard;
+
+	vec3 p = nearPoint + t * (farPoint - nearPoint);
+
+	vec2 derivative = fwidth(p.xy);
+
+	// Pick the two decades that bracket the on screen cell size and blend
+	float level = log(max(length(derivative) * MIN_CELL_PIXELS, 1e-6)) / log(10.0);
+	float fade = fract(level);
+	float cell = pow(10.0, floor(level));
+
+	float fine = gridLines(p.xy, derivative, cell) * (1.0 - fade);
+	float coarse = gridLines(p.xy, derivative, cell * 10.0);
+
+	float alpha = max(fine, coarse);
+
+	vec3 color = LINE_COLOR;
+
+	vec2 axis = abs(p.xy) / max(derivative, vec2(1e-6));
+	if (axis.y < 1.0) {
+		color = X_AXIS_COLOR;
+		alpha = 1.0;
+	}
+	if (axis.x < 1.0) {
+		color = Y_AXIS_COLOR;
+		alpha = 1.0;
+	}
+
+	ViewData v = views[viewIndex];
+	vec4 clip = v.proj * v.view * ubo.model * vec4(p, 1.0);
+
+	// Fade towards the horizon where lines alias
+	float grazing = abs(normalize(farPoint - nearPoint).z);
+	alpha *= smoothstep(0.0, 0.15, grazing);
+
+	if (alpha < 0.01)
+		discard;
+
+	gl_FragDepth = clip.z / clip.w;
+	outColor = vec4(color, alpha * 0.6);
+}
@@ -0,0 +1,64 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+struct ViewData {
+    mat4 view;
+    mat4 proj;
+    vec4 rect;
+};
+
+layout(std430, binding = 1) readonly buffer ViewTable {
+    ViewData views[];
+};
+
+
+layout(location = 0) out vec3 nearPoint;
+layout(location = 1) out vec3 farPoint;
+layout(location = 2) flat out int viewIndex;
+
+out gl_PerVertex {
+	vec4 gl_Position;
+	float gl_ClipDistance[4];
+};
+
+
+// One triangle covering the whole view, no vertex buffer
+const vec2 corners[3] = vec2[](vec2(-1.0, -1.0), vec2(3.0, -1.0), vec2(-1.0, 3.0));
+
+vec3 unproject(mat4 inverseViewProj, vec2 ndc, float depth)
+{
+	vec4 p = inverseViewProj * vec4(ndc, depth, 1.0);
+	return p.xyz / p.w;
+}
+
+void main()
+{
+	ViewData v = views[gl_InstanceIndex];
+	vec2 ndc = corners[gl_VertexIndex];
+
+	mat4 inverseViewProj = inverse(v.proj * v.view * ubo.model);
+
+	nearPoint = unproject(inverseViewProj, ndc, 0.0);
+	farPoint = unproject(inverseViewProj, ndc, 1.0);
+	viewIndex = gl_InstanceIndex;
+
+	// Same rectangle mapping as the point shader
+	vec2 lo = 2.0 * v.rect.xy - 1.0;
+	vec2 hi = lo + 2.0 * v.rect.zw;
+
+	vec4 clip = vec4(ndc * v.rect.zw + 0.5 * (lo + hi), 0.0, 1.0);
+
+	gl_ClipDistance[0] = clip.x - lo.x;
+	gl_ClipDistance[1] = hi.x - clip.x;
+	gl_ClipDistance[2] = clip.y - lo.y;
+	gl_ClipDistance[3] = hi.y - clip.y;
+
+	gl_Position = clip;
+}
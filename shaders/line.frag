@@ -0,0 +1,30 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) noperspective in vec2 pixel;
+layout(location = 2) flat in vec4 endpoints;
+layout(location = 3) flat in float halfWidth;
+layout(location = 4) flat in uint pickId;
+
+layout(location = 0) out vec4 outColor;
+layout(location = 1) out uint outId;
+
+
+void main()
+{
+	// Distance to the segment, which gives round caps and round joins where
+	// segments meet
+	vec2 pa = pixel - endpoints.xy;
+	vec2 ba = endpoints.zw - endpoints.xy;
+	float h = clamp(dot(pa, ba) / max(dot(ba, ba), 1e-6), 0.0, 1.0);
+	float d = length(pa - ba * h);
+
+	float coverage = clamp(halfWidth + 0.5 - d, 0.0, 1.0);
+
+	if (coverage <= 0.0)
+		discard;
+
+	outColor = vec4(fragColor.rgb, fragColor.a * coverage);
+	outId = pickId;
+}
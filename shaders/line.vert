@@ -0,0 +1,144 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    uint hoverId;
+} ubo;
+
+struct ViewData {
+    mat4 view;
+    mat4 proj;
+    vec4 rect;
+};
+
+layout(std430, binding = 1) readonly buffer ViewTable {
+    ViewData views[];
+};
+
+// The model's vertex buffer, read as plain floats
+struct LineVertex {
+    float px, py, pz;
+    float cx, cy, cz;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer VertexBuffer {
+    LineVertex vertices[];
+};
+
+struct Segment {
+    uint a;
+    uint b;
+    uint color;
+    uint flags;
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer SegmentBuffer {
+    Segment segments[];
+};
+
+layout(push_constant) uniform LinePush {
+    vec2 viewport;
+    float width;
+    uint segmentCount;
+    uint firstView;
+    uint idBase;
+} line;
+
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) noperspective out vec2 pixel;
+layout(location = 2) flat out vec4 endpoints;
+layout(location = 3) flat out float halfWidth;
+layout(location = 4) flat out uint pickId;
+
+out gl_PerVertex {
+	vec4 gl_Position;
+	float gl_ClipDistance[4];
+};
+
+
+// x runs from the start (0) to the end (1) of the segment, y across it.
+// Drawn indexed as 0 1 2, 0 2 3.
+const vec2 corners[4] = vec2[](vec2(0.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+                               vec2(0.0, 1.0));
+
+// Pixels added around the line for antialiasing
+const float FRINGE = 1.0;
+
+const vec4 HOVER_COLOR = vec4(1.0, 0.75, 0.1, 1.0);
+
+void main()
+{
+	uint segmentIndex = gl_InstanceIndex % line.segmentCount;
+	ViewData v = views[line.firstView + gl_InstanceIndex / line.segmentCount];
+
+	Segment s = segments[segmentIndex];
+	LineVertex a = vertices[s.a];
+	LineVertex b = vertices[s.b];
+
+	mat4 mvp = v.proj * v.view * ubo.model;
+	vec4 ca = mvp * vec4(a.px, a.py, a.pz, 1.0);
+	vec4 cb = mvp * vec4(b.px, b.py, b.pz, 1.0);
+
+	vec2 lo = 2.0 * v.rect.xy - 1.0;
+	vec2 hi = lo + 2.0 * v.rect.zw;
+
+	// Entirely behind the camera, collapse the quad
+	if (ca.z < 0.0 && cb.z < 0.0) {
+		gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+		gl_ClipDistance = float[](-1.0, -1.0, -1.0, -1.0);
+		return;
+	}
+
+	// Trim at the near plane so both ends can be projected
+	if (ca.z < 0.0)
+		ca = mix(ca, cb, ca.z / (ca.z - cb.z));
+	if (cb.z < 0.0)
+		cb = mix(cb, ca, cb.z / (cb.z - ca.z));
+
+	vec2 size = line.viewport * v.rect.zw;
+
+	vec2 sa = (ca.xy / ca.w * 0.5 + 0.5) * size;
+	vec2 sb = (cb.xy / cb.w * 0.5 + 0.5) * size;
+
+	vec2 dir = sb - sa;
+	float len = length(dir);
+	dir = len > 1e-4 ? dir / len : vec2(1.0, 0.0);
+	vec2 normal = vec2(-dir.y, dir.x);
+
+	// Extended past both ends so the fragment shader can round the caps
+	float extent = 0.5 * line.width + FRINGE;
+	vec2 corner = corners[gl_VertexIndex];
+
+	vec2 p = mix(sa, sb, corner.x) + dir * (2.0 * corner.x - 1.0) * extent +
+	         normal * corner.y * extent;
+
+	float za = ca.z / ca.w;
+	float zb = cb.z / cb.w;
+
+	vec2 ndc = p / size * 2.0 - 1.0;
+	vec4 clip = vec4(ndc * v.rect.zw + 0.5 * (lo + hi), mix(za, zb, corner.x), 1.0);
+
+	gl_ClipDistance[0] = clip.x - lo.x;
+	gl_ClipDistance[1] = hi.x - clip.x;
+	gl_ClipDistance[2] = clip.y - lo.y;
+	gl_ClipDistance[3] = hi.y - clip.y;
+
+	gl_Position = clip;
+
+	pixel = p;
+	endpoints = vec4(sa, sb);
+	halfWidth = 0.5 * line.width;
+
+	vec3 color = mix(vec3(a.cx, a.cy, a.cz), vec3(b.cx, b.cy, b.cz), corner.x);
+	fragColor = s.color != 0u ? unpackUnorm4x8(s.color) : vec4(color, 1.0);
+
+	pickId = line.idBase + segmentIndex;
+
+	if (pickId == ubo.hoverId)
+		fragColor = HOVER_COLOR;
+}
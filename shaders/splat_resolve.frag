@@ -0,0 +1,30 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Read as two words, the resolve needs no 64-bit arithmetic
+layout(std430, set = 2, binding = 0) readonly buffer SplatBuffer {
+    uvec2 pixels[];
+};
+
+layout(push_constant) uniform SplatPush {
+    uvec2 extent;
+    uint pointCount;
+    uint firstView;
+    uint lodSlot;
+} splat;
+
+layout(location = 0) out vec4 outColor;
+
+
+void main()
+{
+	uvec2 pixel = uvec2(gl_FragCoord.xy);
+	uvec2 value = pixels[pixel.y * splat.extent.x + pixel.x];
+
+	// Still cleared, nothing landed here
+	if (value.y == 0xFFFFFFFFu)
+		discard;
+
+	outColor = unpackUnorm4x8(value.x);
+	gl_FragDepth = uintBitsToFloat(value.y);
+}
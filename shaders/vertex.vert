@@ -6,8 +6,25 @@ layout(binding = 0) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
+    uint hoverId;
 } ubo;
 
+struct ViewData {
+    mat4 view;
+    mat4 proj;
+    vec4 rect;
+};
+
+// Camera table, the instance index picks the entry
+layout(std430, binding = 1) readonly buffer ViewTable {
+    ViewData views[];
+};
+
+
+// Pick id of the buffer's first vertex
+layout(push_constant) uniform PointPush {
+    uint idBase;
+} point;
 
 
 layout(location = 0) in vec3 inPosition;
@@ -15,20 +32,42 @@ layout(location = 1) in vec3 inColor;
 
 
 layout(location = 0) out vec4 fragColor;
+layout(location = 1) flat out uint pickId;
+
+const vec3 HOVER_COLOR = vec3(1.0, 0.75, 0.1);
 
 out gl_PerVertex {
 	vec4 gl_Position;
 	float gl_PointSize;
+	float gl_ClipDistance[4];
 };
 
 
 
 void main()
 {
+	ViewData v = views[gl_InstanceIndex];
+
 	gl_PointSize = 7.0;
 	vec4 pos = vec4(inPosition.xyz, 1.0);
-	gl_Position = ubo.proj * ubo.view * ubo.model * pos;
+	vec4 clip = v.proj * v.view * ubo.model * pos;
+
+	// Squeeze the view into its rectangle and clip to the rectangle edges
+	vec2 lo = 2.0 * v.rect.xy - 1.0;
+	vec2 hi = lo + 2.0 * v.rect.zw;
+
+	clip.xy = clip.xy * v.rect.zw + 0.5 * (lo + hi) * clip.w;
+
+	gl_ClipDistance[0] = clip.x - lo.x * clip.w;
+	gl_ClipDistance[1] = hi.x * clip.w - clip.x;
+	gl_ClipDistance[2] = clip.y - lo.y * clip.w;
+	gl_ClipDistance[3] = hi.y * clip.w - clip.y;
+
+	gl_Position = clip;
 	
 
-	fragColor = vec4(inColor.xyz, 1.0);
+	pickId = point.idBase + gl_VertexIndex;
+
+	vec3 color = pickId == ubo.hoverId ? HOVER_COLOR : inColor.xyz;
+	fragColor = vec4(color, 1.0);
 }
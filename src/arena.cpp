@@ -0,0 +1,167 @@
+#include "arena.hpp"
+#include "pch.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+namespace {
+
+const size_t BLOCK_ALIGNMENT = 64;
+
+std::byte *alignUp(std::byte *p, size_t alignment) {
+  auto address = reinterpret_cast<uintptr_t>(p);
+  address = (address + alignment - 1) & ~(uintptr_t(alignment) - 1);
+  return reinterpret_cast<std::byte *>(address);
+}
+
+} // namespace
+
+Arena::Arena(size_t blockSize, std::pmr::memory_resource *upstream)
+    : mUpstream{upstream}, mBlockSize{blockSize}, mCurrent{0}, mOffset{0},
+      mUsed{0} {}
+
+Arena::~Arena() { release(); }
+
+void Arena::reset() {
+
+  mFree.clear();
+  mCurrent = 0;
+  mOffset = 0;
+  mUsed = 0;
+}
+
+void Arena::release() {
+
+  for (const auto &block : mBlocks)
+    mUpstream->deallocate(block.data, block.size, BLOCK_ALIGNMENT);
+
+  mBlocks.clear();
+  reset();
+}
+
+size_t Arena::used() const { return mUsed; }
+
+size_t Arena::reserved() const {
+
+  size_t total = 0;
+  for (const auto &block : mBlocks)
+    total += block.size;
+  return total;
+}
+
+void *Arena::do_allocate(size_t bytes, size_t alignment) {
+
+  // Reuse the smallest freed range that fits
+  auto best = mFree.end();
+  for (auto it = mFree.begin(); it != mFree.end(); ++it) {
+
+    std::byte *p = alignUp(it->data, alignment);
+    if (p + bytes > it->data + it->size)
+      continue;
+    if (best == mFree.end() || it->size < best->size)
+      best = it;
+  }
+
+  if (best != mFree.end()) {
+
+    std::byte *p = alignUp(best->data, alignment);
+    FreeRange head = {best->data, static_cast<size_t>(p - best->data)};
+    FreeRange tail = {p + bytes,
+                      static_cast<size_t>(best->data + best->size - p) - bytes};
+
+    // What the allocation leaves on either side stays free, in place
+    if (head.size > 0 && tail.size > 0) {
+      *best = tail;
+      mFree.insert(best, head);
+    } else if (head.size > 0) {
+      *best = head;
+    } else if (tail.size > 0) {
+      *best = tail;
+    } else {
+      mFree.erase(best);
+    }
+
+    mUsed += bytes;
+    return p;
+  }
+
+  while (mCurrent < mBlocks.size()) {
+
+    Block &block = mBlocks[mCurrent];
+    std::byte *p = alignUp(block.data + mOffset, alignment);
+
+    if (p + bytes <= block.data + block.size) {
+      mOffset = static_cast<size_t>(p + bytes - block.data);
+      mUsed += bytes;
+      return p;
+    }
+
+    mCurrent++;
+    mOffset = 0;
+  }
+
+  size_t size = std::max(mBlockSize, bytes + alignment);
+  auto *data = static_cast<std::byte *>(
+      mUpstream->allocate(size, BLOCK_ALIGNMENT));
+  mBlocks.push_back({data, size});
+
+  mCurrent = mBlocks.size() - 1;
+
+  std::byte *p = alignUp(data, alignment);
+  mOffset = static_cast<size_t>(p + bytes - data);
+  mUsed += bytes;
+
+  return p;
+}
+
+void Arena::do_deallocate(void *p, size_t bytes, size_t alignment) {
+
+  if (!p || bytes == 0)
+    return;
+
+  auto *data = static_cast<std::byte *>(p);
+  mUsed -= bytes;
+
+  // Sorted by address, so neighbours merge and regrown streams leave one
+  // range behind instead of many too small to reuse
+  auto next = std::lower_bound(
+      mFree.begin(), mFree.end(), data,
+      [](const FreeRange &range, std::byte *p) { return range.data < p; });
+
+  auto it = mFree.insert(next, {data, bytes});
+
+  // Blocks may be adjacent in memory, ranges never span two
+  if (std::next(it) != mFree.end() &&
+      it->data + it->size == std::next(it)->data &&
+      !startsBlock(std::next(it)->data)) {
+    it->size += std::next(it)->size;
+    mFree.erase(std::next(it));
+  }
+
+  if (it != mFree.begin() && std::prev(it)->data + std::prev(it)->size ==
+                                 it->data &&
+      !startsBlock(it->data)) {
+    std::prev(it)->size += it->size;
+    it = std::prev(mFree.erase(it));
+  }
+
+  // A range that ends where bumping continues rolls it back
+  if (mCurrent < mBlocks.size()) {
+    Block &block = mBlocks[mCurrent];
+    if (it->data >= block.data && it->data + it->size == block.data + mOffset) {
+      mOffset = static_cast<size_t>(it->data - block.data);
+      mFree.erase(it);
+    }
+  }
+}
+
+bool Arena::startsBlock(const std::byte *p) const {
+  return std::any_of(mBlocks.begin(), mBlocks.end(),
+                     [p](const Block &block) { return block.data == p; });
+}
+
+bool Arena::do_is_equal(
+    const std::pmr::memory_resource &other) const noexcept {
+  return this == &other;
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
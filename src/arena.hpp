@@ -0,0 +1,59 @@
+#pragma once
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+// Bump allocator for a model's attribute streams. Blocks are only returned
+// upstream by release() or the destructor, freed allocations are kept and
+// handed out again, so a model that is cleared and rebuilt reuses its memory.
+// Not thread-safe, the owner serialises access.
+class Arena : public std::pmr::memory_resource {
+
+public:
+  explicit Arena(size_t blockSize = 1 << 20,
+                 std::pmr::memory_resource *upstream =
+                     std::pmr::new_delete_resource());
+  ~Arena();
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  // Forgets every allocation but keeps the blocks. Only valid once nothing
+  // allocated from the arena is alive anymore.
+  void reset();
+
+  // Returns all blocks upstream, same precondition as reset()
+  void release();
+
+  size_t used() const;
+  size_t reserved() const;
+
+private:
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+  bool do_is_equal(
+      const std::pmr::memory_resource &other) const noexcept override;
+
+  bool startsBlock(const std::byte *p) const;
+
+  struct Block {
+    std::byte *data;
+    size_t size;
+  };
+
+  struct FreeRange {
+    std::byte *data;
+    size_t size;
+  };
+
+  std::pmr::memory_resource *mUpstream;
+  size_t mBlockSize;
+
+  std::vector<Block> mBlocks;
+  // Sorted by address, adjacent ranges within a block are merged
+  std::vector<FreeRange> mFree;
+  size_t mCurrent;
+  size_t mOffset;
+  size_t mUsed;
+};
+
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -0,0 +1,62 @@
+#include "checksum.hpp"
+#include "pch.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+namespace {
+
+using CrcTables = std::array<std::array<uint32_t, 256>, 8>;
+
+// Slicing-by-8 tables, table[0] is the classic byte-wise table
+const CrcTables &crcTables() {
+
+  static const CrcTables tables = [] {
+    CrcTables t{};
+
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      t[0][n] = c;
+    }
+
+    for (uint32_t n = 0; n < 256; n++)
+      for (size_t k = 1; k < 8; k++)
+        t[k][n] = t[0][t[k - 1][n] & 0xFF] ^ (t[k - 1][n] >> 8);
+
+    return t;
+  }();
+
+  return tables;
+}
+
+} // namespace
+
+uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size) {
+
+  const CrcTables &t = crcTables();
+
+  crc = ~crc;
+
+  while (size >= 8) {
+
+    uint32_t lo = crc ^ (uint32_t(data[0]) | uint32_t(data[1]) << 8 |
+                         uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24);
+    uint32_t hi = uint32_t(data[4]) | uint32_t(data[5]) << 8 |
+                  uint32_t(data[6]) << 16 | uint32_t(data[7]) << 24;
+
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^
+          t[4][lo >> 24] ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+          t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+
+    data += 8;
+    size -= 8;
+  }
+
+  while (size-- > 0)
+    crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+
+  return ~crc;
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -0,0 +1,9 @@
+#pragma once
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+// CRC-32 (IEEE, as used by PNG and zlib). Pass the previous result to
+// continue a running checksum, 0 to start one.
+uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size);
+
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -0,0 +1,164 @@
+#include "depgraph.hpp"
+#include "thread_pool.hpp"
+#include "pch.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+namespace {
+
+// Nodes are usually cheap, keep small waves on the calling thread
+const size_t WAVE_GRAIN = 256;
+
+} // namespace
+
+uint32_t DependencyGraph::addNode() {
+
+  uint32_t node = static_cast<uint32_t>(mInputs.size());
+
+  mInputs.emplace_back();
+  mDependents.emplace_back();
+  mDirty.push_back(0);
+  mPending.push_back(0);
+  mVisited.push_back(0);
+
+  return node;
+}
+
+void DependencyGraph::addEdge(uint32_t input, uint32_t node) {
+
+  if (input == node || reaches(node, input))
+    throw std::invalid_argument("dependency would close a cycle");
+
+  mInputs[node].push_back(input);
+  mDependents[input].push_back(node);
+
+  if (mDirty[input])
+    markDirty(node);
+}
+
+bool DependencyGraph::reaches(uint32_t from, uint32_t to) {
+
+  // Marks instead of clearing a visited set per query
+  if (++mVisitMark == 0) {
+    std::fill(mVisited.begin(), mVisited.end(), 0);
+    mVisitMark = 1;
+  }
+
+  std::vector<uint32_t> stack = {from};
+  mVisited[from] = mVisitMark;
+
+  while (!stack.empty()) {
+
+    uint32_t node = stack.back();
+    stack.pop_back();
+
+    if (node == to)
+      return true;
+
+    for (uint32_t next : mDependents[node]) {
+      if (mVisited[next] != mVisitMark) {
+        mVisited[next] = mVisitMark;
+        stack.push_back(next);
+      }
+    }
+  }
+
+  return false;
+}
+
+void DependencyGraph::markDirty(uint32_t node) {
+
+  if (mDirty[node])
+    return;
+
+  // A dirty node's dependents are dirty already, so the walk stops there
+  std::vector<uint32_t> stack = {node};
+  mDirty[node] = 1;
+
+  while (!stack.empty()) {
+
+    uint32_t current = stack.back();
+    stack.pop_back();
+    mDirtyList.push_back(current);
+
+    for (uint32_t next : mDependents[current]) {
+      if (!mDirty[next]) {
+        mDirty[next] = 1;
+        stack.push_back(next);
+      }
+    }
+  }
+}
+
+bool DependencyGraph::isDirty(uint32_t node) const { return mDirty[node]; }
+
+size_t DependencyGraph::dirtyCount() const { return mDirtyList.size(); }
+
+size_t DependencyGraph::size() const { return mInputs.size(); }
+
+const std::vector<uint32_t> &DependencyGraph::inputs(uint32_t node) const {
+  return mInputs[node];
+}
+
+const std::vector<uint32_t> &DependencyGraph::dependents(uint32_t node) const {
+  return mDependents[node];
+}
+
+void DependencyGraph::evaluate(
+    const std::function<void(uint32_t node)> &evaluate,
+    std::vector<uint32_t> &evaluated, ThreadPool *pool) {
+
+  evaluated.clear();
+
+  if (mDirtyList.empty())
+    return;
+
+  std::vector<uint32_t> wave;
+
+  for (uint32_t node : mDirtyList) {
+
+    uint32_t pending = 0;
+    for (uint32_t input : mInputs[node])
+      pending += mDirty[input];
+
+    mPending[node] = pending;
+
+    if (pending == 0)
+      wave.push_back(node);
+  }
+
+  std::vector<uint32_t> next;
+
+  while (!wave.empty()) {
+
+    auto body = [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++)
+        evaluate(wave[i]);
+    };
+
+    if (pool)
+      pool->parallelFor(wave.size(), body, WAVE_GRAIN);
+    else
+      body(0, wave.size());
+
+    next.clear();
+
+    for (uint32_t node : wave) {
+
+      evaluated.push_back(node);
+
+      for (uint32_t dependent : mDependents[node])
+        if (--mPending[dependent] == 0)
+          next.push_back(dependent);
+    }
+
+    wave.swap(next);
+  }
+
+  for (uint32_t node : mDirtyList)
+    mDirty[node] = 0;
+
+  mDirtyList.clear();
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
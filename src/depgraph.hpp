@@ -0,0 +1,48 @@
+#pragma once
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+class ThreadPool;
+
+// Nodes evaluated in dependency order. Marking a node dirty marks everything
+// downstream of it, and evaluate() only visits dirty nodes. Dirty nodes are
+// run in waves: a wave holds the nodes whose dirty inputs are all done, so
+// its nodes don't depend on each other and run on the pool together.
+class DependencyGraph {
+
+public:
+  uint32_t addNode();
+
+  // node is evaluated after input. Throws std::invalid_argument when the
+  // edge would close a cycle.
+  void addEdge(uint32_t input, uint32_t node);
+
+  void markDirty(uint32_t node);
+  bool isDirty(uint32_t node) const;
+  size_t dirtyCount() const;
+
+  size_t size() const;
+
+  const std::vector<uint32_t> &inputs(uint32_t node) const;
+  const std::vector<uint32_t> &dependents(uint32_t node) const;
+
+  // Calls evaluate for every dirty node, inputs first, and clears them.
+  // evaluated receives the nodes in the order they ran.
+  void evaluate(const std::function<void(uint32_t node)> &evaluate,
+                std::vector<uint32_t> &evaluated, ThreadPool *pool = nullptr);
+
+private:
+  bool reaches(uint32_t from, uint32_t to);
+
+  std::vector<std::vector<uint32_t>> mInputs;
+  std::vector<std::vector<uint32_t>> mDependents;
+  std::vector<uint8_t> mDirty;
+  std::vector<uint32_t> mDirtyList;
+
+  // Scratch, dirty inputs left per node and visit marks
+  std::vector<uint32_t> mPending;
+  std::vector<uint32_t> mVisited;
+  uint32_t mVisitMark = 0;
+};
+
+} // namespace TRUCHAS_APP_NAMESPACE
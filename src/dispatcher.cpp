@@ -0,0 +1,73 @@
+#include "dispatcher.hpp"
+#include "pch.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+Dispatcher::Dispatcher() : mReceived{0}, mApplied{0} {}
+
+Dispatcher::~Dispatcher() {}
+
+void Dispatcher::post(Subject *subject) {
+
+  mReceived.fetch_add(1, std::memory_order_relaxed);
+
+  // Only the first notification since the last drain enqueues the subject
+  if (subject->mQueued.exchange(true, std::memory_order_acq_rel))
+    return;
+
+  subject->mEntry = std::make_shared<std::atomic<Subject *>>(subject);
+  mQueue.push(subject->mEntry);
+
+  if (mWake)
+    mWake();
+}
+
+void Dispatcher::cancel(Subject *subject) {
+
+  if (!subject->mQueued.load(std::memory_order_acquire) || !subject->mEntry)
+    return;
+
+  subject->mEntry->store(nullptr, std::memory_order_release);
+  subject->mEntry.reset();
+}
+
+void Dispatcher::setWake(std::function<void()> wake) {
+  mWake = std::move(wake);
+}
+
+size_t Dispatcher::drain() {
+
+  size_t count = 0;
+  Entry entry;
+
+  while (mQueue.pop(entry)) {
+
+    Subject *subject = entry->load(std::memory_order_acquire);
+
+    // Destroyed while queued
+    if (!subject)
+      continue;
+
+    // Cleared first so edits made while publishing queue it again
+    subject->mEntry.reset();
+    subject->mQueued.store(false, std::memory_order_release);
+    subject->publish();
+
+    mApplied.fetch_add(1, std::memory_order_relaxed);
+    count++;
+  }
+
+  return count;
+}
+
+bool Dispatcher::pending() const { return !mQueue.empty(); }
+
+uint64_t Dispatcher::received() const {
+  return mReceived.load(std::memory_order_relaxed);
+}
+
+uint64_t Dispatcher::applied() const {
+  return mApplied.load(std::memory_order_relaxed);
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
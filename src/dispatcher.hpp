@@ -0,0 +1,100 @@
+#pragma once
+#include "subject.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+// Intrusive multi-producer single-consumer queue (Vyukov). push is wait-free
+// for producers, pop is only called from the consumer thread.
+template <class T> class MpscQueue {
+
+public:
+  MpscQueue() : mHead{&mStub}, mTail{&mStub} {}
+
+  ~MpscQueue() {
+    T value;
+    while (pop(value)) {
+    }
+    if (mTail != &mStub)
+      delete mTail;
+  }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  void push(T value) {
+    Node *node = new Node;
+    node->value = std::move(value);
+
+    Node *prev = mHead.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // Consumer side only
+  bool empty() const {
+    return mTail->next.load(std::memory_order_acquire) == nullptr;
+  }
+
+  // May miss an item whose producer is between the two steps of push, it is
+  // picked up by the next pop.
+  bool pop(T &value) {
+    Node *tail = mTail;
+    Node *next = tail->next.load(std::memory_order_acquire);
+
+    if (!next)
+      return false;
+
+    value = std::move(next->value);
+    mTail = next;
+
+    if (tail != &mStub)
+      delete tail;
+
+    return true;
+  }
+
+private:
+  struct Node {
+    std::atomic<Node *> next{nullptr};
+    T value{};
+  };
+
+  std::atomic<Node *> mHead;
+  Node *mTail;
+  Node mStub;
+};
+
+// Collects notifications from any thread and publishes each dirty subject
+// once when the render thread drains it.
+class Dispatcher {
+
+public:
+  Dispatcher();
+  ~Dispatcher();
+
+  void post(Subject *subject);
+
+  // Leaves a queued subject's entry behind for drain to skip, called when the
+  // subject is destroyed
+  void cancel(Subject *subject);
+
+  // Called on the posting thread whenever a subject gets queued, so a render
+  // thread waiting for events can be woken. Set before producers start.
+  void setWake(std::function<void()> wake);
+
+  // Render thread only, publishes every queued subject
+  size_t drain();
+  bool pending() const;
+
+  uint64_t received() const;
+  uint64_t applied() const;
+
+private:
+  using Entry = std::shared_ptr<std::atomic<Subject *>>;
+
+  MpscQueue<Entry> mQueue;
+  std::atomic<uint64_t> mReceived;
+  std::atomic<uint64_t> mApplied;
+  std::function<void()> mWake;
+};
+
+} // namespace TRUCHAS_APP_NAMESPACE
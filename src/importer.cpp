@@ -0,0 +1,614 @@
+#include "importer.hpp"
+#include "log.hpp"
+#include "pch.hpp"
+#include "thread_pool.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+namespace {
+
+// Rough size of one text line, used to size text chunks
+const size_t TEXT_BYTES_PER_POINT = 32;
+
+// Tokens looked at per text line
+const int MAX_COLUMNS = 32;
+
+enum class PlyType {
+  int8,
+  uint8,
+  int16,
+  uint16,
+  int32,
+  uint32,
+  float32,
+  float64
+};
+
+bool parsePlyType(const std::string &name, PlyType &type) {
+
+  static const std::map<std::string, PlyType> types = {
+      {"char", PlyType::int8},      {"int8", PlyType::int8},
+      {"uchar", PlyType::uint8},    {"uint8", PlyType::uint8},
+      {"short", PlyType::int16},    {"int16", PlyType::int16},
+      {"ushort", PlyType::uint16},  {"uint16", PlyType::uint16},
+      {"int", PlyType::int32},      {"int32", PlyType::int32},
+      {"uint", PlyType::uint32},    {"uint32", PlyType::uint32},
+      {"float", PlyType::float32},  {"float32", PlyType::float32},
+      {"double", PlyType::float64}, {"float64", PlyType::float64}};
+
+  auto it = types.find(name);
+  if (it == types.end())
+    return false;
+
+  type = it->second;
+  return true;
+}
+
+size_t plyTypeSize(PlyType type) {
+
+  switch (type) {
+  case PlyType::int8:
+  case PlyType::uint8:
+    return 1;
+  case PlyType::int16:
+  case PlyType::uint16:
+    return 2;
+  case PlyType::int32:
+  case PlyType::uint32:
+  case PlyType::float32:
+    return 4;
+  case PlyType::float64:
+    return 8;
+  }
+  return 0;
+}
+
+float plyColorScale(PlyType type) {
+
+  switch (type) {
+  case PlyType::float32:
+  case PlyType::float64:
+    return 1.0f;
+  case PlyType::uint16:
+    return 1.0f / 65535.0f;
+  default:
+    return 1.0f / 255.0f;
+  }
+}
+
+template <class T> T readValue(const uint8_t *p, bool swap) {
+
+  std::array<uint8_t, sizeof(T)> bytes;
+  memcpy(bytes.data(), p, sizeof(T));
+
+  if (swap)
+    std::reverse(bytes.begin(), bytes.end());
+
+  T value;
+  memcpy(&value, bytes.data(), sizeof(T));
+  return value;
+}
+
+float readPlyValue(const uint8_t *p, PlyType type, bool swap) {
+
+  switch (type) {
+  case PlyType::int8:
+    return static_cast<float>(static_cast<int8_t>(*p));
+  case PlyType::uint8:
+    return static_cast<float>(*p);
+  case PlyType::int16:
+    return static_cast<float>(readValue<int16_t>(p, swap));
+  case PlyType::uint16:
+    return static_cast<float>(readValue<uint16_t>(p, swap));
+  case PlyType::int32:
+    return static_cast<float>(readValue<int32_t>(p, swap));
+  case PlyType::uint32:
+    return static_cast<float>(readValue<uint32_t>(p, swap));
+  case PlyType::float32:
+    return readValue<float>(p, swap);
+  case PlyType::float64:
+    return static_cast<float>(readValue<double>(p, swap));
+  }
+  return 0.0f;
+}
+
+const char *nextLine(const char *p, const char *end) {
+  const void *newline = memchr(p, '\n', static_cast<size_t>(end - p));
+  return newline ? static_cast<const char *>(newline) + 1 : end;
+}
+
+// Parses the complete lines in [begin, end). columns holds the token index of
+// x, y, z, red, green, blue, -1 when absent. A colorScale of 0 guesses per
+// line between 0..1 and 0..255 values.
+void parseLines(const char *begin, const char *end,
+                const std::array<int, 6> &columns, float colorScale,
+                std::vector<SnapshotVertex> &out) {
+
+  std::array<float, MAX_COLUMNS> values;
+  const bool hasColor = columns[3] >= 0 && columns[4] >= 0 && columns[5] >= 0;
+
+  for (const char *p = begin; p < end;) {
+
+    const char *lineEnd = nextLine(p, end);
+    int count = 0;
+
+    for (const char *q = p; q < lineEnd && count < MAX_COLUMNS;) {
+
+      while (q < lineEnd &&
+             (*q == ' ' || *q == '\t' || *q == ',' || *q == '\r' || *q == '\n'))
+        q++;
+
+      if (q == lineEnd || *q == '#')
+        break;
+
+      auto [next, error] = std::from_chars(q, lineEnd, values[count]);
+
+      // Headers and other non numeric lines are skipped
+      if (error != std::errc()) {
+        count = 0;
+        break;
+      }
+
+      count++;
+      q = next;
+    }
+
+    p = lineEnd;
+
+    if (count <= columns[0] || count <= columns[1] || count <= columns[2])
+      continue;
+
+    SnapshotVertex vertex;
+    vertex.pos = glm::vec3(values[columns[0]], values[columns[1]],
+                           values[columns[2]]);
+    vertex.col = glm::vec3(1.0f, 1.0f, 1.0f);
+
+    if (hasColor && count > columns[3] && count > columns[4] &&
+        count > columns[5]) {
+
+      glm::vec3 color(values[columns[3]], values[columns[4]],
+                      values[columns[5]]);
+
+      float scale = colorScale;
+      if (scale == 0.0f)
+        scale = (color.x > 1.0f || color.y > 1.0f || color.z > 1.0f)
+                    ? 1.0f / 255.0f
+                    : 1.0f;
+
+      vertex.col = color * scale;
+    }
+
+    out.push_back(vertex);
+  }
+}
+
+} // namespace
+
+struct PointCloudImporter::PlyLayout {
+  bool binary = false;
+  bool swap = false;
+  uint64_t count = 0;
+  size_t stride = 0;
+  size_t headerSize = 0;
+  float colorScale = 1.0f / 255.0f;
+
+  // x, y, z, red, green, blue
+  std::array<int, 6> columns{-1, -1, -1, -1, -1, -1};
+  std::array<size_t, 6> offsets{};
+  std::array<PlyType, 6> types{};
+};
+
+PointCloudImporter::PointCloudImporter(ThreadPool *pool, size_t chunkPoints,
+                                       size_t maxQueued)
+    : mPool{pool}, mChunkPoints{std::max<size_t>(chunkPoints, 1)},
+      mMaxQueued{std::max<size_t>(maxQueued, 1)}, mCancel{false},
+      mFinished{false}, mFailed{false}, mPoints{0}, mBytes{0}, mTotalBytes{0},
+      mElapsed{0} {}
+
+PointCloudImporter::~PointCloudImporter() { cancel(); }
+
+bool PointCloudImporter::start(const std::string &path) {
+
+  if (mThread.joinable())
+    return false;
+
+  if (!mFile.open(path)) {
+    LOG_ERROR("failed to open point cloud {}", path);
+    return false;
+  }
+
+  mPath = path;
+  mCancel = false;
+  mFinished = false;
+  mFailed = false;
+  mPoints = 0;
+  mBytes = 0;
+  mTotalBytes = mFile.size();
+  mElapsed = 0;
+  mStart = std::chrono::steady_clock::now();
+
+  mThread = std::thread(&PointCloudImporter::run, this);
+  return true;
+}
+
+void PointCloudImporter::cancel() {
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCancel = true;
+  }
+  mSpace.notify_all();
+
+  if (mThread.joinable())
+    mThread.join();
+}
+
+bool PointCloudImporter::ready() const {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  return !mReady.empty();
+}
+
+bool PointCloudImporter::poll(Chunk &chunk) {
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (mReady.empty())
+      return false;
+
+    chunk = std::move(mReady.front());
+    mReady.pop_front();
+  }
+  mSpace.notify_one();
+
+  return true;
+}
+
+void PointCloudImporter::recycle(Chunk &&chunk) {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (mSpare.size() < mMaxQueued)
+    mSpare.push_back(std::move(chunk));
+}
+
+bool PointCloudImporter::done() const {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mFinished && mReady.empty();
+}
+
+bool PointCloudImporter::failed() const { return mFailed; }
+
+ImportStats PointCloudImporter::stats() const {
+
+  ImportStats stats;
+  stats.points = mPoints;
+  stats.bytes = mBytes;
+  stats.totalBytes = mTotalBytes;
+
+  int64_t elapsed = mElapsed;
+  if (!mFinished)
+    elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - mStart)
+                  .count();
+
+  stats.seconds = static_cast<double>(elapsed) * 1e-6;
+  return stats;
+}
+
+void PointCloudImporter::run() {
+
+  const uint8_t *data = mFile.data();
+  size_t size = mFile.size();
+
+  bool ok;
+
+  if (size >= 4 && memcmp(data, "ply", 3) == 0 &&
+      (data[3] == '\n' || data[3] == '\r'))
+    ok = importPly();
+  else
+    ok = importText(data, data + size, {0, 1, 2, 3, 4, 5}, 0.0f,
+                    std::numeric_limits<uint64_t>::max());
+
+  finish(ok);
+}
+
+PointCloudImporter::Chunk PointCloudImporter::takeSpare() {
+
+  Chunk chunk;
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mSpare.empty()) {
+      chunk = std::move(mSpare.back());
+      mSpare.pop_back();
+    }
+  }
+
+  chunk.vertices.clear();
+  chunk.vertices.reserve(mChunkPoints);
+  return chunk;
+}
+
+bool PointCloudImporter::emit(Chunk &&chunk) {
+
+  if (chunk.vertices.empty())
+    return !mCancel;
+
+  chunk.min = chunk.max = chunk.vertices[0].pos;
+  for (const auto &vertex : chunk.vertices) {
+    chunk.min = glm::min(chunk.min, vertex.pos);
+    chunk.max = glm::max(chunk.max, vertex.pos);
+  }
+
+  size_t count = chunk.vertices.size();
+
+  std::unique_lock<std::mutex> lock(mMutex);
+  mSpace.wait(lock, [this] { return mCancel || mReady.size() < mMaxQueued; });
+
+  if (mCancel)
+    return false;
+
+  mReady.push_back(std::move(chunk));
+  mPoints += count;
+
+  return true;
+}
+
+void PointCloudImporter::finish(bool ok) {
+
+  mElapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                 std::chrono::steady_clock::now() - mStart)
+                 .count();
+
+  mFile.close();
+  mFailed = !ok;
+  mFinished = true;
+
+  if (!ok) {
+    if (!mCancel)
+      LOG_ERROR("import of {} failed after {} points", mPath, mPoints.load());
+    return;
+  }
+
+  ImportStats stats = this->stats();
+  LOG_INFO("imported {} points from {} in {:.2f}s, {:.0f} points/s",
+           stats.points, mPath, stats.seconds, stats.pointsPerSecond());
+}
+
+bool PointCloudImporter::importText(const uint8_t *begin, const uint8_t *end,
+                                    const std::array<int, 6> &columns,
+                                    float colorScale, uint64_t limit) {
+
+  const char *p = reinterpret_cast<const char *>(begin);
+  const char *last = reinterpret_cast<const char *>(end);
+
+  size_t parts = mPool ? mPool->size() + 1 : 1;
+  size_t chunkBytes = mChunkPoints * TEXT_BYTES_PER_POINT;
+
+  mParts.resize(parts);
+  std::vector<const char *> bounds(parts + 1);
+
+  uint64_t remaining = limit;
+
+  while (p < last && remaining > 0) {
+
+    if (mCancel)
+      return false;
+
+    const char *stop =
+        nextLine(p + std::min<size_t>(chunkBytes, last - p) - 1, last);
+
+    // Split on line boundaries so every part parses independently
+    bounds[0] = p;
+    for (size_t k = 1; k < parts; k++) {
+      const char *target = p + (stop - p) * k / parts;
+      bounds[k] = std::max(bounds[k - 1],
+                           target > p ? nextLine(target - 1, stop) : p);
+    }
+    bounds[parts] = stop;
+
+    auto parse = [&](size_t first, size_t count) {
+      for (size_t k = first; k < count; k++) {
+        mParts[k].clear();
+        parseLines(bounds[k], bounds[k + 1], columns, colorScale, mParts[k]);
+      }
+    };
+
+    if (mPool)
+      mPool->parallelFor(parts, parse);
+    else
+      parse(0, parts);
+
+    Chunk chunk = takeSpare();
+
+    for (const auto &part : mParts) {
+      size_t n = static_cast<size_t>(
+          std::min<uint64_t>(part.size(), remaining));
+      chunk.vertices.insert(chunk.vertices.end(), part.begin(),
+                            part.begin() + n);
+      remaining -= n;
+    }
+
+    mBytes += static_cast<uint64_t>(stop - p);
+    p = stop;
+
+    if (!emit(std::move(chunk)))
+      return false;
+  }
+
+  return true;
+}
+
+bool PointCloudImporter::importBinary(const uint8_t *begin, const uint8_t *end,
+                                      const PlyLayout &layout) {
+
+  uint64_t available = static_cast<uint64_t>(end - begin) / layout.stride;
+
+  if (available < layout.count)
+    LOG_WARN("{} is truncated, {} of {} vertices present", mPath, available,
+             layout.count);
+
+  uint64_t count = std::min(available, layout.count);
+  const bool hasColor = layout.columns[3] >= 0;
+
+  for (uint64_t first = 0; first < count; first += mChunkPoints) {
+
+    if (mCancel)
+      return false;
+
+    size_t n =
+        static_cast<size_t>(std::min<uint64_t>(mChunkPoints, count - first));
+    const uint8_t *source = begin + first * layout.stride;
+
+    Chunk chunk = takeSpare();
+    chunk.vertices.resize(n);
+
+    auto convert = [&](size_t from, size_t to) {
+      for (size_t i = from; i < to; i++) {
+
+        const uint8_t *record = source + i * layout.stride;
+        SnapshotVertex &vertex = chunk.vertices[i];
+
+        for (int c = 0; c < 3; c++)
+          vertex.pos[c] = readPlyValue(record + layout.offsets[c],
+                                       layout.types[c], layout.swap);
+
+        if (hasColor) {
+          for (int c = 0; c < 3; c++)
+            vertex.col[c] = readPlyValue(record + layout.offsets[3 + c],
+                                         layout.types[3 + c], layout.swap) *
+                            layout.colorScale;
+        } else {
+          vertex.col = glm::vec3(1.0f, 1.0f, 1.0f);
+        }
+      }
+    };
+
+    if (mPool)
+      mPool->parallelFor(n, convert, 1 << 14);
+    else
+      convert(0, n);
+
+    mBytes += n * layout.stride;
+
+    if (!emit(std::move(chunk)))
+      return false;
+  }
+
+  return true;
+}
+
+bool PointCloudImporter::importPly() {
+
+  const char *begin = reinterpret_cast<const char *>(mFile.data());
+  const char *end = begin + mFile.size();
+
+  PlyLayout layout;
+  bool inVertex = false;
+  bool seenElement = false;
+  int property = 0;
+
+  static const std::array<const char *, 6> names = {"x",   "y",     "z",
+                                                    "red", "green", "blue"};
+
+  const char *p = begin;
+
+  while (true) {
+
+    if (p >= end) {
+      LOG_ERROR("{} has no end_header", mPath);
+      return false;
+    }
+
+    const char *lineEnd = nextLine(p, end);
+    std::istringstream line(std::string(p, lineEnd));
+    p = lineEnd;
+
+    std::string keyword;
+    line >> keyword;
+
+    if (keyword == "end_header")
+      break;
+
+    if (keyword == "format") {
+
+      std::string format;
+      line >> format;
+
+      layout.binary = format != "ascii";
+      layout.swap = format == "binary_big_endian";
+
+      if (format != "ascii" && format != "binary_little_endian" &&
+          format != "binary_big_endian") {
+        LOG_ERROR("{} uses unknown ply format {}", mPath, format);
+        return false;
+      }
+
+    } else if (keyword == "element") {
+
+      std::string name;
+      uint64_t count = 0;
+      line >> name >> count;
+
+      inVertex = name == "vertex";
+
+      if (inVertex && seenElement) {
+        LOG_ERROR("{}: the vertex element has to come first", mPath);
+        return false;
+      }
+
+      if (inVertex)
+        layout.count = count;
+      seenElement = true;
+
+    } else if (keyword == "property" && inVertex) {
+
+      std::string typeName, name;
+      line >> typeName >> name;
+
+      PlyType type;
+      if (typeName == "list" || !parsePlyType(typeName, type)) {
+        LOG_ERROR("{}: unsupported vertex property {}", mPath, typeName);
+        return false;
+      }
+
+      for (size_t c = 0; c < names.size(); c++) {
+        if (name == names[c]) {
+          layout.columns[c] = property;
+          layout.offsets[c] = layout.stride;
+          layout.types[c] = type;
+        }
+      }
+
+      if (name == "red")
+        layout.colorScale = plyColorScale(type);
+
+      layout.stride += plyTypeSize(type);
+      property++;
+    }
+  }
+
+  if (layout.columns[0] < 0 || layout.columns[1] < 0 || layout.columns[2] < 0) {
+    LOG_ERROR("{} has no x, y, z vertex properties", mPath);
+    return false;
+  }
+
+  if (layout.columns[3] < 0 || layout.columns[4] < 0 || layout.columns[5] < 0)
+    layout.columns[3] = layout.columns[4] = layout.columns[5] = -1;
+
+  layout.headerSize = static_cast<size_t>(p - begin);
+  mBytes += layout.headerSize;
+
+  const uint8_t *body = mFile.data() + layout.headerSize;
+
+  if (layout.binary)
+    return importBinary(body, mFile.data() + mFile.size(), layout);
+
+  return importText(body, mFile.data() + mFile.size(), layout.columns,
+                    layout.colorScale, layout.count);
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -0,0 +1,98 @@
+#pragma once
+#include "snapshot.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+class ThreadPool;
+
+struct ImportStats {
+  uint64_t points = 0;
+  uint64_t bytes = 0;
+  uint64_t totalBytes = 0;
+  double seconds = 0.0;
+
+  double pointsPerSecond() const {
+    return seconds > 0.0 ? static_cast<double>(points) / seconds : 0.0;
+  }
+};
+
+// Streams an XYZ or PLY (ascii, binary little or big endian) point cloud.
+// The file is mapped and cut into chunks on a background thread, each chunk
+// is converted to vertices on the pool and queued for the render thread. At
+// most maxQueued chunks are waiting at any time, the reader blocks until the
+// consumer catches up, so host memory stays at a few chunk sizes.
+class PointCloudImporter {
+
+public:
+  struct Chunk {
+    std::vector<SnapshotVertex> vertices;
+    glm::vec3 min{0.0f};
+    glm::vec3 max{0.0f};
+  };
+
+  explicit PointCloudImporter(ThreadPool *pool = nullptr,
+                              size_t chunkPoints = 1 << 20,
+                              size_t maxQueued = 3);
+  ~PointCloudImporter();
+
+  PointCloudImporter(const PointCloudImporter &) = delete;
+  PointCloudImporter &operator=(const PointCloudImporter &) = delete;
+
+  bool start(const std::string &path);
+  void cancel();
+
+  // Consumer side, never blocks
+  bool ready() const;
+  bool poll(Chunk &chunk);
+
+  // Hands a consumed chunk back so its storage is reused
+  void recycle(Chunk &&chunk);
+
+  // Reading finished and every chunk was polled
+  bool done() const;
+  bool failed() const;
+
+  ImportStats stats() const;
+
+private:
+  struct PlyLayout;
+
+  void run();
+  bool importText(const uint8_t *begin, const uint8_t *end,
+                  const std::array<int, 6> &columns, float colorScale,
+                  uint64_t limit);
+  bool importBinary(const uint8_t *begin, const uint8_t *end,
+                    const PlyLayout &layout);
+  bool importPly();
+
+  Chunk takeSpare();
+  bool emit(Chunk &&chunk);
+  void finish(bool ok);
+
+  std::string mPath;
+  MappedFile mFile;
+  ThreadPool *mPool;
+  size_t mChunkPoints;
+  size_t mMaxQueued;
+
+  std::thread mThread;
+  mutable std::mutex mMutex;
+  std::condition_variable mSpace;
+  std::deque<Chunk> mReady;
+  std::vector<Chunk> mSpare;
+
+  // Per worker parse output, reused for every chunk
+  std::vector<std::vector<SnapshotVertex>> mParts;
+
+  std::atomic<bool> mCancel;
+  std::atomic<bool> mFinished;
+  std::atomic<bool> mFailed;
+  std::atomic<uint64_t> mPoints;
+  std::atomic<uint64_t> mBytes;
+  std::atomic<uint64_t> mTotalBytes;
+
+  std::chrono::steady_clock::time_point mStart;
+  std::atomic<int64_t> mElapsed;
+};
+
+} // namespace TRUCHAS_APP_NAMESPACE
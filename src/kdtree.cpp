@@ -0,0 +1,383 @@
+#include "kdtree.hpp"
+#include "thread_pool.hpp"
+#include "pch.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+namespace {
+
+const size_t PARALLEL_GRAIN = 1 << 15;
+const float INF = std::numeric_limits<float>::infinity();
+// Closer than this to the camera plane counts as behind it
+const float NEAR_W = 1e-6f;
+
+void forRange(ThreadPool *pool, size_t count,
+              const std::function<void(size_t, size_t)> &body,
+              size_t grain = PARALLEL_GRAIN) {
+  if (pool)
+    pool->parallelFor(count, body, grain);
+  else if (count > 0)
+    body(0, count);
+}
+
+// Squared distances in world units
+struct WorldMetric {
+  glm::vec3 center;
+
+  float distance(const glm::vec3 &p) const {
+    return glm::distance2(p, center);
+  }
+
+  float bound(const KdNode &node) const {
+    glm::vec3 d = glm::max(glm::max(node.min - center, center - node.max),
+                           glm::vec3(0.0f));
+    return glm::dot(d, d);
+  }
+};
+
+// Squared distances in pixels
+struct ScreenMetric {
+  glm::mat4 viewProj;
+  glm::vec2 viewport;
+  glm::vec2 cursor;
+
+  bool project(const glm::vec3 &p, glm::vec2 &pixel) const {
+
+    glm::vec4 clip = viewProj * glm::vec4(p, 1.0f);
+
+    if (clip.w <= NEAR_W)
+      return false;
+
+    pixel = glm::vec2((clip.x / clip.w * 0.5f + 0.5f) * viewport.x,
+                      (clip.y / clip.w * 0.5f + 0.5f) * viewport.y);
+    return true;
+  }
+
+  float distance(const glm::vec3 &p) const {
+
+    glm::vec2 pixel;
+    if (!project(p, pixel))
+      return INF;
+
+    glm::vec2 d = pixel - cursor;
+    return glm::dot(d, d);
+  }
+
+  // With every corner in front of the camera the box projects inside the
+  // rectangle around the projected corners
+  float bound(const KdNode &node) const {
+
+    glm::vec2 lo(std::numeric_limits<float>::max());
+    glm::vec2 hi(std::numeric_limits<float>::lowest());
+    int behind = 0;
+
+    for (int i = 0; i < 8; i++) {
+
+      glm::vec3 corner(i & 1 ? node.max.x : node.min.x,
+                       i & 2 ? node.max.y : node.min.y,
+                       i & 4 ? node.max.z : node.min.z);
+
+      glm::vec2 pixel;
+      if (!project(corner, pixel)) {
+        behind++;
+        continue;
+      }
+
+      lo = glm::min(lo, pixel);
+      hi = glm::max(hi, pixel);
+    }
+
+    if (behind == 8)
+      return INF;
+
+    // Crosses the camera plane, the projection is unbounded
+    if (behind > 0)
+      return 0.0f;
+
+    glm::vec2 d =
+        glm::max(glm::max(lo - cursor, cursor - hi), glm::vec2(0.0f));
+    return glm::dot(d, d);
+  }
+};
+
+bool closer(const PointHit &a, const PointHit &b) {
+  return a.distance < b.distance;
+}
+
+} // namespace
+
+void PointKdTree::build(std::span<const glm::vec3> positions,
+                        ThreadPool *pool) {
+
+  clear();
+
+  if (positions.empty())
+    return;
+
+  if (positions.size() > std::numeric_limits<uint32_t>::max())
+    throw std::length_error("too many points for one k-d tree");
+
+  uint32_t count = static_cast<uint32_t>(positions.size());
+
+  // Leaves hold at most LEAF_POINTS, halving puts the rest within one
+  while (((count - 1) >> mDepth) + 1 > LEAF_POINTS)
+    mDepth++;
+
+  mNodes.resize((size_t(2) << mDepth) - 1);
+
+  std::vector<Entry> entries(count);
+
+  forRange(pool, count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      entries[i] = {positions[i], static_cast<uint32_t>(i)};
+  });
+
+  mNodes[0].first = 0;
+  mNodes[0].count = count;
+
+  // Splits the top levels here until every worker has a few subtrees
+  uint32_t parallelLevel = 0;
+  size_t subtrees = pool ? 4 * (pool->size() + 1) : 1;
+
+  while ((size_t(1) << parallelLevel) < subtrees && parallelLevel < mDepth)
+    parallelLevel++;
+
+  for (uint32_t level = 0; level < parallelLevel; level++)
+    for (uint32_t n = (1u << level) - 1; n < (2u << level) - 1; n++)
+      split(entries, n, level, false);
+
+  uint32_t firstSubtree = (1u << parallelLevel) - 1;
+
+  forRange(
+      pool, size_t(1) << parallelLevel,
+      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          split(entries, firstSubtree + static_cast<uint32_t>(i),
+                parallelLevel, true);
+        }
+      },
+      1);
+
+  mOrder.resize(count);
+  mPoints.resize(count);
+
+  forRange(pool, count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      mOrder[i] = entries[i].index;
+      mPoints[i] = entries[i].position;
+    }
+  });
+
+  mStale.assign(count, 0);
+}
+
+void PointKdTree::split(std::vector<Entry> &entries, uint32_t node,
+                        uint32_t level, bool recurse) {
+
+  KdNode &current = mNodes[node];
+  uint32_t first = current.first;
+  uint32_t count = current.count;
+
+  Entry *begin = entries.data() + first;
+  Entry *end = begin + count;
+
+  glm::vec3 min(0.0f);
+  glm::vec3 max(0.0f);
+
+  if (count > 0) {
+    min = max = begin->position;
+
+    for (const Entry *it = begin + 1; it != end; it++) {
+      min = glm::min(min, it->position);
+      max = glm::max(max, it->position);
+    }
+  }
+
+  current.min = min;
+  current.max = max;
+
+  if (level == mDepth)
+    return;
+
+  // Median on the widest axis
+  glm::vec3 extent = max - min;
+  int axis = extent.x >= extent.y ? 0 : 1;
+  if (extent.z > extent[axis])
+    axis = 2;
+
+  uint32_t half = count / 2;
+
+  std::nth_element(begin, begin + half, end,
+                   [axis](const Entry &a, const Entry &b) {
+                     return a.position[axis] < b.position[axis];
+                   });
+
+  uint32_t left = 2 * node + 1;
+  uint32_t right = 2 * node + 2;
+
+  mNodes[left].first = first;
+  mNodes[left].count = half;
+  mNodes[right].first = first + half;
+  mNodes[right].count = count - half;
+
+  if (!recurse)
+    return;
+
+  split(entries, left, level + 1, true);
+  split(entries, right, level + 1, true);
+}
+
+void PointKdTree::clear() {
+
+  mNodes.clear();
+  mOrder.clear();
+  mPoints.clear();
+  mDepth = 0;
+  mStale.clear();
+  mChanged.clear();
+}
+
+void PointKdTree::markChanged(uint32_t index) {
+
+  if (index >= mStale.size())
+    mStale.resize(index + 1, 0);
+
+  if (mStale[index])
+    return;
+
+  mStale[index] = 1;
+  mChanged.push_back(index);
+}
+
+bool PointKdTree::needsRebuild() const {
+  return mChanged.size() > std::max(MIN_REBUILD_CHANGES, mOrder.size() / 16);
+}
+
+size_t PointKdTree::size() const { return mOrder.size(); }
+
+size_t PointKdTree::changedCount() const { return mChanged.size(); }
+
+const std::vector<KdNode> &PointKdTree::nodes() const { return mNodes; }
+
+const std::vector<uint32_t> &PointKdTree::order() const { return mOrder; }
+
+void PointKdTree::nearest(std::span<const glm::vec3> positions,
+                          const glm::vec3 &point, size_t k, float maxDistance,
+                          std::vector<PointHit> &hits) const {
+  search(positions, WorldMetric{point}, k, maxDistance * maxDistance, hits);
+}
+
+void PointKdTree::within(std::span<const glm::vec3> positions,
+                         const glm::vec3 &point, float radius,
+                         std::vector<PointHit> &hits) const {
+  search(positions, WorldMetric{point}, std::numeric_limits<size_t>::max(),
+         radius * radius, hits);
+}
+
+void PointKdTree::nearestOnScreen(std::span<const glm::vec3> positions,
+                                  const ScreenView &view,
+                                  const glm::vec2 &cursor, size_t k,
+                                  float maxPixels,
+                                  std::vector<PointHit> &hits) const {
+  search(positions, ScreenMetric{view.viewProj, view.viewport, cursor}, k,
+         maxPixels * maxPixels, hits);
+}
+
+template <typename Metric>
+void PointKdTree::search(std::span<const glm::vec3> positions,
+                         const Metric &metric, size_t k, float limit,
+                         std::vector<PointHit> &hits) const {
+
+  hits.clear();
+
+  if (k == 0)
+    return;
+
+  // Radius queries keep everything, nearest queries a max-heap of k
+  bool keepAll = k == std::numeric_limits<size_t>::max();
+  size_t count = positions.size();
+
+  auto consider = [&](uint32_t index, float distance) {
+
+    if (distance > limit || std::isinf(distance))
+      return;
+
+    if (keepAll) {
+      hits.push_back({index, distance});
+      return;
+    }
+
+    if (hits.size() < k) {
+      hits.push_back({index, distance});
+      std::push_heap(hits.begin(), hits.end(), closer);
+    } else if (distance < hits.front().distance) {
+      std::pop_heap(hits.begin(), hits.end(), closer);
+      hits.back() = {index, distance};
+      std::push_heap(hits.begin(), hits.end(), closer);
+    }
+
+    if (hits.size() == k)
+      limit = hits.front().distance;
+  };
+
+  for (uint32_t index : mChanged)
+    if (index < count)
+      consider(index, metric.distance(positions[index]));
+
+  if (!mNodes.empty()) {
+
+    // Depth first, nearer child first. Every level leaves at most one
+    // sibling behind, so the stack stays shallow.
+    std::array<std::pair<uint32_t, float>, 64> stack;
+    size_t top = 0;
+    stack[top++] = {0, metric.bound(mNodes[0])};
+
+    uint32_t firstLeaf = (1u << mDepth) - 1;
+
+    while (top > 0) {
+
+      auto [n, bound] = stack[--top];
+      const KdNode &node = mNodes[n];
+
+      if (bound > limit || std::isinf(bound) || node.count == 0)
+        continue;
+
+      if (n >= firstLeaf) {
+
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+
+          uint32_t index = mOrder[i];
+
+          if (index >= count || mStale[index])
+            continue;
+
+          consider(index, metric.distance(mPoints[i]));
+        }
+        continue;
+      }
+
+      uint32_t left = 2 * n + 1;
+      uint32_t right = 2 * n + 2;
+      float leftBound = metric.bound(mNodes[left]);
+      float rightBound = metric.bound(mNodes[right]);
+
+      if (leftBound < rightBound) {
+        stack[top++] = {right, rightBound};
+        stack[top++] = {left, leftBound};
+      } else {
+        stack[top++] = {left, leftBound};
+        stack[top++] = {right, rightBound};
+      }
+    }
+  }
+
+  if (keepAll)
+    std::sort(hits.begin(), hits.end(), closer);
+  else
+    std::sort_heap(hits.begin(), hits.end(), closer);
+
+  for (PointHit &hit : hits)
+    hit.distance = std::sqrt(hit.distance);
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
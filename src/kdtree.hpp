@@ -0,0 +1,97 @@
+#pragma once
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+class ThreadPool;
+
+struct KdNode {
+  glm::vec3 min;
+  // Range in order()
+  uint32_t first;
+  glm::vec3 max;
+  uint32_t count;
+};
+
+struct PointHit {
+  uint32_t index;
+  // World units, or pixels for screen queries
+  float distance;
+};
+
+// Camera a screen query measures in, Vulkan clip space with y down
+struct ScreenView {
+  glm::mat4 viewProj;
+  glm::vec2 viewport;
+};
+
+// Spatial index for snapping. A balanced k-d tree, node n has its children
+// at 2n + 1 and 2n + 2, so subtrees below the top levels are built in
+// parallel without sharing anything.
+//
+// Edits after the build don't touch the tree. Changed indices are only
+// marked, the tree skips them and queries test them one by one against the
+// current positions, until there are enough to be worth a rebuild.
+class PointKdTree {
+
+public:
+  static constexpr uint32_t LEAF_POINTS = 32;
+  // Changed points tolerated before needsRebuild(), at least
+  static constexpr size_t MIN_REBUILD_CHANGES = 1024;
+
+  void build(std::span<const glm::vec3> positions, ThreadPool *pool = nullptr);
+  void clear();
+
+  // index was added, moved or dropped since the build
+  void markChanged(uint32_t index);
+  bool needsRebuild() const;
+
+  // Points in the tree and points checked one by one
+  size_t size() const;
+  size_t changedCount() const;
+
+  const std::vector<KdNode> &nodes() const;
+  const std::vector<uint32_t> &order() const;
+
+  // positions are the current points, indices past its end are gone. Hits
+  // come sorted by distance and replace what was in hits.
+  void nearest(std::span<const glm::vec3> positions, const glm::vec3 &point,
+               size_t k, float maxDistance, std::vector<PointHit> &hits) const;
+  void within(std::span<const glm::vec3> positions, const glm::vec3 &point,
+              float radius, std::vector<PointHit> &hits) const;
+
+  // Same, with distances in pixels from cursor. Points behind the camera
+  // never match.
+  void nearestOnScreen(std::span<const glm::vec3> positions,
+                       const ScreenView &view, const glm::vec2 &cursor,
+                       size_t k, float maxPixels,
+                       std::vector<PointHit> &hits) const;
+
+private:
+  template <typename Metric>
+  void search(std::span<const glm::vec3> positions, const Metric &metric,
+              size_t k, float limit, std::vector<PointHit> &hits) const;
+
+  // Positions travel with their index while splitting, so partitioning
+  // stays in one contiguous array
+  struct Entry {
+    glm::vec3 position;
+    uint32_t index;
+  };
+
+  // Bounds node and partitions its range between the children, and their
+  // subtrees too when recurse is set
+  void split(std::vector<Entry> &entries, uint32_t node, uint32_t level,
+             bool recurse);
+
+  std::vector<KdNode> mNodes;
+  std::vector<uint32_t> mOrder;
+  // Positions in tree order, leaves scan them without indirection
+  std::vector<glm::vec3> mPoints;
+  uint32_t mDepth = 0;
+
+  // Set for indices the tree no longer speaks for, listed in mChanged
+  std::vector<uint8_t> mStale;
+  std::vector<uint32_t> mChanged;
+};
+
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -0,0 +1,420 @@
+#include "kernels.hpp"
+#include "pch.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||            \
+    defined(_M_IX86)
+#define TRUCHAS_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit the instructions inside functions marked for
+// them, MSVC always does
+#if defined(__GNUC__) || defined(__clang__)
+#define TRUCHAS_TARGET(features) __attribute__((target(features)))
+#else
+#define TRUCHAS_TARGET(features)
+#endif
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+static_assert(sizeof(glm::vec3) == 12, "kernels expect packed vec3");
+
+namespace {
+
+const float INF = std::numeric_limits<float>::infinity();
+
+const glm::vec3 &positionAt(const void *positions, size_t i, size_t stride) {
+  return *reinterpret_cast<const glm::vec3 *>(
+      static_cast<const uint8_t *>(positions) + i * stride);
+}
+
+// Scalar
+
+void boundsRange(const void *positions, size_t begin, size_t end,
+                 size_t stride, glm::vec3 &min, glm::vec3 &max) {
+  for (size_t i = begin; i < end; i++) {
+    const glm::vec3 &p = positionAt(positions, i, stride);
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+}
+
+void finishBounds(size_t count, glm::vec3 &min, glm::vec3 &max) {
+  if (count == 0)
+    min = max = glm::vec3(0.0f);
+}
+
+void boundsScalar(const void *positions, size_t count, size_t stride,
+                  glm::vec3 &min, glm::vec3 &max) {
+  min = glm::vec3(INF);
+  max = glm::vec3(-INF);
+  boundsRange(positions, 0, count, stride, min, max);
+  finishBounds(count, min, max);
+}
+
+void transformScalar(const glm::mat4 &m, const glm::vec3 *in, glm::vec3 *out,
+                     size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    glm::vec4 p = m * glm::vec4(in[i], 1.0f);
+    out[i] = glm::vec3(p.x, p.y, p.z);
+  }
+}
+
+void packRange(const glm::vec3 *points, const glm::vec3 *colors, float *dst,
+               size_t begin, size_t end) {
+  for (size_t i = begin; i < end; i++) {
+    float *v = dst + 6 * i;
+    v[0] = points[i].x;
+    v[1] = points[i].y;
+    v[2] = points[i].z;
+    v[3] = colors[i].x;
+    v[4] = colors[i].y;
+    v[5] = colors[i].z;
+  }
+}
+
+void packScalar(const glm::vec3 *points, const glm::vec3 *colors, float *dst,
+                size_t count) {
+  packRange(points, colors, dst, 0, count);
+}
+
+#ifdef TRUCHAS_KERNELS_X86
+
+// Lanes of a block of loads are folded into the component they hold. With
+// vec3 or Vertex strides a block always starts on a record, so lane l of
+// load j holds float (width * j + l) of a record, modulo its size.
+void foldLanes(const float *mins, const float *maxs, size_t lanes,
+               size_t floatsPerRecord, glm::vec3 &min, glm::vec3 &max) {
+  for (size_t l = 0; l < lanes; l++) {
+    size_t component = l % floatsPerRecord;
+    if (component < 3) {
+      min[component] = std::min(min[component], mins[l]);
+      max[component] = std::max(max[component], maxs[l]);
+    }
+  }
+}
+
+// SSE4.1
+
+TRUCHAS_TARGET("sse4.1")
+void boundsSse41(const void *positions, size_t count, size_t stride,
+                 glm::vec3 &min, glm::vec3 &max) {
+
+  min = glm::vec3(INF);
+  max = glm::vec3(-INF);
+
+  size_t done = 0;
+
+  if (stride == 12 || stride == 24) {
+
+    // Three loads of four floats
+    size_t floatsPerRecord = stride / 4;
+    size_t perBlock = 12 / floatsPerRecord;
+    size_t blocks = count / perBlock;
+
+    const float *f = static_cast<const float *>(positions);
+
+    __m128 lo[3], hi[3];
+    for (int j = 0; j < 3; j++) {
+      lo[j] = _mm_set1_ps(INF);
+      hi[j] = _mm_set1_ps(-INF);
+    }
+
+    for (size_t b = 0; b < blocks; b++, f += 12) {
+      for (int j = 0; j < 3; j++) {
+        __m128 v = _mm_loadu_ps(f + 4 * j);
+        lo[j] = _mm_min_ps(lo[j], v);
+        hi[j] = _mm_max_ps(hi[j], v);
+      }
+    }
+
+    alignas(16) float mins[12], maxs[12];
+    for (int j = 0; j < 3; j++) {
+      _mm_store_ps(mins + 4 * j, lo[j]);
+      _mm_store_ps(maxs + 4 * j, hi[j]);
+    }
+
+    foldLanes(mins, maxs, 12, floatsPerRecord, min, max);
+    done = blocks * perBlock;
+  }
+
+  boundsRange(positions, done, count, stride, min, max);
+  finishBounds(count, min, max);
+}
+
+TRUCHAS_TARGET("sse4.1")
+void transformSse41(const glm::mat4 &m, const glm::vec3 *in, glm::vec3 *out,
+                    size_t count) {
+
+  __m128 c0 = _mm_setr_ps(m[0][0], m[0][1], m[0][2], m[0][3]);
+  __m128 c1 = _mm_setr_ps(m[1][0], m[1][1], m[1][2], m[1][3]);
+  __m128 c2 = _mm_setr_ps(m[2][0], m[2][1], m[2][2], m[2][3]);
+  __m128 c3 = _mm_setr_ps(m[3][0], m[3][1], m[3][2], m[3][3]);
+
+  for (size_t i = 0; i < count; i++) {
+
+    __m128 r = _mm_add_ps(c3, _mm_mul_ps(c0, _mm_set1_ps(in[i].x)));
+    r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(in[i].y)));
+    r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(in[i].z)));
+
+    // Twelve bytes, a full store would run into the next input
+    _mm_storel_pi(reinterpret_cast<__m64 *>(&out[i]), r);
+    _mm_store_ss(&out[i].z, _mm_movehl_ps(r, r));
+  }
+}
+
+TRUCHAS_TARGET("sse4.1")
+void packSse41(const glm::vec3 *points, const glm::vec3 *colors, float *dst,
+               size_t count) {
+
+  size_t blocks = count / 4;
+
+  const float *p = reinterpret_cast<const float *>(points);
+  const float *c = reinterpret_cast<const float *>(colors);
+  float *out = dst;
+
+  // Four records from three loads of each stream, six stores
+  for (size_t b = 0; b < blocks; b++, p += 12, c += 12, out += 24) {
+
+    __m128 p0 = _mm_loadu_ps(p);
+    __m128 p1 = _mm_loadu_ps(p + 4);
+    __m128 p2 = _mm_loadu_ps(p + 8);
+    __m128 k0 = _mm_loadu_ps(c);
+    __m128 k1 = _mm_loadu_ps(c + 4);
+    __m128 k2 = _mm_loadu_ps(c + 8);
+
+    __m128 o0 = _mm_blend_ps(p0, _mm_shuffle_ps(k0, k0, 0x00), 0x8);
+
+    __m128 t = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(0, 0, 3, 3));
+    __m128 o1 = _mm_shuffle_ps(k0, t, _MM_SHUFFLE(2, 0, 2, 1));
+
+    t = _mm_shuffle_ps(p1, k0, _MM_SHUFFLE(3, 3, 1, 1));
+    __m128 o2 = _mm_shuffle_ps(t, k1, _MM_SHUFFLE(1, 0, 2, 0));
+
+    t = _mm_shuffle_ps(p2, k1, _MM_SHUFFLE(2, 2, 0, 0));
+    __m128 o3 = _mm_shuffle_ps(p1, t, _MM_SHUFFLE(2, 0, 3, 2));
+
+    t = _mm_shuffle_ps(k1, k2, _MM_SHUFFLE(0, 0, 3, 3));
+    __m128 o4 = _mm_shuffle_ps(t, p2, _MM_SHUFFLE(2, 1, 2, 0));
+
+    __m128 o5 = _mm_blend_ps(k2, _mm_shuffle_ps(p2, p2, 0xFF), 0x1);
+
+    _mm_storeu_ps(out, o0);
+    _mm_storeu_ps(out + 4, o1);
+    _mm_storeu_ps(out + 8, o2);
+    _mm_storeu_ps(out + 12, o3);
+    _mm_storeu_ps(out + 16, o4);
+    _mm_storeu_ps(out + 20, o5);
+  }
+
+  packRange(points, colors, dst, blocks * 4, count);
+}
+
+// AVX2
+
+TRUCHAS_TARGET("avx2")
+void boundsAvx2(const void *positions, size_t count, size_t stride,
+                glm::vec3 &min, glm::vec3 &max) {
+
+  min = glm::vec3(INF);
+  max = glm::vec3(-INF);
+
+  size_t done = 0;
+
+  if (stride == 12 || stride == 24) {
+
+    // Three loads of eight floats
+    size_t floatsPerRecord = stride / 4;
+    size_t perBlock = 24 / floatsPerRecord;
+    size_t blocks = count / perBlock;
+
+    const float *f = static_cast<const float *>(positions);
+
+    __m256 lo[3], hi[3];
+    for (int j = 0; j < 3; j++) {
+      lo[j] = _mm256_set1_ps(INF);
+      hi[j] = _mm256_set1_ps(-INF);
+    }
+
+    for (size_t b = 0; b < blocks; b++, f += 24) {
+      for (int j = 0; j < 3; j++) {
+        __m256 v = _mm256_loadu_ps(f + 8 * j);
+        lo[j] = _mm256_min_ps(lo[j], v);
+        hi[j] = _mm256_max_ps(hi[j], v);
+      }
+    }
+
+    alignas(32) float mins[24], maxs[24];
+    for (int j = 0; j < 3; j++) {
+      _mm256_store_ps(mins + 8 * j, lo[j]);
+      _mm256_store_ps(maxs + 8 * j, hi[j]);
+    }
+
+    foldLanes(mins, maxs, 24, floatsPerRecord, min, max);
+    done = blocks * perBlock;
+  }
+
+  boundsRange(positions, done, count, stride, min, max);
+  finishBounds(count, min, max);
+}
+
+TRUCHAS_TARGET("avx2,fma")
+void transformAvx2(const glm::mat4 &m, const glm::vec3 *in, glm::vec3 *out,
+                   size_t count) {
+
+  __m256 m00 = _mm256_set1_ps(m[0][0]), m01 = _mm256_set1_ps(m[0][1]),
+         m02 = _mm256_set1_ps(m[0][2]);
+  __m256 m10 = _mm256_set1_ps(m[1][0]), m11 = _mm256_set1_ps(m[1][1]),
+         m12 = _mm256_set1_ps(m[1][2]);
+  __m256 m20 = _mm256_set1_ps(m[2][0]), m21 = _mm256_set1_ps(m[2][1]),
+         m22 = _mm256_set1_ps(m[2][2]);
+  __m256 m30 = _mm256_set1_ps(m[3][0]), m31 = _mm256_set1_ps(m[3][1]),
+         m32 = _mm256_set1_ps(m[3][2]);
+
+  // Eight points span three loads. Every component sits in lanes of its
+  // own across the loads, so two blends and a permute gather it, and the
+  // same steps backwards scatter it again.
+  const __m256i xOrder = _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5);
+  const __m256i yOrder = _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6);
+  const __m256i yBack = _mm256_setr_epi32(5, 0, 3, 6, 1, 4, 7, 2);
+  const __m256i zOrder = _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7);
+
+  size_t blocks = count / 8;
+
+  const float *src = reinterpret_cast<const float *>(in);
+  float *dst = reinterpret_cast<float *>(out);
+
+  for (size_t b = 0; b < blocks; b++, src += 24, dst += 24) {
+
+    __m256 a = _mm256_loadu_ps(src);
+    __m256 c = _mm256_loadu_ps(src + 8);
+    __m256 e = _mm256_loadu_ps(src + 16);
+
+    __m256 x = _mm256_permutevar8x32_ps(
+        _mm256_blend_ps(_mm256_blend_ps(a, c, 0x92), e, 0x24), xOrder);
+    __m256 y = _mm256_permutevar8x32_ps(
+        _mm256_blend_ps(_mm256_blend_ps(a, c, 0x24), e, 0x49), yOrder);
+    __m256 z = _mm256_permutevar8x32_ps(
+        _mm256_blend_ps(_mm256_blend_ps(a, c, 0x49), e, 0x92), zOrder);
+
+    __m256 rx = _mm256_fmadd_ps(
+        m00, x, _mm256_fmadd_ps(m10, y, _mm256_fmadd_ps(m20, z, m30)));
+    __m256 ry = _mm256_fmadd_ps(
+        m01, x, _mm256_fmadd_ps(m11, y, _mm256_fmadd_ps(m21, z, m31)));
+    __m256 rz = _mm256_fmadd_ps(
+        m02, x, _mm256_fmadd_ps(m12, y, _mm256_fmadd_ps(m22, z, m32)));
+
+    // The x and z orders are their own inverse
+    __m256 tx = _mm256_permutevar8x32_ps(rx, xOrder);
+    __m256 ty = _mm256_permutevar8x32_ps(ry, yBack);
+    __m256 tz = _mm256_permutevar8x32_ps(rz, zOrder);
+
+    _mm256_storeu_ps(dst,
+                     _mm256_blend_ps(_mm256_blend_ps(tx, ty, 0x92), tz, 0x24));
+    _mm256_storeu_ps(dst + 8,
+                     _mm256_blend_ps(_mm256_blend_ps(tx, ty, 0x24), tz, 0x49));
+    _mm256_storeu_ps(dst + 16,
+                     _mm256_blend_ps(_mm256_blend_ps(tx, ty, 0x49), tz, 0x92));
+  }
+
+  transformSse41(m, in + blocks * 8, out + blocks * 8, count - blocks * 8);
+}
+
+bool cpuSupports(KernelLevel level) {
+
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_cpu_init();
+  if (level == KernelLevel::avx2)
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  if (level == KernelLevel::sse41)
+    return __builtin_cpu_supports("sse4.1");
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+
+  bool sse41 = (info[2] & (1 << 19)) != 0;
+  bool fma = (info[2] & (1 << 12)) != 0;
+  // The OS has to save the ymm registers too
+  bool osAvx = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+
+  __cpuidex(info, 7, 0);
+  bool avx2 = (info[1] & (1 << 5)) != 0;
+
+  if (level == KernelLevel::avx2)
+    return avx2 && fma && osAvx;
+  if (level == KernelLevel::sse41)
+    return sse41;
+#endif
+
+  return level == KernelLevel::scalar;
+}
+
+#else
+
+bool cpuSupports(KernelLevel level) { return level == KernelLevel::scalar; }
+
+#endif
+
+const KernelTable SCALAR_TABLE = {KernelLevel::scalar, "scalar", boundsScalar,
+                                  transformScalar, packScalar};
+
+#ifdef TRUCHAS_KERNELS_X86
+const KernelTable SSE41_TABLE = {KernelLevel::sse41, "sse4.1", boundsSse41,
+                                 transformSse41, packSse41};
+// Packing is bound by the stores, the SSE version already saturates them
+const KernelTable AVX2_TABLE = {KernelLevel::avx2, "avx2", boundsAvx2,
+                                transformAvx2, packSse41};
+#endif
+
+} // namespace
+
+KernelLevel supportedKernelLevel() {
+
+  static const KernelLevel level = [] {
+    for (KernelLevel candidate : {KernelLevel::avx2, KernelLevel::sse41})
+      if (cpuSupports(candidate))
+        return candidate;
+    return KernelLevel::scalar;
+  }();
+
+  return level;
+}
+
+const KernelTable &kernelTable(KernelLevel level) {
+
+  level = std::min(level, supportedKernelLevel());
+
+#ifdef TRUCHAS_KERNELS_X86
+  if (level == KernelLevel::avx2)
+    return AVX2_TABLE;
+  if (level == KernelLevel::sse41)
+    return SSE41_TABLE;
+#endif
+
+  return SCALAR_TABLE;
+}
+
+const KernelTable &kernels() {
+  static const KernelTable &table = kernelTable(supportedKernelLevel());
+  return table;
+}
+
+void computeBounds(const void *positions, size_t count, size_t stride,
+                   glm::vec3 &min, glm::vec3 &max) {
+  kernels().bounds(positions, count, stride, min, max);
+}
+
+void transformPoints(const glm::mat4 &m, const glm::vec3 *in, glm::vec3 *out,
+                     size_t count) {
+  kernels().transform(m, in, out, count);
+}
+
+void packVertices(const glm::vec3 *points, const glm::vec3 *colors, float *dst,
+                  size_t count) {
+  kernels().pack(points, colors, dst, count);
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
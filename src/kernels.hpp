@@ -0,0 +1,42 @@
+#pragma once
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+enum class KernelLevel : uint8_t { scalar, sse41, avx2 };
+
+// One implementation of every kernel. Positions are tightly packed vec3
+// unless a stride is given.
+struct KernelTable {
+  KernelLevel level;
+  const char *name;
+
+  // stride in bytes. 12 and 24, points and Vertex records, take the vector
+  // path. Empty ranges give zero bounds.
+  void (*bounds)(const void *positions, size_t count, size_t stride,
+                 glm::vec3 &min, glm::vec3 &max);
+
+  // Affine, w taken as 1. in and out may be the same array.
+  void (*transform)(const glm::mat4 &m, const glm::vec3 *in, glm::vec3 *out,
+                    size_t count);
+
+  // Interleaves into records of position then color, six floats each, the
+  // renderer's Vertex layout. dst may be mapped staging memory.
+  void (*pack)(const glm::vec3 *points, const glm::vec3 *colors, float *dst,
+               size_t count);
+};
+
+// Best level both the build and the CPU support, detected once
+KernelLevel supportedKernelLevel();
+
+// Table for level, or the best supported one below it
+const KernelTable &kernelTable(KernelLevel level);
+const KernelTable &kernels();
+
+void computeBounds(const void *positions, size_t count, size_t stride,
+                   glm::vec3 &min, glm::vec3 &max);
+void transformPoints(const glm::mat4 &m, const glm::vec3 *in, glm::vec3 *out,
+                     size_t count);
+void packVertices(const glm::vec3 *points, const glm::vec3 *colors, float *dst,
+                  size_t count);
+
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -0,0 +1,130 @@
+#include "log.hpp"
+#include "pch.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+const char *toString(LogLevel level) {
+
+  switch (level) {
+  case LogLevel::trace:
+    return "trace";
+  case LogLevel::debug:
+    return "debug";
+  case LogLevel::info:
+    return "info";
+  case LogLevel::warn:
+    return "warn";
+  case LogLevel::error:
+    return "error";
+  }
+  return "";
+}
+
+Logger &Logger::instance() {
+  static Logger logger;
+  return logger;
+}
+
+Logger::Logger()
+    : mRing{std::make_unique<Record[]>(CAPACITY)}, mHead{0}, mTail{0},
+      mWritten{0}, mConsumed{0}, mDropped{0}, mWake{0}, mParked{false},
+      mFlushing{0}, mStop{false} {
+
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0,
+                "ring capacity must be a power of two");
+
+  for (size_t i = 0; i < CAPACITY; i++)
+    mRing[i].sequence.store(i, std::memory_order_relaxed);
+
+  mSink = [](LogLevel level, std::string_view message) {
+    std::ostream &os = level >= LogLevel::warn ? std::cerr : std::cout;
+    os << "[" << toString(level) << "] " << message << '\n';
+  };
+
+  mThread = std::thread(&Logger::run, this);
+}
+
+Logger::~Logger() {
+
+  mStop = true;
+  mWake.fetch_add(1);
+  mWake.notify_one();
+
+  if (mThread.joinable())
+    mThread.join();
+
+  std::cout.flush();
+}
+
+void Logger::setSink(Sink sink) {
+
+  std::lock_guard<std::mutex> lock(mSinkMutex);
+  mSink = std::move(sink);
+}
+
+void Logger::flush() {
+
+  uint64_t target = mWritten.load();
+  mFlushing.fetch_add(1);
+
+  uint64_t consumed;
+  while ((consumed = mConsumed.load()) < target)
+    mConsumed.wait(consumed);
+
+  mFlushing.fetch_sub(1);
+}
+
+uint64_t Logger::dropped() const { return mDropped.load(); }
+
+bool Logger::drainOne(std::string &message) {
+
+  Record &record = mRing[mTail & (CAPACITY - 1)];
+
+  if (record.sequence.load(std::memory_order_acquire) != mTail + 1)
+    return false;
+
+  record.format(record.payload, message);
+  LogLevel level = record.level;
+
+  record.sequence.store(mTail + CAPACITY, std::memory_order_release);
+  mTail++;
+
+  {
+    std::lock_guard<std::mutex> lock(mSinkMutex);
+    mSink(level, message);
+  }
+
+  mConsumed.fetch_add(1);
+  if (mFlushing.load())
+    mConsumed.notify_all();
+
+  return true;
+}
+
+void Logger::run() {
+
+  std::string message;
+
+  while (true) {
+
+    bool stopping = mStop.load();
+
+    if (drainOne(message))
+      continue;
+
+    if (stopping)
+      return;
+
+    // Park until a producer publishes a record or the destructor stops us
+    uint32_t wake = mWake.load();
+    mParked.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (!drainOne(message) && !mStop.load())
+      mWake.wait(wake);
+
+    mParked.store(false, std::memory_order_relaxed);
+  }
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -0,0 +1,207 @@
+#pragma once
+
+// Lowest level compiled in, everything below expands to nothing.
+// 0 trace, 1 debug, 2 info, 3 warn, 4 error, 5 off
+#ifndef TRUCHAS_LOG_LEVEL
+#ifdef TRUCHAS_DEBUG
+#define TRUCHAS_LOG_LEVEL 1
+#else
+#define TRUCHAS_LOG_LEVEL 2
+#endif
+#endif
+
+#define TRUCHAS_LOG(level, ...)                                                \
+  ::TRUCHAS_APP_NAMESPACE::Logger::instance().write(level, __VA_ARGS__)
+
+#if TRUCHAS_LOG_LEVEL <= 0
+#define LOG_TRACE(...)                                                         \
+  TRUCHAS_LOG(::TRUCHAS_APP_NAMESPACE::LogLevel::trace, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) ((void)0)
+#endif
+
+#if TRUCHAS_LOG_LEVEL <= 1
+#define LOG_DEBUG(...)                                                         \
+  TRUCHAS_LOG(::TRUCHAS_APP_NAMESPACE::LogLevel::debug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#if TRUCHAS_LOG_LEVEL <= 2
+#define LOG_INFO(...)                                                          \
+  TRUCHAS_LOG(::TRUCHAS_APP_NAMESPACE::LogLevel::info, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if TRUCHAS_LOG_LEVEL <= 3
+#define LOG_WARN(...)                                                          \
+  TRUCHAS_LOG(::TRUCHAS_APP_NAMESPACE::LogLevel::warn, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+
+#if TRUCHAS_LOG_LEVEL <= 4
+#define LOG_ERROR(...)                                                         \
+  TRUCHAS_LOG(::TRUCHAS_APP_NAMESPACE::LogLevel::error, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+enum class LogLevel : uint8_t { trace, debug, info, warn, error };
+
+const char *toString(LogLevel level);
+
+// Asynchronous logger. write() copies the format string and arguments into a
+// bounded lock-free ring, formatting happens on a background thread. When the
+// ring is full the record is dropped and counted instead of blocking.
+class Logger {
+
+public:
+  using Sink = std::function<void(LogLevel level, std::string_view message)>;
+
+  static Logger &instance();
+
+  Logger();
+  ~Logger();
+
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+
+  // Format strings must outlive the record, use literals
+  template <class... Args>
+  void write(LogLevel level, std::format_string<Args...> fmt, Args &&...args);
+
+  // Replaces the default stdout/stderr sink, called on the drain thread
+  void setSink(Sink sink);
+
+  // Blocks until every record written so far reached the sink
+  void flush();
+
+  uint64_t dropped() const;
+
+private:
+  static const size_t CAPACITY = 4096;
+  static const size_t PAYLOAD_SIZE = 96;
+
+  struct Record {
+    std::atomic<size_t> sequence;
+    LogLevel level;
+    void (*format)(std::byte *payload, std::string &out);
+    alignas(std::max_align_t) std::byte payload[PAYLOAD_SIZE];
+  };
+
+  template <class Payload> void push(LogLevel level, Payload &&payload);
+
+  void run();
+  bool drainOne(std::string &message);
+
+  std::unique_ptr<Record[]> mRing;
+  std::atomic<size_t> mHead;
+  size_t mTail;
+
+  std::atomic<uint64_t> mWritten;
+  std::atomic<uint64_t> mConsumed;
+  std::atomic<uint64_t> mDropped;
+
+  // Producers only signal while the drain thread is parked on mWake, flush()
+  // is only signalled while a caller waits on mConsumed
+  std::atomic<uint32_t> mWake;
+  std::atomic<bool> mParked;
+  std::atomic<uint32_t> mFlushing;
+
+  std::mutex mSinkMutex;
+  Sink mSink;
+
+  std::atomic<bool> mStop;
+  std::thread mThread;
+};
+
+// Records outlive the call, so strings the caller only points to are copied
+template <class T, class D = std::decay_t<T>>
+using LogStored =
+    std::conditional_t<std::is_same_v<D, const char *> ||
+                           std::is_same_v<D, char *> ||
+                           std::is_same_v<D, std::string_view>,
+                       std::string, D>;
+
+template <class... Args>
+void Logger::write(LogLevel level, std::format_string<Args...> fmt,
+                   Args &&...args) {
+
+  struct Lazy {
+    std::string_view fmt;
+    std::tuple<LogStored<Args>...> args;
+  };
+
+  // Arguments that don't fit the record are formatted on the caller instead
+  if constexpr (sizeof(Lazy) <= PAYLOAD_SIZE &&
+                alignof(Lazy) <= alignof(std::max_align_t)) {
+    push(level,
+         Lazy{fmt.get(),
+              std::tuple<LogStored<Args>...>(std::forward<Args>(args)...)});
+  } else {
+    push(level, std::format(fmt, std::forward<Args>(args)...));
+  }
+}
+
+template <class Payload> void Logger::push(LogLevel level, Payload &&payload) {
+
+  using Stored = std::decay_t<Payload>;
+
+  size_t head = mHead.load(std::memory_order_relaxed);
+  Record *record;
+
+  // Bounded MPMC ring (Vyukov), only the drain thread consumes
+  while (true) {
+
+    record = &mRing[head & (CAPACITY - 1)];
+    size_t sequence = record->sequence.load(std::memory_order_acquire);
+    intptr_t diff = intptr_t(sequence) - intptr_t(head);
+
+    if (diff == 0) {
+      if (mHead.compare_exchange_weak(head, head + 1,
+                                      std::memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      mDropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      head = mHead.load(std::memory_order_relaxed);
+    }
+  }
+
+  new (record->payload) Stored(std::forward<Payload>(payload));
+  record->level = level;
+  record->format = [](std::byte *bytes, std::string &out) {
+    Stored *stored = std::launder(reinterpret_cast<Stored *>(bytes));
+
+    if constexpr (std::is_same_v<Stored, std::string>) {
+      out = std::move(*stored);
+    } else {
+      out = std::apply(
+          [&](auto &...args) {
+            return std::vformat(stored->fmt, std::make_format_args(args...));
+          },
+          stored->args);
+    }
+
+    stored->~Stored();
+  };
+
+  mWritten.fetch_add(1, std::memory_order_relaxed);
+  record->sequence.store(head + 1, std::memory_order_release);
+
+  // Pairs with the fence in run(), either we see the drain thread parked or
+  // it sees this record before going to sleep
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if (mParked.load(std::memory_order_relaxed)) {
+    mWake.fetch_add(1, std::memory_order_relaxed);
+    mWake.notify_one();
+  }
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
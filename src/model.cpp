@@ -1,22 +1,348 @@
 #include "model.hpp"
+#include "log.hpp"
+#include "weld.hpp"
 #include "pch.hpp"
 
-Model::Model() : mId{0} {}
+Model::Model() : Model(0) {}
 
-Model::Model(int id) : mId{id} {}
+Model::Model(int id)
+    : mId{id}, mNextPointId{0}, mRenderables{&mArena}, mIndexPool{nullptr},
+      mIndexStale{true} {}
 
 Model::~Model() {}
 
-void Model::addPoint(glm::vec3 p) {}
+uint32_t Model::addPoint(glm::vec3 p, glm::vec3 color) {
 
-void Model::notify() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return appendPoint(p, color);
+}
+
+uint32_t Model::appendPoint(glm::vec3 p, glm::vec3 color) {
+
+  uint32_t index = static_cast<uint32_t>(mRenderables.size());
+
+  mChanges.markAdded(index);
+  mIndex.markChanged(index);
+  mRenderables.append(p, color, 0, mNextPointId++);
+
+  if (!mPointSegments.empty())
+    mPointSegments.emplace_back();
+
+  return index;
+}
+
+uint32_t Model::findOrAppendPoint(glm::vec3 p, float tolerance) {
+
+  refreshIndex();
+
+  std::vector<TRUCHAS_APP_NAMESPACE::PointHit> hits;
+  mIndex.nearest(positions(), p, 1, tolerance, hits);
+
+  if (!hits.empty())
+    return hits[0].index;
+
+  return appendPoint(p, glm::vec3{1.0f, 1.0f, 1.0f});
+}
+
+void Model::setPoint(uint32_t index, glm::vec3 p) {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (index >= mRenderables.size())
+    throw std::out_of_range("point index out of range");
+
+  mRenderables.points[index] = p;
+  mChanges.markModified(index);
+  mIndex.markChanged(index);
+}
+
+void Model::removePoint(uint32_t index) {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (index >= mRenderables.size())
+    throw std::out_of_range("point index out of range");
+
+  // Swap with the last point so removal stays O(1)
+  uint32_t last = static_cast<uint32_t>(mRenderables.size()) - 1;
 
-  for (const auto &observer : observers) {
-    std::cout << "Model notifies." << std::endl;
-    observer->onNotify(mId, mRenderables);
+  if (index != last) {
+    mChanges.markModified(index);
+    mIndex.markChanged(index);
   }
+
+  mRenderables.swapErase(index);
+  mChanges.markRemoved(last);
+  mIndex.markChanged(last);
+
+  if (mPointSegments.empty())
+    return;
+
+  // Highest first, so the segments moved down are never still to remove
+  std::vector<uint32_t> dropped = mPointSegments[index];
+  std::sort(dropped.begin(), dropped.end(), std::greater<uint32_t>());
+  dropped.erase(std::unique(dropped.begin(), dropped.end()), dropped.end());
+
+  for (uint32_t segment : dropped)
+    removeSegment(segment);
+
+  // The last point now lives at index
+  if (index != last) {
+
+    for (uint32_t s : mPointSegments[last]) {
+
+      auto &segment = mRenderables.segments[s];
+
+      if (segment.a == last)
+        segment.a = index;
+      if (segment.b == last)
+        segment.b = index;
+
+      mChanges.markSegmentModified(s);
+    }
+
+    mPointSegments[index] = std::move(mPointSegments[last]);
+  }
+
+  mPointSegments.pop_back();
+}
+
+void Model::addSegment(uint32_t a, uint32_t b, uint32_t color) {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (a >= mRenderables.size() || b >= mRenderables.size())
+    throw std::out_of_range("segment endpoint out of range");
+
+  appendSegment(a, b, color);
+}
+
+void Model::appendSegment(uint32_t a, uint32_t b, uint32_t color) {
+
+  // Until the first segment points carry no lists at all
+  if (mPointSegments.empty())
+    mPointSegments.resize(mRenderables.size());
+
+  uint32_t index = static_cast<uint32_t>(mRenderables.segments.size());
+
+  mRenderables.segments.push_back({a, b, color, 0});
+  mChanges.markSegmentAdded(index);
+  linkSegment(index);
+}
+
+void Model::removeSegment(uint32_t index) {
+
+  auto &segments = mRenderables.segments;
+  uint32_t last = static_cast<uint32_t>(segments.size()) - 1;
+
+  unlinkSegment(index);
+
+  if (index != last) {
+    unlinkSegment(last);
+    segments[index] = segments[last];
+    linkSegment(index);
+    mChanges.markSegmentModified(index);
+  }
+
+  segments.pop_back();
+  mChanges.markSegmentRemoved(last);
+}
+
+void Model::linkSegment(uint32_t index) {
+
+  const auto &segment = mRenderables.segments[index];
+
+  mPointSegments[segment.a].push_back(index);
+  if (segment.b != segment.a)
+    mPointSegments[segment.b].push_back(index);
+}
+
+void Model::unlinkSegment(uint32_t index) {
+
+  const auto &segment = mRenderables.segments[index];
+
+  for (uint32_t point : {segment.a, segment.b}) {
+    auto &list = mPointSegments[point];
+    auto it = std::find(list.begin(), list.end(), index);
+    if (it != list.end())
+      list.erase(it);
+  }
+}
+
+void Model::rebuildAdjacency() {
+
+  mPointSegments.clear();
+
+  if (mRenderables.segments.empty())
+    return;
+
+  mPointSegments.resize(mRenderables.size());
+
+  for (uint32_t s = 0; s < mRenderables.segments.size(); s++)
+    linkSegment(s);
+}
+
+Edge Model::addEdge(glm::vec3 a, glm::vec3 b, uint32_t color,
+                    float weldTolerance) {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  Edge edge{findOrAppendPoint(a, weldTolerance),
+            findOrAppendPoint(b, weldTolerance)};
+
+  appendSegment(edge.a, edge.b, color);
+
+  return edge;
+}
+
+size_t Model::weld(float tolerance) {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  size_t removed =
+      TRUCHAS_APP_NAMESPACE::weldPoints(mRenderables, tolerance, mIndexPool);
+
+  if (removed == 0)
+    return 0;
+
+  LOG_DEBUG("model {} welded {} points", mId, removed);
+
+  mChanges.clear();
+  mChanges.full = true;
+  mIndexStale = true;
+  rebuildAdjacency();
+
+  return removed;
+}
+
+void Model::publish() {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (mChanges.empty())
+    return;
+
+  mChanges.base = mRenderables.generation;
+  mChanges.generation = ++mRenderables.generation;
+
+  LOG_DEBUG("model {} notifies generation {}, {} points", mId,
+            mChanges.generation, mRenderables.size());
+
+  forEachObserver([this](TRUCHAS_APP_NAMESPACE::Observer *observer) {
+    observer->onChange(mId, mRenderables, mChanges);
+  });
+
+  mChanges.clear();
+}
+
+void Model::sync(TRUCHAS_APP_NAMESPACE::Observer *observer) {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  observer->onNotify(mId, mRenderables);
 }
 
 void Model::clearRender() {
-  mRenderables = TRUCHAS_APP_NAMESPACE::RenderData{};
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  // The generation stays so observers can still tell deltas apart
+  mRenderables.clear();
+  mIndex.clear();
+  mPointSegments.clear();
+
+  mChanges.clear();
+  mChanges.full = true;
+}
+
+void Model::reserve(size_t count) {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  mRenderables.reserve(count);
+}
+
+bool Model::save(const std::string &path) const {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  return TRUCHAS_APP_NAMESPACE::SnapshotWriter::write(path, mRenderables);
+}
+
+void Model::load(const TRUCHAS_APP_NAMESPACE::Snapshot &snapshot) {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  // The generation stays ours, the file's only describes when it was saved
+  uint64_t generation = mRenderables.generation;
+  snapshot.read(mRenderables);
+  mRenderables.generation = generation;
+
+  mNextPointId = 0;
+  for (uint32_t id : mRenderables.ids)
+    mNextPointId = std::max(mNextPointId, id + 1);
+
+  mChanges.clear();
+  mChanges.full = true;
+  mIndexStale = true;
+  rebuildAdjacency();
+}
+
+void Model::buildIndex(TRUCHAS_APP_NAMESPACE::ThreadPool *pool) {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mIndexPool = pool;
+  mIndex.build(positions(), mIndexPool);
+  mIndexStale = false;
+}
+
+void Model::nearestPoints(glm::vec3 p, size_t k, float maxDistance,
+                          std::vector<TRUCHAS_APP_NAMESPACE::PointHit> &hits) {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  refreshIndex();
+  mIndex.nearest(positions(), p, k, maxDistance, hits);
+}
+
+void Model::pointsWithin(glm::vec3 p, float radius,
+                         std::vector<TRUCHAS_APP_NAMESPACE::PointHit> &hits) {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  refreshIndex();
+  mIndex.within(positions(), p, radius, hits);
+}
+
+void Model::nearestOnScreen(
+    const TRUCHAS_APP_NAMESPACE::ScreenView &view, glm::vec2 cursor, size_t k,
+    float maxPixels, std::vector<TRUCHAS_APP_NAMESPACE::PointHit> &hits) {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  refreshIndex();
+  mIndex.nearestOnScreen(positions(), view, cursor, k, maxPixels, hits);
+}
+
+void Model::refreshIndex() {
+
+  if (!mIndexStale && !mIndex.needsRebuild())
+    return;
+
+  mIndex.build(positions(), mIndexPool);
+  mIndexStale = false;
+}
+
+std::span<const glm::vec3> Model::positions() const {
+  return {mRenderables.points.data(), mRenderables.points.size()};
+}
+
+int Model::getId() const { return mId; }
+
+uint64_t Model::getGeneration() const {
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mRenderables.generation;
+}
+
+const TRUCHAS_APP_NAMESPACE::RenderData &Model::getRenderData() const {
+  return mRenderables;
 }
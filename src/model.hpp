@@ -1,7 +1,14 @@
 #pragma once
+#include "arena.hpp"
+#include "kdtree.hpp"
+#include "snapshot.hpp"
 #include "subject.hpp"
 
-class Edge {};
+// Segment by its endpoints, which every edge meeting there shares
+struct Edge {
+  uint32_t a;
+  uint32_t b;
+};
 
 class Model : public TRUCHAS_APP_NAMESPACE::Subject {
 
@@ -10,12 +17,82 @@ public:
   Model(int id);
   ~Model();
 
-  void addPoint(glm::vec3 p);
-  void notify() override;
+  // Returns the index of the new point
+  uint32_t addPoint(glm::vec3 p,
+                    glm::vec3 color = glm::vec3{1.0f, 1.0f, 1.0f});
+  void setPoint(uint32_t index, glm::vec3 p);
+  // Removing a point also drops the segments that use it
+  void removePoint(uint32_t index);
 
+  // Color is packed RGBA8, zero blends the endpoint colors
+  void addSegment(uint32_t a, uint32_t b, uint32_t color = 0);
+
+  // Segment between two positions. Endpoints within weldTolerance of an
+  // existing point reuse it, so connected edges store each vertex once.
+  Edge addEdge(glm::vec3 a, glm::vec3 b, uint32_t color = 0,
+               float weldTolerance = 0.0f);
+
+  // Merges points closer than tolerance, see weldPoints. Observers get a
+  // full resync when anything merged.
+  size_t weld(float tolerance = 0.0f);
+
+  // Called by the dispatcher on the render thread, or directly by notify
+  void publish() override;
+
+  // Full snapshot for an observer that just attached
+  void sync(TRUCHAS_APP_NAMESPACE::Observer *observer);
+
+  // Drops every point but keeps the stream capacity for the rebuild
   void clearRender();
+  void reserve(size_t count);
+
+  bool save(const std::string &path) const;
+
+  // Snapping queries over the points, see PointKdTree. The index is built on
+  // first use and rebuilt once enough edits piled up, on the pool last given
+  // to buildIndex.
+  void buildIndex(TRUCHAS_APP_NAMESPACE::ThreadPool *pool = nullptr);
+  void nearestPoints(glm::vec3 p, size_t k, float maxDistance,
+                     std::vector<TRUCHAS_APP_NAMESPACE::PointHit> &hits);
+  void pointsWithin(glm::vec3 p, float radius,
+                    std::vector<TRUCHAS_APP_NAMESPACE::PointHit> &hits);
+  void nearestOnScreen(const TRUCHAS_APP_NAMESPACE::ScreenView &view,
+                       glm::vec2 cursor, size_t k, float maxPixels,
+                       std::vector<TRUCHAS_APP_NAMESPACE::PointHit> &hits);
+
+  // Replaces every point, observers get a full resync on the next notify
+  void load(const TRUCHAS_APP_NAMESPACE::Snapshot &snapshot);
+
+  int getId() const;
+  uint64_t getGeneration() const;
+  const TRUCHAS_APP_NAMESPACE::RenderData &getRenderData() const;
 
 private:
+  // Callers hold mMutex
+  uint32_t appendPoint(glm::vec3 p, glm::vec3 color);
+  uint32_t findOrAppendPoint(glm::vec3 p, float tolerance);
+  void appendSegment(uint32_t a, uint32_t b, uint32_t color);
+  // Moves the last segment into index, like swapErase for points
+  void removeSegment(uint32_t index);
+  void linkSegment(uint32_t index);
+  void unlinkSegment(uint32_t index);
+  void rebuildAdjacency();
+  void refreshIndex();
+  std::span<const glm::vec3> positions() const;
+
   int mId;
+  // Edits may come from producer threads while the render thread publishes
+  mutable std::mutex mMutex;
+  uint32_t mNextPointId;
+  // Must outlive the streams allocated from it
+  TRUCHAS_APP_NAMESPACE::Arena mArena;
   TRUCHAS_APP_NAMESPACE::RenderData mRenderables;
-};
\ No newline at end of file
+  TRUCHAS_APP_NAMESPACE::ChangeSet mChanges;
+  // Segments using each point, so edits only touch their own. Built with
+  // the first segment, empty for plain point sets.
+  std::vector<std::vector<uint32_t>> mPointSegments;
+  TRUCHAS_APP_NAMESPACE::PointKdTree mIndex;
+  TRUCHAS_APP_NAMESPACE::ThreadPool *mIndexPool;
+  // Points were replaced wholesale, the index no longer tracks them
+  bool mIndexStale;
+};
@@ -1,14 +1,66 @@
 #include "observer.hpp"
+#include "log.hpp"
 #include "pch.hpp"
 
 namespace TRUCHAS_APP_NAMESPACE {
 
+RenderData::RenderData() : RenderData(std::pmr::get_default_resource()) {}
+
+RenderData::RenderData(std::pmr::memory_resource *resource)
+    : points{resource}, colors{resource}, flags{resource}, ids{resource},
+      segments{resource} {}
+
+void RenderData::append(const glm::vec3 &point, const glm::vec3 &color,
+                        uint32_t flag, uint32_t id) {
+  points.push_back(point);
+  colors.push_back(color);
+  flags.push_back(flag);
+  ids.push_back(id);
+}
+
+void RenderData::swapErase(uint32_t index) {
+
+  size_t last = points.size() - 1;
+
+  if (index != last) {
+    points[index] = points[last];
+    colors[index] = colors[last];
+    flags[index] = flags[last];
+    ids[index] = ids[last];
+  }
+
+  points.pop_back();
+  colors.pop_back();
+  flags.pop_back();
+  ids.pop_back();
+}
+
+void RenderData::reserve(size_t count) {
+  points.reserve(count);
+  colors.reserve(count);
+  flags.reserve(count);
+  ids.reserve(count);
+}
+
+void RenderData::clear() {
+  points.clear();
+  colors.clear();
+  flags.clear();
+  ids.clear();
+  segments.clear();
+}
+
 Observer::Observer() {}
 
 Observer::~Observer() {}
 
 void Observer::onNotify(int id, const RenderData &renderables) {
-  std::cout << renderables << std::endl;
+  LOG_TRACE("observer notified by {}, {} points", id, renderables.size());
+}
+
+void Observer::onChange(int id, const RenderData &renderables,
+                        const ChangeSet &changes) {
+  onNotify(id, renderables);
 }
 
-} // namespace TRUCHAS_APP_NAMESPACE
\ No newline at end of file
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -2,27 +2,137 @@
 
 namespace TRUCHAS_APP_NAMESPACE {
 
+// Line between two points of the same RenderData, by index
+struct Segment {
+  uint32_t a;
+  uint32_t b;
+  // Packed RGBA8, zero takes the endpoint colors
+  uint32_t color;
+  uint32_t flags;
+};
+
 class RenderData {
 
   friend std::ostream &operator<<(std::ostream &os, const RenderData &ri) {
 
-    os << "RenderItems:" << std::endl;
+    os << "RenderItems:\n";
 
     if (ri.points.empty())
       return os;
-    os << "Points:" << std::endl;
-    for (const auto &p : ri.points) {
-
-      os << std::format("P,{:.2f},{:.2f},{:.2f}", p.x, p.y, p.z);
-      os << std::endl;
-    }
-    os << std::endl;
+    os << "Points:\n";
+    for (const auto &p : ri.points)
+      os << std::format("P,{:.2f},{:.2f},{:.2f}\n", p.x, p.y, p.z);
+    os << '\n';
     return os;
   }
 
 public:
-  std::vector<glm::vec3> points;
-  std::vector<glm::vec3> gridLine;
+  RenderData();
+  explicit RenderData(std::pmr::memory_resource *resource);
+
+  // One entry per point in every stream. Each stream is contiguous and
+  // trivially copyable, so it can be memcpy'd into mapped staging memory.
+  std::pmr::vector<glm::vec3> points;
+  std::pmr::vector<glm::vec3> colors;
+  std::pmr::vector<uint32_t> flags;
+  std::pmr::vector<uint32_t> ids;
+
+  // Indexes into the point streams, kept valid across swapErase by the owner
+  std::pmr::vector<Segment> segments;
+
+  // Bumped by the owner on every notification
+  uint64_t generation = 0;
+
+  size_t size() const { return points.size(); }
+
+  void append(const glm::vec3 &point, const glm::vec3 &color, uint32_t flag,
+              uint32_t id);
+
+  // Moves the last point into index and drops the last slot
+  void swapErase(uint32_t index);
+
+  void reserve(size_t count);
+
+  // Keeps the capacity of every stream
+  void clear();
+};
+
+struct IndexRange {
+  uint32_t first;
+  uint32_t count;
+};
+
+// Point and segment ranges touched since the previous notification, in the
+// index space of the current RenderData. Ranges may reach past the stream's
+// size when an added entry was removed again before notifying; observers
+// clamp them.
+class ChangeSet {
+
+public:
+  // Previous generation the ranges are relative to
+  uint64_t base = 0;
+  uint64_t generation = 0;
+
+  // Ranges are meaningless, resync from the full RenderData
+  bool full = false;
+
+  std::vector<IndexRange> added;
+  std::vector<IndexRange> removed;
+  std::vector<IndexRange> modified;
+
+  std::vector<IndexRange> addedSegments;
+  std::vector<IndexRange> removedSegments;
+  std::vector<IndexRange> modifiedSegments;
+
+  void markAdded(uint32_t index) { mark(added, index); }
+  void markRemoved(uint32_t index) { mark(removed, index); }
+  void markModified(uint32_t index) { mark(modified, index); }
+
+  void markSegmentAdded(uint32_t index) { mark(addedSegments, index); }
+  void markSegmentRemoved(uint32_t index) { mark(removedSegments, index); }
+  void markSegmentModified(uint32_t index) { mark(modifiedSegments, index); }
+
+  bool segmentsChanged() const {
+    return !addedSegments.empty() || !removedSegments.empty() ||
+           !modifiedSegments.empty();
+  }
+
+  bool empty() const {
+    return !full && !segmentsChanged() && added.empty() && removed.empty() &&
+           modified.empty();
+  }
+
+  void clear() {
+    full = false;
+    added.clear();
+    removed.clear();
+    modified.clear();
+    addedSegments.clear();
+    removedSegments.clear();
+    modifiedSegments.clear();
+  }
+
+private:
+  static void mark(std::vector<IndexRange> &ranges, uint32_t index) {
+
+    if (!ranges.empty()) {
+      IndexRange &last = ranges.back();
+
+      if (index >= last.first && index < last.first + last.count)
+        return;
+      if (index == last.first + last.count) {
+        last.count++;
+        return;
+      }
+      if (index + 1 == last.first) {
+        last.first--;
+        last.count++;
+        return;
+      }
+    }
+
+    ranges.push_back({index, 1});
+  }
 };
 
 class Observer {
@@ -31,8 +141,14 @@ public:
   Observer();
   virtual ~Observer();
 
+  // Full snapshot, used for the initial sync and whenever a delta can't be
+  // applied
   virtual void onNotify(int id, const RenderData &renderables);
 
+  // Incremental update, defaults to the full snapshot path
+  virtual void onChange(int id, const RenderData &renderables,
+                        const ChangeSet &changes);
+
 private:
 };
-} // namespace TRUCHAS_APP_NAMESPACE
\ No newline at end of file
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -0,0 +1,414 @@
+#include "octree.hpp"
+#include "thread_pool.hpp"
+#include "pch.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+namespace {
+
+struct Keyed {
+  uint64_t code;
+  uint32_t index;
+
+  bool operator<(const Keyed &other) const {
+    return code < other.code || (code == other.code && index < other.index);
+  }
+};
+
+struct Frustum {
+  std::array<glm::vec4, 6> planes;
+  glm::mat4 viewProj;
+  float pixelScale;
+};
+
+struct Candidate {
+  float pixels;
+  uint32_t tree;
+  uint32_t node;
+
+  bool operator<(const Candidate &other) const {
+    return pixels < other.pixels;
+  }
+};
+
+const size_t PARALLEL_GRAIN = 1 << 15;
+
+void forRange(ThreadPool *pool, size_t count,
+              const std::function<void(size_t, size_t)> &body,
+              size_t grain = PARALLEL_GRAIN) {
+  if (pool)
+    pool->parallelFor(count, body, grain);
+  else if (count > 0)
+    body(0, count);
+}
+
+// Spreads the low 21 bits of v three bits apart
+uint64_t spreadBits(uint64_t v) {
+  v &= 0x1FFFFF;
+  v = (v | v << 32) & 0x1F00000000FFFF;
+  v = (v | v << 16) & 0x1F0000FF0000FF;
+  v = (v | v << 8) & 0x100F00F00F00F00F;
+  v = (v | v << 4) & 0x10C30C30C30C30C3;
+  v = (v | v << 2) & 0x1249249249249249;
+  return v;
+}
+
+// Sorts slices in parallel, then merges neighbouring slices pairwise
+void sortKeys(std::vector<Keyed> &keys, ThreadPool *pool) {
+
+  size_t parts = pool ? pool->size() + 1 : 1;
+  parts = std::max<size_t>(1, std::min(parts, keys.size() / PARALLEL_GRAIN));
+
+  std::vector<size_t> bounds(parts + 1);
+  for (size_t i = 0; i <= parts; i++)
+    bounds[i] = keys.size() * i / parts;
+
+  forRange(
+      pool, parts,
+      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+          std::sort(keys.begin() + bounds[i], keys.begin() + bounds[i + 1]);
+      },
+      1);
+
+  std::vector<Keyed> merged(keys.size());
+
+  for (size_t width = 1; width < parts; width *= 2) {
+
+    size_t pairs = (parts + 2 * width - 1) / (2 * width);
+
+    forRange(
+        pool, pairs,
+        [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+
+            size_t lo = bounds[std::min(parts, 2 * width * i)];
+            size_t mid = bounds[std::min(parts, 2 * width * i + width)];
+            size_t hi = bounds[std::min(parts, 2 * width * (i + 1))];
+
+            std::merge(keys.begin() + lo, keys.begin() + mid,
+                       keys.begin() + mid, keys.begin() + hi,
+                       merged.begin() + lo);
+          }
+        },
+        1);
+
+    keys.swap(merged);
+  }
+}
+
+Frustum makeFrustum(const LodView &view) {
+
+  const glm::mat4 &m = view.viewProj;
+
+  auto row = [&](int i) {
+    return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+  };
+
+  // Vulkan clip space, 0 <= z <= w
+  Frustum frustum;
+  frustum.planes = {row(3) + row(0), row(3) - row(0), row(3) + row(1),
+                    row(3) - row(1), row(2),          row(3) - row(2)};
+  frustum.viewProj = view.viewProj;
+  frustum.pixelScale = view.pixelScale;
+
+  return frustum;
+}
+
+bool intersects(const Frustum &frustum, const OctreeNode &node) {
+
+  for (const glm::vec4 &plane : frustum.planes) {
+
+    glm::vec3 corner(plane.x >= 0.0f ? node.max.x : node.min.x,
+                     plane.y >= 0.0f ? node.max.y : node.min.y,
+                     plane.z >= 0.0f ? node.max.z : node.min.z);
+
+    if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z +
+            plane.w <
+        0.0f)
+      return false;
+  }
+
+  return true;
+}
+
+// Largest projected radius over the views the node is visible in, negative
+// when it is visible in none
+float projectedSize(const std::vector<Frustum> &frusta,
+                    const OctreeNode &node) {
+
+  glm::vec3 center = (node.min + node.max) * 0.5f;
+  float radius = glm::length(node.max - node.min) * 0.5f;
+
+  float pixels = -1.0f;
+
+  for (const Frustum &frustum : frusta) {
+
+    if (!intersects(frustum, node))
+      continue;
+
+    float w = (frustum.viewProj * glm::vec4(center, 1.0f)).w;
+
+    // The camera is inside or right next to the node
+    if (w <= radius)
+      return std::numeric_limits<float>::max();
+
+    pixels = std::max(pixels, radius * frustum.pixelScale / w);
+  }
+
+  return pixels;
+}
+
+} // namespace
+
+void PointOctree::build(const glm::vec3 *positions, size_t count,
+                        size_t stride, ThreadPool *pool) {
+
+  mNodes.clear();
+  mOrder.clear();
+  mPointCount = count;
+
+  if (count == 0)
+    return;
+
+  // Slots are 32-bit and inner nodes add samples on top of the points
+  if (count > std::numeric_limits<uint32_t>::max() / 2)
+    throw std::length_error("too many points for one octree");
+
+  const uint8_t *base = reinterpret_cast<const uint8_t *>(positions);
+
+  auto position = [&](size_t i) -> const glm::vec3 & {
+    return *reinterpret_cast<const glm::vec3 *>(base + i * stride);
+  };
+
+  glm::vec3 min = position(0);
+  glm::vec3 max = min;
+  std::mutex boundsMutex;
+
+  forRange(pool, count, [&](size_t begin, size_t end) {
+    glm::vec3 lo = position(begin);
+    glm::vec3 hi = lo;
+
+    for (size_t i = begin + 1; i < end; i++) {
+      lo = glm::min(lo, position(i));
+      hi = glm::max(hi, position(i));
+    }
+
+    std::lock_guard<std::mutex> lock(boundsMutex);
+    min = glm::min(min, lo);
+    max = glm::max(max, hi);
+  });
+
+  // A cube, so every level halves all three axes
+  glm::vec3 extent = max - min;
+  float size = std::max({extent.x, extent.y, extent.z, 1e-6f});
+
+  const uint64_t cells = uint64_t(1) << MAX_LEVEL;
+  float scale = static_cast<float>(cells) / size;
+
+  std::vector<Keyed> keys(count);
+
+  forRange(pool, count, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+
+      glm::vec3 q = (position(i) - min) * scale;
+
+      uint64_t x = std::min(static_cast<uint64_t>(q.x), cells - 1);
+      uint64_t y = std::min(static_cast<uint64_t>(q.y), cells - 1);
+      uint64_t z = std::min(static_cast<uint64_t>(q.z), cells - 1);
+
+      keys[i] = {spreadBits(x) | spreadBits(y) << 1 | spreadBits(z) << 2,
+                 static_cast<uint32_t>(i)};
+    }
+  });
+
+  sortKeys(keys, pool);
+
+  // Breadth first, so the children of a node end up next to each other.
+  // Each node covers a range of the sorted keys.
+  std::vector<std::pair<uint32_t, uint32_t>> ranges;
+
+  mNodes.push_back({min, min + glm::vec3(size), 0, 0, 0, 0, 0});
+  ranges.push_back({0, static_cast<uint32_t>(count)});
+
+  for (uint32_t n = 0; n < mNodes.size(); n++) {
+
+    auto [begin, end] = ranges[n];
+    uint8_t level = mNodes[n].level;
+
+    if (end - begin <= MAX_LEAF_POINTS || level == MAX_LEVEL)
+      continue;
+
+    // Octant bits of this level, z y x from high to low
+    uint32_t shift = 3 * (MAX_LEVEL - 1 - level);
+    float half = (mNodes[n].max.x - mNodes[n].min.x) * 0.5f;
+    glm::vec3 origin = mNodes[n].min;
+
+    uint32_t firstChild = static_cast<uint32_t>(mNodes.size());
+    uint8_t childCount = 0;
+    uint32_t childBegin = begin;
+
+    for (uint32_t octant = 0; octant < 8 && childBegin < end; octant++) {
+
+      auto split = std::partition_point(
+          keys.begin() + childBegin, keys.begin() + end,
+          [&](const Keyed &key) { return ((key.code >> shift) & 7) <= octant; });
+
+      uint32_t childEnd = static_cast<uint32_t>(split - keys.begin());
+
+      if (childEnd == childBegin)
+        continue;
+
+      glm::vec3 childMin =
+          origin + glm::vec3(float(octant & 1), float((octant >> 1) & 1),
+                             float((octant >> 2) & 1)) *
+                       half;
+
+      mNodes.push_back({childMin, childMin + glm::vec3(half), 0, 0, 0, 0,
+                        static_cast<uint8_t>(level + 1)});
+      ranges.push_back({childBegin, childEnd});
+
+      childCount++;
+      childBegin = childEnd;
+    }
+
+    mNodes[n].firstChild = firstChild;
+    mNodes[n].childCount = childCount;
+  }
+
+  uint32_t slots = 0;
+
+  for (auto &node : mNodes) {
+    size_t n = &node - mNodes.data();
+    node.first = slots;
+    node.count = node.childCount > 0 ? NODE_POINTS
+                                     : ranges[n].second - ranges[n].first;
+    slots += node.count;
+  }
+
+  mOrder.resize(slots);
+
+  forRange(
+      pool, mNodes.size(),
+      [&](size_t begin, size_t end) {
+        for (size_t n = begin; n < end; n++) {
+
+          const OctreeNode &node = mNodes[n];
+          auto [first, last] = ranges[n];
+          uint64_t points = last - first;
+
+          // Keys are in Morton order, so an even stride through them is an
+          // evenly spread sample of the node
+          for (uint32_t i = 0; i < node.count; i++) {
+            uint64_t key = node.childCount > 0
+                               ? (2 * i + 1) * points / (2 * NODE_POINTS)
+                               : i;
+            mOrder[node.first + i] = keys[first + key].index;
+          }
+        }
+      },
+      16);
+}
+
+bool PointOctree::empty() const { return mNodes.empty(); }
+
+const std::vector<OctreeNode> &PointOctree::nodes() const { return mNodes; }
+
+const std::vector<uint32_t> &PointOctree::order() const { return mOrder; }
+
+size_t PointOctree::size() const { return mOrder.size(); }
+
+size_t PointOctree::pointCount() const { return mPointCount; }
+
+void PointOctree::gather(const void *src, void *dst, size_t elementSize,
+                         ThreadPool *pool) const {
+
+  const uint8_t *from = static_cast<const uint8_t *>(src);
+  uint8_t *to = static_cast<uint8_t *>(dst);
+
+  forRange(pool, mOrder.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      std::memcpy(to + i * elementSize, from + mOrder[i] * elementSize,
+                  elementSize);
+  });
+}
+
+size_t selectLod(std::span<const PointOctree *const> trees,
+                 std::span<const LodView> views, size_t budget,
+                 float minPixels, std::vector<std::vector<uint8_t>> &selected) {
+
+  std::vector<Frustum> frusta;
+  for (const LodView &view : views)
+    frusta.push_back(makeFrustum(view));
+
+  selected.resize(trees.size());
+
+  std::priority_queue<Candidate> queue;
+  size_t drawn = 0;
+
+  for (uint32_t t = 0; t < trees.size(); t++) {
+
+    const auto &nodes = trees[t]->nodes();
+    selected[t].assign(nodes.size(), 0);
+
+    if (nodes.empty())
+      continue;
+
+    float pixels = projectedSize(frusta, nodes[0]);
+
+    if (pixels < 0.0f)
+      continue;
+
+    selected[t][0] = 1;
+    drawn += nodes[0].count;
+    queue.push({pixels, t, 0});
+  }
+
+  std::vector<Candidate> children;
+
+  while (!queue.empty()) {
+
+    Candidate candidate = queue.top();
+    queue.pop();
+
+    if (candidate.pixels < minPixels)
+      break;
+
+    const auto &nodes = trees[candidate.tree]->nodes();
+    const OctreeNode &node = nodes[candidate.node];
+
+    if (node.childCount == 0)
+      continue;
+
+    children.clear();
+    size_t refined = 0;
+
+    for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount;
+         c++) {
+
+      float pixels = projectedSize(frusta, nodes[c]);
+
+      if (pixels < 0.0f)
+        continue;
+
+      children.push_back({pixels, candidate.tree, c});
+      refined += nodes[c].count;
+    }
+
+    // Keep the coarse node, smaller ones elsewhere may still fit
+    if (drawn - node.count + refined > budget)
+      continue;
+
+    drawn = drawn - node.count + refined;
+    selected[candidate.tree][candidate.node] = 0;
+
+    for (const Candidate &child : children) {
+      selected[child.tree][child.node] = 1;
+      queue.push(child);
+    }
+  }
+
+  return drawn;
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
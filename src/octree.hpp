@@ -0,0 +1,70 @@
+#pragma once
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+class ThreadPool;
+
+struct OctreeNode {
+  glm::vec3 min;
+  glm::vec3 max;
+  // Range in the node-contiguous order
+  uint32_t first;
+  uint32_t count;
+  // Children are stored next to each other
+  uint32_t firstChild;
+  uint8_t childCount;
+  uint8_t level;
+};
+
+// Level of detail for a point set. Inner nodes hold an evenly spread sample
+// of the points below them, leaves hold their points. Drawing any cut through
+// the tree covers the whole set, drawing the leaves draws every point once.
+// order() lists the source index of every slot, node by node, so a node is
+// one contiguous draw once the vertices are gathered in that order.
+class PointOctree {
+
+public:
+  static constexpr uint32_t NODE_POINTS = 4096;
+  static constexpr uint32_t MAX_LEAF_POINTS = 8192;
+  static constexpr uint8_t MAX_LEVEL = 21;
+
+  // stride is the distance between positions in bytes. Sorting and
+  // gathering run on pool when given.
+  void build(const glm::vec3 *positions, size_t count, size_t stride,
+             ThreadPool *pool = nullptr);
+
+  bool empty() const;
+
+  const std::vector<OctreeNode> &nodes() const;
+  const std::vector<uint32_t> &order() const;
+
+  // Writes the gathered copy of src, size() elements of elementSize bytes
+  void gather(const void *src, void *dst, size_t elementSize,
+              ThreadPool *pool = nullptr) const;
+
+  size_t size() const;
+
+  // Points the tree was built from, size() less the inner node samples
+  size_t pointCount() const;
+
+private:
+  std::vector<OctreeNode> mNodes;
+  std::vector<uint32_t> mOrder;
+  size_t mPointCount = 0;
+};
+
+struct LodView {
+  glm::mat4 viewProj;
+  // Pixels covered by one unit at distance w = 1
+  float pixelScale;
+};
+
+// Picks a cut through every tree. Nodes covering the most pixels in any view
+// are refined first, until refining would pass budget points or no visible
+// node is larger than minPixels. selected[t][n] is set for the nodes drawn
+// from trees[t]. Returns the number of points selected.
+size_t selectLod(std::span<const PointOctree *const> trees,
+                 std::span<const LodView> views, size_t budget,
+                 float minPixels, std::vector<std::vector<uint8_t>> &selected);
+
+} // namespace TRUCHAS_APP_NAMESPACE
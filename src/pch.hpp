@@ -1,15 +1,39 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <bitset>
 #include <cassert>
+#include <charconv>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
 #include <format>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <list>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <queue>
 #include <ostream>
 #include <set>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -0,0 +1,275 @@
+#include "readback.hpp"
+#include "checksum.hpp"
+#include "log.hpp"
+#include "pch.hpp"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include <stb_image_write.h>
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+namespace {
+
+// Largest payload of a stored deflate block
+const size_t STORED_BLOCK_SIZE = 65535;
+
+void putBigEndian(std::vector<uint8_t> &out, uint32_t value) {
+  out.push_back(static_cast<uint8_t>(value >> 24));
+  out.push_back(static_cast<uint8_t>(value >> 16));
+  out.push_back(static_cast<uint8_t>(value >> 8));
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+} // namespace
+
+ImageWriter::ImageWriter() : mStop{false}, mBusy{false}, mWritten{0} {
+  mThread = std::thread(&ImageWriter::run, this);
+}
+
+ImageWriter::~ImageWriter() {
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStop = true;
+  }
+  mWake.notify_one();
+
+  if (mThread.joinable())
+    mThread.join();
+}
+
+void ImageWriter::push(Job job) {
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mJobs.push_back(std::move(job));
+  }
+  mWake.notify_one();
+}
+
+void ImageWriter::flush() {
+
+  std::unique_lock<std::mutex> lock(mMutex);
+  mIdle.wait(lock, [this] { return mJobs.empty() && !mBusy; });
+}
+
+uint64_t ImageWriter::written() const { return mWritten.load(); }
+
+void ImageWriter::run() {
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  while (true) {
+
+    mWake.wait(lock, [this] { return mStop || !mJobs.empty(); });
+
+    if (mJobs.empty()) {
+      if (mStop)
+        return;
+      continue;
+    }
+
+    Job job = std::move(mJobs.front());
+    mJobs.pop_front();
+    mBusy = true;
+
+    lock.unlock();
+
+    encode(job);
+
+    if (job.release)
+      job.release();
+
+    lock.lock();
+
+    mBusy = false;
+    if (mJobs.empty())
+      mIdle.notify_all();
+  }
+}
+
+void ImageWriter::encode(const Job &job) {
+
+  const ReadbackView &view = job.view;
+
+  const uint8_t *pixels = view.data;
+  int stride = static_cast<int>(view.rowPitch);
+
+  // Swapchain images are usually BGRA, stb expects RGBA.
+  if (view.bgra) {
+
+    size_t rowBytes = static_cast<size_t>(view.width) * 4;
+    mScratch.resize(rowBytes * view.height);
+
+    for (uint32_t y = 0; y < view.height; y++) {
+
+      const uint8_t *src = view.data + static_cast<size_t>(y) * view.rowPitch;
+      uint8_t *dst = mScratch.data() + y * rowBytes;
+
+      for (uint32_t x = 0; x < view.width; x++) {
+        dst[4 * x + 0] = src[4 * x + 2];
+        dst[4 * x + 1] = src[4 * x + 1];
+        dst[4 * x + 2] = src[4 * x + 0];
+        dst[4 * x + 3] = 255;
+      }
+    }
+
+    pixels = mScratch.data();
+    stride = static_cast<int>(rowBytes);
+  }
+
+  if (stbi_write_png(job.path.c_str(), static_cast<int>(view.width),
+                     static_cast<int>(view.height), 4, pixels, stride) == 0) {
+    LOG_ERROR("failed to write {}", job.path);
+    return;
+  }
+
+  mWritten++;
+}
+
+PngStreamWriter::PngStreamWriter()
+    : mWidth{0}, mHeight{0}, mRows{0}, mAdlerA{1}, mAdlerB{0} {}
+
+PngStreamWriter::~PngStreamWriter() {
+  if (mFile.is_open())
+    close();
+}
+
+bool PngStreamWriter::open(const std::string &path, uint32_t width,
+                           uint32_t height) {
+
+  mFile.open(path, std::ios::binary | std::ios::trunc);
+
+  if (!mFile.is_open())
+    return false;
+
+  mWidth = width;
+  mHeight = height;
+  mRows = 0;
+  mAdlerA = 1;
+  mAdlerB = 0;
+  mBlock.clear();
+  mBlock.reserve(STORED_BLOCK_SIZE);
+
+  const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  mFile.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+  std::vector<uint8_t> header;
+  putBigEndian(header, width);
+  putBigEndian(header, height);
+  header.push_back(8); // bit depth
+  header.push_back(2); // truecolor
+  header.push_back(0); // deflate
+  header.push_back(0); // adaptive filtering
+  header.push_back(0); // no interlace
+
+  writeChunk("IHDR", header.data(), header.size());
+
+  // zlib header, no compression
+  const uint8_t zlib[] = {0x78, 0x01};
+  writeChunk("IDAT", zlib, sizeof(zlib));
+
+  return mFile.good();
+}
+
+bool PngStreamWriter::writeRows(const uint8_t *rgb, uint32_t rowCount) {
+
+  const uint8_t filter = 0;
+  size_t rowBytes = static_cast<size_t>(mWidth) * 3;
+
+  rowCount = std::min(rowCount, mHeight - mRows);
+
+  for (uint32_t y = 0; y < rowCount; y++) {
+    append(&filter, 1);
+    append(rgb + y * rowBytes, rowBytes);
+  }
+
+  mRows += rowCount;
+
+  return mFile.good();
+}
+
+bool PngStreamWriter::close() {
+
+  if (!mFile.is_open())
+    return false;
+
+  // Pad missing rows so the file is still a valid image
+  if (mRows < mHeight) {
+    std::vector<uint8_t> black(static_cast<size_t>(mWidth) * 3, 0);
+    while (mRows < mHeight)
+      writeRows(black.data(), 1);
+  }
+
+  writeBlock(true);
+  writeChunk("IEND", nullptr, 0);
+
+  bool ok = mFile.good();
+  mFile.close();
+
+  return ok;
+}
+
+uint32_t PngStreamWriter::rowsWritten() const { return mRows; }
+
+void PngStreamWriter::append(const uint8_t *data, size_t size) {
+
+  while (size > 0) {
+
+    if (mBlock.size() == STORED_BLOCK_SIZE)
+      writeBlock(false);
+
+    size_t count = std::min(size, STORED_BLOCK_SIZE - mBlock.size());
+
+    for (size_t i = 0; i < count; i++) {
+      mAdlerA = (mAdlerA + data[i]) % 65521;
+      mAdlerB = (mAdlerB + mAdlerA) % 65521;
+    }
+
+    mBlock.insert(mBlock.end(), data, data + count);
+    data += count;
+    size -= count;
+  }
+}
+
+void PngStreamWriter::writeBlock(bool final) {
+
+  uint16_t length = static_cast<uint16_t>(mBlock.size());
+
+  mChunk.clear();
+  mChunk.push_back(final ? 1 : 0);
+  mChunk.push_back(static_cast<uint8_t>(length));
+  mChunk.push_back(static_cast<uint8_t>(length >> 8));
+  mChunk.push_back(static_cast<uint8_t>(~length));
+  mChunk.push_back(static_cast<uint8_t>(~length >> 8));
+  mChunk.insert(mChunk.end(), mBlock.begin(), mBlock.end());
+
+  if (final)
+    putBigEndian(mChunk, (mAdlerB << 16) | mAdlerA);
+
+  writeChunk("IDAT", mChunk.data(), mChunk.size());
+
+  mBlock.clear();
+}
+
+void PngStreamWriter::writeChunk(const char *type, const uint8_t *data,
+                                 size_t size) {
+
+  std::vector<uint8_t> prefix;
+  putBigEndian(prefix, static_cast<uint32_t>(size));
+  mFile.write(reinterpret_cast<const char *>(prefix.data()), 4);
+
+  uint32_t crc = crc32(0, reinterpret_cast<const uint8_t *>(type), 4);
+  crc = crc32(crc, data, size);
+
+  mFile.write(type, 4);
+  if (size > 0)
+    mFile.write(reinterpret_cast<const char *>(data), size);
+
+  prefix.clear();
+  putBigEndian(prefix, crc);
+  mFile.write(reinterpret_cast<const char *>(prefix.data()), 4);
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -0,0 +1,83 @@
+#pragma once
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+// CPU side view of a finished readback. data points straight into the
+// persistently mapped readback buffer and stays valid until the slot is
+// released back to the renderer, swapchain resizes included.
+struct ReadbackView {
+  const uint8_t *data = nullptr;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t rowPitch = 0;
+  bool bgra = false;
+  uint64_t frame = 0;
+  uint32_t slot = 0;
+};
+
+// Background PNG encoder. Jobs reference the mapped readback memory directly
+// and hand the slot back through release() once the file is written.
+class ImageWriter {
+
+public:
+  struct Job {
+    std::string path;
+    ReadbackView view;
+    std::function<void()> release;
+  };
+
+  ImageWriter();
+  ~ImageWriter();
+
+  void push(Job job);
+  void flush();
+
+  uint64_t written() const;
+
+private:
+  void run();
+  void encode(const Job &job);
+
+  std::thread mThread;
+  std::mutex mMutex;
+  std::condition_variable mWake;
+  std::condition_variable mIdle;
+  std::deque<Job> mJobs;
+  std::vector<uint8_t> mScratch;
+  bool mStop;
+  bool mBusy;
+  std::atomic<uint64_t> mWritten;
+};
+
+// Writes an 8-bit RGB PNG a band of rows at a time. Rows go out as stored
+// (uncompressed) deflate blocks, so nothing but the current block is kept in
+// memory no matter how large the image is.
+class PngStreamWriter {
+
+public:
+  PngStreamWriter();
+  ~PngStreamWriter();
+
+  bool open(const std::string &path, uint32_t width, uint32_t height);
+  // False once the file can't be written, the image is then incomplete
+  bool writeRows(const uint8_t *rgb, uint32_t rowCount);
+  bool close();
+
+  uint32_t rowsWritten() const;
+
+private:
+  void writeChunk(const char *type, const uint8_t *data, size_t size);
+  void writeBlock(bool final);
+  void append(const uint8_t *data, size_t size);
+
+  std::ofstream mFile;
+  uint32_t mWidth;
+  uint32_t mHeight;
+  uint32_t mRows;
+  uint32_t mAdlerA;
+  uint32_t mAdlerB;
+  std::vector<uint8_t> mBlock;
+  std::vector<uint8_t> mChunk;
+};
+
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -4,3 +4,88 @@
 Sketch::Sketch() {}
 
 Sketch::~Sketch() {}
+
+uint32_t Sketch::addFreePoint(glm::vec3 p) {
+  return addEntity(EntityKind::freePoint, p);
+}
+
+uint32_t Sketch::addMidpoint(uint32_t a, uint32_t b) {
+
+  uint32_t entity = addEntity(
+      EntityKind::midpoint,
+      (mEntities.at(a).position + mEntities.at(b).position) * 0.5f);
+
+  mGraph.addEdge(a, entity);
+  mGraph.addEdge(b, entity);
+
+  return entity;
+}
+
+uint32_t Sketch::addEntity(EntityKind kind, glm::vec3 position) {
+
+  uint32_t entity = mGraph.addNode();
+  mEntities.push_back({kind, position, addPoint(position)});
+
+  // New entities go out with the next update
+  mGraph.markDirty(entity);
+
+  return entity;
+}
+
+void Sketch::addLine(uint32_t a, uint32_t b, uint32_t color) {
+  addSegment(mEntities.at(a).point, mEntities.at(b).point, color);
+}
+
+void Sketch::movePoint(uint32_t entity, glm::vec3 p) {
+
+  Entity &e = mEntities.at(entity);
+
+  if (e.kind != EntityKind::freePoint)
+    throw std::invalid_argument("only free points can be moved");
+
+  e.position = p;
+  mGraph.markDirty(entity);
+}
+
+glm::vec3 Sketch::getPosition(uint32_t entity) const {
+  return mEntities.at(entity).position;
+}
+
+size_t Sketch::update(TRUCHAS_APP_NAMESPACE::ThreadPool *pool) {
+
+  mGraph.evaluate([this](uint32_t entity) { evaluate(entity); }, mEvaluated,
+                  pool);
+
+  if (mEvaluated.empty())
+    return 0;
+
+  for (uint32_t entity : mEvaluated)
+    setPoint(mEntities[entity].point, mEntities[entity].position);
+
+  notify();
+
+  return mEvaluated.size();
+}
+
+void Sketch::evaluate(uint32_t entity) {
+
+  Entity &e = mEntities[entity];
+
+  switch (e.kind) {
+
+  case EntityKind::freePoint:
+    break;
+
+  case EntityKind::midpoint: {
+    const auto &inputs = mGraph.inputs(entity);
+    e.position = (mEntities[inputs[0]].position +
+                  mEntities[inputs[1]].position) *
+                 0.5f;
+    break;
+  }
+  }
+}
+
+const TRUCHAS_APP_NAMESPACE::DependencyGraph &Sketch::getGraph() const {
+  return mGraph;
+}
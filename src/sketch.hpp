@@ -1,11 +1,51 @@
 #pragma once
+#include "depgraph.hpp"
 #include "model.hpp"
 
+// Sketch entities are nodes of a dependency graph. Every entity owns one
+// model point; derived entities are recomputed from their inputs, but only
+// when an input changed since the last update().
 class Sketch : public Model {
 
 public:
   Sketch();
   ~Sketch();
 
+  // Returns the entity id
+  uint32_t addFreePoint(glm::vec3 p);
+  uint32_t addMidpoint(uint32_t a, uint32_t b);
+
+  // Segment between the model points of two entities
+  void addLine(uint32_t a, uint32_t b, uint32_t color = 0);
+
+  // Only free points can be moved, derived ones follow their inputs
+  void movePoint(uint32_t entity, glm::vec3 p);
+
+  glm::vec3 getPosition(uint32_t entity) const;
+
+  // Re-evaluates the entities that depend on an edit, on pool when given,
+  // writes their model points and notifies once. Returns how many entities
+  // were evaluated.
+  size_t update(TRUCHAS_APP_NAMESPACE::ThreadPool *pool = nullptr);
+
+  const TRUCHAS_APP_NAMESPACE::DependencyGraph &getGraph() const;
+
 private:
-};
\ No newline at end of file
+  enum class EntityKind : uint8_t { freePoint, midpoint };
+
+  struct Entity {
+    EntityKind kind;
+    glm::vec3 position;
+    uint32_t point;
+  };
+
+  uint32_t addEntity(EntityKind kind, glm::vec3 position);
+
+  // Runs on pool workers, writes nothing but the entity itself
+  void evaluate(uint32_t entity);
+
+  TRUCHAS_APP_NAMESPACE::DependencyGraph mGraph;
+  // Indexed by graph node
+  std::vector<Entity> mEntities;
+  std::vector<uint32_t> mEvaluated;
+};
@@ -0,0 +1,475 @@
+#include "snapshot.hpp"
+#include "checksum.hpp"
+#include "log.hpp"
+#include "pch.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+namespace {
+
+// Points converted per write while streaming
+const size_t WRITE_CHUNK = 1 << 16;
+
+uint64_t alignUp(uint64_t value) {
+  return (value + SNAPSHOT_ALIGNMENT - 1) & ~(SNAPSHOT_ALIGNMENT - 1);
+}
+
+// What the accessors read each element as, 0 for kinds this version skips
+uint32_t elementSizeOf(SnapshotBlockKind kind) {
+  switch (kind) {
+  case SnapshotBlockKind::vertices:
+    return sizeof(SnapshotVertex);
+  case SnapshotBlockKind::flags:
+  case SnapshotBlockKind::ids:
+    return sizeof(uint32_t);
+  case SnapshotBlockKind::segments:
+    return sizeof(Segment);
+  }
+  return 0;
+}
+
+uint32_t headerChecksum(SnapshotHeader header) {
+  header.headerChecksum = 0;
+  return crc32(0, reinterpret_cast<const uint8_t *>(&header), sizeof(header));
+}
+
+class BlockStream {
+
+public:
+  BlockStream(std::ofstream &file, SnapshotBlockKind kind, uint32_t elementSize)
+      : mFile{file} {
+
+    // Pad up to the block start
+    uint64_t position = static_cast<uint64_t>(mFile.tellp());
+    uint64_t offset = alignUp(position);
+
+    static const std::array<char, 4096> zeros{};
+    mFile.write(zeros.data(), static_cast<std::streamsize>(offset - position));
+
+    mBlock = {kind, elementSize, offset, 0, 0, 0};
+  }
+
+  void write(const void *data, size_t size) {
+    mFile.write(static_cast<const char *>(data),
+                static_cast<std::streamsize>(size));
+    mBlock.checksum =
+        crc32(mBlock.checksum, static_cast<const uint8_t *>(data), size);
+    mBlock.size += size;
+  }
+
+  const SnapshotBlock &block() const { return mBlock; }
+
+private:
+  std::ofstream &mFile;
+  SnapshotBlock mBlock;
+};
+
+} // namespace
+
+MappedFile::MappedFile()
+    : mData{nullptr}, mSize{0},
+#ifdef _WIN32
+      mFile{INVALID_HANDLE_VALUE}, mMapping{nullptr}
+#else
+      mFile{-1}
+#endif
+{
+}
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string &path) {
+
+  close();
+
+#ifdef _WIN32
+
+  mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (mFile == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(mFile, &size) || size.QuadPart == 0) {
+    close();
+    return false;
+  }
+  mSize = static_cast<size_t>(size.QuadPart);
+
+  mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mMapping) {
+    close();
+    return false;
+  }
+
+  mData = static_cast<const uint8_t *>(
+      MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+
+#else
+
+  mFile = ::open(path.c_str(), O_RDONLY);
+  if (mFile < 0)
+    return false;
+
+  struct stat info;
+  if (fstat(mFile, &info) != 0 || info.st_size == 0) {
+    close();
+    return false;
+  }
+  mSize = static_cast<size_t>(info.st_size);
+
+  void *data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+  if (data == MAP_FAILED) {
+    close();
+    return false;
+  }
+
+  // Blocks are read front to back
+  madvise(data, mSize, MADV_SEQUENTIAL);
+  mData = static_cast<const uint8_t *>(data);
+
+#endif
+
+  if (!mData) {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void MappedFile::close() {
+
+#ifdef _WIN32
+  if (mData)
+    UnmapViewOfFile(mData);
+  if (mMapping)
+    CloseHandle(mMapping);
+  if (mFile != INVALID_HANDLE_VALUE)
+    CloseHandle(mFile);
+  mMapping = nullptr;
+  mFile = INVALID_HANDLE_VALUE;
+#else
+  if (mData)
+    munmap(const_cast<uint8_t *>(mData), mSize);
+  if (mFile >= 0)
+    ::close(mFile);
+  mFile = -1;
+#endif
+
+  mData = nullptr;
+  mSize = 0;
+}
+
+const uint8_t *MappedFile::data() const { return mData; }
+
+size_t MappedFile::size() const { return mSize; }
+
+bool SnapshotWriter::write(const std::string &path, const RenderData &data) {
+
+  // Written next to the destination and renamed over it, so a reader that
+  // has the old file mapped keeps it and a failed write leaves it intact
+  std::string tempPath = path + ".tmp";
+  std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+
+  if (!file.is_open()) {
+    LOG_ERROR("failed to open snapshot {}", tempPath);
+    return false;
+  }
+
+  const size_t count = data.size();
+
+  SnapshotHeader header{};
+  header.magic = SNAPSHOT_MAGIC;
+  header.version = SNAPSHOT_VERSION;
+  header.headerSize = sizeof(SnapshotHeader);
+  header.blockCount = 4;
+  header.pointCount = count;
+  header.generation = data.generation;
+
+  std::array<SnapshotBlock, 4> blocks{};
+
+  // Reserve the header and table, they are filled in once the checksums are
+  // known
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(blocks.data()),
+             sizeof(SnapshotBlock) * blocks.size());
+
+  glm::vec3 min = count > 0 ? data.points[0] : glm::vec3(0.0f);
+  glm::vec3 max = min;
+
+  {
+    BlockStream stream(file, SnapshotBlockKind::vertices,
+                       sizeof(SnapshotVertex));
+    std::vector<SnapshotVertex> chunk(std::min(count, WRITE_CHUNK));
+
+    for (size_t first = 0; first < count; first += WRITE_CHUNK) {
+
+      size_t n = std::min(WRITE_CHUNK, count - first);
+
+      for (size_t i = 0; i < n; i++) {
+        const glm::vec3 &p = data.points[first + i];
+        chunk[i] = {p, data.colors[first + i]};
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+      }
+
+      stream.write(chunk.data(), sizeof(SnapshotVertex) * n);
+    }
+
+    blocks[0] = stream.block();
+  }
+
+  {
+    BlockStream stream(file, SnapshotBlockKind::flags, sizeof(uint32_t));
+    stream.write(data.flags.data(), sizeof(uint32_t) * count);
+    blocks[1] = stream.block();
+  }
+
+  {
+    BlockStream stream(file, SnapshotBlockKind::ids, sizeof(uint32_t));
+    stream.write(data.ids.data(), sizeof(uint32_t) * count);
+    blocks[2] = stream.block();
+  }
+
+  {
+    BlockStream stream(file, SnapshotBlockKind::segments, sizeof(Segment));
+    stream.write(data.segments.data(), sizeof(Segment) * data.segments.size());
+    blocks[3] = stream.block();
+  }
+
+  for (int i = 0; i < 3; i++) {
+    header.boundsMin[i] = min[i];
+    header.boundsMax[i] = max[i];
+  }
+
+  header.tableChecksum =
+      crc32(0, reinterpret_cast<const uint8_t *>(blocks.data()),
+            sizeof(SnapshotBlock) * blocks.size());
+  header.headerChecksum = headerChecksum(header);
+
+  file.seekp(0);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(blocks.data()),
+             sizeof(SnapshotBlock) * blocks.size());
+  file.close();
+
+  std::error_code error;
+
+  if (!file.good()) {
+    LOG_ERROR("failed to write snapshot {}", path);
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+
+  std::filesystem::rename(tempPath, path, error);
+
+  if (error) {
+    LOG_ERROR("failed to replace snapshot {}: {}", path, error.message());
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+
+  return true;
+}
+
+bool Snapshot::open(const std::string &path) {
+
+  close();
+
+  if (!mFile.open(path)) {
+    LOG_ERROR("failed to map snapshot {}", path);
+    return false;
+  }
+
+  const uint8_t *base = mFile.data();
+  size_t size = mFile.size();
+
+  auto fail = [&](const char *reason) {
+    LOG_ERROR("invalid snapshot {}: {}", path, reason);
+    close();
+    return false;
+  };
+
+  if (size < sizeof(SnapshotHeader))
+    return fail("truncated header");
+
+  const auto *header = reinterpret_cast<const SnapshotHeader *>(base);
+
+  if (header->magic != SNAPSHOT_MAGIC)
+    return fail("not a snapshot");
+  if (header->version != SNAPSHOT_VERSION)
+    return fail("unsupported version");
+  if (header->headerSize != sizeof(SnapshotHeader) ||
+      header->headerChecksum != headerChecksum(*header))
+    return fail("corrupt header");
+
+  size_t tableSize = sizeof(SnapshotBlock) * header->blockCount;
+
+  if (size < sizeof(SnapshotHeader) + tableSize)
+    return fail("truncated block table");
+
+  const auto *blocks =
+      reinterpret_cast<const SnapshotBlock *>(base + sizeof(SnapshotHeader));
+
+  if (crc32(0, reinterpret_cast<const uint8_t *>(blocks), tableSize) !=
+      header->tableChecksum)
+    return fail("corrupt block table");
+
+  for (uint32_t i = 0; i < header->blockCount; i++) {
+
+    const SnapshotBlock &block = blocks[i];
+
+    if (block.offset % SNAPSHOT_ALIGNMENT != 0 || block.offset > size ||
+        block.size > size - block.offset)
+      return fail("block out of range");
+
+    uint32_t elementSize = elementSizeOf(block.kind);
+
+    if (block.elementSize == 0 ||
+        (elementSize != 0 && block.elementSize != elementSize))
+      return fail("block element size mismatch");
+
+    if (block.size % block.elementSize != 0 ||
+        (block.kind != SnapshotBlockKind::segments &&
+         block.size / block.elementSize != header->pointCount))
+      return fail("block size mismatch");
+  }
+
+  mHeader = header;
+  mBlocks = blocks;
+
+  if (!findBlock(SnapshotBlockKind::vertices))
+    return fail("missing vertex block");
+
+  return true;
+}
+
+void Snapshot::close() {
+  mFile.close();
+  mHeader = nullptr;
+  mBlocks = nullptr;
+}
+
+bool Snapshot::verify() const {
+
+  if (!mHeader)
+    return false;
+
+  for (uint32_t i = 0; i < mHeader->blockCount; i++) {
+
+    const SnapshotBlock &block = mBlocks[i];
+
+    if (crc32(0, mFile.data() + block.offset, block.size) != block.checksum)
+      return false;
+  }
+
+  return true;
+}
+
+const SnapshotHeader &Snapshot::header() const { return *mHeader; }
+
+size_t Snapshot::size() const {
+  return mHeader ? static_cast<size_t>(mHeader->pointCount) : 0;
+}
+
+const SnapshotBlock *Snapshot::findBlock(SnapshotBlockKind kind) const {
+
+  if (!mHeader)
+    return nullptr;
+
+  for (uint32_t i = 0; i < mHeader->blockCount; i++)
+    if (mBlocks[i].kind == kind)
+      return &mBlocks[i];
+
+  return nullptr;
+}
+
+std::span<const SnapshotVertex> Snapshot::vertices() const {
+
+  const SnapshotBlock *block = findBlock(SnapshotBlockKind::vertices);
+  if (!block)
+    return {};
+
+  return {reinterpret_cast<const SnapshotVertex *>(mFile.data() +
+                                                   block->offset),
+          size()};
+}
+
+std::span<const uint32_t> Snapshot::flags() const {
+
+  const SnapshotBlock *block = findBlock(SnapshotBlockKind::flags);
+  if (!block)
+    return {};
+
+  return {reinterpret_cast<const uint32_t *>(mFile.data() + block->offset),
+          size()};
+}
+
+std::span<const uint32_t> Snapshot::ids() const {
+
+  const SnapshotBlock *block = findBlock(SnapshotBlockKind::ids);
+  if (!block)
+    return {};
+
+  return {reinterpret_cast<const uint32_t *>(mFile.data() + block->offset),
+          size()};
+}
+
+std::span<const Segment> Snapshot::segments() const {
+
+  const SnapshotBlock *block = findBlock(SnapshotBlockKind::segments);
+  if (!block)
+    return {};
+
+  return {reinterpret_cast<const Segment *>(mFile.data() + block->offset),
+          static_cast<size_t>(block->size / sizeof(Segment))};
+}
+
+void Snapshot::read(RenderData &data) const {
+
+  auto vertices = this->vertices();
+  auto flags = this->flags();
+  auto ids = this->ids();
+
+  data.points.resize(vertices.size());
+  data.colors.resize(vertices.size());
+
+  for (size_t i = 0; i < vertices.size(); i++) {
+    data.points[i] = vertices[i].pos;
+    data.colors[i] = vertices[i].col;
+  }
+
+  if (flags.empty())
+    data.flags.assign(vertices.size(), 0);
+  else
+    data.flags.assign(flags.begin(), flags.end());
+
+  if (ids.empty()) {
+    data.ids.resize(vertices.size());
+    std::iota(data.ids.begin(), data.ids.end(), 0u);
+  } else {
+    data.ids.assign(ids.begin(), ids.end());
+  }
+
+  // Endpoints are checked here, observers index with them unchecked
+  data.segments.clear();
+  for (const Segment &segment : segments())
+    if (segment.a < vertices.size() && segment.b < vertices.size())
+      data.segments.push_back(segment);
+
+  data.generation = mHeader ? mHeader->generation : 0;
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
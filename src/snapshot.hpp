@@ -0,0 +1,123 @@
+#pragma once
+#include "observer.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+// Binary geometry snapshot, little endian:
+//
+//   SnapshotHeader
+//   SnapshotBlock[blockCount]
+//   blocks, each starting on a SNAPSHOT_ALIGNMENT boundary
+//
+// The vertex block already has the renderer's interleaved layout, so a
+// mapped file can be copied into staging memory as is.
+
+const uint32_t SNAPSHOT_MAGIC = 0x4E534354; // "TCSN"
+const uint16_t SNAPSHOT_VERSION = 1;
+const uint64_t SNAPSHOT_ALIGNMENT = 4096;
+
+// Segments are optional and the only block not sized by the point count
+enum class SnapshotBlockKind : uint32_t {
+  vertices = 1,
+  flags = 2,
+  ids = 3,
+  segments = 4
+};
+
+struct SnapshotVertex {
+  glm::vec3 pos;
+  glm::vec3 col;
+};
+
+struct SnapshotHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t headerSize;
+  uint32_t blockCount;
+  uint32_t tableChecksum;
+  uint64_t pointCount;
+  uint64_t generation;
+  float boundsMin[3];
+  float boundsMax[3];
+  uint32_t headerChecksum;
+  uint32_t reserved;
+};
+
+struct SnapshotBlock {
+  SnapshotBlockKind kind;
+  uint32_t elementSize;
+  uint64_t offset;
+  uint64_t size;
+  uint32_t checksum;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(SnapshotVertex) == 24);
+static_assert(sizeof(SnapshotHeader) == 64);
+static_assert(sizeof(SnapshotBlock) == 32);
+static_assert(sizeof(Segment) == 16);
+
+// Read-only file mapping
+class MappedFile {
+
+public:
+  MappedFile();
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool open(const std::string &path);
+  void close();
+
+  const uint8_t *data() const;
+  size_t size() const;
+
+private:
+  const uint8_t *mData;
+  size_t mSize;
+#ifdef _WIN32
+  void *mFile;
+  void *mMapping;
+#else
+  int mFile;
+#endif
+};
+
+// Streams a RenderData to disk a chunk at a time
+class SnapshotWriter {
+
+public:
+  static bool write(const std::string &path, const RenderData &data);
+};
+
+// Mapped snapshot. open() validates the header and block table only,
+// verify() also checks every block checksum.
+class Snapshot {
+
+public:
+  bool open(const std::string &path);
+  void close();
+
+  bool verify() const;
+
+  const SnapshotHeader &header() const;
+  size_t size() const;
+
+  std::span<const SnapshotVertex> vertices() const;
+  std::span<const uint32_t> flags() const;
+  std::span<const uint32_t> ids() const;
+  std::span<const Segment> segments() const;
+
+  // Copies the streams into data, which keeps its allocator
+  void read(RenderData &data) const;
+
+private:
+  const SnapshotBlock *findBlock(SnapshotBlockKind kind) const;
+
+  MappedFile mFile;
+  const SnapshotHeader *mHeader = nullptr;
+  const SnapshotBlock *mBlocks = nullptr;
+};
+
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -1,18 +1,95 @@
 #include "subject.hpp"
+#include "dispatcher.hpp"
+#include "thread_pool.hpp"
+#include "log.hpp"
 #include "pch.hpp"
 
 namespace TRUCHAS_APP_NAMESPACE {
 
-void Subject::addRender(Observer *observer) { observers.push_back(observer); }
+namespace {
 
-void Subject::removeRender(Observer *observer) {}
+// Below this a parallel fan-out costs more than it saves
+const size_t PARALLEL_FANOUT_MIN = 8;
+
+} // namespace
+
+Subject::Subject() : mObservers{std::make_shared<const ObserverList>()} {}
+
+Subject::~Subject() {
+  if (mDispatcher)
+    mDispatcher->cancel(this);
+}
+
+void Subject::addRender(Observer *observer) {
+
+  auto current = mObservers.load();
+  std::shared_ptr<const ObserverList> next;
+
+  do {
+    auto list = std::make_shared<ObserverList>(*current);
+    list->push_back(observer);
+    next = std::move(list);
+  } while (!mObservers.compare_exchange_weak(current, next));
+}
+
+void Subject::removeRender(Observer *observer) {
+
+  auto current = mObservers.load();
+  std::shared_ptr<const ObserverList> next;
+
+  do {
+    if (std::find(current->begin(), current->end(), observer) ==
+        current->end())
+      return;
+
+    auto list = std::make_shared<ObserverList>(*current);
+    list->erase(std::remove(list->begin(), list->end(), observer),
+                list->end());
+    next = std::move(list);
+  } while (!mObservers.compare_exchange_weak(current, next));
+}
+
+std::shared_ptr<const Subject::ObserverList> Subject::getObservers() const {
+  return mObservers.load();
+}
 
 void Subject::notify() {
 
-  for (const auto &observer : observers) {
-    std::cout << "Subject notifies." << std::endl;
-    observer->onNotify(int{0}, RenderData{});
+  if (mDispatcher)
+    mDispatcher->post(this);
+  else
+    publish();
+}
+
+void Subject::publish() {
+
+  LOG_DEBUG("subject notifies");
+
+  forEachObserver(
+      [](Observer *observer) { observer->onNotify(int{0}, RenderData{}); });
+}
+
+void Subject::setDispatcher(Dispatcher *dispatcher) {
+  mDispatcher = dispatcher;
+}
+
+void Subject::setThreadPool(ThreadPool *pool) { mPool = pool; }
+
+void Subject::forEachObserver(
+    const std::function<void(Observer *)> &fn) const {
+
+  auto observers = mObservers.load();
+
+  if (mPool && observers->size() >= PARALLEL_FANOUT_MIN) {
+    mPool->parallelFor(observers->size(), [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++)
+        fn((*observers)[i]);
+    });
+    return;
   }
+
+  for (auto *observer : *observers)
+    fn(observer);
 }
 
-} // namespace TRUCHAS_APP_NAMESPACE
\ No newline at end of file
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -4,16 +4,47 @@
 
 namespace TRUCHAS_APP_NAMESPACE {
 
+class Dispatcher;
+class ThreadPool;
+
 class Subject {
 
 public:
+  using ObserverList = std::vector<Observer *>;
+
+  Subject();
+  virtual ~Subject();
+
+  // Safe from any thread. The list is copied on write, so a notification
+  // already running keeps its snapshot and may still reach a removed observer.
   void addRender(Observer *observer);
   void removeRender(Observer *observer);
+
+  std::shared_ptr<const ObserverList> getObservers() const;
+
+  // Goes through the dispatcher when one is set, otherwise publishes now
   virtual void notify();
 
+  // Hands the current state to every observer
+  virtual void publish();
+
+  void setDispatcher(Dispatcher *dispatcher);
+
+  // Fan-out to many observers runs on the pool, which requires observers to
+  // accept calls from worker threads.
+  void setThreadPool(ThreadPool *pool);
+
 protected:
-  std::vector<Observer *> observers;
+  void forEachObserver(const std::function<void(Observer *)> &fn) const;
 
 private:
+  friend class Dispatcher;
+
+  std::atomic<std::shared_ptr<const ObserverList>> mObservers;
+  Dispatcher *mDispatcher = nullptr;
+  ThreadPool *mPool = nullptr;
+  std::atomic<bool> mQueued{false};
+  // Set while queued, cleared by the destructor so drain skips the entry
+  std::shared_ptr<std::atomic<Subject *>> mEntry;
 };
-} // namespace TRUCHAS_APP_NAMESPACE
\ No newline at end of file
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -0,0 +1,305 @@
+#include "tessellation.hpp"
+#include "thread_pool.hpp"
+#include "pch.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+namespace {
+
+const float TWO_PI = 6.28318530718f;
+// Clip w a curve reaching the camera plane is refined for
+const float MIN_DISTANCE = 1e-4f;
+const int MIN_BUCKET = -30;
+const int MAX_BUCKET = 30;
+// World tolerances of the finest and coarsest bucket
+const float MIN_TOLERANCE = 0x1p-30f;
+const float MAX_TOLERANCE = 0x1p30f;
+// Curves per task, a curve is a few hundred points at most
+const size_t CURVE_GRAIN = 16;
+
+void forRange(ThreadPool *pool, size_t count,
+              const std::function<void(size_t, size_t)> &body, size_t grain) {
+  if (pool)
+    pool->parallelFor(count, body, grain);
+  else if (count > 0)
+    body(0, count);
+}
+
+uint32_t clampSegments(float segments, uint32_t min) {
+  if (!(segments < static_cast<float>(CurveTessellator::MAX_SEGMENTS)))
+    return CurveTessellator::MAX_SEGMENTS;
+  return std::max(min, static_cast<uint32_t>(std::ceil(segments)));
+}
+
+int bucketOf(float tolerance) {
+  // A zero pixel scale or tolerance gives inf or NaN, keep log2 finite
+  if (!(tolerance > MIN_TOLERANCE))
+    return MIN_BUCKET;
+  if (!(tolerance < MAX_TOLERANCE))
+    return MAX_BUCKET;
+  return static_cast<int>(std::floor(std::log2(tolerance)));
+}
+
+glm::vec3 bezier(const glm::vec3 *c, float t) {
+  float s = 1.0f - t;
+  return c[0] * (s * s * s) + c[1] * (3.0f * s * s * t) +
+         c[2] * (3.0f * s * t * t) + c[3] * (t * t * t);
+}
+
+} // namespace
+
+Curve Curve::arc(glm::vec3 center, glm::vec3 xAxis, glm::vec3 yAxis,
+                 float radius, float start, float sweep) {
+
+  Curve curve;
+  curve.kind = CurveKind::arc;
+  curve.center = center;
+  curve.xAxis = xAxis;
+  curve.yAxis = yAxis;
+  curve.radius = radius;
+  curve.start = start;
+  curve.sweep = sweep;
+
+  return curve;
+}
+
+Curve Curve::circle(glm::vec3 center, glm::vec3 xAxis, glm::vec3 yAxis,
+                    float radius) {
+  return arc(center, xAxis, yAxis, radius, 0.0f, TWO_PI);
+}
+
+Curve Curve::spline(std::vector<glm::vec3> controls) {
+
+  Curve curve;
+  curve.kind = CurveKind::spline;
+  curve.controls = std::move(controls);
+
+  return curve;
+}
+
+uint32_t CurveTessellator::addCurve(Curve curve) {
+
+  uint32_t id = static_cast<uint32_t>(mCurves.size());
+
+  mCurves.emplace_back();
+  mCurves.back().curve = std::move(curve);
+  bound(mCurves.back());
+
+  return id;
+}
+
+void CurveTessellator::setCurve(uint32_t id, Curve curve) {
+
+  Entry &entry = mCurves.at(id);
+
+  entry.curve = std::move(curve);
+  entry.lods.clear();
+  entry.current = -1;
+  bound(entry);
+}
+
+size_t CurveTessellator::size() const { return mCurves.size(); }
+
+void CurveTessellator::bound(Entry &entry) {
+
+  const Curve &curve = entry.curve;
+
+  if (curve.kind == CurveKind::arc) {
+    entry.center = curve.center;
+    entry.radius = curve.radius;
+    return;
+  }
+
+  if (curve.controls.empty()) {
+    entry.center = glm::vec3(0.0f);
+    entry.radius = 0.0f;
+    return;
+  }
+
+  // The pieces stay inside the hull of their control points
+  glm::vec3 min = curve.controls[0];
+  glm::vec3 max = min;
+
+  for (const glm::vec3 &c : curve.controls) {
+    min = glm::min(min, c);
+    max = glm::max(max, c);
+  }
+
+  entry.center = (min + max) * 0.5f;
+  entry.radius = glm::length(max - min) * 0.5f;
+}
+
+size_t CurveTessellator::update(const TessellationView &view,
+                                ThreadPool *pool) {
+
+  mChanged.clear();
+
+  const glm::mat4 &m = view.viewProj;
+
+  // Clip w is affine in the position, this is its largest change per unit
+  float slope = glm::length(glm::vec3(m[0][3], m[1][3], m[2][3]));
+
+  std::vector<int> buckets(mCurves.size());
+
+  forRange(
+      pool, mCurves.size(),
+      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+
+          const Entry &entry = mCurves[i];
+
+          float w = (m * glm::vec4(entry.center, 1.0f)).w;
+          float reach = entry.radius * slope;
+
+          // Behind the camera, keep whatever it had
+          if (w + reach <= 0.0f) {
+            buckets[i] = entry.current >= 0
+                             ? entry.lods[entry.current].bucket
+                             : bucketOf(std::max(entry.radius, 1e-6f));
+            continue;
+          }
+
+          float nearest = std::max(w - reach, MIN_DISTANCE);
+          buckets[i] = bucketOf(view.tolerance * nearest / view.pixelScale);
+        }
+      },
+      1024);
+
+  std::vector<uint32_t> work;
+
+  for (uint32_t i = 0; i < mCurves.size(); i++) {
+
+    Entry &entry = mCurves[i];
+    int bucket = buckets[i];
+
+    if (entry.current >= 0 && entry.lods[entry.current].bucket == bucket)
+      continue;
+
+    auto cached = std::find_if(entry.lods.begin(), entry.lods.end(),
+                               [&](const Lod &lod) {
+                                 return lod.bucket == bucket;
+                               });
+
+    if (cached != entry.lods.end()) {
+      entry.current = static_cast<int>(cached - entry.lods.begin());
+      mChanged.push_back(i);
+      continue;
+    }
+
+    work.push_back(i);
+  }
+
+  forRange(
+      pool, work.size(),
+      [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+
+          Entry &entry = mCurves[work[k]];
+          int bucket = buckets[work[k]];
+
+          // Full, the bucket furthest from the new one goes
+          if (entry.lods.size() < MAX_CACHED_LODS) {
+            entry.lods.emplace_back();
+            entry.current = static_cast<int>(entry.lods.size()) - 1;
+          } else {
+            auto furthest = std::max_element(
+                entry.lods.begin(), entry.lods.end(),
+                [&](const Lod &a, const Lod &b) {
+                  return std::abs(a.bucket - bucket) <
+                         std::abs(b.bucket - bucket);
+                });
+            entry.current = static_cast<int>(furthest - entry.lods.begin());
+          }
+
+          Lod &lod = entry.lods[entry.current];
+          lod.bucket = bucket;
+          tessellate(entry.curve, std::ldexp(1.0f, bucket), lod.points);
+        }
+      },
+      CURVE_GRAIN);
+
+  mChanged.insert(mChanged.end(), work.begin(), work.end());
+  std::sort(mChanged.begin(), mChanged.end());
+
+  return work.size();
+}
+
+const std::vector<uint32_t> &CurveTessellator::changed() const {
+  return mChanged;
+}
+
+std::span<const glm::vec3> CurveTessellator::points(uint32_t id) const {
+
+  const Entry &entry = mCurves.at(id);
+
+  if (entry.current < 0)
+    return {};
+
+  return entry.lods[entry.current].points;
+}
+
+int CurveTessellator::bucket(uint32_t id) const {
+
+  const Entry &entry = mCurves.at(id);
+
+  return entry.current >= 0 ? entry.lods[entry.current].bucket
+                            : std::numeric_limits<int>::min();
+}
+
+void CurveTessellator::tessellate(const Curve &curve, float tolerance,
+                                  std::vector<glm::vec3> &points) {
+
+  points.clear();
+
+  if (curve.kind == CurveKind::arc) {
+
+    float sweep = std::abs(curve.sweep);
+    bool closed = sweep >= TWO_PI - 1e-6f;
+
+    // A chord over angle a strays r (1 - cos(a / 2)) from the arc
+    float segments = 0.0f;
+
+    if (curve.radius > tolerance) {
+      float step = 2.0f * std::acos(1.0f - tolerance / curve.radius);
+      segments = sweep / step;
+    }
+
+    uint32_t count = clampSegments(segments, closed ? 3 : 1);
+    points.resize(count + 1);
+
+    for (uint32_t i = 0; i <= count; i++) {
+
+      float angle = curve.start + curve.sweep * i / count;
+
+      points[i] = curve.center + curve.radius * (std::cos(angle) * curve.xAxis +
+                                                 std::sin(angle) * curve.yAxis);
+    }
+
+    return;
+  }
+
+  const std::vector<glm::vec3> &c = curve.controls;
+
+  if (c.size() < 4) {
+    points.assign(c.begin(), c.end());
+    return;
+  }
+
+  points.push_back(c[0]);
+
+  for (size_t first = 0; first + 3 < c.size(); first += 3) {
+
+    const glm::vec3 *piece = c.data() + first;
+
+    // Wang's bound for a cubic, from its largest second difference
+    float bend = std::max(glm::length(piece[0] - 2.0f * piece[1] + piece[2]),
+                          glm::length(piece[1] - 2.0f * piece[2] + piece[3]));
+
+    uint32_t count = clampSegments(std::sqrt(0.75f * bend / tolerance), 1);
+
+    for (uint32_t i = 1; i <= count; i++)
+      points.push_back(bezier(piece, static_cast<float>(i) / count));
+  }
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
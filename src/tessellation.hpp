@@ -0,0 +1,90 @@
+#pragma once
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+class ThreadPool;
+
+enum class CurveKind : uint8_t { arc, spline };
+
+// Arcs run from start over sweep radians in the plane of xAxis and yAxis, a
+// sweep of two pi closes the circle. Splines are cubic Bezier pieces that
+// share their ends, 3n + 1 control points.
+struct Curve {
+  CurveKind kind = CurveKind::arc;
+  glm::vec3 center{0.0f};
+  glm::vec3 xAxis{1.0f, 0.0f, 0.0f};
+  glm::vec3 yAxis{0.0f, 1.0f, 0.0f};
+  float radius = 1.0f;
+  float start = 0.0f;
+  float sweep = 0.0f;
+  std::vector<glm::vec3> controls;
+
+  static Curve arc(glm::vec3 center, glm::vec3 xAxis, glm::vec3 yAxis,
+                   float radius, float start, float sweep);
+  static Curve circle(glm::vec3 center, glm::vec3 xAxis, glm::vec3 yAxis,
+                      float radius);
+  static Curve spline(std::vector<glm::vec3> controls);
+};
+
+struct TessellationView {
+  glm::mat4 viewProj;
+  // Pixels covered by one unit at distance w = 1
+  float pixelScale;
+  // Largest distance in pixels between a curve and its polyline
+  float tolerance;
+};
+
+// Turns curves into polylines. The world tolerance of a curve follows from
+// the pixel tolerance at the curve's nearest distance to the camera and is
+// rounded down to a power of two, its LOD bucket. A curve is tessellated
+// again only when its bucket changes, and the last few buckets per curve
+// are kept so zooming back and forth reuses them.
+class CurveTessellator {
+
+public:
+  static constexpr uint32_t MAX_SEGMENTS = 1 << 12;
+  static constexpr size_t MAX_CACHED_LODS = 4;
+
+  uint32_t addCurve(Curve curve);
+  // Drops the cached polylines
+  void setCurve(uint32_t id, Curve curve);
+
+  size_t size() const;
+
+  // Picks the buckets for view and tessellates what isn't cached, on pool
+  // when given. Returns the number of curves tessellated.
+  size_t update(const TessellationView &view, ThreadPool *pool = nullptr);
+
+  // Curves whose polyline changed in the last update, in id order
+  const std::vector<uint32_t> &changed() const;
+
+  std::span<const glm::vec3> points(uint32_t id) const;
+  int bucket(uint32_t id) const;
+
+  // Polyline of curve within tolerance world units
+  static void tessellate(const Curve &curve, float tolerance,
+                         std::vector<glm::vec3> &points);
+
+private:
+  struct Lod {
+    int bucket;
+    std::vector<glm::vec3> points;
+  };
+
+  struct Entry {
+    Curve curve;
+    // Bounding sphere
+    glm::vec3 center;
+    float radius;
+    std::vector<Lod> lods;
+    // Index into lods, none before the first update
+    int current = -1;
+  };
+
+  static void bound(Entry &entry);
+
+  std::vector<Entry> mCurves;
+  std::vector<uint32_t> mChanged;
+};
+
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -0,0 +1,145 @@
+#include "thread_pool.hpp"
+#include "pch.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+namespace {
+
+// Shared between the caller and helper tasks. Helpers that start after the
+// work is gone only touch this, so the caller never waits for them.
+struct ParallelForState {
+  const std::function<void(size_t, size_t)> *body = nullptr;
+  size_t count = 0;
+  size_t chunkSize = 0;
+  size_t chunks = 0;
+
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> done{0};
+
+  std::mutex mutex;
+  std::condition_variable finished;
+  std::exception_ptr error;
+
+  void work() {
+
+    size_t chunk;
+    while ((chunk = next.fetch_add(1)) < chunks) {
+
+      size_t begin = chunk * chunkSize;
+      size_t end = std::min(count, begin + chunkSize);
+
+      try {
+        (*body)(begin, end);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error)
+          error = std::current_exception();
+      }
+
+      if (done.fetch_add(1) + 1 == chunks) {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.notify_all();
+      }
+    }
+  }
+};
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned threadCount) : mStop{false} {
+
+  // Leave a core for the thread that calls parallelFor
+  if (threadCount == 0) {
+    unsigned cores = std::thread::hardware_concurrency();
+    threadCount = cores > 1 ? cores - 1 : 1;
+  }
+
+  mWorkers.reserve(threadCount);
+  for (unsigned i = 0; i < threadCount; i++)
+    mWorkers.emplace_back(&ThreadPool::run, this);
+}
+
+ThreadPool::~ThreadPool() {
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStop = true;
+  }
+  mWake.notify_all();
+
+  for (auto &worker : mWorkers)
+    if (worker.joinable())
+      worker.join();
+}
+
+size_t ThreadPool::size() const { return mWorkers.size(); }
+
+void ThreadPool::submit(std::function<void()> task) {
+
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTasks.push_back(std::move(task));
+  }
+  mWake.notify_one();
+}
+
+void ThreadPool::parallelFor(
+    size_t count, const std::function<void(size_t begin, size_t end)> &body,
+    size_t grain) {
+
+  if (count == 0)
+    return;
+
+  grain = std::max<size_t>(grain, 1);
+
+  size_t chunks = std::min((count + grain - 1) / grain, 4 * (size() + 1));
+
+  if (chunks <= 1) {
+    body(0, count);
+    return;
+  }
+
+  auto state = std::make_shared<ParallelForState>();
+  state->body = &body;
+  state->count = count;
+  state->chunkSize = (count + chunks - 1) / chunks;
+  state->chunks = (count + state->chunkSize - 1) / state->chunkSize;
+
+  size_t helpers = std::min(size(), state->chunks - 1);
+  for (size_t i = 0; i < helpers; i++)
+    submit([state] { state->work(); });
+
+  state->work();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->finished.wait(lock,
+                       [&] { return state->done.load() == state->chunks; });
+
+  if (state->error)
+    std::rethrow_exception(state->error);
+}
+
+void ThreadPool::run() {
+
+  std::unique_lock<std::mutex> lock(mMutex);
+
+  while (true) {
+
+    mWake.wait(lock, [this] { return mStop || !mTasks.empty(); });
+
+    if (mTasks.empty()) {
+      if (mStop)
+        return;
+      continue;
+    }
+
+    std::function<void()> task = std::move(mTasks.front());
+    mTasks.pop_front();
+
+    lock.unlock();
+    task();
+    lock.lock();
+  }
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
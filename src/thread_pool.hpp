@@ -0,0 +1,36 @@
+#pragma once
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+// Fixed set of worker threads shared by geometry kernels and observer fan-out.
+class ThreadPool {
+
+public:
+  explicit ThreadPool(unsigned threadCount = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  size_t size() const;
+
+  void submit(std::function<void()> task);
+
+  // Splits [0, count) into chunks of at least grain items and runs body on
+  // them, the calling thread included. Returns once every chunk is done and
+  // rethrows the first exception thrown by body.
+  void parallelFor(size_t count,
+                   const std::function<void(size_t begin, size_t end)> &body,
+                   size_t grain = 1);
+
+private:
+  void run();
+
+  std::vector<std::thread> mWorkers;
+  std::mutex mMutex;
+  std::condition_variable mWake;
+  std::deque<std::function<void()>> mTasks;
+  bool mStop;
+};
+
+} // namespace TRUCHAS_APP_NAMESPACE
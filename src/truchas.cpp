@@ -1,5 +1,7 @@
 #include "truchas.hpp"
 #include "config.h"
+#include "kernels.hpp"
+#include "log.hpp"
 #include "pch.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -7,9 +9,86 @@
 #include <stb_image.h>
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
+const uint32_t MAX_VIEWS = 16;
+const uint32_t MAX_ATLAS_SIZE = 8192;
+const uint32_t MAX_IMPORT_UPLOADS = 2;
+const uint32_t MAX_LINE_SETS = 1024;
+const uint32_t MAX_SPLAT_SETS = 4096;
+const uint32_t SPLAT_GROUP_SIZE = 256;
+// Guaranteed minimum of maxComputeWorkGroupCount
+const uint32_t MAX_SPLAT_GROUPS = 65535;
+const uint32_t NO_LOD_SLOT = std::numeric_limits<uint32_t>::max();
+// uvec4, large enough for either indirect command
+const vk::DeviceSize LOD_SLOT_SIZE = 16;
+// Pixels around the cursor searched for a pick id
+const int32_t PICK_RADIUS = 4;
+const uint32_t PICK_SIZE = 2 * PICK_RADIUS + 1;
+// Points per task when filling vertices, a chunk's source stays in cache
+// between its bounds and its writes
+const size_t VERTEX_FILL_GRAIN = 1 << 14;
+// Frames drawn on demand after input, ImGui settles hover state and the
+// pick for the cursor resolves within them
+const uint32_t INPUT_FRAMES = 3;
+// Longest on demand wait, also ImGui's caret blink period
+const double IDLE_WAIT_SECONDS = 0.5;
+// Render scale changes in these steps
+const float RENDER_SCALE_STEP = 1.0f / 16.0f;
+// Scene times this close to the target keep the scale
+const float RENDER_SCALE_BAND = 0.1f;
+const uint32_t NO_IMAGE = std::numeric_limits<uint32_t>::max();
+// Everything that reads vertex, segment and index buffers
+const vk::PipelineStageFlags DRAW_READ_STAGES =
+    vk::PipelineStageFlagBits::eVertexInput |
+    vk::PipelineStageFlagBits::eVertexShader |
+    vk::PipelineStageFlagBits::eComputeShader;
+const glm::vec4 FULL_VIEW_RECT = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
 
 namespace TRUCHAS_APP_NAMESPACE {
 
+namespace {
+
+TruchasRender *renderOf(GLFWwindow *window) {
+  return static_cast<TruchasRender *>(glfwGetWindowUserPointer(window));
+}
+
+void requestInputFrames(GLFWwindow *window) {
+  renderOf(window)->requestFrame(INPUT_FRAMES);
+}
+
+uint64_t mixHash(uint64_t seed, uint64_t value) {
+  return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+bool sameView(const ViewData &a, const ViewData &b) {
+  return a.view == b.view && a.proj == b.proj && a.rect == b.rect;
+}
+
+// Pixels the sphere around min, max spans in the view showing it largest,
+// unbounded when a camera is inside it
+float screenSize(const glm::vec3 &min, const glm::vec3 &max,
+                 const glm::mat4 &model, const std::vector<ViewData> &views,
+                 float height) {
+
+  glm::vec4 center = model * glm::vec4(0.5f * (min + max), 1.0f);
+  float radius = 0.5f * glm::length(max - min);
+  float size = 0.0f;
+
+  for (const ViewData &view : views) {
+
+    float distance = glm::length(glm::vec3(view.view * center));
+
+    if (distance <= radius)
+      return std::numeric_limits<float>::infinity();
+
+    float pixelScale = 0.5f * std::abs(view.proj[1][1]) * view.rect.w * height;
+    size = std::max(size, radius / distance * pixelScale);
+  }
+
+  return size;
+}
+
+} // namespace
+
 void TruchasRender::setup() {
 
   // GLFW
@@ -36,16 +115,23 @@ void TruchasRender::setup() {
   preparePipelines();
 
   createCommandPool();
+  createQuadIndices();
   createDepthResources();
+  createPickTarget();
   createFramebuffers();
   createUniformBuffer();
   createDescriptorPool();
   createDescriptorSets();
+  createSplatTargets();
   allocCommandBuffers();
   createSyncObjects();
+  createPickResources();
 }
 
-void TruchasRender::setBGColor(glm::vec4 color) { bgColor = color; }
+void TruchasRender::setBGColor(glm::vec4 color) {
+  bgColor = color;
+  requestFrame();
+}
 
 void TruchasRender::createWindow() {
   glfwInit();
@@ -58,6 +144,37 @@ void TruchasRender::createWindow() {
   glfwSetWindowUserPointer(mMainWindow, this);
 
   glfwSetInputMode(mMainWindow, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+
+  // Installed before ImGui's, which chain to them
+  glfwSetFramebufferSizeCallback(mMainWindow, [](GLFWwindow *window, int,
+                                                 int) {
+    renderOf(window)->frameBufferResized = true;
+    renderOf(window)->requestFrame();
+  });
+  glfwSetWindowRefreshCallback(mMainWindow, requestInputFrames);
+  glfwSetWindowFocusCallback(mMainWindow, [](GLFWwindow *window, int) {
+    requestInputFrames(window);
+  });
+  glfwSetCursorPosCallback(mMainWindow,
+                           [](GLFWwindow *window, double, double) {
+                             requestInputFrames(window);
+                           });
+  glfwSetCursorEnterCallback(mMainWindow, [](GLFWwindow *window, int) {
+    requestInputFrames(window);
+  });
+  glfwSetMouseButtonCallback(mMainWindow,
+                             [](GLFWwindow *window, int, int, int) {
+                               requestInputFrames(window);
+                             });
+  glfwSetScrollCallback(mMainWindow, [](GLFWwindow *window, double, double) {
+    requestInputFrames(window);
+  });
+  glfwSetKeyCallback(mMainWindow, [](GLFWwindow *window, int, int, int, int) {
+    requestInputFrames(window);
+  });
+  glfwSetCharCallback(mMainWindow, [](GLFWwindow *window, unsigned int) {
+    requestInputFrames(window);
+  });
 }
 
 vk::Result TruchasRender::createInstance() {
@@ -83,6 +200,8 @@ vk::Result TruchasRender::createInstance() {
       glfwExtensionCount; // static_cast<uint32_t>(glfwExtensionsVector.size());
   createInfo.ppEnabledExtensionNames =
       glfwExtensions; // glfwExtensionsVector.data();
+  // 1.2 for 64-bit buffer atomics, older devices still enumerate
+  mAppInfo.apiVersion = VK_API_VERSION_1_2;
   createInfo.pApplicationInfo = &mAppInfo;
 
   vk::Result result = vk::createInstance(&createInfo, nullptr, &mInstance);
@@ -118,7 +237,6 @@ void TruchasRender::pickPhysicalDevice() {
   }
 
   if (&mPhysicalDevice == VK_NULL_HANDLE) {
-    std::cout << "Failed!" << std::endl;
     throw std::runtime_error("failed to find a suitable GPU!");
   }
 }
@@ -214,8 +332,8 @@ void TruchasRender::createLogicalDevice() {
 
   deviceFeatures.fillModeNonSolid = true;
   deviceFeatures.depthBounds = true;
-  deviceFeatures.wideLines = true;
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  deviceFeatures.shaderClipDistance = VK_TRUE;
 
   vk::DeviceCreateInfo createInfo(
       {}, static_cast<uint32_t>(queueCreateInfos.size()),
@@ -223,6 +341,53 @@ void TruchasRender::createLogicalDevice() {
       static_cast<uint32_t>(deviceExtensions.size()), deviceExtensions.data(),
       &deviceFeatures);
 
+  // Splatting runs on the graphics queue and needs 64-bit storage atomics
+  vk::PhysicalDeviceVulkan12Features enabled12;
+
+  auto queueFamilies = mPhysicalDevice.getQueueFamilyProperties();
+  bool computeQueue = static_cast<bool>(
+      queueFamilies[mIndices.graphicsFamily].queueFlags &
+      vk::QueueFlagBits::eCompute);
+
+  // Level of detail draws all nodes of a buffer with one indirect call
+  mLodSupported = mPhysicalDevice.getFeatures().multiDrawIndirect;
+  mSplatSupported = false;
+  mDrawIndirectCount = false;
+
+  if (mPhysicalDevice.getProperties().apiVersion >= VK_API_VERSION_1_2) {
+
+    auto supported =
+        mPhysicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                     vk::PhysicalDeviceVulkan12Features>();
+    const auto &supported12 =
+        supported.get<vk::PhysicalDeviceVulkan12Features>();
+
+    mSplatSupported =
+        computeQueue &&
+        supported.get<vk::PhysicalDeviceFeatures2>().features.shaderInt64 &&
+        supported12.shaderBufferInt64Atomics;
+
+    mDrawIndirectCount = mLodSupported && supported12.drawIndirectCount;
+  }
+
+  if (mSplatSupported) {
+    deviceFeatures.shaderInt64 = VK_TRUE;
+    enabled12.shaderBufferInt64Atomics = VK_TRUE;
+  } else {
+    LOG_INFO("64-bit atomics unavailable, points are always rasterized");
+  }
+
+  if (mLodSupported)
+    deviceFeatures.multiDrawIndirect = VK_TRUE;
+  else
+    LOG_INFO("multi draw indirect unavailable, points are drawn in full");
+
+  // Without it unselected nodes are drawn as empty commands
+  enabled12.drawIndirectCount = mDrawIndirectCount;
+
+  if (mSplatSupported || mDrawIndirectCount)
+    createInfo.pNext = &enabled12;
+
   if (enableValidationLayers) {
     createInfo.enabledLayerCount =
         static_cast<uint32_t>(validationLayers.size());
@@ -318,9 +483,36 @@ void TruchasRender::createSwapChain() {
     imageCount = swapChainSupport.capabilities.maxImageCount;
   }
 
-  vk::SwapchainCreateInfoKHR createInfo(
-      {}, mSurface, imageCount, surfaceFormat.format, surfaceFormat.colorSpace,
-      extent, 1, vk::ImageUsageFlagBits::eColorAttachment);
+  vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment;
+
+  // Needed to copy finished frames out for readback
+  mReadbackSupported = static_cast<bool>(
+      swapChainSupport.capabilities.supportedUsageFlags &
+      vk::ImageUsageFlagBits::eTransferSrc);
+
+  if (mReadbackSupported)
+    usage |= vk::ImageUsageFlagBits::eTransferSrc;
+
+  // Dynamic resolution blits the scene up into the images
+  vk::FormatFeatureFlags blit =
+      vk::FormatFeatureFlagBits::eBlitSrc |
+      vk::FormatFeatureFlagBits::eBlitDst |
+      vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+
+  mUpscaleSupported =
+      (swapChainSupport.capabilities.supportedUsageFlags &
+       vk::ImageUsageFlagBits::eTransferDst) &&
+      (mPhysicalDevice.getFormatProperties(surfaceFormat.format)
+           .optimalTilingFeatures &
+       blit) == blit;
+
+  if (mUpscaleSupported)
+    usage |= vk::ImageUsageFlagBits::eTransferDst;
+
+  vk::SwapchainCreateInfoKHR createInfo({}, mSurface, imageCount,
+                                        surfaceFormat.format,
+                                        surfaceFormat.colorSpace, extent, 1,
+                                        usage);
 
   uint32_t queueFamilyIndices[] = {
       static_cast<uint32_t>(mIndices.graphicsFamily),
@@ -343,6 +535,7 @@ void TruchasRender::createSwapChain() {
   mSwapchain = mDevice.createSwapchainKHR(createInfo, nullptr);
 
   mImages = mDevice.getSwapchainImagesKHR(mSwapchain);
+  mImagesInFlight.assign(mImages.size(), nullptr);
 
   mFormat = surfaceFormat.format;
   mExtent = extent;
@@ -358,6 +551,12 @@ void TruchasRender::recreateSwapchain() {
 
   mDevice.waitIdle();
 
+  // Hand out finished copies while they still match the old extent
+  if (mReadbackEnabled) {
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+      collectReadbacks(i);
+  }
+
   cleanupSwapchain();
 
   createSwapChain();
@@ -367,9 +566,22 @@ void TruchasRender::recreateSwapchain() {
   createDescriptorSetLayout();
   createPipelineLayout();
   createDepthResources();
+  createPickTarget();
   createFramebuffers();
+  createSplatTargets();
+
+  if (mDynamicResolution || mProgressive)
+    createSceneTarget();
 
   preparePipelines();
+
+  if (mReadbackEnabled && !mReadbackSupported) {
+    LOG_WARN("new swapchain images can't be copied from, readback stops");
+    disableReadback();
+  }
+
+  // Recorded against the old framebuffers
+  createCommandBuffers();
 }
 
 void TruchasRender::createImageViews() {
@@ -440,16 +652,42 @@ TruchasRender::findDepthFormat(vk::PhysicalDevice const &PhysicalDevice) {
 
 void TruchasRender::createRenderPass() {
 
+  mRenderPass = makeRenderPass(mFormat, vk::ImageLayout::ePresentSrcKHR);
+
+  // Compatible with mRenderPass, so ImGui's pipeline draws in it too
+  mUiRenderPass = makeRenderPass(mFormat, vk::ImageLayout::ePresentSrcKHR,
+                                 vk::ImageLayout::eTransferDstOptimal);
+
+  // Progressive frames over the scene target, compatible with
+  // mOffscreenRenderPass
+  mProgressiveClearPass =
+      makeRenderPass(mFormat, vk::ImageLayout::eTransferSrcOptimal,
+                     vk::ImageLayout::eUndefined, true);
+  mProgressiveLoadPass =
+      makeRenderPass(mFormat, vk::ImageLayout::eTransferSrcOptimal,
+                     vk::ImageLayout::eTransferSrcOptimal, true);
+}
+
+vk::RenderPass
+TruchasRender::makeRenderPass(vk::Format colorFormat,
+                              vk::ImageLayout colorFinalLayout,
+                              vk::ImageLayout colorInitialLayout,
+                              bool keepDepth) {
+
+  bool load = colorInitialLayout != vk::ImageLayout::eUndefined;
+  bool loadDepth = load && keepDepth;
+
   // Color Attachment
   vk::AttachmentDescription colorAttachment = {};
-  colorAttachment.format = mFormat;
+  colorAttachment.format = colorFormat;
   colorAttachment.samples = vk::SampleCountFlagBits::e1;
-  colorAttachment.loadOp = vk::AttachmentLoadOp::eClear;
+  colorAttachment.loadOp =
+      load ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear;
   colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
   colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
   colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-  colorAttachment.initialLayout = vk::ImageLayout::eUndefined;
-  colorAttachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+  colorAttachment.initialLayout = colorInitialLayout;
+  colorAttachment.finalLayout = colorFinalLayout;
 
   vk::AttachmentReference colorAttachmentRef = {};
   colorAttachmentRef.attachment = 0;
@@ -459,23 +697,52 @@ void TruchasRender::createRenderPass() {
   vk::AttachmentDescription depthAttachment = {};
   depthAttachment.format = findDepthFormat(mPhysicalDevice);
   depthAttachment.samples = vk::SampleCountFlagBits::e1;
-  depthAttachment.loadOp = vk::AttachmentLoadOp::eClear;
-  depthAttachment.storeOp = vk::AttachmentStoreOp::eDontCare;
+  depthAttachment.loadOp =
+      loadDepth ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear;
+  depthAttachment.storeOp = keepDepth ? vk::AttachmentStoreOp::eStore
+                                      : vk::AttachmentStoreOp::eDontCare;
   depthAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
   depthAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-  depthAttachment.initialLayout = vk::ImageLayout::eUndefined;
+  depthAttachment.initialLayout =
+      loadDepth ? vk::ImageLayout::eDepthStencilAttachmentOptimal
+                : vk::ImageLayout::eUndefined;
   depthAttachment.finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
 
   vk::AttachmentReference depthAttachmentRef = {};
   depthAttachmentRef.attachment = 1;
   depthAttachmentRef.layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
 
+  // Pick ids, cleared to 0 and left ready to copy out
+  vk::AttachmentDescription idAttachment = {};
+  idAttachment.format = vk::Format::eR32Uint;
+  idAttachment.samples = vk::SampleCountFlagBits::e1;
+  idAttachment.loadOp =
+      loadDepth ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear;
+  idAttachment.storeOp = vk::AttachmentStoreOp::eStore;
+  idAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+  idAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+  idAttachment.initialLayout = loadDepth
+                                   ? vk::ImageLayout::eTransferSrcOptimal
+                                   : vk::ImageLayout::eUndefined;
+  idAttachment.finalLayout = vk::ImageLayout::eTransferSrcOptimal;
+
+  std::array<vk::AttachmentReference, 2> sceneColorRefs = {
+      colorAttachmentRef,
+      vk::AttachmentReference(2, vk::ImageLayout::eColorAttachmentOptimal)};
+
   vk::SubpassDescription subpass = {};
   subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
-  subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &colorAttachmentRef;
+  subpass.colorAttachmentCount = mPickingEnabled ? 2 : 1;
+  subpass.pColorAttachments = sceneColorRefs.data();
   subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
+  // ImGui's pipeline has a single blend attachment, so with ids the UI gets
+  // a subpass of its own
+  vk::SubpassDescription uiSubpass = {};
+  uiSubpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+  uiSubpass.colorAttachmentCount = 1;
+  uiSubpass.pColorAttachments = &colorAttachmentRef;
+
   vk::SubpassDependency dependency = {};
   dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
   dependency.dstSubpass = 0;
@@ -486,46 +753,173 @@ void TruchasRender::createRenderPass() {
   dependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead |
                              vk::AccessFlagBits::eColorAttachmentWrite;
 
-  std::array<vk::AttachmentDescription, 2> attachments = {colorAttachment,
-                                                          depthAttachment};
+  // Frames overlap, the one before may still test against the shared depth
+  // or copy the attachments out
+  dependency.srcStageMask |= vk::PipelineStageFlagBits::eLateFragmentTests |
+                             vk::PipelineStageFlagBits::eTransfer;
+  dependency.srcAccessMask |= vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+  dependency.dstStageMask |= vk::PipelineStageFlagBits::eEarlyFragmentTests;
+  dependency.dstAccessMask |= vk::AccessFlagBits::eDepthStencilAttachmentRead |
+                              vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+
+  // Loaded contents were written by a transfer
+  if (load)
+    dependency.srcAccessMask |= vk::AccessFlagBits::eTransferWrite;
+
+  vk::SubpassDependency uiDependency = {};
+  uiDependency.srcSubpass = 0;
+  uiDependency.dstSubpass = 1;
+  uiDependency.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+  uiDependency.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+  uiDependency.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+  uiDependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead |
+                               vk::AccessFlagBits::eColorAttachmentWrite;
+  uiDependency.dependencyFlags = vk::DependencyFlagBits::eByRegion;
+
+  std::vector<vk::AttachmentDescription> attachments = {colorAttachment,
+                                                        depthAttachment};
+  std::vector<vk::SubpassDescription> subpasses = {subpass};
+  std::vector<vk::SubpassDependency> dependencies = {dependency};
+
+  if (mPickingEnabled) {
+    attachments.push_back(idAttachment);
+    subpasses.push_back(uiSubpass);
+    dependencies.push_back(uiDependency);
+  }
+
   vk::RenderPassCreateInfo renderPassInfo = {};
 
   renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
   renderPassInfo.pAttachments = attachments.data();
-  renderPassInfo.subpassCount = 1;
-  renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
+  renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+  renderPassInfo.pSubpasses = subpasses.data();
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies = dependencies.data();
+
+  vk::RenderPass renderPass;
 
-  if (mDevice.createRenderPass(&renderPassInfo, nullptr, &mRenderPass) !=
+  if (mDevice.createRenderPass(&renderPassInfo, nullptr, &renderPass) !=
       vk::Result::eSuccess)
     throw std::runtime_error("failed to create render pass!");
+
+  return renderPass;
 }
 
 void TruchasRender::createDescriptorSetLayout() {
 
+  // Compute too, the splat pass projects with the same cameras
+  vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eVertex |
+                                vk::ShaderStageFlagBits::eFragment |
+                                vk::ShaderStageFlagBits::eCompute;
+
   vk::DescriptorSetLayoutBinding uboLayoutBinding(
-      0, vk::DescriptorType::eUniformBuffer, 1,
-      vk::ShaderStageFlagBits::eVertex, nullptr);
+      0, vk::DescriptorType::eUniformBuffer, 1, stages, nullptr);
 
-  std::array<vk::DescriptorSetLayoutBinding, 1> bindings = {uboLayoutBinding};
+  vk::DescriptorSetLayoutBinding viewLayoutBinding(
+      1, vk::DescriptorType::eStorageBuffer, 1, stages, nullptr);
 
-  vk::DescriptorSetLayoutCreateInfo layoutInfo({}, 1, &uboLayoutBinding);
+  std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding,
+                                                            viewLayoutBinding};
+
+  vk::DescriptorSetLayoutCreateInfo layoutInfo(
+      {}, static_cast<uint32_t>(bindings.size()), bindings.data());
 
   if (mDevice.createDescriptorSetLayout(&layoutInfo, nullptr,
                                         &this->mDescriptorSetLayout) !=
       vk::Result::eSuccess)
     throw std::runtime_error("failed to create descriptor set layout!");
+
+  // Line and splat sets outlive the swapchain, so their layouts do too
+  if (mLineSetLayout)
+    return;
+
+  std::array<vk::DescriptorSetLayoutBinding, 2> lineBindings = {
+      vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1,
+                                     vk::ShaderStageFlagBits::eVertex,
+                                     nullptr),
+      vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1,
+                                     vk::ShaderStageFlagBits::eVertex,
+                                     nullptr)};
+
+  vk::DescriptorSetLayoutCreateInfo lineLayoutInfo(
+      {}, static_cast<uint32_t>(lineBindings.size()), lineBindings.data());
+
+  if (mDevice.createDescriptorSetLayout(&lineLayoutInfo, nullptr,
+                                        &mLineSetLayout) !=
+      vk::Result::eSuccess)
+    throw std::runtime_error("failed to create line set layout!");
+
+  vk::DescriptorSetLayoutBinding splatSourceBinding(
+      0, vk::DescriptorType::eStorageBuffer, 1,
+      vk::ShaderStageFlagBits::eCompute, nullptr);
+
+  // The image's splat buffer and its level of detail table
+  std::array<vk::DescriptorSetLayoutBinding, 2> splatTargetBindings = {
+      vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1,
+                                     vk::ShaderStageFlagBits::eCompute |
+                                         vk::ShaderStageFlagBits::eFragment,
+                                     nullptr),
+      vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1,
+                                     vk::ShaderStageFlagBits::eCompute,
+                                     nullptr)};
+
+  vk::DescriptorSetLayoutCreateInfo splatSourceInfo({}, 1, &splatSourceBinding);
+  vk::DescriptorSetLayoutCreateInfo splatTargetInfo(
+      {}, static_cast<uint32_t>(splatTargetBindings.size()),
+      splatTargetBindings.data());
+
+  if (mDevice.createDescriptorSetLayout(&splatSourceInfo, nullptr,
+                                        &mSplatSourceLayout) !=
+          vk::Result::eSuccess ||
+      mDevice.createDescriptorSetLayout(&splatTargetInfo, nullptr,
+                                        &mSplatTargetLayout) !=
+          vk::Result::eSuccess)
+    throw std::runtime_error("failed to create splat set layouts!");
 }
 
 void TruchasRender::createPipelineLayout() {
 
+  // Pick id of the first vertex
+  vk::PushConstantRange pointPushRange(vk::ShaderStageFlagBits::eVertex, 0,
+                                       sizeof(uint32_t));
+
   vk::PipelineLayoutCreateInfo pipelineLayoutInfo({}, 1, &mDescriptorSetLayout,
-                                                  0, nullptr);
+                                                  1, &pointPushRange);
 
   if (mDevice.createPipelineLayout(&pipelineLayoutInfo, nullptr,
                                    &mPipelineLayout) != vk::Result::eSuccess)
     throw std::runtime_error("failed to create pipeline layout");
+
+  std::array<vk::DescriptorSetLayout, 2> lineLayouts = {mDescriptorSetLayout,
+                                                        mLineSetLayout};
+
+  vk::PushConstantRange pushRange(vk::ShaderStageFlagBits::eVertex, 0,
+                                  sizeof(LinePush));
+
+  vk::PipelineLayoutCreateInfo linePipelineLayoutInfo(
+      {}, static_cast<uint32_t>(lineLayouts.size()), lineLayouts.data(), 1,
+      &pushRange);
+
+  if (mDevice.createPipelineLayout(&linePipelineLayoutInfo, nullptr,
+                                   &mLinePipelineLayout) !=
+      vk::Result::eSuccess)
+    throw std::runtime_error("failed to create line pipeline layout");
+
+  std::array<vk::DescriptorSetLayout, 3> splatLayouts = {
+      mDescriptorSetLayout, mSplatSourceLayout, mSplatTargetLayout};
+
+  vk::PushConstantRange splatPushRange(vk::ShaderStageFlagBits::eCompute |
+                                           vk::ShaderStageFlagBits::eFragment,
+                                       0, sizeof(SplatPush));
+
+  vk::PipelineLayoutCreateInfo splatPipelineLayoutInfo(
+      {}, static_cast<uint32_t>(splatLayouts.size()), splatLayouts.data(), 1,
+      &splatPushRange);
+
+  if (mDevice.createPipelineLayout(&splatPipelineLayoutInfo, nullptr,
+                                   &mSplatPipelineLayout) !=
+      vk::Result::eSuccess)
+    throw std::runtime_error("failed to create splat pipeline layout");
 }
 
 std::vector<char> TruchasRender::readFile(const std::string filename) {
@@ -566,8 +960,11 @@ TruchasRender::createShaderModule(const std::vector<char> &code) {
 
 void TruchasRender::createCommandPool() {
 
+  // Command buffers are recorded again one at a time
   vk::CommandPoolCreateInfo commandPoolInfo(
-      vk::CommandPoolCreateFlagBits::eTransient, mIndices.graphicsFamily);
+      vk::CommandPoolCreateFlagBits::eTransient |
+          vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+      mIndices.graphicsFamily);
 
   vk::Result result =
       mDevice.createCommandPool(&commandPoolInfo, nullptr, &mCommandPool);
@@ -625,6 +1022,39 @@ void TruchasRender::createDepthResources() {
       createImageView(depthImage, depthFormat, vk::ImageAspectFlagBits::eDepth);
 }
 
+std::vector<vk::ClearValue> TruchasRender::sceneClearValues() const {
+
+  std::array<float, 4> color = {bgColor.x, bgColor.y, bgColor.z, bgColor.w};
+
+  std::vector<vk::ClearValue> clearValues(mPickingEnabled ? 3 : 2);
+  clearValues[0].setColor(color);
+  clearValues[1].depthStencil.depth = 1.0f;
+  clearValues[1].depthStencil.stencil = 0;
+
+  if (mPickingEnabled)
+    clearValues[2].setColor(std::array<uint32_t, 4>{0, 0, 0, 0});
+
+  return clearValues;
+}
+
+std::vector<vk::PipelineColorBlendAttachmentState>
+TruchasRender::sceneBlendAttachments(
+    const vk::PipelineColorBlendAttachmentState &color, bool writeId) const {
+
+  std::vector<vk::PipelineColorBlendAttachmentState> attachments = {color};
+
+  // Integer attachments can't blend
+  if (mPickingEnabled) {
+    vk::PipelineColorBlendAttachmentState id;
+    id.blendEnable = VK_FALSE;
+    id.colorWriteMask = writeId ? vk::ColorComponentFlagBits::eR
+                                : vk::ColorComponentFlags();
+    attachments.push_back(id);
+  }
+
+  return attachments;
+}
+
 void TruchasRender::createBuffer(vk::DeviceSize &size,
                                  const vk::BufferUsageFlags &usage,
                                  const vk::MemoryPropertyFlags &properties,
@@ -746,7 +1176,10 @@ void TruchasRender::createFramebuffers() {
 
   for (decltype(mImageViews.size()) i = 0; i < mImageViews.size(); i++) {
 
-    std::array<vk::ImageView, 2> attachments = {mImageViews[i], depthImageView};
+    std::vector<vk::ImageView> attachments = {mImageViews[i], depthImageView};
+
+    if (mPickingEnabled)
+      attachments.push_back(mIdImageView);
 
     vk::FramebufferCreateInfo FramebufferInfo(
         {}, mRenderPass, static_cast<uint32_t>(attachments.size()),
@@ -770,19 +1203,53 @@ void TruchasRender::createUniformBuffer() {
                      vk::MemoryPropertyFlagBits::eHostCoherent,
                  mUniformBuffers[i], mUniformBufferMemories[i]);
   }
+
+  vk::DeviceSize viewBufferSize = sizeof(ViewData) * MAX_VIEWS;
+
+  mViewBuffers.resize(mImages.size());
+  mViewBufferMemories.resize(mImages.size());
+
+  for (size_t i = 0; i < mImages.size(); i++) {
+    createBuffer(viewBufferSize, vk::BufferUsageFlagBits::eStorageBuffer,
+                 vk::MemoryPropertyFlagBits::eHostVisible |
+                     vk::MemoryPropertyFlagBits::eHostCoherent,
+                 mViewBuffers[i], mViewBufferMemories[i]);
+  }
 }
 
 void TruchasRender::createDescriptorPool() {
 
-  std::array<vk::DescriptorPoolSize, 1> poolSizes = {};
+  std::array<vk::DescriptorPoolSize, 2> poolSizes = {};
   poolSizes[0].type = vk::DescriptorType::eUniformBuffer;
   poolSizes[0].descriptorCount = static_cast<uint32_t>(mImages.size());
+  poolSizes[1].type = vk::DescriptorType::eStorageBuffer;
+  poolSizes[1].descriptorCount = static_cast<uint32_t>(mImages.size());
 
   vk::DescriptorPoolCreateInfo poolInfo(
       {}, static_cast<uint32_t>(mImages.size()),
       static_cast<uint32_t>(poolSizes.size()), poolSizes.data());
 
   mDescriptorPool = mDevice.createDescriptorPool(poolInfo, nullptr);
+
+  // Sets come and go with the models' segments
+  vk::DescriptorPoolSize linePoolSize(vk::DescriptorType::eStorageBuffer,
+                                      2 * MAX_LINE_SETS);
+
+  vk::DescriptorPoolCreateInfo linePoolInfo(
+      vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, MAX_LINE_SETS, 1,
+      &linePoolSize);
+
+  mLineDescriptorPool = mDevice.createDescriptorPool(linePoolInfo, nullptr);
+
+  // Splat sources per large buffer plus a target per swapchain image
+  vk::DescriptorPoolSize splatPoolSize(vk::DescriptorType::eStorageBuffer,
+                                       2 * MAX_SPLAT_SETS);
+
+  vk::DescriptorPoolCreateInfo splatPoolInfo(
+      vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, MAX_SPLAT_SETS, 1,
+      &splatPoolSize);
+
+  mSplatDescriptorPool = mDevice.createDescriptorPool(splatPoolInfo, nullptr);
 }
 
 void TruchasRender::createDescriptorSets() {
@@ -802,17 +1269,27 @@ void TruchasRender::createDescriptorSets() {
   for (size_t i = 0; i < mImages.size(); i++) {
 
     vk::DescriptorBufferInfo bufferInfo(mUniformBuffers[i], 0, sizeof(u));
-
-    vk::WriteDescriptorSet descriptorWrites;
-
-    descriptorWrites.dstSet = mDescriptorSets[i];
-    descriptorWrites.dstBinding = 0;
-    descriptorWrites.dstArrayElement = 0;
-    descriptorWrites.descriptorType = vk::DescriptorType::eUniformBuffer;
-    descriptorWrites.descriptorCount = 1;
-    descriptorWrites.pBufferInfo = &bufferInfo;
-
-    mDevice.updateDescriptorSets(1, &descriptorWrites, 0, nullptr);
+    vk::DescriptorBufferInfo viewInfo(mViewBuffers[i], 0, VK_WHOLE_SIZE);
+
+    std::array<vk::WriteDescriptorSet, 2> descriptorWrites;
+
+    descriptorWrites[0].dstSet = mDescriptorSets[i];
+    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].dstArrayElement = 0;
+    descriptorWrites[0].descriptorType = vk::DescriptorType::eUniformBuffer;
+    descriptorWrites[0].descriptorCount = 1;
+    descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+    descriptorWrites[1].dstSet = mDescriptorSets[i];
+    descriptorWrites[1].dstBinding = 1;
+    descriptorWrites[1].dstArrayElement = 0;
+    descriptorWrites[1].descriptorType = vk::DescriptorType::eStorageBuffer;
+    descriptorWrites[1].descriptorCount = 1;
+    descriptorWrites[1].pBufferInfo = &viewInfo;
+
+    mDevice.updateDescriptorSets(
+        static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(),
+        0, nullptr);
   }
 }
 
@@ -832,6 +1309,7 @@ void TruchasRender::createSyncObjects() {
   mImageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   mRenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   mInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+  mSubmittedFrames.assign(MAX_FRAMES_IN_FLIGHT, 0);
 
   vk::SemaphoreCreateInfo semaphoreInfo;
 
@@ -891,7 +1369,8 @@ void TruchasRender::initImgui() {
   init_info.Queue = mGraphicsQueue;
   init_info.PipelineCache = VK_NULL_HANDLE;
   init_info.DescriptorPool = mGuiDescriptorPool;
-  init_info.Subpass = 0;
+  // The id attachment is left out of the UI subpass
+  init_info.Subpass = mPickingEnabled ? 1 : 0;
   init_info.MinImageCount = static_cast<uint32_t>(mImageViews.size());
   init_info.ImageCount = static_cast<uint32_t>(mImageViews.size());
   init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
@@ -982,14 +1461,24 @@ void TruchasRender::createSketchPointPipeline() {
       vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
           vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
 
+  auto BlendAttachments = sceneBlendAttachments(ColorBlendAttachment);
+
   vk::PipelineColorBlendStateCreateInfo ColorBlendingInfo(
-      {}, VK_FALSE, vk::LogicOp::eCopy, 1, &ColorBlendAttachment,
+      {}, VK_FALSE, vk::LogicOp::eCopy,
+      static_cast<uint32_t>(BlendAttachments.size()), BlendAttachments.data(),
       {0.0f, 0.0f, 0.0f, 0.0f});
 
   vk::PipelineDepthStencilStateCreateInfo depthStencilInfo(
       {}, VK_TRUE, VK_TRUE, vk::CompareOp::eLess, VK_TRUE, VK_FALSE, {}, {},
       0.0f, 1.0f);
 
+  // Viewport is set per draw so offscreen targets can share the pipeline
+  std::array<vk::DynamicState, 2> DynamicStates = {vk::DynamicState::eViewport,
+                                                   vk::DynamicState::eScissor};
+
+  vk::PipelineDynamicStateCreateInfo DynamicStateInfo(
+      {}, static_cast<uint32_t>(DynamicStates.size()), DynamicStates.data());
+
   vk::GraphicsPipelineCreateInfo PipelineCreateInfo;
 
   PipelineCreateInfo.stageCount = 2;
@@ -1001,6 +1490,7 @@ void TruchasRender::createSketchPointPipeline() {
   PipelineCreateInfo.pMultisampleState = &MultisampleInfo;
   PipelineCreateInfo.pDepthStencilState = &depthStencilInfo;
   PipelineCreateInfo.pColorBlendState = &ColorBlendingInfo;
+  PipelineCreateInfo.pDynamicState = &DynamicStateInfo;
 
   PipelineCreateInfo.renderPass = mRenderPass;
   PipelineCreateInfo.subpass = 0;
@@ -1021,172 +1511,3008 @@ vk::Pipeline TruchasRender::getSketchPointPipeline() {
   return Pipelines.SketchPoint;
 }
 
-void TruchasRender::preparePipelines() { createSketchPointPipeline(); }
+void TruchasRender::createSketchGridPipeline() {
 
-void TruchasRender::copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer,
-                               vk::DeviceSize size) {
+  // Vertices come from gl_VertexIndex
+  vk::PipelineVertexInputStateCreateInfo VertexInputInfo;
 
-  vk::CommandBuffer commandBuffer = beginSingleTimeCommands(
-      vk::CommandBufferLevel::ePrimary, vk::CommandBufferInheritanceInfo());
+  auto vertShaderCode = readFile(config::grid_vert_shader_file_path);
+  auto fragShaderCode = readFile(config::grid_frag_shader_file_path);
 
-  vk::BufferCopy copyRegion;
-  copyRegion.size = size;
+  vk::ShaderModule vertShaderModule = createShaderModule(vertShaderCode);
+  vk::ShaderModule fragShaderModule = createShaderModule(fragShaderCode);
 
-  commandBuffer.copyBuffer(srcBuffer, dstBuffer, copyRegion);
+  vk::PipelineShaderStageCreateInfo ShaderStages[] = {
+      {{}, vk::ShaderStageFlagBits::eVertex, vertShaderModule, "main"},
+      {{}, vk::ShaderStageFlagBits::eFragment, fragShaderModule, "main"}};
 
-  endSingleTimeCommands(commandBuffer);
-}
+  vk::PipelineInputAssemblyStateCreateInfo InputAssemblyInfo(
+      {}, vk::PrimitiveTopology::eTriangleList, VK_FALSE);
 
-void TruchasRender::deleteBuffer(uint32_t id) {
+  vk::PipelineRasterizationStateCreateInfo RasterizerInfo(
+      {}, VK_FALSE, VK_FALSE, vk::PolygonMode::eFill,
+      vk::CullModeFlagBits::eNone, vk::FrontFace::eCounterClockwise, VK_FALSE,
+      0.0f, 0.0f, 0.0f, 1.0f);
 
-  // mBuffers[id].isEmpty = true;
+  vk::PipelineViewportStateCreateInfo ViewportInfo({}, 1, nullptr, 1, nullptr);
 
-  std::map<uint32_t, Buffer>::iterator erase_iter = mBuffers.find(id);
+  vk::PipelineMultisampleStateCreateInfo MultisampleInfo(
+      {}, vk::SampleCountFlagBits::e1, VK_FALSE, 1.0f, nullptr, VK_FALSE,
+      VK_FALSE);
 
-  if (erase_iter != mBuffers.end()) {
-    mDevice.destroyBuffer(mBuffers[id].mBuffer);
-    mDevice.freeMemory(mBuffers[id].mMemory);
-    mBuffers.erase(erase_iter);
-  }
-}
+  vk::PipelineColorBlendAttachmentState ColorBlendAttachment(
+      VK_TRUE, vk::BlendFactor::eSrcAlpha, vk::BlendFactor::eOneMinusSrcAlpha,
+      vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eZero,
+      vk::BlendOp::eAdd,
+      vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+          vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
 
-void TruchasRender::createCommandBuffers() {
+  // Translucent, the ids of whatever shows through stay
+  auto BlendAttachments = sceneBlendAttachments(ColorBlendAttachment, false);
 
-  mDevice.resetCommandPool(mCommandPool, vk::CommandPoolResetFlags());
+  vk::PipelineColorBlendStateCreateInfo ColorBlendingInfo(
+      {}, VK_FALSE, vk::LogicOp::eCopy,
+      static_cast<uint32_t>(BlendAttachments.size()), BlendAttachments.data(),
+      {0.0f, 0.0f, 0.0f, 0.0f});
 
-  for (size_t i = 0; i < mCommandBuffers.size(); i++) {
+  // Tested against the geometry but never hides it
+  vk::PipelineDepthStencilStateCreateInfo depthStencilInfo(
+      {}, VK_TRUE, VK_FALSE, vk::CompareOp::eLess, VK_FALSE, VK_FALSE, {}, {},
+      0.0f, 1.0f);
 
-    vk::CommandBufferBeginInfo beginInfo(
-        vk::CommandBufferUsageFlagBits::eSimultaneousUse);
+  std::array<vk::DynamicState, 2> DynamicStates = {vk::DynamicState::eViewport,
+                                                   vk::DynamicState::eScissor};
 
-    mCommandBuffers[i].begin(beginInfo);
+  vk::PipelineDynamicStateCreateInfo DynamicStateInfo(
+      {}, static_cast<uint32_t>(DynamicStates.size()), DynamicStates.data());
 
-    vk::Rect2D renderArea({0, 0}, {mExtent.width, mExtent.height});
+  vk::GraphicsPipelineCreateInfo PipelineCreateInfo;
 
-    std::array<float, 4> color = {bgColor.x, bgColor.y, bgColor.z, bgColor.w};
+  PipelineCreateInfo.stageCount = 2;
+  PipelineCreateInfo.pStages = ShaderStages;
+  PipelineCreateInfo.pVertexInputState = &VertexInputInfo;
+  PipelineCreateInfo.pInputAssemblyState = &InputAssemblyInfo;
+  PipelineCreateInfo.pViewportState = &ViewportInfo;
+  PipelineCreateInfo.pRasterizationState = &RasterizerInfo;
+  PipelineCreateInfo.pMultisampleState = &MultisampleInfo;
+  PipelineCreateInfo.pDepthStencilState = &depthStencilInfo;
+  PipelineCreateInfo.pColorBlendState = &ColorBlendingInfo;
+  PipelineCreateInfo.pDynamicState = &DynamicStateInfo;
 
-    std::array<vk::ClearValue, 2> clearValues{};
-    clearValues[0].setColor(color);
-    clearValues[1].depthStencil.depth = 1.0f;
-    clearValues[1].depthStencil.stencil = 0;
+  PipelineCreateInfo.renderPass = mRenderPass;
+  PipelineCreateInfo.subpass = 0;
 
-    vk::RenderPassBeginInfo renderPassInfo(
-        mRenderPass, mFramebuffers[i], renderArea,
-        static_cast<uint32_t>(clearValues.size()), clearValues.data());
+  PipelineCreateInfo.basePipelineIndex = -1;
+  PipelineCreateInfo.layout = mPipelineLayout;
 
-    mCommandBuffers[i].beginRenderPass(renderPassInfo,
-                                       vk::SubpassContents::eInline);
+  Pipelines.SketchGrid =
+      mDevice
+          .createGraphicsPipeline(mPipelineCache, PipelineCreateInfo, nullptr)
+          .value;
 
-    vk::DeviceSize offsets[] = {0};
+  mDevice.destroyShaderModule(vertShaderModule, nullptr);
+  mDevice.destroyShaderModule(fragShaderModule, nullptr);
+}
 
-    mCommandBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                                          mPipelineLayout, 0, 1,
-                                          &mDescriptorSets[i], 0, nullptr);
+void TruchasRender::createSketchLinePipeline() {
 
-    for (const auto &buffer : mBuffers) {
+  // Segments and their endpoints come from storage buffers
+  vk::PipelineVertexInputStateCreateInfo VertexInputInfo;
 
-      // if (buffer.second.isEmpty)
-      //   continue;
+  auto vertShaderCode = readFile(config::line_vert_shader_file_path);
+  auto fragShaderCode = readFile(config::line_frag_shader_file_path);
 
-      mCommandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics,
-                                      Pipelines.SketchPoint);
-      mCommandBuffers[i].bindVertexBuffers(0, 1, &buffer.second.mBuffer,
-                                           offsets);
-      mCommandBuffers[i].draw(buffer.second.mPointSize, 1, 0, 0);
-    }
+  vk::ShaderModule vertShaderModule = createShaderModule(vertShaderCode);
+  vk::ShaderModule fragShaderModule = createShaderModule(fragShaderCode);
 
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), mCommandBuffers[i]);
+  vk::PipelineShaderStageCreateInfo ShaderStages[] = {
+      {{}, vk::ShaderStageFlagBits::eVertex, vertShaderModule, "main"},
+      {{}, vk::ShaderStageFlagBits::eFragment, fragShaderModule, "main"}};
 
-    mCommandBuffers[i].endRenderPass();
+  vk::PipelineInputAssemblyStateCreateInfo InputAssemblyInfo(
+      {}, vk::PrimitiveTopology::eTriangleList, VK_FALSE);
 
-    mCommandBuffers[i].end();
-  }
-}
+  vk::PipelineRasterizationStateCreateInfo RasterizerInfo(
+      {}, VK_FALSE, VK_FALSE, vk::PolygonMode::eFill,
+      vk::CullModeFlagBits::eNone, vk::FrontFace::eCounterClockwise, VK_FALSE,
+      0.0f, 0.0f, 0.0f, 1.0f);
 
-void TruchasRender::updateUniformBuffer(uint32_t currentImage) {
+  vk::PipelineViewportStateCreateInfo ViewportInfo({}, 1, nullptr, 1, nullptr);
 
-  glm::vec3 up = glm::vec3(0.0f, 0.0f, 1.0f);
-  u.model = glm::rotate(glm::mat4(1.0f), glm::radians(0.0f), up);
+  vk::PipelineMultisampleStateCreateInfo MultisampleInfo(
+      {}, vk::SampleCountFlagBits::e1, VK_FALSE, 1.0f, nullptr, VK_FALSE,
+      VK_FALSE);
 
-  u.view = glm::lookAt(glm::vec3(0.0f, -10.0f, 0.0f),
-                       glm::vec3(0.0f, 0.0f, 0.0f), up);
+  // Coverage from the fragment shader antialiases the edges
+  vk::PipelineColorBlendAttachmentState ColorBlendAttachment(
+      VK_TRUE, vk::BlendFactor::eSrcAlpha, vk::BlendFactor::eOneMinusSrcAlpha,
+      vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eZero,
+      vk::BlendOp::eAdd,
+      vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+          vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
 
-  u.proj =
-      glm::perspective(glm::radians(45.0f),
-                       mExtent.width / (float)mExtent.height, 0.001f, 100.0f);
+  auto BlendAttachments = sceneBlendAttachments(ColorBlendAttachment);
 
-  u.proj[1][1] *= -1;
+  vk::PipelineColorBlendStateCreateInfo ColorBlendingInfo(
+      {}, VK_FALSE, vk::LogicOp::eCopy,
+      static_cast<uint32_t>(BlendAttachments.size()), BlendAttachments.data(),
+      {0.0f, 0.0f, 0.0f, 0.0f});
 
-  vk::MemoryMapFlags memMapFlags;
+  // Less or equal so overlapping joins of the same polyline both draw
+  vk::PipelineDepthStencilStateCreateInfo depthStencilInfo(
+      {}, VK_TRUE, VK_TRUE, vk::CompareOp::eLessOrEqual, VK_FALSE, VK_FALSE,
+      {}, {}, 0.0f, 1.0f);
 
-  void *data;
-  data = mDevice.mapMemory(mUniformBufferMemories[currentImage], 0, sizeof(u),
-                           memMapFlags);
-  memcpy(data, &u, sizeof(u));
-  mDevice.unmapMemory(mUniformBufferMemories[currentImage]);
-}
+  std::array<vk::DynamicState, 2> DynamicStates = {vk::DynamicState::eViewport,
+                                                   vk::DynamicState::eScissor};
 
-void TruchasRender::drawFrame() {
+  vk::PipelineDynamicStateCreateInfo DynamicStateInfo(
+      {}, static_cast<uint32_t>(DynamicStates.size()), DynamicStates.data());
 
-  vk::Result result1 = mDevice.waitForFences(mInFlightFences[mCurrentFrame],
-                                             VK_TRUE, UINT64_MAX);
+  vk::GraphicsPipelineCreateInfo PipelineCreateInfo;
 
-  uint32_t imageIndex = 0;
+  PipelineCreateInfo.stageCount = 2;
+  PipelineCreateInfo.pStages = ShaderStages;
+  PipelineCreateInfo.pVertexInputState = &VertexInputInfo;
+  PipelineCreateInfo.pInputAssemblyState = &InputAssemblyInfo;
+  PipelineCreateInfo.pViewportState = &ViewportInfo;
+  PipelineCreateInfo.pRasterizationState = &RasterizerInfo;
+  PipelineCreateInfo.pMultisampleState = &MultisampleInfo;
+  PipelineCreateInfo.pDepthStencilState = &depthStencilInfo;
+  PipelineCreateInfo.pColorBlendState = &ColorBlendingInfo;
+  PipelineCreateInfo.pDynamicState = &DynamicStateInfo;
 
-  vk::Fence F;
+  PipelineCreateInfo.renderPass = mRenderPass;
+  PipelineCreateInfo.subpass = 0;
 
-  vk::Result result = mDevice.acquireNextImageKHR(
-      mSwapchain, UINT64_MAX, mImageAvailableSemaphores[mCurrentFrame], F,
-      &imageIndex);
+  PipelineCreateInfo.basePipelineIndex = -1;
+  PipelineCreateInfo.layout = mLinePipelineLayout;
 
-  if (result == vk::Result::eErrorOutOfDateKHR) {
-    recreateSwapchain();
-    return;
-  } else if (result != vk::Result::eSuccess &&
-             result != vk::Result::eSuboptimalKHR) {
-    throw std::runtime_error("failed to acquire swap chain image!");
-  }
+  Pipelines.SketchLine =
+      mDevice
+          .createGraphicsPipeline(mPipelineCache, PipelineCreateInfo, nullptr)
+          .value;
 
-  updateUniformBuffer(imageIndex);
+  mDevice.destroyShaderModule(vertShaderModule, nullptr);
+  mDevice.destroyShaderModule(fragShaderModule, nullptr);
+}
 
-  vk::Semaphore waitSemaphore[] = {mImageAvailableSemaphores[mCurrentFrame]};
-  vk::Semaphore signalSemaphore[] = {mRenderFinishedSemaphores[mCurrentFrame]};
+void TruchasRender::createSketchSplatPipelines() {
 
-  vk::PipelineStageFlags waitStages =
-      vk::PipelineStageFlagBits::eColorAttachmentOutput;
+  auto compShaderCode = readFile(config::splat_comp_shader_file_path);
+  vk::ShaderModule compShaderModule = createShaderModule(compShaderCode);
 
-  vk::SubmitInfo submitInfo(1, waitSemaphore, &waitStages, 1,
-                            &mCommandBuffers[imageIndex], 1, signalSemaphore);
+  // Dispatch base lets one model span several dispatches of at most
+  // MAX_SPLAT_GROUPS groups
+  vk::ComputePipelineCreateInfo ComputeCreateInfo(
+      vk::PipelineCreateFlagBits::eDispatchBase,
+      {{}, vk::ShaderStageFlagBits::eCompute, compShaderModule, "main"},
+      mSplatPipelineLayout);
 
-  mDevice.resetFences(mInFlightFences[mCurrentFrame]);
+  Pipelines.SketchSplat =
+      mDevice.createComputePipeline(mPipelineCache, ComputeCreateInfo, nullptr)
+          .value;
 
-  mGraphicsQueue.submit(submitInfo, mInFlightFences[mCurrentFrame]);
+  mDevice.destroyShaderModule(compShaderModule, nullptr);
 
-  vk::PresentInfoKHR presentInfo(1, signalSemaphore, 1, &mSwapchain,
-                                 &imageIndex);
+  // Resolve, a full screen triangle writing color and depth
+  vk::PipelineVertexInputStateCreateInfo VertexInputInfo;
 
-  result = mPresentQueue.presentKHR(presentInfo);
+  auto vertShaderCode = readFile(config::splat_resolve_vert_shader_file_path);
+  auto fragShaderCode = readFile(config::splat_resolve_frag_shader_file_path);
 
-  if (result == vk::Result::eErrorOutOfDateKHR ||
-      result == vk::Result::eSuboptimalKHR || frameBufferResized ||
-      result == vk::Result::eErrorIncompatibleDisplayKHR) {
-    frameBufferResized = false;
-    recreateSwapchain();
-  } else if (result != vk::Result::eSuccess) {
-    // std::cout << "Present Queue Failed\n";
-    throw std::runtime_error("failed to present swap chain image!");
-  }
+  vk::ShaderModule vertShaderModule = createShaderModule(vertShaderCode);
+  vk::ShaderModule fragShaderModule = createShaderModule(fragShaderCode);
 
-  mPresentQueue.waitIdle();
+  vk::PipelineShaderStageCreateInfo ShaderStages[] = {
+      {{}, vk::ShaderStageFlagBits::eVertex, vertShaderModule, "main"},
+      {{}, vk::ShaderStageFlagBits::eFragment, fragShaderModule, "main"}};
 
-  mCurrentFrame = (mCurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
-}
+  vk::PipelineInputAssemblyStateCreateInfo InputAssemblyInfo(
+      {}, vk::PrimitiveTopology::eTriangleList, VK_FALSE);
+
+  vk::PipelineRasterizationStateCreateInfo RasterizerInfo(
+      {}, VK_FALSE, VK_FALSE, vk::PolygonMode::eFill,
+      vk::CullModeFlagBits::eNone, vk::FrontFace::eCounterClockwise, VK_FALSE,
+      0.0f, 0.0f, 0.0f, 1.0f);
+
+  vk::PipelineViewportStateCreateInfo ViewportInfo({}, 1, nullptr, 1, nullptr);
+
+  vk::PipelineMultisampleStateCreateInfo MultisampleInfo(
+      {}, vk::SampleCountFlagBits::e1, VK_FALSE, 1.0f, nullptr, VK_FALSE,
+      VK_FALSE);
+
+  vk::PipelineColorBlendAttachmentState ColorBlendAttachment(
+      VK_FALSE, vk::BlendFactor::eOne, vk::BlendFactor::eZero,
+      vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eZero,
+      vk::BlendOp::eAdd,
+      vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+          vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+
+  // Splatted points are not pickable, the cleared ids stay
+  auto BlendAttachments = sceneBlendAttachments(ColorBlendAttachment, false);
+
+  vk::PipelineColorBlendStateCreateInfo ColorBlendingInfo(
+      {}, VK_FALSE, vk::LogicOp::eCopy,
+      static_cast<uint32_t>(BlendAttachments.size()), BlendAttachments.data(),
+      {0.0f, 0.0f, 0.0f, 0.0f});
+
+  // Splatted depth goes into the depth buffer so raster geometry, the grid
+  // and lines still sort against it
+  vk::PipelineDepthStencilStateCreateInfo depthStencilInfo(
+      {}, VK_TRUE, VK_TRUE, vk::CompareOp::eLess, VK_FALSE, VK_FALSE, {}, {},
+      0.0f, 1.0f);
+
+  std::array<vk::DynamicState, 2> DynamicStates = {vk::DynamicState::eViewport,
+                                                   vk::DynamicState::eScissor};
+
+  vk::PipelineDynamicStateCreateInfo DynamicStateInfo(
+      {}, static_cast<uint32_t>(DynamicStates.size()), DynamicStates.data());
+
+  vk::GraphicsPipelineCreateInfo PipelineCreateInfo;
+
+  PipelineCreateInfo.stageCount = 2;
+  PipelineCreateInfo.pStages = ShaderStages;
+  PipelineCreateInfo.pVertexInputState = &VertexInputInfo;
+  PipelineCreateInfo.pInputAssemblyState = &InputAssemblyInfo;
+  PipelineCreateInfo.pViewportState = &ViewportInfo;
+  PipelineCreateInfo.pRasterizationState = &RasterizerInfo;
+  PipelineCreateInfo.pMultisampleState = &MultisampleInfo;
+  PipelineCreateInfo.pDepthStencilState = &depthStencilInfo;
+  PipelineCreateInfo.pColorBlendState = &ColorBlendingInfo;
+  PipelineCreateInfo.pDynamicState = &DynamicStateInfo;
+
+  PipelineCreateInfo.renderPass = mRenderPass;
+  PipelineCreateInfo.subpass = 0;
+
+  PipelineCreateInfo.basePipelineIndex = -1;
+  PipelineCreateInfo.layout = mSplatPipelineLayout;
+
+  Pipelines.SketchSplatResolve =
+      mDevice
+          .createGraphicsPipeline(mPipelineCache, PipelineCreateInfo, nullptr)
+          .value;
+
+  mDevice.destroyShaderModule(vertShaderModule, nullptr);
+  mDevice.destroyShaderModule(fragShaderModule, nullptr);
+}
+
+void TruchasRender::preparePipelines() {
+  createSketchPointPipeline();
+  createSketchLinePipeline();
+  createSketchGridPipeline();
+
+  if (mSplatSupported)
+    createSketchSplatPipelines();
+}
+
+void TruchasRender::copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer,
+                               vk::DeviceSize size) {
+
+  vk::CommandBuffer commandBuffer = beginSingleTimeCommands(
+      vk::CommandBufferLevel::ePrimary, vk::CommandBufferInheritanceInfo());
+
+  vk::BufferCopy copyRegion;
+  copyRegion.size = size;
+
+  commandBuffer.copyBuffer(srcBuffer, dstBuffer, copyRegion);
+
+  endSingleTimeCommands(commandBuffer);
+}
+
+void TruchasRender::retire(std::function<void()> destroy) {
+  mRetired.push_back({mFrameCount + 1, std::move(destroy)});
+}
+
+void TruchasRender::retireBuffer(Buffer &buffer) {
+
+  vk::DescriptorSet splatSet = buffer.mSplatSet;
+  buffer.mSplatSet = nullptr;
+
+  retire([this, splatSet, handle = buffer.mBuffer, memory = buffer.mMemory] {
+    if (splatSet)
+      mDevice.freeDescriptorSets(mSplatDescriptorPool, 1, &splatSet);
+    mDevice.destroyBuffer(handle);
+    mDevice.freeMemory(memory);
+  });
+}
+
+void TruchasRender::releaseRetired(bool idle) {
+
+  while (!mRetired.empty() &&
+         (idle || mRetired.front().frame <= mCompletedFrames)) {
+    mRetired.front().destroy();
+    mRetired.pop_front();
+  }
+}
+
+void TruchasRender::submitTransfer(vk::CommandBuffer &commandBuffer,
+                                   std::function<void()> release) {
+
+  // Submission order makes later frames wait for the copies
+  vk::MemoryBarrier written(vk::AccessFlagBits::eTransferWrite,
+                            vk::AccessFlagBits::eVertexAttributeRead |
+                                vk::AccessFlagBits::eIndexRead |
+                                vk::AccessFlagBits::eShaderRead);
+
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                DRAW_READ_STAGES, {}, 1, &written, 0, nullptr,
+                                0, nullptr);
+  commandBuffer.end();
+
+  vk::SubmitInfo submitInfo(0, nullptr, nullptr, 1, &commandBuffer, 0, nullptr);
+  mGraphicsQueue.submit(submitInfo, nullptr);
+
+  retire([this, commandBuffer, release = std::move(release)] {
+    mDevice.freeCommandBuffers(mCommandPool, commandBuffer);
+    if (release)
+      release();
+  });
+}
+
+void TruchasRender::writeRegions(vk::Buffer buffer,
+                                 const std::vector<vk::BufferCopy> &regions,
+                                 vk::DeviceSize stagingSize,
+                                 const std::function<void(void *)> &fill) {
+
+  vk::Buffer stagingBuffer;
+  vk::DeviceMemory stagingBufferMemory;
+
+  createBuffer(stagingSize, vk::BufferUsageFlagBits::eTransferSrc,
+               vk::MemoryPropertyFlagBits::eHostVisible |
+                   vk::MemoryPropertyFlagBits::eHostCoherent,
+               stagingBuffer, stagingBufferMemory);
+
+  fill(mDevice.mapMemory(stagingBufferMemory, 0, stagingSize, {}));
+  mDevice.unmapMemory(stagingBufferMemory);
+
+  vk::CommandBuffer commandBuffer = beginSingleTimeCommands(
+      vk::CommandBufferLevel::ePrimary, vk::CommandBufferInheritanceInfo());
+
+  // Written in place, the frames in flight finish drawing it first
+  commandBuffer.pipelineBarrier(DRAW_READ_STAGES,
+                                vk::PipelineStageFlagBits::eTransfer, {}, 0,
+                                nullptr, 0, nullptr, 0, nullptr);
+
+  commandBuffer.copyBuffer(stagingBuffer, buffer,
+                           static_cast<uint32_t>(regions.size()),
+                           regions.data());
+
+  submitTransfer(commandBuffer, [this, stagingBuffer, stagingBufferMemory] {
+    mDevice.destroyBuffer(stagingBuffer);
+    mDevice.freeMemory(stagingBufferMemory);
+  });
+}
+
+void TruchasRender::deleteBuffer(uint32_t id) {
+
+  // mBuffers[id].isEmpty = true;
+
+  std::map<uint32_t, Buffer>::iterator erase_iter = mBuffers.find(id);
+
+  if (erase_iter != mBuffers.end()) {
+    // The frames in flight may still draw it
+    retireBuffer(erase_iter->second);
+    mBuffers.erase(erase_iter);
+    mDrawsChanged = true;
+  }
+
+  // The set still points at the destroyed vertex buffer
+  deleteLineSet(id);
+  requestFrame();
+}
+
+void TruchasRender::createCommandBuffers() {
+
+  // Outdated command buffers are never submitted again, the slots and ids
+  // only have to match the ones recorded from now on
+  assignLodSlots();
+  assignPickIds();
+
+  mOutdatedCommandBuffers.assign(mCommandBuffers.size(), true);
+  mDrawsChanged = false;
+}
+
+void TruchasRender::recordCommandBuffer(uint32_t i) {
+
+  mOutdatedCommandBuffers[i] = false;
+
+  vk::CommandBufferBeginInfo beginInfo(
+      vk::CommandBufferUsageFlagBits::eSimultaneousUse);
+
+  mCommandBuffers[i].reset();
+  mCommandBuffers[i].begin(beginInfo);
+
+  uint32_t firstQuery = 2 * i;
+
+  if (mTimestamps) {
+    mCommandBuffers[i].resetQueryPool(mTimestamps, firstQuery, 2);
+    mCommandBuffers[i].writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,
+                                      mTimestamps, firstQuery);
+  }
+
+  // Every view is an instance, more views add no recorded commands
+  uint32_t viewCount = getViewCount();
+  vk::Extent2D extent = sceneExtent();
+
+  bool splatted = recordSplats(mCommandBuffers[i], i, viewCount);
+
+  vk::Rect2D renderArea({0, 0}, extent);
+
+  std::vector<vk::ClearValue> clearValues = sceneClearValues();
+
+  vk::RenderPassBeginInfo renderPassInfo(
+      mRenderPass, mFramebuffers[i], renderArea,
+      static_cast<uint32_t>(clearValues.size()), clearValues.data());
+
+  if (mDynamicResolution) {
+    renderPassInfo.renderPass = mOffscreenRenderPass;
+    renderPassInfo.framebuffer = mSceneTarget.mFramebuffer;
+  }
+
+  mCommandBuffers[i].beginRenderPass(renderPassInfo,
+                                     vk::SubpassContents::eInline);
+
+  vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(extent.width),
+                        static_cast<float>(extent.height), 0.0f, 1.0f);
+
+  mCommandBuffers[i].setViewport(0, 1, &viewport);
+  mCommandBuffers[i].setScissor(0, 1, &renderArea);
+
+  // First, so the rest depth tests against the splats
+  if (splatted)
+    recordSplatResolve(mCommandBuffers[i], i);
+
+  mCommandBuffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                        mPipelineLayout, 0, 1,
+                                        &mDescriptorSets[i], 0, nullptr);
+
+  mCommandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                  Pipelines.SketchPoint);
+
+  recordGeometry(mCommandBuffers[i], viewCount, 0, static_cast<int>(i));
+
+  if (mShowGrid) {
+    mCommandBuffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                    Pipelines.SketchGrid);
+    mCommandBuffers[i].draw(3, viewCount, 0, 0);
+  }
+
+  recordLines(mCommandBuffers[i], mDescriptorSets[i], viewCount, 0, extent);
+
+  if (mDynamicResolution) {
+
+    // The scene pass ends here, the UI gets a pass of its own at full size
+    if (mPickingEnabled)
+      mCommandBuffers[i].nextSubpass(vk::SubpassContents::eInline);
+
+    mCommandBuffers[i].endRenderPass();
+
+    if (mTimestamps)
+      mCommandBuffers[i].writeTimestamp(
+          vk::PipelineStageFlagBits::eBottomOfPipe, mTimestamps,
+          firstQuery + 1);
+
+    recordUpscale(mCommandBuffers[i], i, extent);
+
+    renderPassInfo.renderPass = mUiRenderPass;
+    renderPassInfo.framebuffer = mFramebuffers[i];
+    renderPassInfo.renderArea = vk::Rect2D({0, 0}, mExtent);
+
+    mCommandBuffers[i].beginRenderPass(renderPassInfo,
+                                       vk::SubpassContents::eInline);
+  }
+
+  if (mPickingEnabled)
+    mCommandBuffers[i].nextSubpass(vk::SubpassContents::eInline);
+
+  ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), mCommandBuffers[i]);
+
+  mCommandBuffers[i].endRenderPass();
+
+  mCommandBuffers[i].end();
+}
+
+void TruchasRender::recordGeometry(vk::CommandBuffer &commandBuffer,
+                                   uint32_t instanceCount,
+                                   uint32_t firstInstance, int imageIndex) {
+
+  vk::DeviceSize offsets[] = {0};
+
+  auto draw = [&](const Buffer &buffer) {
+
+    commandBuffer.bindVertexBuffers(0, 1, &buffer.mBuffer, offsets);
+    commandBuffer.pushConstants(mPipelineLayout,
+                                vk::ShaderStageFlagBits::eVertex, 0,
+                                sizeof(buffer.mPickBase), &buffer.mPickBase);
+
+    if (imageIndex < 0 || !buffer.mOctree || buffer.mLodSlot == NO_LOD_SLOT) {
+      commandBuffer.draw(buffer.mPointSize, instanceCount, 0, firstInstance);
+      return;
+    }
+
+    // updateLod fills in the selected nodes and the views as instances
+    vk::Buffer table = mLodTables[imageIndex].mBuffer;
+    vk::DeviceSize header = LOD_SLOT_SIZE * buffer.mLodSlot;
+    uint32_t nodeCount =
+        static_cast<uint32_t>(buffer.mOctree->nodes().size());
+
+    if (mDrawIndirectCount)
+      commandBuffer.drawIndirectCount(table, header + LOD_SLOT_SIZE, table,
+                                      header, nodeCount, LOD_SLOT_SIZE);
+    else
+      commandBuffer.drawIndirect(table, header + LOD_SLOT_SIZE, nodeCount,
+                                 LOD_SLOT_SIZE);
+  };
+
+  bool splatting = imageIndex >= 0;
+
+  for (const auto &buffer : mBuffers)
+    if (!splatting || !shouldSplat(buffer.second.mPointSize))
+      draw(buffer.second);
+
+  for (const auto &cloud : mPointClouds)
+    if (!splatting || !shouldSplat(cloud.second.pointCount()))
+      for (const auto &chunk : cloud.second.mChunks)
+        draw(chunk);
+}
+
+bool TruchasRender::shouldSplat(size_t pointCount) const {
+  return mSplatSupported && !mSplatBuffers.empty() &&
+         pointCount >= mSplatThreshold;
+}
+
+void TruchasRender::createSplatTargets() {
+
+  if (!mSplatSupported)
+    return;
+
+  destroySplatTargets();
+
+  vk::DeviceSize size = sizeof(uint64_t) * mExtent.width * mExtent.height;
+
+  std::vector<vk::DescriptorSetLayout> layouts(mImages.size(),
+                                               mSplatTargetLayout);
+
+  vk::DescriptorSetAllocateInfo allocInfo(
+      mSplatDescriptorPool, static_cast<uint32_t>(layouts.size()),
+      layouts.data());
+
+  mSplatTargets = mDevice.allocateDescriptorSets(allocInfo);
+
+  for (size_t i = 0; i < mImages.size(); i++) {
+
+    mSplatBuffers.push_back(uploadBuffer(
+        nullptr, 0, size, vk::BufferUsageFlagBits::eStorageBuffer));
+
+    vk::DescriptorBufferInfo bufferInfo(mSplatBuffers[i].mBuffer, 0,
+                                        VK_WHOLE_SIZE);
+
+    vk::WriteDescriptorSet descriptorWrite;
+    descriptorWrite.dstSet = mSplatTargets[i];
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.descriptorType = vk::DescriptorType::eStorageBuffer;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+
+    mDevice.updateDescriptorSets(1, &descriptorWrite, 0, nullptr);
+  }
+
+  // Tables of a different image count are replaced by assignLodSlots
+  if (mLodTables.size() == mImages.size())
+    writeLodTables();
+}
+
+void TruchasRender::destroySplatTargets() {
+
+  for (auto &buffer : mSplatBuffers) {
+    mDevice.destroyBuffer(buffer.mBuffer);
+    mDevice.freeMemory(buffer.mMemory);
+  }
+
+  if (!mSplatTargets.empty())
+    mDevice.freeDescriptorSets(mSplatDescriptorPool,
+                               static_cast<uint32_t>(mSplatTargets.size()),
+                               mSplatTargets.data());
+
+  mSplatBuffers.clear();
+  mSplatTargets.clear();
+}
+
+vk::DescriptorSet TruchasRender::getSplatSource(Buffer &buffer) {
+
+  if (buffer.mSplatSet)
+    return buffer.mSplatSet;
+
+  vk::DescriptorSetAllocateInfo allocInfo(mSplatDescriptorPool, 1,
+                                          &mSplatSourceLayout);
+  buffer.mSplatSet = mDevice.allocateDescriptorSets(allocInfo)[0];
+
+  vk::DescriptorBufferInfo bufferInfo(buffer.mBuffer, 0, VK_WHOLE_SIZE);
+
+  vk::WriteDescriptorSet descriptorWrite;
+  descriptorWrite.dstSet = buffer.mSplatSet;
+  descriptorWrite.dstBinding = 0;
+  descriptorWrite.descriptorType = vk::DescriptorType::eStorageBuffer;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pBufferInfo = &bufferInfo;
+
+  mDevice.updateDescriptorSets(1, &descriptorWrite, 0, nullptr);
+
+  return buffer.mSplatSet;
+}
+
+bool TruchasRender::recordSplats(vk::CommandBuffer &commandBuffer,
+                                 uint32_t imageIndex, uint32_t viewCount) {
+
+  std::vector<Buffer *> sources;
+
+  for (auto &buffer : mBuffers)
+    if (shouldSplat(buffer.second.mPointSize))
+      sources.push_back(&buffer.second);
+
+  for (auto &cloud : mPointClouds)
+    if (shouldSplat(cloud.second.pointCount()))
+      for (auto &chunk : cloud.second.mChunks)
+        sources.push_back(&chunk);
+
+  if (sources.empty())
+    return false;
+
+  vk::Buffer target = mSplatBuffers[imageIndex].mBuffer;
+
+  // All ones is behind the far plane, so any point replaces it
+  commandBuffer.fillBuffer(target, 0, VK_WHOLE_SIZE, 0xFFFFFFFF);
+
+  vk::BufferMemoryBarrier cleared(
+      vk::AccessFlagBits::eTransferWrite,
+      vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+      VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, target, 0,
+      VK_WHOLE_SIZE);
+
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                vk::PipelineStageFlagBits::eComputeShader, {},
+                                0, nullptr, 1, &cleared, 0, nullptr);
+
+  commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute,
+                             Pipelines.SketchSplat);
+  commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                   mSplatPipelineLayout, 0, 1,
+                                   &mDescriptorSets[imageIndex], 0, nullptr);
+  commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                   mSplatPipelineLayout, 2, 1,
+                                   &mSplatTargets[imageIndex], 0, nullptr);
+
+  vk::Extent2D extent = sceneExtent();
+  SplatPush push{glm::uvec2(extent.width, extent.height), 0, 0, NO_LOD_SLOT};
+
+  for (Buffer *source : sources) {
+
+    vk::DescriptorSet sourceSet = getSplatSource(*source);
+
+    push.pointCount = source->mPointSize;
+    push.lodSlot = source->mOctree ? source->mLodSlot : NO_LOD_SLOT;
+
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                                     mSplatPipelineLayout, 1, 1, &sourceSet, 0,
+                                     nullptr);
+    commandBuffer.pushConstants(mSplatPipelineLayout,
+                                vk::ShaderStageFlagBits::eCompute |
+                                    vk::ShaderStageFlagBits::eFragment,
+                                0, sizeof(push), &push);
+
+    // The header slot is the dispatch over the selected node ranges
+    if (push.lodSlot != NO_LOD_SLOT) {
+      commandBuffer.dispatchIndirect(mLodTables[imageIndex].mBuffer,
+                                     LOD_SLOT_SIZE * push.lodSlot);
+      continue;
+    }
+
+    // Points along x, views along y
+    uint32_t groups =
+        (push.pointCount + SPLAT_GROUP_SIZE - 1) / SPLAT_GROUP_SIZE;
+
+    for (uint32_t first = 0; first < groups; first += MAX_SPLAT_GROUPS)
+      commandBuffer.dispatchBase(first, 0, 0,
+                                 std::min(MAX_SPLAT_GROUPS, groups - first),
+                                 viewCount, 1);
+  }
+
+  vk::BufferMemoryBarrier splatted(
+      vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead,
+      VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, target, 0,
+      VK_WHOLE_SIZE);
+
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                vk::PipelineStageFlagBits::eFragmentShader, {},
+                                0, nullptr, 1, &splatted, 0, nullptr);
+
+  return true;
+}
+
+void TruchasRender::recordSplatResolve(vk::CommandBuffer &commandBuffer,
+                                       uint32_t imageIndex) {
+
+  vk::Extent2D extent = sceneExtent();
+  SplatPush push{glm::uvec2(extent.width, extent.height), 0, 0, NO_LOD_SLOT};
+
+  commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                             Pipelines.SketchSplatResolve);
+  commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                   mSplatPipelineLayout, 2, 1,
+                                   &mSplatTargets[imageIndex], 0, nullptr);
+  commandBuffer.pushConstants(mSplatPipelineLayout,
+                              vk::ShaderStageFlagBits::eCompute |
+                                  vk::ShaderStageFlagBits::eFragment,
+                              0, sizeof(push), &push);
+  commandBuffer.draw(3, 1, 0, 0);
+}
+
+bool TruchasRender::useLod(size_t pointCount) const {
+  return mLodSupported && mLodEnabled && pointCount >= mLodThreshold;
+}
+
+std::shared_ptr<const PointOctree>
+TruchasRender::buildOctree(const Vertex *vertices, size_t count,
+                           std::vector<Vertex> &ordered) {
+
+  ThreadPool &pool = getThreadPool();
+
+  auto octree = std::make_shared<PointOctree>();
+  octree->build(&vertices->pos, count, sizeof(Vertex), &pool);
+
+  ordered.resize(octree->size());
+  octree->gather(vertices, ordered.data(), sizeof(Vertex), &pool);
+
+  return octree;
+}
+
+void TruchasRender::assignLodSlots() {
+
+  uint32_t slots = 0;
+
+  auto assign = [&](Buffer &buffer) {
+    if (!buffer.mOctree)
+      return;
+
+    buffer.mLodSlot = slots;
+    slots += static_cast<uint32_t>(buffer.mOctree->nodes().size()) + 1;
+  };
+
+  for (auto &buffer : mBuffers)
+    assign(buffer.second);
+
+  for (auto &cloud : mPointClouds)
+    for (auto &chunk : cloud.second.mChunks)
+      assign(chunk);
+
+  // The splat shader binds a table whether or not anything uses it
+  mLodSlotCount = std::max(slots, 1u);
+
+  if (mLodTables.size() == mImages.size() &&
+      mLodSlotCount <= mLodTables[0].mCapacity)
+    return;
+
+  // Frames in flight read the tables through the splat targets, growing by
+  // half keeps this wait rare
+  if (!mLodTables.empty())
+    mDevice.waitIdle();
+
+  destroyLodTables();
+
+  // Streamed clouds add chunks every few frames
+  uint32_t capacity = mLodSlotCount + mLodSlotCount / 2;
+
+  for (size_t i = 0; i < mImages.size(); i++) {
+
+    Buffer table;
+    table.mDeviceSize = LOD_SLOT_SIZE * capacity;
+    table.mCapacity = capacity;
+
+    createBuffer(table.mDeviceSize,
+                 vk::BufferUsageFlagBits::eIndirectBuffer |
+                     vk::BufferUsageFlagBits::eStorageBuffer,
+                 vk::MemoryPropertyFlagBits::eHostVisible |
+                     vk::MemoryPropertyFlagBits::eHostCoherent,
+                 table.mBuffer, table.mMemory);
+
+    void *mapped = mDevice.mapMemory(table.mMemory, 0, table.mDeviceSize, {});
+    std::memset(mapped, 0, static_cast<size_t>(table.mDeviceSize));
+
+    mLodTables.push_back(table);
+    mLodMapped.push_back(static_cast<uint32_t *>(mapped));
+  }
+
+  writeLodTables();
+}
+
+void TruchasRender::writeLodTables() {
+
+  for (size_t i = 0; i < mSplatTargets.size() && i < mLodTables.size(); i++) {
+
+    vk::DescriptorBufferInfo tableInfo(mLodTables[i].mBuffer, 0,
+                                       VK_WHOLE_SIZE);
+
+    vk::WriteDescriptorSet descriptorWrite;
+    descriptorWrite.dstSet = mSplatTargets[i];
+    descriptorWrite.dstBinding = 1;
+    descriptorWrite.descriptorType = vk::DescriptorType::eStorageBuffer;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = &tableInfo;
+
+    mDevice.updateDescriptorSets(1, &descriptorWrite, 0, nullptr);
+  }
+}
+
+void TruchasRender::destroyLodTables() {
+
+  for (auto &table : mLodTables) {
+    mDevice.unmapMemory(table.mMemory);
+    mDevice.destroyBuffer(table.mBuffer);
+    mDevice.freeMemory(table.mMemory);
+  }
+
+  mLodTables.clear();
+  mLodMapped.clear();
+}
+
+void TruchasRender::updateLod(uint32_t imageIndex) {
+
+  if (imageIndex >= mLodTables.size())
+    return;
+
+  std::vector<Buffer *> buffers;
+  std::vector<const PointOctree *> trees;
+  std::vector<uint8_t> splatted;
+
+  // Buffers uploaded since the last recording have no slots yet
+  auto collect = [&](Buffer &buffer, bool splat) {
+    if (!buffer.mOctree || buffer.mLodSlot == NO_LOD_SLOT)
+      return;
+
+    buffers.push_back(&buffer);
+    trees.push_back(buffer.mOctree.get());
+    splatted.push_back(splat);
+  };
+
+  for (auto &buffer : mBuffers)
+    collect(buffer.second, shouldSplat(buffer.second.mPointSize));
+
+  for (auto &cloud : mPointClouds) {
+    bool splat = shouldSplat(cloud.second.pointCount());
+    for (auto &chunk : cloud.second.mChunks)
+      collect(chunk, splat);
+  }
+
+  if (trees.empty())
+    return;
+
+  uint32_t viewCount = getViewCount();
+
+  ViewData camera = {u.view, u.proj, FULL_VIEW_RECT};
+  const ViewData *viewData = mViews.empty() ? &camera : mViews.data();
+
+  std::vector<LodView> views(viewCount);
+
+  for (uint32_t v = 0; v < viewCount; v++) {
+    const ViewData &view = viewData[v];
+    views[v] = {view.proj * view.view * u.model,
+                0.5f * std::abs(view.proj[1][1]) * view.rect.w *
+                    static_cast<float>(mExtent.height)};
+  }
+
+  // Refine further every frame the cameras hold still
+  bool still = std::equal(views.begin(), views.end(), mLodViews.begin(),
+                          mLodViews.end(),
+                          [](const LodView &a, const LodView &b) {
+                            return a.viewProj == b.viewProj &&
+                                   a.pixelScale == b.pixelScale;
+                          });
+
+  mLodFrameBudget =
+      still ? std::min(std::max(2 * mLodFrameBudget, mLodBudget),
+                       mLodMaxBudget)
+            : mLodBudget;
+  mLodViews = std::move(views);
+
+  std::vector<std::vector<uint8_t>> selected;
+  selectLod(trees, mLodViews, mLodFrameBudget, mLodMinPixels, selected);
+
+  uint32_t *table = mLodMapped[imageIndex];
+
+  for (size_t t = 0; t < trees.size(); t++) {
+
+    const auto &nodes = trees[t]->nodes();
+    uint32_t *header = table + 4 * buffers[t]->mLodSlot;
+    uint32_t *slot = header + 4;
+    uint32_t used = 0;
+
+    if (splatted[t]) {
+
+      // Node ranges and the first group of each, one dispatch covers them
+      uint32_t groups = 0;
+
+      for (size_t n = 0; n < nodes.size(); n++) {
+
+        if (!selected[t][n])
+          continue;
+
+        uint32_t nodeGroups =
+            (nodes[n].count + SPLAT_GROUP_SIZE - 1) / SPLAT_GROUP_SIZE;
+
+        if (groups + nodeGroups > MAX_SPLAT_GROUPS)
+          break;
+
+        uint32_t *range = slot + 4 * used++;
+        range[0] = nodes[n].first;
+        range[1] = nodes[n].count;
+        range[2] = groups;
+        range[3] = 0;
+
+        groups += nodeGroups;
+      }
+
+      header[0] = groups;
+      header[1] = viewCount;
+      header[2] = 1;
+      header[3] = used;
+      continue;
+    }
+
+    for (size_t n = 0; n < nodes.size(); n++) {
+
+      if (!selected[t][n])
+        continue;
+
+      uint32_t *draw = slot + 4 * used++;
+      draw[0] = nodes[n].count;
+      draw[1] = viewCount;
+      draw[2] = nodes[n].first;
+      draw[3] = 0;
+    }
+
+    header[0] = used;
+    header[1] = header[2] = header[3] = 0;
+
+    // Without a count buffer every node's command is drawn
+    if (!mDrawIndirectCount)
+      std::memset(slot + 4 * used, 0, LOD_SLOT_SIZE * (nodes.size() - used));
+  }
+}
+
+void TruchasRender::createPickTarget() {
+
+  if (!mPickingEnabled)
+    return;
+
+  createImage(mPhysicalDevice, mDevice, mExtent.width, mExtent.height,
+              vk::Format::eR32Uint, vk::ImageTiling::eOptimal,
+              vk::ImageUsageFlagBits::eColorAttachment |
+                  vk::ImageUsageFlagBits::eTransferSrc,
+              vk::MemoryPropertyFlagBits::eDeviceLocal, mIdImage,
+              mIdImageMemory);
+
+  mIdImageView = createImageView(mIdImage, vk::Format::eR32Uint,
+                                 vk::ImageAspectFlagBits::eColor);
+}
+
+void TruchasRender::destroyPickTarget() {
+
+  mDevice.destroyImageView(mIdImageView);
+  mDevice.destroyImage(mIdImage);
+  mDevice.freeMemory(mIdImageMemory);
+
+  mIdImageView = nullptr;
+  mIdImage = nullptr;
+  mIdImageMemory = nullptr;
+}
+
+void TruchasRender::createPickResources() {
+
+  if (!mPickingEnabled)
+    return;
+
+  vk::CommandPoolCreateInfo commandPoolInfo(
+      vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+      mIndices.graphicsFamily);
+
+  mPickCommandPool = mDevice.createCommandPool(commandPoolInfo);
+
+  vk::CommandBufferAllocateInfo allocInfo(
+      mPickCommandPool, vk::CommandBufferLevel::ePrimary, MAX_FRAMES_IN_FLIGHT);
+
+  std::vector<vk::CommandBuffer> commandBuffers =
+      mDevice.allocateCommandBuffers(allocInfo);
+
+  mPickSlots.resize(MAX_FRAMES_IN_FLIGHT);
+
+  for (size_t i = 0; i < mPickSlots.size(); i++) {
+
+    PickSlot &slot = mPickSlots[i];
+
+    slot.mBuffer.mDeviceSize = sizeof(uint32_t) * PICK_SIZE * PICK_SIZE;
+
+    createBuffer(slot.mBuffer.mDeviceSize,
+                 vk::BufferUsageFlagBits::eTransferDst,
+                 vk::MemoryPropertyFlagBits::eHostVisible |
+                     vk::MemoryPropertyFlagBits::eHostCoherent,
+                 slot.mBuffer.mBuffer, slot.mBuffer.mMemory);
+
+    slot.mMapped = static_cast<const uint32_t *>(mDevice.mapMemory(
+        slot.mBuffer.mMemory, 0, slot.mBuffer.mDeviceSize, {}));
+    slot.mCommandBuffer = commandBuffers[i];
+  }
+}
+
+void TruchasRender::destroyPickResources() {
+
+  for (auto &slot : mPickSlots) {
+    mDevice.unmapMemory(slot.mBuffer.mMemory);
+    mDevice.destroyBuffer(slot.mBuffer.mBuffer);
+    mDevice.freeMemory(slot.mBuffer.mMemory);
+  }
+
+  mPickSlots.clear();
+
+  // Frees the slots' command buffers with it
+  mDevice.destroyCommandPool(mPickCommandPool);
+  mPickCommandPool = nullptr;
+}
+
+void TruchasRender::assignPickIds() {
+
+  mPickRanges.clear();
+  mPickGeneration++;
+
+  // 0 is the cleared background
+  uint32_t next = 1;
+
+  auto assign = [&](uint32_t &base, uint32_t count, PickKind kind,
+                    uint32_t id, uint32_t offset,
+                    std::shared_ptr<const PointOctree> octree) {
+    base = next;
+    mPickRanges.push_back({next, count, kind, id, offset, std::move(octree)});
+    next += count;
+  };
+
+  for (auto &[id, buffer] : mBuffers)
+    assign(buffer.mPickBase, buffer.mPointSize, PickKind::point, id, 0,
+           buffer.mOctree);
+
+  for (auto &[id, cloud] : mPointClouds) {
+
+    uint32_t offset = 0;
+
+    for (auto &chunk : cloud.mChunks) {
+      assign(chunk.mPickBase, chunk.mPointSize, PickKind::cloudPoint, id,
+             offset, chunk.mOctree);
+      offset += chunk.mOctree
+                    ? static_cast<uint32_t>(chunk.mOctree->pointCount())
+                    : chunk.mPointSize;
+    }
+  }
+
+  for (auto &[id, lineSet] : mLineSets)
+    assign(lineSet.mPickBase, lineSet.mSegments.mPointSize, PickKind::segment,
+           id, 0, nullptr);
+}
+
+void TruchasRender::recordPick(PickSlot &slot) {
+
+  slot.mPending = false;
+
+  // The cursor is over the UI
+  if (ImGui::GetCurrentContext() && ImGui::GetIO().WantCaptureMouse)
+    return;
+
+  double x, y;
+  int windowWidth, windowHeight;
+  glfwGetCursorPos(mMainWindow, &x, &y);
+  glfwGetWindowSize(mMainWindow, &windowWidth, &windowHeight);
+
+  if (windowWidth <= 0 || windowHeight <= 0)
+    return;
+
+  // Screen coordinates to pixels of the scene, which is smaller than the
+  // framebuffer with dynamic resolution
+  vk::Extent2D extent = sceneExtent();
+  vk::Image ids =
+      mDynamicResolution || mProgressive ? mSceneTarget.mIdImage : mIdImage;
+
+  x *= extent.width / static_cast<double>(windowWidth);
+  y *= extent.height / static_cast<double>(windowHeight);
+
+  if (x < 0.0 || y < 0.0 || x >= extent.width || y >= extent.height)
+    return;
+
+  int32_t cx = static_cast<int32_t>(x);
+  int32_t cy = static_cast<int32_t>(y);
+
+  int32_t x0 = std::max(cx - PICK_RADIUS, 0);
+  int32_t y0 = std::max(cy - PICK_RADIUS, 0);
+  int32_t x1 =
+      std::min(cx + PICK_RADIUS + 1, static_cast<int32_t>(extent.width));
+  int32_t y1 =
+      std::min(cy + PICK_RADIUS + 1, static_cast<int32_t>(extent.height));
+
+  slot.mRegion = vk::Rect2D({x0, y0}, {static_cast<uint32_t>(x1 - x0),
+                                       static_cast<uint32_t>(y1 - y0)});
+  slot.mCursor = vk::Offset2D(cx - x0, cy - y0);
+  slot.mGeneration = mPickGeneration;
+
+  vk::CommandBuffer &commandBuffer = slot.mCommandBuffer;
+
+  commandBuffer.reset();
+  commandBuffer.begin(vk::CommandBufferBeginInfo(
+      vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+  // The render pass already left the ids in transfer layout
+  vk::ImageMemoryBarrier toTransfer(
+      vk::AccessFlagBits::eColorAttachmentWrite,
+      vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eTransferSrcOptimal,
+      vk::ImageLayout::eTransferSrcOptimal, VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED, ids,
+      vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+
+  commandBuffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eColorAttachmentOutput,
+      vk::PipelineStageFlagBits::eTransfer, {}, 0, nullptr, 0, nullptr, 1,
+      &toTransfer);
+
+  vk::ImageSubresourceLayers layers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+
+  vk::BufferImageCopy region(
+      0, 0, 0, layers, {slot.mRegion.offset.x, slot.mRegion.offset.y, 0},
+      {slot.mRegion.extent.width, slot.mRegion.extent.height, 1});
+
+  commandBuffer.copyImageToBuffer(ids, vk::ImageLayout::eTransferSrcOptimal,
+                                  slot.mBuffer.mBuffer, 1, &region);
+
+  vk::BufferMemoryBarrier toHost(
+      vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead,
+      VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, slot.mBuffer.mBuffer, 0,
+      VK_WHOLE_SIZE);
+
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                vk::PipelineStageFlagBits::eHost, {}, 0,
+                                nullptr, 1, &toHost, 0, nullptr);
+
+  commandBuffer.end();
+
+  slot.mPending = true;
+}
+
+void TruchasRender::resolvePick(PickSlot &slot) {
+
+  if (!slot.mPending) {
+    mPick = PickResult{};
+    return;
+  }
+
+  slot.mPending = false;
+
+  // Ids handed out before the last recording may belong to other buffers
+  uint32_t pickId = 0;
+
+  if (slot.mGeneration == mPickGeneration)
+    pickId = nearestPickId(slot.mMapped, slot.mRegion.extent.width,
+                           slot.mRegion.extent.height,
+                           static_cast<uint32_t>(slot.mCursor.x),
+                           static_cast<uint32_t>(slot.mCursor.y));
+
+  // The hover highlight follows in the next frame
+  if (pickId != mPick.pickId)
+    requestFrame();
+
+  mPick = lookupPick(pickId);
+  mPick.frame = slot.mFrame;
+}
+
+uint32_t TruchasRender::nearestPickId(const uint32_t *ids, uint32_t width,
+                                      uint32_t height, uint32_t x,
+                                      uint32_t y) {
+
+  uint32_t nearest = 0;
+  int64_t nearestDistance = std::numeric_limits<int64_t>::max();
+
+  for (uint32_t row = 0; row < height; row++) {
+    for (uint32_t column = 0; column < width; column++) {
+
+      uint32_t id = ids[row * width + column];
+
+      if (id == 0)
+        continue;
+
+      int64_t dx = static_cast<int64_t>(column) - x;
+      int64_t dy = static_cast<int64_t>(row) - y;
+      int64_t distance = dx * dx + dy * dy;
+
+      if (distance < nearestDistance) {
+        nearest = id;
+        nearestDistance = distance;
+      }
+    }
+  }
+
+  return nearest;
+}
+
+PickResult TruchasRender::lookupPick(uint32_t pickId) const {
+
+  PickResult result;
+
+  if (pickId == 0)
+    return result;
+
+  // Ranges are handed out in increasing order
+  auto it = std::upper_bound(
+      mPickRanges.begin(), mPickRanges.end(), pickId,
+      [](uint32_t id, const PickRange &range) { return id < range.first; });
+
+  if (it == mPickRanges.begin())
+    return result;
+
+  --it;
+
+  uint32_t index = pickId - it->first;
+
+  if (index >= it->count)
+    return result;
+
+  if (it->octree)
+    index = it->octree->order()[index];
+
+  result.kind = it->kind;
+  result.id = it->id;
+  result.index = it->offset + index;
+  result.pickId = pickId;
+
+  return result;
+}
+
+const PickResult &TruchasRender::getPick() const { return mPick; }
+
+ubo TruchasRender::cameraUniform(float aspect) {
+
+  ubo camera;
+
+  glm::vec3 up = glm::vec3(0.0f, 0.0f, 1.0f);
+  camera.model = glm::rotate(glm::mat4(1.0f), glm::radians(0.0f), up);
+
+  camera.view = glm::lookAt(glm::vec3(0.0f, -10.0f, 0.0f),
+                            glm::vec3(0.0f, 0.0f, 0.0f), up);
+
+  camera.proj =
+      glm::perspective(glm::radians(45.0f), aspect, 0.001f, 100.0f);
+
+  camera.proj[1][1] *= -1;
+
+  return camera;
+}
+
+void TruchasRender::updateUniformBuffer(uint32_t currentImage) {
+
+  u = cameraUniform(mExtent.width / (float)mExtent.height);
+  u.hoverId = mPick.pickId;
+
+  vk::MemoryMapFlags memMapFlags;
+
+  void *data;
+  data = mDevice.mapMemory(mUniformBufferMemories[currentImage], 0, sizeof(u),
+                           memMapFlags);
+  memcpy(data, &u, sizeof(u));
+  mDevice.unmapMemory(mUniformBufferMemories[currentImage]);
+
+  ViewData view = {u.view, u.proj, FULL_VIEW_RECT};
+
+  const ViewData *views = mViews.empty() ? &view : mViews.data();
+  vk::DeviceSize viewSize = sizeof(ViewData) * getViewCount();
+
+  data = mDevice.mapMemory(mViewBufferMemories[currentImage], 0, viewSize,
+                           memMapFlags);
+  memcpy(data, views, viewSize);
+  mDevice.unmapMemory(mViewBufferMemories[currentImage]);
+}
+
+void TruchasRender::setViews(const std::vector<ViewData> &views) {
+
+  mViews.assign(views.begin(),
+                views.begin() + std::min<size_t>(views.size(), MAX_VIEWS));
+  requestFrame();
+}
+
+uint32_t TruchasRender::getViewCount() {
+  return mViews.empty() ? 1 : static_cast<uint32_t>(mViews.size());
+}
+
+std::vector<ViewData> TruchasRender::quadViews(glm::vec3 center,
+                                               float radius) {
+
+  // Each quadrant keeps the window's aspect ratio
+  float aspect = mExtent.width / (float)mExtent.height;
+  float h = radius;
+  float w = radius * aspect;
+
+  glm::mat4 ortho = glm::ortho(-w, w, -h, h, 0.0f, 4.0f * radius);
+  ortho[1][1] *= -1;
+
+  auto orthoView = [&](glm::vec3 dir, glm::vec3 up, glm::vec4 rect) {
+    glm::mat4 view = glm::lookAt(center + 2.0f * radius * dir, center, up);
+    return ViewData{view, ortho, rect};
+  };
+
+  ubo camera = cameraUniform(aspect);
+
+  return {orthoView({0.0f, 0.0f, 1.0f}, {0.0f, 1.0f, 0.0f},
+                    {0.0f, 0.0f, 0.5f, 0.5f}),
+          orthoView({0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, 1.0f},
+                    {0.5f, 0.0f, 0.5f, 0.5f}),
+          orthoView({1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f},
+                    {0.0f, 0.5f, 0.5f, 0.5f}),
+          {camera.view, camera.proj, {0.5f, 0.5f, 0.5f, 0.5f}}};
+}
+
+void TruchasRender::setDispatcher(Dispatcher *dispatcher) {
+
+  mDispatcher = dispatcher;
+
+  // Posts from model threads end an on demand wait
+  if (mDispatcher)
+    mDispatcher->setWake(glfwPostEmptyEvent);
+}
+
+void TruchasRender::applyPendingUpdates() {
+
+  // Replaced buffers are retired, the command buffers are recorded again
+  // only when the draws changed
+  if (mDispatcher && mDispatcher->pending())
+    mDispatcher->drain();
+}
+
+ThreadPool &TruchasRender::getThreadPool() {
+
+  if (!mThreadPool)
+    mThreadPool = std::make_unique<ThreadPool>();
+
+  return *mThreadPool;
+}
+
+bool TruchasRender::importPointCloud(uint32_t id, const std::string &path,
+                                     size_t chunkPoints) {
+
+  deletePointCloud(id);
+
+  PointCloud &cloud = mPointClouds[id];
+  cloud.mImporter =
+      std::make_unique<PointCloudImporter>(&getThreadPool(), chunkPoints);
+
+  if (!cloud.mImporter->start(path)) {
+    mPointClouds.erase(id);
+    return false;
+  }
+
+  return true;
+}
+
+void TruchasRender::pumpImports() {
+
+  bool ready = false;
+  for (const auto &cloud : mPointClouds)
+    ready |= cloud.second.mImporter && cloud.second.mImporter->ready();
+
+  if (!ready)
+    return;
+
+  PointCloudImporter::Chunk chunk;
+
+  for (auto &[id, cloud] : mPointClouds) {
+
+    if (!cloud.mImporter)
+      continue;
+
+    for (uint32_t n = 0; n < MAX_IMPORT_UPLOADS && cloud.mImporter->poll(chunk);
+         n++) {
+
+      uint32_t count = static_cast<uint32_t>(chunk.vertices.size());
+      const Vertex *vertices =
+          reinterpret_cast<const Vertex *>(chunk.vertices.data());
+
+      // Every chunk gets a tree of its own, it is the cloud as a whole that
+      // grows too large to draw
+      std::vector<Vertex> ordered;
+      std::shared_ptr<const PointOctree> octree;
+
+      if (mLodSupported && mLodEnabled && count > 0) {
+        octree = buildOctree(vertices, count, ordered);
+        vertices = ordered.data();
+        count = static_cast<uint32_t>(ordered.size());
+      }
+
+      Buffer buffer = createVertexBuffer(vertices, count, count);
+      buffer.mOctree = octree;
+
+      buffer.mMin = chunk.min;
+      buffer.mMax = chunk.max;
+
+      cloud.mMin = cloud.mChunks.empty() ? chunk.min
+                                         : glm::min(cloud.mMin, chunk.min);
+      cloud.mMax = cloud.mChunks.empty() ? chunk.max
+                                         : glm::max(cloud.mMax, chunk.max);
+      cloud.mChunks.push_back(buffer);
+      mDrawsChanged = true;
+
+      cloud.mImporter->recycle(std::move(chunk));
+    }
+
+    if (cloud.mImporter->done() && cloud.mImporter->failed())
+      LOG_WARN("point cloud {} stopped after {} chunks", id,
+               cloud.mChunks.size());
+  }
+}
+
+ImportStats TruchasRender::getImportStats(uint32_t id) const {
+
+  auto it = mPointClouds.find(id);
+
+  if (it == mPointClouds.end() || !it->second.mImporter)
+    return {};
+
+  return it->second.mImporter->stats();
+}
+
+void TruchasRender::deletePointCloud(uint32_t id) {
+
+  auto it = mPointClouds.find(id);
+
+  if (it == mPointClouds.end())
+    return;
+
+  // Stop the reader before its buffers go away
+  it->second.mImporter.reset();
+
+  for (auto &chunk : it->second.mChunks)
+    retireBuffer(chunk);
+
+  mPointClouds.erase(it);
+  mDrawsChanged = true;
+  requestFrame();
+}
+
+void TruchasRender::drawFrame() {
+
+  applyPendingUpdates();
+  pumpImports();
+
+  if (mDrawsChanged)
+    createCommandBuffers();
+
+  vk::Result result1 = mDevice.waitForFences(mInFlightFences[mCurrentFrame],
+                                             VK_TRUE, UINT64_MAX);
+
+  mCompletedFrames =
+      std::max(mCompletedFrames, mSubmittedFrames[mCurrentFrame]);
+  releaseRetired();
+
+  // Copies submitted with this fence are finished now
+  if (mReadbackEnabled)
+    collectReadbacks(mCurrentFrame);
+
+  if (mPickingEnabled)
+    resolvePick(mPickSlots[mCurrentFrame]);
+
+  if (mDynamicResolution)
+    updateRenderScale();
+
+  uint32_t imageIndex = 0;
+
+  vk::Fence F;
+
+  vk::Result result = mDevice.acquireNextImageKHR(
+      mSwapchain, UINT64_MAX, mImageAvailableSemaphores[mCurrentFrame], F,
+      &imageIndex);
+
+  if (result == vk::Result::eErrorOutOfDateKHR) {
+    recreateSwapchain();
+    return;
+  } else if (result != vk::Result::eSuccess &&
+             result != vk::Result::eSuboptimalKHR) {
+    throw std::runtime_error("failed to acquire swap chain image!");
+  }
+
+  // Images can come back out of order, the frame that drew this one last
+  // may still read its uniforms and tables
+  if (mImagesInFlight[imageIndex] &&
+      mDevice.waitForFences(mImagesInFlight[imageIndex], VK_TRUE,
+                            UINT64_MAX) != vk::Result::eSuccess)
+    throw std::runtime_error("failed to wait for swap chain image!");
+
+  mImagesInFlight[imageIndex] = mInFlightFences[mCurrentFrame];
+
+  // Its last frame has finished, nothing else submits it
+  if (!mProgressive && imageIndex < mOutdatedCommandBuffers.size() &&
+      mOutdatedCommandBuffers[imageIndex])
+    recordCommandBuffer(imageIndex);
+
+  updateUniformBuffer(imageIndex);
+
+  // Progressive frames draw the buffers whole, nothing reads the tables
+  if (!mProgressive)
+    updateLod(imageIndex);
+
+  vk::Semaphore waitSemaphore[] = {mImageAvailableSemaphores[mCurrentFrame]};
+  vk::Semaphore signalSemaphore[] = {mRenderFinishedSemaphores[mCurrentFrame]};
+
+  vk::PipelineStageFlags waitStages =
+      vk::PipelineStageFlagBits::eColorAttachmentOutput;
+
+  std::array<vk::CommandBuffer, 3> commandBuffers = {
+      mProgressive ? recordProgressive(imageIndex)
+                   : mCommandBuffers[imageIndex]};
+  uint32_t commandBufferCount = 1;
+
+  if (mPickingEnabled) {
+
+    PickSlot &pick = mPickSlots[mCurrentFrame];
+    recordPick(pick);
+
+    if (pick.mPending) {
+      pick.mFrame = mFrameCount;
+      commandBuffers[commandBufferCount++] = pick.mCommandBuffer;
+    }
+  }
+
+  if (mReadbackEnabled) {
+
+    ReadbackSlot *slot = acquireReadbackSlot();
+
+    if (slot) {
+      recordReadback(*slot, imageIndex);
+      slot->mFrame = mFrameCount;
+      slot->mFence = mCurrentFrame;
+      commandBuffers[commandBufferCount++] = slot->mCommandBuffer;
+    } else {
+      mReadbackDropped++;
+    }
+  }
+
+  vk::SubmitInfo submitInfo(1, waitSemaphore, &waitStages, commandBufferCount,
+                            commandBuffers.data(), 1, signalSemaphore);
+
+  mDevice.resetFences(mInFlightFences[mCurrentFrame]);
+
+  mGraphicsQueue.submit(submitInfo, mInFlightFences[mCurrentFrame]);
+  mSubmittedFrames[mCurrentFrame] = mFrameCount + 1;
+
+  if (mCurrentFrame < mFrameImages.size())
+    mFrameImages[mCurrentFrame] = imageIndex;
+
+  vk::PresentInfoKHR presentInfo(1, signalSemaphore, 1, &mSwapchain,
+                                 &imageIndex);
+
+  result = mPresentQueue.presentKHR(presentInfo);
+
+  if (result == vk::Result::eErrorOutOfDateKHR ||
+      result == vk::Result::eSuboptimalKHR || frameBufferResized ||
+      result == vk::Result::eErrorIncompatibleDisplayKHR) {
+    frameBufferResized = false;
+    recreateSwapchain();
+  } else if (result != vk::Result::eSuccess) {
+    // std::cout << "Present Queue Failed\n";
+    throw std::runtime_error("failed to present swap chain image!");
+  }
+
+  mCurrentFrame = (mCurrentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  mFrameCount++;
+}
+
+bool TruchasRender::runFrame() {
+
+  if (!mOnDemand) {
+    glfwPollEvents();
+    drawFrame();
+    return true;
+  }
+
+  if (frameNeeded()) {
+    glfwPollEvents();
+  } else {
+    glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+
+    // Only the caret moves without events
+    if (ImGui::GetCurrentContext() && ImGui::GetIO().WantTextInput)
+      requestFrame();
+  }
+
+  if (!frameNeeded())
+    return false;
+
+  if (mFramesRequested > 0)
+    mFramesRequested--;
+
+  drawFrame();
+  return true;
+}
+
+void TruchasRender::setOnDemand(bool onDemand) {
+  mOnDemand = onDemand;
+  requestFrame();
+}
+
+bool TruchasRender::isOnDemand() const { return mOnDemand; }
+
+void TruchasRender::requestFrame(uint32_t frames) {
+  mFramesRequested = std::max(mFramesRequested, frames);
+}
+
+bool TruchasRender::frameNeeded() const {
+
+  if (mFramesRequested > 0 || frameBufferResized)
+    return true;
+
+  if (mDispatcher && mDispatcher->pending())
+    return true;
+
+  // Still cameras keep adding to the accumulated image
+  if (mProgressive && mProgressiveNext < mProgressiveBatches.size())
+    return true;
+
+  // Chunks keep arriving until the reader is done
+  for (const auto &cloud : mPointClouds)
+    if (cloud.second.mImporter && !cloud.second.mImporter->done())
+      return true;
+
+  // Copies are looked up once their fence signals on a later frame
+  for (const auto &pick : mPickSlots)
+    if (pick.mPending)
+      return true;
+
+  for (const auto &slot : mReadbackSlots)
+    if (slot->mState.load(std::memory_order_acquire) == ReadbackSlot::pending)
+      return true;
+
+  // Still cameras refine the octrees until the budget is used up
+  if (!mLodTables.empty() && mLodFrameBudget < mLodMaxBudget) {
+
+    for (const auto &buffer : mBuffers)
+      if (buffer.second.mOctree)
+        return true;
+
+    for (const auto &cloud : mPointClouds)
+      for (const auto &chunk : cloud.second.mChunks)
+        if (chunk.mOctree)
+          return true;
+  }
+
+  return false;
+}
+
+void TruchasRender::enableReadback(uint32_t ringSize) {
+
+  // One slot per frame in flight plus room for the consumer to hold one
+  mReadbackRingSize = std::max<uint32_t>(ringSize, MAX_FRAMES_IN_FLIGHT + 1);
+
+  if (!mReadbackSupported) {
+    LOG_WARN("swapchain images can't be copied from, readback is unavailable");
+    return;
+  }
+
+  if (mReadbackEnabled) {
+    mDevice.waitIdle();
+    destroyReadbackResources();
+  }
+
+  vk::CommandPoolCreateInfo commandPoolInfo(
+      vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+      mIndices.graphicsFamily);
+
+  if (!mReadbackCommandPool)
+    mReadbackCommandPool = mDevice.createCommandPool(commandPoolInfo);
+
+  createReadbackResources();
+
+  mReadbackEnabled = true;
+}
+
+void TruchasRender::disableReadback() {
+
+  if (!mReadbackEnabled)
+    return;
+
+  mDevice.waitIdle();
+
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    collectReadbacks(i);
+
+  destroyReadbackResources();
+
+  mDevice.destroyCommandPool(mReadbackCommandPool);
+  mReadbackCommandPool = nullptr;
+
+  mReadbackEnabled = false;
+}
+
+void TruchasRender::setReadbackCallback(
+    std::function<void(const ReadbackView &)> callback) {
+  mReadbackCallback = std::move(callback);
+}
+
+void TruchasRender::setReadbackOutput(const std::string &pathPattern) {
+
+  // Checked here, collectReadbacks formats it inside drawFrame
+  try {
+    uint64_t frame = 0;
+    (void)std::vformat(pathPattern, std::make_format_args(frame));
+  } catch (const std::format_error &e) {
+    throw std::runtime_error("invalid readback path pattern \"" + pathPattern +
+                             "\": " + e.what());
+  }
+
+  mReadbackPath = pathPattern;
+
+  if (!mReadbackPath.empty() && !mImageWriter)
+    mImageWriter = std::make_unique<ImageWriter>();
+}
+
+void TruchasRender::releaseReadback(uint32_t slot) {
+  mReadbackSlots[slot]->mState.store(ReadbackSlot::free,
+                                     std::memory_order_release);
+}
+
+void TruchasRender::createReadbackResources() {
+
+  mReadbackSlots.clear();
+  mReadbackNext = 0;
+
+  vk::CommandBufferAllocateInfo allocInfo(mReadbackCommandPool,
+                                          vk::CommandBufferLevel::ePrimary,
+                                          mReadbackRingSize);
+
+  std::vector<vk::CommandBuffer> commandBuffers =
+      mDevice.allocateCommandBuffers(allocInfo);
+
+  for (uint32_t i = 0; i < mReadbackRingSize; i++) {
+
+    auto slot = std::make_unique<ReadbackSlot>();
+
+    createReadbackBuffer(*slot);
+    slot->mCommandBuffer = commandBuffers[i];
+
+    mReadbackSlots.push_back(std::move(slot));
+  }
+}
+
+void TruchasRender::createReadbackBuffer(ReadbackSlot &slot) {
+
+  slot.mBuffer.mDeviceSize =
+      static_cast<vk::DeviceSize>(mExtent.width) * mExtent.height * 4;
+  slot.mBuffer.mPointSize = 0;
+
+  // Prefer cached memory, the CPU reads every byte of it
+  try {
+    createBuffer(slot.mBuffer.mDeviceSize,
+                 vk::BufferUsageFlagBits::eTransferDst,
+                 vk::MemoryPropertyFlagBits::eHostVisible |
+                     vk::MemoryPropertyFlagBits::eHostCoherent |
+                     vk::MemoryPropertyFlagBits::eHostCached,
+                 slot.mBuffer.mBuffer, slot.mBuffer.mMemory);
+  } catch (const std::runtime_error &) {
+    mDevice.destroyBuffer(slot.mBuffer.mBuffer);
+    createBuffer(slot.mBuffer.mDeviceSize,
+                 vk::BufferUsageFlagBits::eTransferDst,
+                 vk::MemoryPropertyFlagBits::eHostVisible |
+                     vk::MemoryPropertyFlagBits::eHostCoherent,
+                 slot.mBuffer.mBuffer, slot.mBuffer.mMemory);
+  }
+
+  slot.mMapped =
+      mDevice.mapMemory(slot.mBuffer.mMemory, 0, slot.mBuffer.mDeviceSize, {});
+}
+
+void TruchasRender::destroyReadbackBuffer(ReadbackSlot &slot) {
+  mDevice.unmapMemory(slot.mBuffer.mMemory);
+  mDevice.destroyBuffer(slot.mBuffer.mBuffer);
+  mDevice.freeMemory(slot.mBuffer.mMemory);
+  slot.mMapped = nullptr;
+}
+
+void TruchasRender::destroyReadbackResources() {
+
+  // Files in the encoder queue still point into the mapped buffers
+  if (mImageWriter)
+    mImageWriter->flush();
+
+  for (auto &slot : mReadbackSlots) {
+    destroyReadbackBuffer(*slot);
+    mDevice.freeCommandBuffers(mReadbackCommandPool, slot->mCommandBuffer);
+  }
+
+  mReadbackSlots.clear();
+}
+
+ReadbackSlot *TruchasRender::acquireReadbackSlot() {
+
+  for (uint32_t i = 0; i < mReadbackSlots.size(); i++) {
+
+    uint32_t index = (mReadbackNext + i) % mReadbackSlots.size();
+    uint32_t expected = ReadbackSlot::free;
+
+    if (mReadbackSlots[index]->mState.compare_exchange_strong(
+            expected, ReadbackSlot::pending, std::memory_order_acquire)) {
+
+      ReadbackSlot &slot = *mReadbackSlots[index];
+
+      // Resizes leave the slots alone so held views stay valid, the buffer
+      // catches up with the extent once the slot comes back
+      if (slot.mBuffer.mDeviceSize !=
+          static_cast<vk::DeviceSize>(mExtent.width) * mExtent.height * 4) {
+        destroyReadbackBuffer(slot);
+        createReadbackBuffer(slot);
+      }
+
+      mReadbackNext = (index + 1) % mReadbackSlots.size();
+      return &slot;
+    }
+  }
+
+  return nullptr;
+}
+
+void TruchasRender::recordReadback(ReadbackSlot &slot, uint32_t imageIndex) {
+
+  vk::CommandBuffer &commandBuffer = slot.mCommandBuffer;
+
+  commandBuffer.reset();
+  commandBuffer.begin(vk::CommandBufferBeginInfo(
+      vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+  vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+
+  vk::ImageMemoryBarrier toTransfer(
+      vk::AccessFlagBits::eColorAttachmentWrite,
+      vk::AccessFlagBits::eTransferRead, vk::ImageLayout::ePresentSrcKHR,
+      vk::ImageLayout::eTransferSrcOptimal, VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED, mImages[imageIndex], range);
+
+  commandBuffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eColorAttachmentOutput,
+      vk::PipelineStageFlagBits::eTransfer, {}, 0, nullptr, 0, nullptr, 1,
+      &toTransfer);
+
+  vk::ImageSubresourceLayers layers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+
+  vk::BufferImageCopy region(0, 0, 0, layers, {0, 0, 0},
+                             {mExtent.width, mExtent.height, 1});
+
+  commandBuffer.copyImageToBuffer(mImages[imageIndex],
+                                  vk::ImageLayout::eTransferSrcOptimal,
+                                  slot.mBuffer.mBuffer, 1, &region);
+
+  vk::ImageMemoryBarrier toPresent(
+      vk::AccessFlagBits::eTransferRead, {},
+      vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::ePresentSrcKHR,
+      VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, mImages[imageIndex],
+      range);
+
+  vk::BufferMemoryBarrier toHost(
+      vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead,
+      VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, slot.mBuffer.mBuffer, 0,
+      VK_WHOLE_SIZE);
+
+  commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                vk::PipelineStageFlagBits::eBottomOfPipe |
+                                    vk::PipelineStageFlagBits::eHost,
+                                {}, 0, nullptr, 1, &toHost, 1, &toPresent);
+
+  commandBuffer.end();
+}
+
+void TruchasRender::collectReadbacks(size_t fence) {
+
+  for (uint32_t i = 0; i < mReadbackSlots.size(); i++) {
+
+    ReadbackSlot &slot = *mReadbackSlots[i];
+
+    if (slot.mState.load(std::memory_order_acquire) != ReadbackSlot::pending ||
+        slot.mFence != fence)
+      continue;
+
+    slot.mState.store(ReadbackSlot::held, std::memory_order_release);
+    mReadbackCompleted++;
+
+    ReadbackView view;
+    view.data = static_cast<const uint8_t *>(slot.mMapped);
+    view.width = mExtent.width;
+    view.height = mExtent.height;
+    view.rowPitch = mExtent.width * 4;
+    view.bgra = mFormat == vk::Format::eB8G8R8A8Unorm ||
+                mFormat == vk::Format::eB8G8R8A8Srgb;
+    view.frame = slot.mFrame;
+    view.slot = i;
+
+    if (mImageWriter && !mReadbackPath.empty()) {
+      mImageWriter->push({std::vformat(mReadbackPath,
+                                       std::make_format_args(view.frame)),
+                          view, [this, i] { releaseReadback(i); }});
+    } else if (mReadbackCallback) {
+      mReadbackCallback(view);
+    } else {
+      releaseReadback(i);
+    }
+  }
+}
+
+OffscreenTarget TruchasRender::createOffscreenTarget(uint32_t width,
+                                                     uint32_t height) {
+
+  // Same formats as mRenderPass, so every pipeline can draw into it
+  if (!mOffscreenRenderPass)
+    mOffscreenRenderPass =
+        makeRenderPass(mFormat, vk::ImageLayout::eTransferSrcOptimal);
+
+  OffscreenTarget target;
+  target.mExtent = vk::Extent2D(width, height);
+
+  createImage(mPhysicalDevice, mDevice, width, height, mFormat,
+              vk::ImageTiling::eOptimal,
+              vk::ImageUsageFlagBits::eColorAttachment |
+                  vk::ImageUsageFlagBits::eTransferSrc,
+              vk::MemoryPropertyFlagBits::eDeviceLocal, target.mColorImage,
+              target.mColorMemory);
+
+  target.mColorView = createImageView(target.mColorImage, mFormat,
+                                      vk::ImageAspectFlagBits::eColor);
+
+  vk::Format depthFormat = findDepthFormat(mPhysicalDevice);
+
+  createImage(mPhysicalDevice, mDevice, width, height, depthFormat,
+              vk::ImageTiling::eOptimal,
+              vk::ImageUsageFlagBits::eDepthStencilAttachment,
+              vk::MemoryPropertyFlagBits::eDeviceLocal, target.mDepthImage,
+              target.mDepthMemory);
+
+  target.mDepthView = createImageView(target.mDepthImage, depthFormat,
+                                      vk::ImageAspectFlagBits::eDepth);
+
+  std::vector<vk::ImageView> attachments = {target.mColorView,
+                                            target.mDepthView};
+
+  if (mPickingEnabled) {
+
+    createImage(mPhysicalDevice, mDevice, width, height, vk::Format::eR32Uint,
+                vk::ImageTiling::eOptimal,
+                vk::ImageUsageFlagBits::eColorAttachment |
+                    vk::ImageUsageFlagBits::eTransferSrc,
+                vk::MemoryPropertyFlagBits::eDeviceLocal, target.mIdImage,
+                target.mIdMemory);
+
+    target.mIdView = createImageView(target.mIdImage, vk::Format::eR32Uint,
+                                     vk::ImageAspectFlagBits::eColor);
+
+    attachments.push_back(target.mIdView);
+  }
+
+  vk::FramebufferCreateInfo FramebufferInfo(
+      {}, mOffscreenRenderPass, static_cast<uint32_t>(attachments.size()),
+      attachments.data(), width, height, 1);
+
+  target.mFramebuffer = mDevice.createFramebuffer(FramebufferInfo);
+
+  return target;
+}
+
+void TruchasRender::destroyOffscreenTarget(OffscreenTarget &target) {
+
+  mDevice.destroyFramebuffer(target.mFramebuffer);
+
+  mDevice.destroyImageView(target.mColorView);
+  mDevice.destroyImage(target.mColorImage);
+  mDevice.freeMemory(target.mColorMemory);
+
+  mDevice.destroyImageView(target.mDepthView);
+  mDevice.destroyImage(target.mDepthImage);
+  mDevice.freeMemory(target.mDepthMemory);
+
+  mDevice.destroyImageView(target.mIdView);
+  mDevice.destroyImage(target.mIdImage);
+  mDevice.freeMemory(target.mIdMemory);
+
+  target = OffscreenTarget{};
+}
+
+void TruchasRender::enableDynamicResolution(float targetMs, float minScale,
+                                            float maxScale) {
+
+  mFrameTarget = targetMs;
+  mMaxScale = std::clamp(maxScale, RENDER_SCALE_STEP, 1.0f);
+  mMinScale = std::clamp(minScale, RENDER_SCALE_STEP, mMaxScale);
+  mRenderScale = mMaxScale;
+
+  if (!mUpscaleSupported) {
+    LOG_WARN("swapchain images can't be blitted to, dynamic resolution is "
+             "unavailable");
+    return;
+  }
+
+  // Both draw through the scene target
+  disableProgressive();
+
+  mDevice.waitIdle();
+
+  if (!mDynamicResolution)
+    createSceneTarget();
+
+  mDynamicResolution = true;
+
+  createCommandBuffers();
+  requestFrame();
+}
+
+void TruchasRender::disableDynamicResolution() {
+
+  if (!mDynamicResolution)
+    return;
+
+  mDevice.waitIdle();
+
+  destroySceneTarget();
+
+  mDynamicResolution = false;
+  mRenderScale = 1.0f;
+
+  createCommandBuffers();
+  requestFrame();
+}
+
+float TruchasRender::getRenderScale() const { return mRenderScale; }
+
+float TruchasRender::getGpuFrameTime() const { return mGpuFrameTime; }
+
+vk::Extent2D TruchasRender::sceneExtent() const {
+
+  if (!mDynamicResolution)
+    return mExtent;
+
+  return vk::Extent2D(
+      std::max(1u, static_cast<uint32_t>(mExtent.width * mRenderScale)),
+      std::max(1u, static_cast<uint32_t>(mExtent.height * mRenderScale)));
+}
+
+void TruchasRender::createSceneTarget() {
+
+  // Full size, smaller scales only draw part of it
+  mSceneTarget = createOffscreenTarget(mExtent.width, mExtent.height);
+
+  // Nothing accumulated in it yet
+  mProgressiveViews.clear();
+
+  vk::PhysicalDeviceLimits limits = mPhysicalDevice.getProperties().limits;
+  uint32_t validBits = mPhysicalDevice.getQueueFamilyProperties()
+                           [mIndices.graphicsFamily]
+                               .timestampValidBits;
+
+  if (!limits.timestampComputeAndGraphics || validBits == 0) {
+    LOG_INFO("timestamps unavailable, the render scale stays at {}",
+             mRenderScale);
+    return;
+  }
+
+  mTimestampPeriod = limits.timestampPeriod;
+  mTimestampMask =
+      validBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << validBits) - 1;
+
+  vk::QueryPoolCreateInfo poolInfo({}, vk::QueryType::eTimestamp,
+                                   2 * static_cast<uint32_t>(mImages.size()));
+
+  mTimestamps = mDevice.createQueryPool(poolInfo);
+  mFrameImages.assign(MAX_FRAMES_IN_FLIGHT, NO_IMAGE);
+}
+
+void TruchasRender::destroySceneTarget() {
+
+  destroyOffscreenTarget(mSceneTarget);
+
+  mDevice.destroyQueryPool(mTimestamps);
+  mTimestamps = nullptr;
+  mFrameImages.clear();
+}
+
+void TruchasRender::recordUpscale(vk::CommandBuffer &commandBuffer,
+                                  uint32_t imageIndex, vk::Extent2D extent) {
+
+  vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+
+  // The scene pass already left its color in transfer layout
+  std::array<vk::ImageMemoryBarrier, 2> barriers = {
+      vk::ImageMemoryBarrier(
+          vk::AccessFlagBits::eColorAttachmentWrite,
+          vk::AccessFlagBits::eTransferRead,
+          vk::ImageLayout::eTransferSrcOptimal,
+          vk::ImageLayout::eTransferSrcOptimal, VK_QUEUE_FAMILY_IGNORED,
+          VK_QUEUE_FAMILY_IGNORED, mSceneTarget.mColorImage, range),
+      vk::ImageMemoryBarrier({}, vk::AccessFlagBits::eTransferWrite,
+                             vk::ImageLayout::eUndefined,
+                             vk::ImageLayout::eTransferDstOptimal,
+                             VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+                             mImages[imageIndex], range)};
+
+  commandBuffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eColorAttachmentOutput,
+      vk::PipelineStageFlagBits::eTransfer, {}, 0, nullptr, 0, nullptr,
+      static_cast<uint32_t>(barriers.size()), barriers.data());
+
+  vk::ImageSubresourceLayers layers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+
+  vk::ImageBlit blit(
+      layers,
+      {vk::Offset3D(0, 0, 0),
+       vk::Offset3D(static_cast<int32_t>(extent.width),
+                    static_cast<int32_t>(extent.height), 1)},
+      layers,
+      {vk::Offset3D(0, 0, 0),
+       vk::Offset3D(static_cast<int32_t>(mExtent.width),
+                    static_cast<int32_t>(mExtent.height), 1)});
+
+  commandBuffer.blitImage(mSceneTarget.mColorImage,
+                          vk::ImageLayout::eTransferSrcOptimal,
+                          mImages[imageIndex],
+                          vk::ImageLayout::eTransferDstOptimal, 1, &blit,
+                          vk::Filter::eLinear);
+}
+
+void TruchasRender::updateRenderScale() {
+
+  uint32_t image = mCurrentFrame < mFrameImages.size()
+                       ? mFrameImages[mCurrentFrame]
+                       : NO_IMAGE;
+
+  if (!mTimestamps || image == NO_IMAGE)
+    return;
+
+  std::array<uint64_t, 2> ticks;
+
+  vk::Result result = mDevice.getQueryPoolResults(
+      mTimestamps, 2 * image, 2, sizeof(ticks), ticks.data(), sizeof(uint64_t),
+      vk::QueryResultFlagBits::e64);
+
+  if (result != vk::Result::eSuccess)
+    return;
+
+  mGpuFrameTime =
+      static_cast<float>((ticks[1] - ticks[0]) & mTimestampMask) *
+      mTimestampPeriod * 1e-6f;
+
+  float scale = nextRenderScale(mRenderScale, mGpuFrameTime, mFrameTarget,
+                                mMinScale, mMaxScale);
+
+  if (scale == mRenderScale)
+    return;
+
+  // A still scene gets drawn again at the sharper scale
+  if (scale > mRenderScale)
+    requestFrame();
+
+  mRenderScale = scale;
+
+  // The scale is recorded into viewports and splat sizes
+  mDevice.waitIdle();
+  createCommandBuffers();
+
+  // Frames in flight were drawn at the old scale
+  std::fill(mFrameImages.begin(), mFrameImages.end(), NO_IMAGE);
+}
+
+float TruchasRender::nextRenderScale(float scale, float gpuMs, float targetMs,
+                                     float minScale, float maxScale) {
+
+  if (gpuMs > 0.0f && targetMs > 0.0f &&
+      std::abs(gpuMs - targetMs) > RENDER_SCALE_BAND * targetMs) {
+
+    // Largest step expected to stay within the target, so a scale reached
+    // from either side is kept
+    float wanted = scale * std::sqrt(targetMs / gpuMs);
+    scale = std::floor(wanted / RENDER_SCALE_STEP + 1e-3f) * RENDER_SCALE_STEP;
+  }
+
+  return std::clamp(scale, minScale, maxScale);
+}
+
+void TruchasRender::enableProgressive(size_t budget) {
+
+  mProgressiveBudget = budget;
+
+  if (!mUpscaleSupported) {
+    LOG_WARN("swapchain images can't be blitted to, progressive rendering is "
+             "unavailable");
+    return;
+  }
+
+  // Planned again with the new budget
+  if (mProgressive) {
+    mProgressiveViews.clear();
+    requestFrame();
+    return;
+  }
+
+  // Both draw through the scene target
+  disableDynamicResolution();
+
+  mDevice.waitIdle();
+
+  createSceneTarget();
+
+  vk::CommandPoolCreateInfo commandPoolInfo(
+      vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+      mIndices.graphicsFamily);
+
+  mProgressiveCommandPool = mDevice.createCommandPool(commandPoolInfo);
+
+  vk::CommandBufferAllocateInfo allocInfo(mProgressiveCommandPool,
+                                          vk::CommandBufferLevel::ePrimary,
+                                          MAX_FRAMES_IN_FLIGHT);
+
+  mProgressiveCommandBuffers = mDevice.allocateCommandBuffers(allocInfo);
+
+  mProgressive = true;
+  requestFrame();
+}
+
+void TruchasRender::disableProgressive() {
+
+  if (!mProgressive)
+    return;
+
+  mDevice.waitIdle();
+
+  destroySceneTarget();
+
+  mProgressiveCommandBuffers.clear();
+  mDevice.destroyCommandPool(mProgressiveCommandPool);
+  mProgressiveCommandPool = nullptr;
+
+  mProgressive = false;
+  mProgressiveBatches.clear();
+  mProgressiveNext = 0;
+
+  createCommandBuffers();
+  requestFrame();
+}
+
+bool TruchasRender::isProgressive() const { return mProgressive; }
+
+bool TruchasRender::isRefined() const {
+  return !mProgressive || mProgressiveNext >= mProgressiveBatches.size();
+}
+
+uint64_t TruchasRender::sceneSignature() const {
+
+  uint64_t signature = mixHash(mExtent.width, mExtent.height);
+
+  auto add = [&](uint32_t id, const Buffer &buffer) {
+    signature = mixHash(signature, id);
+    signature = mixHash(signature, std::hash<vk::Buffer>{}(buffer.mBuffer));
+    signature = mixHash(signature, buffer.mPointSize);
+    signature = mixHash(signature, buffer.mGeneration);
+  };
+
+  for (const auto &[id, buffer] : mBuffers)
+    add(id, buffer);
+
+  for (const auto &[id, cloud] : mPointClouds)
+    for (const auto &chunk : cloud.mChunks)
+      add(id, chunk);
+
+  for (const auto &[id, lineSet] : mLineSets)
+    add(id, lineSet.mSegments);
+
+  for (int i = 0; i < 4; i++)
+    signature = mixHash(signature, std::hash<float>{}(bgColor[i]));
+
+  signature = mixHash(signature, std::hash<float>{}(mLineWidth));
+  return mixHash(signature, mShowGrid);
+}
+
+vk::CommandBuffer TruchasRender::recordProgressive(uint32_t imageIndex) {
+
+  uint32_t viewCount = getViewCount();
+
+  ViewData camera = {u.view, u.proj, FULL_VIEW_RECT};
+  std::vector<ViewData> views =
+      mViews.empty() ? std::vector<ViewData>{camera} : mViews;
+
+  // Same order as recordGeometry
+  std::vector<const Buffer *> draws;
+
+  for (const auto &buffer : mBuffers)
+    draws.push_back(&buffer.second);
+
+  for (const auto &cloud : mPointClouds)
+    for (const auto &chunk : cloud.second.mChunks)
+      draws.push_back(&chunk);
+
+  uint64_t scene = sceneSignature();
+
+  bool restart =
+      scene != mProgressiveScene ||
+      !std::equal(views.begin(), views.end(), mProgressiveViews.begin(),
+                  mProgressiveViews.end(), sameView);
+
+  if (restart) {
+
+    // Largest on screen first, so moving frames show what matters most
+    std::vector<float> sizes(draws.size());
+
+    for (size_t d = 0; d < draws.size(); d++)
+      sizes[d] = screenSize(draws[d]->mMin, draws[d]->mMax, u.model, views,
+                            static_cast<float>(mExtent.height));
+
+    std::vector<uint32_t> order(draws.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      return sizes[a] > sizes[b];
+    });
+
+    std::vector<uint32_t> counts(draws.size());
+
+    for (size_t d = 0; d < order.size(); d++)
+      counts[d] = draws[order[d]]->mPointSize;
+
+    mProgressiveBatches = progressiveBatches(counts, mProgressiveBudget);
+
+    for (auto &batch : mProgressiveBatches)
+      for (auto &range : batch)
+        range.draw = order[range.draw];
+
+    mProgressiveNext = 0;
+    mProgressiveViews = std::move(views);
+    mProgressiveScene = scene;
+  }
+
+  vk::CommandBuffer commandBuffer = mProgressiveCommandBuffers[mCurrentFrame];
+
+  commandBuffer.reset();
+  commandBuffer.begin(vk::CommandBufferBeginInfo(
+      vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+  vk::Rect2D renderArea({0, 0}, mExtent);
+  std::vector<vk::ClearValue> clearValues = sceneClearValues();
+
+  // Once everything is accumulated frames only show the target
+  if (restart || mProgressiveNext < mProgressiveBatches.size()) {
+
+    vk::RenderPassBeginInfo renderPassInfo(
+        restart ? mProgressiveClearPass : mProgressiveLoadPass,
+        mSceneTarget.mFramebuffer, renderArea,
+        static_cast<uint32_t>(clearValues.size()), clearValues.data());
+
+    commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+
+    vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(mExtent.width),
+                          static_cast<float>(mExtent.height), 0.0f, 1.0f);
+
+    commandBuffer.setViewport(0, 1, &viewport);
+    commandBuffer.setScissor(0, 1, &renderArea);
+
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                     mPipelineLayout, 0, 1,
+                                     &mDescriptorSets[imageIndex], 0, nullptr);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                               Pipelines.SketchPoint);
+
+    vk::DeviceSize offsets[] = {0};
+
+    // An empty scene has no batches, its first frame is also its last
+    bool last = mProgressiveNext + 1 >= mProgressiveBatches.size();
+
+    if (mProgressiveNext < mProgressiveBatches.size()) {
+      for (const auto &range : mProgressiveBatches[mProgressiveNext++]) {
+
+        const Buffer &buffer = *draws[range.draw];
+
+        commandBuffer.bindVertexBuffers(0, 1, &buffer.mBuffer, offsets);
+        commandBuffer.pushConstants(mPipelineLayout,
+                                    vk::ShaderStageFlagBits::eVertex, 0,
+                                    sizeof(buffer.mPickBase),
+                                    &buffer.mPickBase);
+        commandBuffer.draw(range.count, viewCount, range.first, 0);
+      }
+    }
+
+    // The grid blends without writing depth and segment edges blend while
+    // writing it, so both go over the finished points like in a normal
+    // frame. Frames before the last show the points only.
+    if (last) {
+
+      if (mShowGrid) {
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                   Pipelines.SketchGrid);
+        commandBuffer.draw(3, viewCount, 0, 0);
+      }
+
+      recordLines(commandBuffer, mDescriptorSets[imageIndex], viewCount, 0,
+                  mExtent);
+    }
+
+    if (mPickingEnabled)
+      commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+
+    commandBuffer.endRenderPass();
+  }
+
+  recordUpscale(commandBuffer, imageIndex, mExtent);
+
+  vk::RenderPassBeginInfo uiPassInfo(mUiRenderPass, mFramebuffers[imageIndex],
+                                     renderArea,
+                                     static_cast<uint32_t>(clearValues.size()),
+                                     clearValues.data());
+
+  commandBuffer.beginRenderPass(uiPassInfo, vk::SubpassContents::eInline);
+
+  if (mPickingEnabled)
+    commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+
+  ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+
+  commandBuffer.endRenderPass();
+  commandBuffer.end();
+
+  return commandBuffer;
+}
+
+std::vector<std::vector<ProgressiveRange>>
+TruchasRender::progressiveBatches(const std::vector<uint32_t> &counts,
+                                  size_t budget) {
+
+  std::vector<std::vector<ProgressiveRange>> batches;
+
+  if (budget == 0)
+    budget = std::numeric_limits<size_t>::max();
+
+  // Full, the next range starts a batch
+  size_t used = budget;
+
+  for (uint32_t draw = 0; draw < counts.size(); draw++) {
+
+    uint32_t first = 0;
+
+    while (first < counts[draw]) {
+
+      if (used == budget) {
+        batches.emplace_back();
+        used = 0;
+      }
+
+      uint32_t count = static_cast<uint32_t>(
+          std::min<size_t>(counts[draw] - first, budget - used));
+
+      batches.back().push_back({draw, first, count});
+      first += count;
+      used += count;
+    }
+  }
+
+  return batches;
+}
+
+ViewData TruchasRender::fitView(const Buffer &buffer, float aspect) {
+
+  const float fov = glm::radians(45.0f);
+
+  glm::vec3 center = 0.5f * (buffer.mMin + buffer.mMax);
+  float radius = std::max(0.5f * glm::length(buffer.mMax - buffer.mMin), 0.01f);
+  float distance = radius / std::sin(0.5f * fov);
+
+  // Same direction the main camera looks from, raised for a 3/4 view
+  glm::vec3 up = glm::vec3(0.0f, 0.0f, 1.0f);
+  glm::vec3 eye = center + distance * glm::normalize(glm::vec3(0.5f, -1.0f, 0.6f));
+
+  ViewData view;
+  view.rect = FULL_VIEW_RECT;
+  view.view = glm::lookAt(eye, center, up);
+  view.proj = glm::perspective(fov, aspect, 0.01f * distance,
+                               distance + 2.0f * radius);
+  view.proj[1][1] *= -1;
+
+  return view;
+}
+
+std::vector<ThumbnailAtlas>
+TruchasRender::renderThumbnails(const std::vector<uint32_t> &ids,
+                                uint32_t tileSize) {
+
+  std::vector<ThumbnailAtlas> atlases;
+
+  std::vector<uint32_t> models;
+  for (uint32_t id : ids) {
+    auto it = mBuffers.find(id);
+    if (it != mBuffers.end() && it->second.mPointSize > 0)
+      models.push_back(id);
+  }
+
+  if (models.empty())
+    return atlases;
+
+  uint32_t maxSide = std::min(
+      mPhysicalDevice.getProperties().limits.maxImageDimension2D,
+      MAX_ATLAS_SIZE);
+
+  tileSize = std::clamp<uint32_t>(tileSize, 1, maxSide);
+
+  uint32_t perRow = maxSide / tileSize;
+  uint32_t perPage = perRow * perRow;
+  uint32_t tileCount =
+      std::min(perPage, static_cast<uint32_t>(models.size()));
+
+  // Per tile cameras, one view table entry per tile
+  ViewBatch batch = createViewBatch(
+      {glm::mat4(1.0f), glm::mat4(1.0f), glm::mat4(1.0f)}, tileCount);
+
+  for (size_t first = 0; first < models.size(); first += perPage) {
+
+    uint32_t count = static_cast<uint32_t>(
+        std::min<size_t>(perPage, models.size() - first));
+    uint32_t columns = std::min(
+        perRow, static_cast<uint32_t>(std::ceil(std::sqrt(double(count)))));
+    uint32_t rows = (count + columns - 1) / columns;
+
+    ThumbnailAtlas atlas;
+    atlas.width = columns * tileSize;
+    atlas.height = rows * tileSize;
+
+    OffscreenTarget target = createOffscreenTarget(atlas.width, atlas.height);
+
+    vk::DeviceSize readbackSize =
+        static_cast<vk::DeviceSize>(atlas.width) * atlas.height * 4;
+    vk::Buffer readbackBuffer;
+    vk::DeviceMemory readbackMemory;
+
+    createBuffer(readbackSize, vk::BufferUsageFlagBits::eTransferDst,
+                 vk::MemoryPropertyFlagBits::eHostVisible |
+                     vk::MemoryPropertyFlagBits::eHostCoherent,
+                 readbackBuffer, readbackMemory);
+
+    for (uint32_t t = 0; t < count; t++) {
+
+      uint32_t id = models[first + t];
+
+      batch.mViews[t] = fitView(mBuffers[id], 1.0f);
+
+      vk::Rect2D tile({static_cast<int32_t>((t % columns) * tileSize),
+                       static_cast<int32_t>((t / columns) * tileSize)},
+                      {tileSize, tileSize});
+      atlas.tiles[id] = tile;
+    }
+
+    vk::CommandBuffer commandBuffer = beginSingleTimeCommands(
+        vk::CommandBufferLevel::ePrimary, vk::CommandBufferInheritanceInfo());
+
+    std::vector<vk::ClearValue> clearValues = sceneClearValues();
+
+    vk::RenderPassBeginInfo renderPassInfo(
+        mOffscreenRenderPass, target.mFramebuffer,
+        vk::Rect2D({0, 0}, target.mExtent),
+        static_cast<uint32_t>(clearValues.size()), clearValues.data());
+
+    commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                               Pipelines.SketchPoint);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                     mPipelineLayout, 0, 1, &batch.mSet, 0,
+                                     nullptr);
+
+    vk::DeviceSize offsets[] = {0};
+
+    for (uint32_t t = 0; t < count; t++) {
+
+      const Buffer &buffer = mBuffers[models[first + t]];
+      const vk::Rect2D &tile = atlas.tiles[models[first + t]];
+
+      vk::Viewport viewport(static_cast<float>(tile.offset.x),
+                            static_cast<float>(tile.offset.y),
+                            static_cast<float>(tileSize),
+                            static_cast<float>(tileSize), 0.0f, 1.0f);
+
+      commandBuffer.setViewport(0, 1, &viewport);
+      commandBuffer.setScissor(0, 1, &tile);
+
+      commandBuffer.bindVertexBuffers(0, 1, &buffer.mBuffer, offsets);
+      commandBuffer.pushConstants(mPipelineLayout,
+                                  vk::ShaderStageFlagBits::eVertex, 0,
+                                  sizeof(buffer.mPickBase), &buffer.mPickBase);
+      // firstInstance selects this tile's camera in the view table
+      commandBuffer.draw(buffer.mPointSize, 1, 0, t);
+    }
+
+    if (mPickingEnabled)
+      commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+
+    commandBuffer.endRenderPass();
+
+    vk::ImageMemoryBarrier toTransfer(
+        vk::AccessFlagBits::eColorAttachmentWrite,
+        vk::AccessFlagBits::eTransferRead,
+        vk::ImageLayout::eTransferSrcOptimal,
+        vk::ImageLayout::eTransferSrcOptimal, VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED, target.mColorImage,
+        vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+
+    commandBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::PipelineStageFlagBits::eTransfer, {}, 0, nullptr, 0, nullptr, 1,
+        &toTransfer);
+
+    vk::ImageSubresourceLayers layers(vk::ImageAspectFlagBits::eColor, 0, 0,
+                                      1);
+    vk::BufferImageCopy region(0, 0, 0, layers, {0, 0, 0},
+                               {atlas.width, atlas.height, 1});
+
+    commandBuffer.copyImageToBuffer(target.mColorImage,
+                                    vk::ImageLayout::eTransferSrcOptimal,
+                                    readbackBuffer, 1, &region);
+
+    vk::BufferMemoryBarrier toHost(
+        vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead,
+        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, readbackBuffer, 0,
+        VK_WHOLE_SIZE);
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                  vk::PipelineStageFlagBits::eHost, {}, 0,
+                                  nullptr, 1, &toHost, 0, nullptr);
+
+    endSingleTimeCommands(commandBuffer);
+
+    const uint8_t *pixels = static_cast<const uint8_t *>(
+        mDevice.mapMemory(readbackMemory, 0, readbackSize, {}));
+
+    atlas.pixels.assign(pixels, pixels + readbackSize);
+
+    mDevice.unmapMemory(readbackMemory);
+
+    if (mFormat == vk::Format::eB8G8R8A8Unorm ||
+        mFormat == vk::Format::eB8G8R8A8Srgb) {
+      for (size_t p = 0; p < atlas.pixels.size(); p += 4)
+        std::swap(atlas.pixels[p], atlas.pixels[p + 2]);
+    }
+
+    mDevice.destroyBuffer(readbackBuffer);
+    mDevice.freeMemory(readbackMemory);
+    destroyOffscreenTarget(target);
+
+    atlases.push_back(std::move(atlas));
+  }
+
+  destroyViewBatch(batch);
+
+  return atlases;
+}
+
+bool TruchasRender::exportTiled(const std::string &path, uint32_t width,
+                                uint32_t height, uint32_t tileSize) {
+
+  if (width == 0 || height == 0)
+    return false;
+
+  uint32_t maxSide = std::min(
+      mPhysicalDevice.getProperties().limits.maxImageDimension2D,
+      MAX_ATLAS_SIZE);
+
+  tileSize = std::clamp<uint32_t>(tileSize, 1, maxSide);
+
+  uint32_t columns = (width + tileSize - 1) / tileSize;
+  uint32_t rows = (height + tileSize - 1) / tileSize;
+  uint32_t tileCount = columns * rows;
+
+  PngStreamWriter writer;
+
+  if (!writer.open(path, width, height))
+    return false;
+
+  ubo camera = cameraUniform(width / static_cast<float>(height));
+
+  // Two tiles in flight, the GPU renders tile k+1 while tile k is encoded
+  struct TileFrame {
+    OffscreenTarget target;
+    vk::Buffer buffer;
+    vk::DeviceMemory memory;
+    const uint8_t *mapped = nullptr;
+    vk::CommandBuffer commandBuffer;
+    vk::Fence fence;
+  };
+
+  std::array<TileFrame, 2> frames;
+
+  ViewBatch batch =
+      createViewBatch(camera, static_cast<uint32_t>(frames.size()));
+
+  vk::CommandPoolCreateInfo commandPoolInfo(
+      vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+      mIndices.graphicsFamily);
+
+  vk::CommandPool commandPool = mDevice.createCommandPool(commandPoolInfo);
+
+  std::vector<vk::CommandBuffer> commandBuffers =
+      mDevice.allocateCommandBuffers(vk::CommandBufferAllocateInfo(
+          commandPool, vk::CommandBufferLevel::ePrimary,
+          static_cast<uint32_t>(frames.size())));
+
+  vk::DeviceSize tileBytes =
+      static_cast<vk::DeviceSize>(tileSize) * tileSize * 4;
+
+  for (size_t f = 0; f < frames.size(); f++) {
+
+    frames[f].target = createOffscreenTarget(tileSize, tileSize);
+
+    createBuffer(tileBytes, vk::BufferUsageFlagBits::eTransferDst,
+                 vk::MemoryPropertyFlagBits::eHostVisible |
+                     vk::MemoryPropertyFlagBits::eHostCoherent,
+                 frames[f].buffer, frames[f].memory);
+
+    frames[f].mapped = static_cast<const uint8_t *>(
+        mDevice.mapMemory(frames[f].memory, 0, tileBytes, {}));
+    frames[f].commandBuffer = commandBuffers[f];
+    frames[f].fence = mDevice.createFence(vk::FenceCreateInfo());
+  }
+
+  bool bgra = mFormat == vk::Format::eB8G8R8A8Unorm ||
+              mFormat == vk::Format::eB8G8R8A8Srgb;
+
+  // One row of tiles, the only part of the image held in host memory
+  std::vector<uint8_t> band(static_cast<size_t>(width) * tileSize * 3);
+
+  auto submitTile = [&](uint32_t k) {
+    TileFrame &frame = frames[k % frames.size()];
+
+    uint32_t x0 = (k % columns) * tileSize;
+    uint32_t y0 = (k / columns) * tileSize;
+
+    // Crop the full projection to this tile's part of the image
+    float sx = width / static_cast<float>(tileSize);
+    float sy = height / static_cast<float>(tileSize);
+    float cx = 2.0f * (x0 + 0.5f * tileSize) / width - 1.0f;
+    float cy = 2.0f * (y0 + 0.5f * tileSize) / height - 1.0f;
+
+    glm::mat4 crop(1.0f);
+    crop[0][0] = sx;
+    crop[1][1] = sy;
+    crop[3][0] = -sx * cx;
+    crop[3][1] = -sy * cy;
+
+    uint32_t viewIndex = k % frames.size();
+    batch.mViews[viewIndex] = {camera.view, crop * camera.proj, FULL_VIEW_RECT};
+
+    vk::CommandBuffer &commandBuffer = frame.commandBuffer;
+
+    commandBuffer.reset();
+    commandBuffer.begin(vk::CommandBufferBeginInfo(
+        vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+    recordOffscreenScene(commandBuffer, frame.target, batch.mSet, viewIndex);
+
+    vk::ImageSubresourceLayers layers(vk::ImageAspectFlagBits::eColor, 0, 0,
+                                      1);
+    vk::BufferImageCopy region(0, 0, 0, layers, {0, 0, 0},
+                               {tileSize, tileSize, 1});
+
+    commandBuffer.copyImageToBuffer(frame.target.mColorImage,
+                                    vk::ImageLayout::eTransferSrcOptimal,
+                                    frame.buffer, 1, &region);
+
+    vk::BufferMemoryBarrier toHost(
+        vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead,
+        VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, frame.buffer, 0,
+        VK_WHOLE_SIZE);
+
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                  vk::PipelineStageFlagBits::eHost, {}, 0,
+                                  nullptr, 1, &toHost, 0, nullptr);
+
+    commandBuffer.end();
+
+    vk::SubmitInfo submitInfo(0, nullptr, nullptr, 1, &commandBuffer, 0,
+                              nullptr);
+
+    mDevice.resetFences(frame.fence);
+    mGraphicsQueue.submit(submitInfo, frame.fence);
+  };
+
+  auto encodeTile = [&](uint32_t k) {
+    TileFrame &frame = frames[k % frames.size()];
+
+    if (mDevice.waitForFences(frame.fence, VK_TRUE, UINT64_MAX) !=
+        vk::Result::eSuccess)
+      return false;
+
+    uint32_t tx = k % columns;
+    uint32_t x0 = tx * tileSize;
+    uint32_t y0 = (k / columns) * tileSize;
+    uint32_t w = std::min(tileSize, width - x0);
+    uint32_t h = std::min(tileSize, height - y0);
+
+    for (uint32_t y = 0; y < h; y++) {
+
+      const uint8_t *src = frame.mapped + static_cast<size_t>(y) * tileSize * 4;
+      uint8_t *dst = band.data() + (static_cast<size_t>(y) * width + x0) * 3;
+
+      for (uint32_t x = 0; x < w; x++) {
+        dst[3 * x + 0] = src[4 * x + (bgra ? 2 : 0)];
+        dst[3 * x + 1] = src[4 * x + 1];
+        dst[3 * x + 2] = src[4 * x + (bgra ? 0 : 2)];
+      }
+    }
+
+    return tx < columns - 1 || writer.writeRows(band.data(), h);
+  };
+
+  bool written = true;
+
+  for (uint32_t k = 0; k <= tileCount && written; k++) {
+
+    if (k < tileCount)
+      submitTile(k);
+
+    if (k > 0)
+      written = encodeTile(k - 1);
+  }
+
+  // The tile after the failed one may still be rendering
+  if (!written)
+    mGraphicsQueue.waitIdle();
+
+  for (auto &frame : frames) {
+    mDevice.destroyFence(frame.fence);
+    mDevice.unmapMemory(frame.memory);
+    mDevice.destroyBuffer(frame.buffer);
+    mDevice.freeMemory(frame.memory);
+    destroyOffscreenTarget(frame.target);
+  }
+
+  mDevice.destroyCommandPool(commandPool);
+  destroyViewBatch(batch);
+
+  if (!written) {
+    LOG_ERROR("tiled export to {} failed, the file was removed", path);
+    writer.close();
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    return false;
+  }
+
+  return writer.close();
+}
+
+void TruchasRender::recordOffscreenScene(vk::CommandBuffer &commandBuffer,
+                                         const OffscreenTarget &target,
+                                         vk::DescriptorSet descriptorSet,
+                                         uint32_t viewIndex) {
+
+  std::vector<vk::ClearValue> clearValues = sceneClearValues();
+
+  vk::Rect2D renderArea({0, 0}, target.mExtent);
+
+  vk::RenderPassBeginInfo renderPassInfo(
+      mOffscreenRenderPass, target.mFramebuffer, renderArea,
+      static_cast<uint32_t>(clearValues.size()), clearValues.data());
+
+  commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+
+  vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(target.mExtent.width),
+                        static_cast<float>(target.mExtent.height), 0.0f, 1.0f);
+
+  commandBuffer.setViewport(0, 1, &viewport);
+  commandBuffer.setScissor(0, 1, &renderArea);
+
+  commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                             Pipelines.SketchPoint);
+  commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                   mPipelineLayout, 0, 1, &descriptorSet, 0,
+                                   nullptr);
+
+  recordGeometry(commandBuffer, 1, viewIndex);
+
+  if (mShowGrid) {
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                               Pipelines.SketchGrid);
+    commandBuffer.draw(3, 1, 0, viewIndex);
+  }
+
+  recordLines(commandBuffer, descriptorSet, 1, viewIndex, target.mExtent);
+
+  // The pass has the UI subpass too, it just stays empty here
+  if (mPickingEnabled)
+    commandBuffer.nextSubpass(vk::SubpassContents::eInline);
+
+  commandBuffer.endRenderPass();
+
+  vk::ImageMemoryBarrier toTransfer(
+      vk::AccessFlagBits::eColorAttachmentWrite,
+      vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eTransferSrcOptimal,
+      vk::ImageLayout::eTransferSrcOptimal, VK_QUEUE_FAMILY_IGNORED,
+      VK_QUEUE_FAMILY_IGNORED, target.mColorImage,
+      vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+
+  commandBuffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eColorAttachmentOutput,
+      vk::PipelineStageFlagBits::eTransfer, {}, 0, nullptr, 0, nullptr, 1,
+      &toTransfer);
+}
+
+ViewBatch TruchasRender::createViewBatch(const ubo &camera,
+                                         uint32_t viewCount) {
+
+  ViewBatch batch;
+
+  vk::DeviceSize uboSize = sizeof(ubo);
+
+  createBuffer(uboSize, vk::BufferUsageFlagBits::eUniformBuffer,
+               vk::MemoryPropertyFlagBits::eHostVisible |
+                   vk::MemoryPropertyFlagBits::eHostCoherent,
+               batch.mUboBuffer, batch.mUboMemory);
+
+  void *data = mDevice.mapMemory(batch.mUboMemory, 0, uboSize, {});
+  memcpy(data, &camera, sizeof(camera));
+  mDevice.unmapMemory(batch.mUboMemory);
+
+  vk::DeviceSize viewSize = sizeof(ViewData) * std::max(viewCount, 1u);
+
+  createBuffer(viewSize, vk::BufferUsageFlagBits::eStorageBuffer,
+               vk::MemoryPropertyFlagBits::eHostVisible |
+                   vk::MemoryPropertyFlagBits::eHostCoherent,
+               batch.mViewBuffer, batch.mViewMemory);
+
+  batch.mViews = static_cast<ViewData *>(
+      mDevice.mapMemory(batch.mViewMemory, 0, viewSize, {}));
+
+  std::array<vk::DescriptorPoolSize, 2> poolSizes = {
+      vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, 1),
+      vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 1)};
+
+  vk::DescriptorPoolCreateInfo poolInfo(
+      {}, 1, static_cast<uint32_t>(poolSizes.size()), poolSizes.data());
+
+  batch.mPool = mDevice.createDescriptorPool(poolInfo);
+
+  vk::DescriptorSetAllocateInfo allocInfo(batch.mPool, 1,
+                                          &mDescriptorSetLayout);
+
+  batch.mSet = mDevice.allocateDescriptorSets(allocInfo)[0];
+
+  vk::DescriptorBufferInfo bufferInfo(batch.mUboBuffer, 0, sizeof(ubo));
+  vk::DescriptorBufferInfo viewInfo(batch.mViewBuffer, 0, VK_WHOLE_SIZE);
+
+  std::array<vk::WriteDescriptorSet, 2> descriptorWrites = {
+      vk::WriteDescriptorSet(batch.mSet, 0, 0, 1,
+                             vk::DescriptorType::eUniformBuffer, nullptr,
+                             &bufferInfo),
+      vk::WriteDescriptorSet(batch.mSet, 1, 0, 1,
+                             vk::DescriptorType::eStorageBuffer, nullptr,
+                             &viewInfo)};
+
+  mDevice.updateDescriptorSets(static_cast<uint32_t>(descriptorWrites.size()),
+                               descriptorWrites.data(), 0, nullptr);
+
+  return batch;
+}
+
+void TruchasRender::destroyViewBatch(ViewBatch &batch) {
+
+  mDevice.unmapMemory(batch.mViewMemory);
+  mDevice.destroyBuffer(batch.mViewBuffer);
+  mDevice.freeMemory(batch.mViewMemory);
+  mDevice.destroyBuffer(batch.mUboBuffer);
+  mDevice.freeMemory(batch.mUboMemory);
+  mDevice.destroyDescriptorPool(batch.mPool);
+
+  batch = ViewBatch{};
+}
 
 void TruchasRender::destroyPipelines() {
 
   mDevice.destroyPipeline(Pipelines.SketchPoint);
   mDevice.destroyPipeline(Pipelines.SketchLine);
   mDevice.destroyPipeline(Pipelines.SketchGrid);
+  mDevice.destroyPipeline(Pipelines.SketchSplat);
+  mDevice.destroyPipeline(Pipelines.SketchSplatResolve);
   mDevice.destroyPipeline(mTextPipeline);
 }
 
@@ -1196,17 +4522,27 @@ void TruchasRender::cleanupSwapchain() {
     mDevice.destroyFramebuffer(mFramebuffer, nullptr);
 
   mDevice.destroyPipelineLayout(mPipelineLayout, nullptr);
+  mDevice.destroyPipelineLayout(mLinePipelineLayout, nullptr);
+  mDevice.destroyPipelineLayout(mSplatPipelineLayout, nullptr);
 
   mDevice.destroyDescriptorSetLayout(mDescriptorSetLayout, nullptr);
 
+  destroySplatTargets();
+
   mDevice.destroyRenderPass(mRenderPass, nullptr);
+  mDevice.destroyRenderPass(mUiRenderPass, nullptr);
+  mDevice.destroyRenderPass(mProgressiveClearPass, nullptr);
+  mDevice.destroyRenderPass(mProgressiveLoadPass, nullptr);
 
+  destroySceneTarget();
   destroyPipelines();
 
   mDevice.destroyImage(depthImage);
   mDevice.freeMemory(depthImageMemory);
   mDevice.destroyImageView(depthImageView);
 
+  destroyPickTarget();
+
   for (auto &view : mImageViews)
     mDevice.destroyImageView(view, nullptr);
 
@@ -1215,6 +4551,8 @@ void TruchasRender::cleanupSwapchain() {
 
 void TruchasRender::cleanup() {
 
+  mDevice.waitIdle();
+
   for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     mDevice.destroySemaphore(mImageAvailableSemaphores[i]);
     mDevice.destroySemaphore(mRenderFinishedSemaphores[i]);
@@ -1223,12 +4561,31 @@ void TruchasRender::cleanup() {
 
   destroyPipelines();
 
+  disableReadback();
+  mImageWriter.reset();
+
   for (auto &Buffer : mBuffers) {
 
     mDevice.destroyBuffer(Buffer.second.mBuffer);
     mDevice.freeMemory(Buffer.second.mMemory);
   }
 
+  while (!mLineSets.empty())
+    deleteLineSet(mLineSets.begin()->first);
+
+  mDevice.destroyBuffer(mQuadIndices.mBuffer);
+  mDevice.freeMemory(mQuadIndices.mMemory);
+
+  destroySplatTargets();
+  destroyLodTables();
+
+  while (!mPointClouds.empty())
+    deletePointCloud(mPointClouds.begin()->first);
+
+  releaseRetired(true);
+
+  mThreadPool.reset();
+
   for (auto &framebuffer : mFramebuffers) {
     mDevice.destroyFramebuffer(framebuffer, nullptr);
   }
@@ -1241,6 +4598,14 @@ void TruchasRender::cleanup() {
     mDevice.freeMemory(memory);
   }
 
+  for (auto &Buffer : mViewBuffers) {
+    mDevice.destroyBuffer(Buffer);
+  }
+
+  for (auto &memory : mViewBufferMemories) {
+    mDevice.freeMemory(memory);
+  }
+
   mDevice.destroySampler(mTextureSampler);
   mDevice.destroyImageView(mTextureImageView);
   mDevice.destroyImage(mTextureImage);
@@ -1250,12 +4615,30 @@ void TruchasRender::cleanup() {
   mDevice.freeMemory(depthImageMemory);
   mDevice.destroyImageView(depthImageView);
 
+  destroyPickTarget();
+  destroyPickResources();
+
+  // Frees the progressive command buffers with it
+  mDevice.destroyCommandPool(mProgressiveCommandPool);
   mDevice.destroyCommandPool(mCommandPool);
   mDevice.destroyDescriptorPool(mGuiDescriptorPool);
   mDevice.destroyDescriptorPool(mDescriptorPool);
+  mDevice.destroyDescriptorPool(mLineDescriptorPool);
+  mDevice.destroyDescriptorPool(mSplatDescriptorPool);
   mDevice.destroyPipelineLayout(mPipelineLayout, nullptr);
+  mDevice.destroyPipelineLayout(mLinePipelineLayout, nullptr);
+  mDevice.destroyPipelineLayout(mSplatPipelineLayout, nullptr);
   mDevice.destroyDescriptorSetLayout(mDescriptorSetLayout, nullptr);
+  mDevice.destroyDescriptorSetLayout(mLineSetLayout, nullptr);
+  mDevice.destroyDescriptorSetLayout(mSplatSourceLayout, nullptr);
+  mDevice.destroyDescriptorSetLayout(mSplatTargetLayout, nullptr);
+  destroySceneTarget();
+
   mDevice.destroy(mRenderPass, nullptr);
+  mDevice.destroy(mUiRenderPass, nullptr);
+  mDevice.destroy(mProgressiveClearPass, nullptr);
+  mDevice.destroy(mProgressiveLoadPass, nullptr);
+  mDevice.destroy(mOffscreenRenderPass, nullptr);
 
   for (auto &imageView : mImageViews) {
     mDevice.destroyImageView(imageView, nullptr);
@@ -1282,29 +4665,476 @@ void TruchasRender::destroy() {
 
 void TruchasRender::onNotify(int id, const RenderData &Renderables) {
 
-  std::cout << "Render notified!" << std::endl;
-  std::cout << Renderables << std::endl;
+  LOG_DEBUG("render buffer {} rebuilt from {} points", id, Renderables.size());
+
+  size_t count = Renderables.size();
+
+  if (count == 0) {
+    deleteBuffer(id);
+    return;
+  }
+
+  size_t capacity = count + count / 2;
+  std::shared_ptr<PointOctree> octree;
+
+  // Segments index the points, so only plain point sets are reordered
+  if (useLod(count) && Renderables.segments.empty()) {
+
+    octree = std::make_shared<PointOctree>();
+    octree->build(Renderables.points.data(), count, sizeof(glm::vec3),
+                  &getThreadPool());
+
+    // Edits rebuild the tree, spare room would never be written
+    count = capacity = octree->size();
+  }
+
+  // Storage usage lets the line shader fetch segment endpoints
+  vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eVertexBuffer |
+                               vk::BufferUsageFlagBits::eStorageBuffer;
+
+  glm::vec3 min, max;
+
+  // Vertices go straight into the staging memory, nothing in between
+  Buffer buffer = uploadBuffer(
+      sizeof(Vertex) * count, sizeof(Vertex) * capacity, usage,
+      [&](void *mapped) {
+        fillVertices(Renderables, octree.get(), static_cast<Vertex *>(mapped),
+                     min, max);
+      });
+
+  buffer.mPointSize = static_cast<uint32_t>(count);
+  buffer.mCapacity = static_cast<uint32_t>(capacity);
+  buffer.mMin = min;
+  buffer.mMax = max;
+  buffer.mGeneration = Renderables.generation;
+  buffer.mOctree = octree;
+
+  deleteBuffer(id);
+  mBuffers[id] = buffer;
+  mDrawsChanged = true;
+
+  updateLineSet(id, Renderables.segments);
+  requestFrame();
+}
+
+void TruchasRender::fillVertices(const RenderData &renderables,
+                                 const PointOctree *octree, Vertex *dst,
+                                 glm::vec3 &min, glm::vec3 &max) {
 
-  std::vector<Vertex> Vertices;
+  ThreadPool &pool = getThreadPool();
+
+  const glm::vec3 *points = renderables.points.data();
+  const glm::vec3 *colors = renderables.colors.data();
+  size_t count = renderables.size();
+
+  size_t chunks = (count + VERTEX_FILL_GRAIN - 1) / VERTEX_FILL_GRAIN;
+  std::vector<std::pair<glm::vec3, glm::vec3>> bounds(chunks);
+
+  // Without a tree every chunk is written where it is read
+  pool.parallelFor(
+      chunks,
+      [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+
+          size_t first = c * VERTEX_FILL_GRAIN;
+          size_t n = std::min(VERTEX_FILL_GRAIN, count - first);
+
+          computeBounds(points + first, n, sizeof(glm::vec3), bounds[c].first,
+                        bounds[c].second);
+
+          if (!octree)
+            packVertices(points + first, colors + first, &dst[first].pos.x, n);
+        }
+      },
+      1);
+
+  if (octree) {
+
+    const std::vector<uint32_t> &order = octree->order();
+
+    pool.parallelFor(
+        order.size(),
+        [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++)
+            dst[i] = {points[order[i]], colors[order[i]]};
+        },
+        VERTEX_FILL_GRAIN);
+  }
+
+  min = bounds[0].first;
+  max = bounds[0].second;
+
+  for (const auto &[chunkMin, chunkMax] : bounds) {
+    min = glm::min(min, chunkMin);
+    max = glm::max(max, chunkMax);
+  }
+}
+
+Buffer TruchasRender::createVertexBuffer(const void *vertices, uint32_t count,
+                                        uint32_t capacity) {
+
+  capacity = std::max(capacity, count);
+
+  Buffer buffer = uploadBuffer(vertices, sizeof(Vertex) * count,
+                               sizeof(Vertex) * capacity,
+                               vk::BufferUsageFlagBits::eVertexBuffer |
+                                   vk::BufferUsageFlagBits::eStorageBuffer);
+
+  buffer.mPointSize = count;
+  buffer.mCapacity = capacity;
+
+  return buffer;
+}
+
+Buffer TruchasRender::uploadBuffer(const void *data, vk::DeviceSize dataSize,
+                                   vk::DeviceSize size,
+                                   vk::BufferUsageFlags usage) {
+  return uploadBuffer(dataSize, size, usage, [&](void *mapped) {
+    memcpy(mapped, data, static_cast<size_t>(dataSize));
+  });
+}
+
+Buffer TruchasRender::uploadBuffer(vk::DeviceSize dataSize, vk::DeviceSize size,
+                                   vk::BufferUsageFlags usage,
+                                   const std::function<void(void *)> &fill) {
+
+  Buffer buffer;
+  buffer.mDeviceSize = size;
+
+  createBuffer(buffer.mDeviceSize,
+               vk::BufferUsageFlagBits::eTransferDst | usage,
+               vk::MemoryPropertyFlagBits::eDeviceLocal, buffer.mBuffer,
+               buffer.mMemory);
+
+  if (dataSize == 0)
+    return buffer;
+
+  vk::Buffer stagingBuffer;
+  vk::DeviceMemory stagingBufferMemory;
+
+  createBuffer(dataSize, vk::BufferUsageFlagBits::eTransferSrc,
+               vk::MemoryPropertyFlagBits::eHostVisible |
+                   vk::MemoryPropertyFlagBits::eHostCoherent,
+               stagingBuffer, stagingBufferMemory);
+
+  fill(mDevice.mapMemory(stagingBufferMemory, 0, dataSize, {}));
+  mDevice.unmapMemory(stagingBufferMemory);
+
+  vk::CommandBuffer commandBuffer = beginSingleTimeCommands(
+      vk::CommandBufferLevel::ePrimary, vk::CommandBufferInheritanceInfo());
+
+  commandBuffer.copyBuffer(stagingBuffer, buffer.mBuffer,
+                           vk::BufferCopy(0, 0, dataSize));
+
+  // Nothing draws the new buffer before the next frame
+  submitTransfer(commandBuffer, [this, stagingBuffer, stagingBufferMemory] {
+    mDevice.destroyBuffer(stagingBuffer);
+    mDevice.freeMemory(stagingBufferMemory);
+  });
+
+  return buffer;
+}
+
+void TruchasRender::createQuadIndices() {
+
+  const std::array<uint16_t, 6> indices = {0, 1, 2, 0, 2, 3};
+  vk::DeviceSize size = sizeof(indices);
+
+  mQuadIndices = uploadBuffer(indices.data(), size, size,
+                              vk::BufferUsageFlagBits::eIndexBuffer);
+  mQuadIndices.mPointSize = static_cast<uint32_t>(indices.size());
+  mQuadIndices.mCapacity = mQuadIndices.mPointSize;
+}
+
+void TruchasRender::updateLineSet(uint32_t id,
+                                  std::span<const Segment> segments) {
+
+  auto vertices = mBuffers.find(id);
+
+  // The frames in flight keep drawing the old set and segments
+  deleteLineSet(id);
+
+  if (segments.empty() || vertices == mBuffers.end())
+    return;
+
+  LineSet &lineSet = mLineSets[id];
+
+  vk::DescriptorSetAllocateInfo allocInfo(mLineDescriptorPool, 1,
+                                          &mLineSetLayout);
+  lineSet.mSet = mDevice.allocateDescriptorSets(allocInfo)[0];
+
+  // Room for added segments, updateSegments writes them in place
+  uint32_t count = static_cast<uint32_t>(segments.size());
+  uint32_t capacity = count + count / 2;
+
+  lineSet.mSegments = uploadBuffer(
+      segments.data(), sizeof(Segment) * count, sizeof(Segment) * capacity,
+      vk::BufferUsageFlagBits::eStorageBuffer);
+  lineSet.mSegments.mPointSize = count;
+  lineSet.mSegments.mCapacity = capacity;
+
+  vk::DescriptorBufferInfo vertexInfo(vertices->second.mBuffer, 0,
+                                      VK_WHOLE_SIZE);
+  vk::DescriptorBufferInfo segmentInfo(lineSet.mSegments.mBuffer, 0,
+                                       VK_WHOLE_SIZE);
+
+  std::array<vk::WriteDescriptorSet, 2> descriptorWrites;
+
+  descriptorWrites[0].dstSet = lineSet.mSet;
+  descriptorWrites[0].dstBinding = 0;
+  descriptorWrites[0].descriptorType = vk::DescriptorType::eStorageBuffer;
+  descriptorWrites[0].descriptorCount = 1;
+  descriptorWrites[0].pBufferInfo = &vertexInfo;
+
+  descriptorWrites[1].dstSet = lineSet.mSet;
+  descriptorWrites[1].dstBinding = 1;
+  descriptorWrites[1].descriptorType = vk::DescriptorType::eStorageBuffer;
+  descriptorWrites[1].descriptorCount = 1;
+  descriptorWrites[1].pBufferInfo = &segmentInfo;
+
+  mDevice.updateDescriptorSets(static_cast<uint32_t>(descriptorWrites.size()),
+                               descriptorWrites.data(), 0, nullptr);
+
+  mDrawsChanged = true;
+}
+
+void TruchasRender::updateSegments(uint32_t id,
+                                   std::span<const Segment> segments,
+                                   const ChangeSet &changes) {
+
+  auto it = mLineSets.find(id);
+  uint32_t count = static_cast<uint32_t>(segments.size());
+
+  // A new set, or one that outgrew its buffer, is built whole
+  if (it == mLineSets.end() || count == 0 ||
+      count > it->second.mSegments.mCapacity) {
+    updateLineSet(id, segments);
+    return;
+  }
+
+  Buffer &buffer = it->second.mSegments;
+
+  std::vector<vk::BufferCopy> regions;
+  vk::DeviceSize stagingSize = 0;
+
+  for (const auto *ranges :
+       {&changes.addedSegments, &changes.modifiedSegments}) {
+    for (const auto &range : *ranges) {
+
+      if (range.first >= count)
+        continue;
+
+      uint32_t n = std::min(range.count, count - range.first);
+
+      regions.push_back({stagingSize, sizeof(Segment) * range.first,
+                         sizeof(Segment) * n});
+      stagingSize += sizeof(Segment) * n;
+    }
+  }
+
+  if (stagingSize > 0) {
+    writeRegions(buffer.mBuffer, regions, stagingSize, [&](void *mapped) {
+      auto *source = reinterpret_cast<const std::byte *>(segments.data());
+      for (const auto &region : regions)
+        memcpy(static_cast<std::byte *>(mapped) + region.srcOffset,
+               source + region.dstOffset, static_cast<size_t>(region.size));
+    });
+  }
+
+  // Removed segments sit past the new count and are no longer drawn
+  if (count != buffer.mPointSize)
+    mDrawsChanged = true;
+
+  buffer.mPointSize = count;
+}
+
+void TruchasRender::deleteLineSet(uint32_t id) {
+
+  auto it = mLineSets.find(id);
+
+  if (it == mLineSets.end())
+    return;
+
+  retireBuffer(it->second.mSegments);
+
+  if (it->second.mSet)
+    retire([this, set = it->second.mSet] {
+      mDevice.freeDescriptorSets(mLineDescriptorPool, 1, &set);
+    });
+
+  mLineSets.erase(it);
+  mDrawsChanged = true;
+}
+
+void TruchasRender::recordLines(vk::CommandBuffer &commandBuffer,
+                                vk::DescriptorSet descriptorSet,
+                                uint32_t viewCount, uint32_t firstView,
+                                vk::Extent2D extent) {
+
+  if (mLineSets.empty())
+    return;
+
+  commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                             Pipelines.SketchLine);
+  commandBuffer.bindIndexBuffer(mQuadIndices.mBuffer, 0,
+                                vk::IndexType::eUint16);
+
+  // Set 0 has to be bound again, the push constant range makes the line
+  // layout incompatible with mPipelineLayout
+  commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                   mLinePipelineLayout, 0, 1, &descriptorSet,
+                                   0, nullptr);
+
+  LinePush push{glm::vec2(static_cast<float>(extent.width),
+                          static_cast<float>(extent.height)),
+                mLineWidth, 0, firstView, 0};
+
+  for (const auto &lineSet : mLineSets) {
+
+    push.segmentCount = lineSet.second.mSegments.mPointSize;
+    push.idBase = lineSet.second.mPickBase;
+
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                     mLinePipelineLayout, 1, 1,
+                                     &lineSet.second.mSet, 0, nullptr);
+    commandBuffer.pushConstants(mLinePipelineLayout,
+                                vk::ShaderStageFlagBits::eVertex, 0,
+                                sizeof(push), &push);
+
+    // Four corners per segment quad, shared by its two triangles. The
+    // shader splits the instance index into segment and view.
+    commandBuffer.drawIndexed(mQuadIndices.mPointSize,
+                              push.segmentCount * viewCount, 0, 0, 0);
+  }
+}
+
+void TruchasRender::uploadSnapshot(uint32_t id, const Snapshot &snapshot) {
+
+  auto vertices = snapshot.vertices();
+
+  deleteBuffer(id);
+
+  if (vertices.empty())
+    return;
+
+  const SnapshotHeader &header = snapshot.header();
+
+  uint32_t count = static_cast<uint32_t>(vertices.size());
+  uint32_t capacity = count + count / 2;
+  const void *data = vertices.data();
+
+  std::vector<Vertex> ordered;
+  std::shared_ptr<const PointOctree> octree;
+  std::span<const Segment> segments = snapshot.segments();
+
+  // open() skips the block checksums, so endpoints are checked here like
+  // Snapshot::read does, the mapped span is only copied when one is bad
+  auto outside = [&](const Segment &segment) {
+    return segment.a >= vertices.size() || segment.b >= vertices.size();
+  };
+
+  std::vector<Segment> valid;
+  if (std::any_of(segments.begin(), segments.end(), outside)) {
+    std::remove_copy_if(segments.begin(), segments.end(),
+                        std::back_inserter(valid), outside);
+    LOG_WARN("snapshot {} dropped {} segments outside its {} points", id,
+             segments.size() - valid.size(), vertices.size());
+    segments = valid;
+  }
+
+  // Segments index the points, so only plain point sets are reordered
+  if (useLod(count) && segments.empty()) {
+    octree = buildOctree(reinterpret_cast<const Vertex *>(data), count,
+                         ordered);
+    data = ordered.data();
+    count = capacity = static_cast<uint32_t>(ordered.size());
+  }
+
+  Buffer buffer = createVertexBuffer(data, count, capacity);
+  buffer.mOctree = octree;
+
+  buffer.mMin = glm::vec3(header.boundsMin[0], header.boundsMin[1],
+                          header.boundsMin[2]);
+  buffer.mMax = glm::vec3(header.boundsMax[0], header.boundsMax[1],
+                          header.boundsMax[2]);
+  buffer.mGeneration = header.generation;
+
+  mBuffers[id] = buffer;
+  mDrawsChanged = true;
+
+  updateLineSet(id, segments);
+  requestFrame();
+}
+
+void TruchasRender::onChange(int id, const RenderData &Renderables,
+                             const ChangeSet &changes) {
+
+  auto it = mBuffers.find(id);
+  uint32_t size = static_cast<uint32_t>(Renderables.size());
+
+  // Anything the buffer can't absorb in place falls back to a full upload,
+  // octree buffers no longer match the model's indices
+  if (changes.full || it == mBuffers.end() || it->second.mOctree ||
+      it->second.mGeneration != changes.base || size == 0 ||
+      size > it->second.mCapacity) {
+    onNotify(id, Renderables);
+    return;
+  }
+
+  Buffer &buffer = it->second;
+
+  std::vector<vk::BufferCopy> regions;
+  vk::DeviceSize stagingSize = 0;
+
+  for (const auto *ranges : {&changes.added, &changes.modified}) {
+    for (const auto &range : *ranges) {
+
+      if (range.first >= size)
+        continue;
+
+      uint32_t count = std::min(range.count, size - range.first);
+
+      regions.push_back({stagingSize, sizeof(Vertex) * range.first,
+                         sizeof(Vertex) * count});
+      stagingSize += sizeof(Vertex) * count;
+    }
+  }
+
+  if (stagingSize > 0) {
+    writeRegions(buffer.mBuffer, regions, stagingSize, [&](void *mapped) {
+      Vertex *data = static_cast<Vertex *>(mapped);
+
+      for (const auto &region : regions) {
+
+        uint32_t first =
+            static_cast<uint32_t>(region.dstOffset / sizeof(Vertex));
+        uint32_t count = static_cast<uint32_t>(region.size / sizeof(Vertex));
+
+        packVertices(Renderables.points.data() + first,
+                     Renderables.colors.data() + first, &data->pos.x, count);
+        data += count;
+
+        glm::vec3 min, max;
+        computeBounds(Renderables.points.data() + first, count,
+                      sizeof(glm::vec3), min, max);
+        buffer.mMin = glm::min(buffer.mMin, min);
+        buffer.mMax = glm::max(buffer.mMax, max);
+      }
+    });
+  }
 
-  // if (!Renderables.Points.empty()) {
+  // Moved points keep the recorded draws, only a new count records them again
+  if (size != buffer.mPointSize)
+    mDrawsChanged = true;
 
-  //   for (const auto& p : Renderables.Points) {
-  //     Vertices.push_back( { p, glm::vec3 {1.0f, 1.0f, 1.0f} } );
-  //   }
-  // }
+  // Removed points sit past the new size and are simply no longer drawn
+  buffer.mPointSize = size;
+  buffer.mGeneration = changes.generation;
 
-  // if (Vertices.empty()) {
-  //   deleteBuffer(id);
-  //   return;
-  // }
+  if (changes.segmentsChanged())
+    updateSegments(id, Renderables.segments, changes);
 
-  // if (mBuffers.find(id) == mBuffers.end()) {
-  //   createDeviceBuffer(id, Vertices, vk::BufferUsageFlagBits::eVertexBuffer);
-  // }
-  // else {
-  //   updateDeviceBuffer(id, Vertices, vk::BufferUsageFlagBits::eVertexBuffer);
-  // }
+  requestFrame();
 }
 
 } // namespace TRUCHAS_APP_NAMESPACE
@@ -1,5 +1,10 @@
 #pragma once
+#include "dispatcher.hpp"
+#include "importer.hpp"
+#include "octree.hpp"
+#include "readback.hpp"
 #include "sketch.hpp"
+#include "thread_pool.hpp"
 
 namespace TRUCHAS_APP_NAMESPACE {
 
@@ -8,6 +13,9 @@ struct Vertex {
   glm::vec3 col;
 };
 
+static_assert(sizeof(Vertex) == sizeof(SnapshotVertex),
+              "snapshot vertices are uploaded without conversion");
+
 struct SwapChainSupportDetails {
   vk::SurfaceCapabilitiesKHR capabilities;
   std::vector<vk::SurfaceFormatKHR> formats;
@@ -27,6 +35,17 @@ struct ubo {
   glm::mat4 model;
   glm::mat4 view;
   glm::mat4 proj;
+  // Pick id under the cursor, drawn highlighted. 0 is nothing.
+  uint32_t hoverId = 0;
+};
+
+// One camera in the view table (binding 1). Draws pick their entry through
+// the instance index, so several cameras can share one descriptor set.
+// rect is the view's part of the framebuffer as x, y, width, height in 0..1.
+struct ViewData {
+  glm::mat4 view;
+  glm::mat4 proj;
+  glm::vec4 rect;
 };
 
 struct Buffer {
@@ -35,6 +54,162 @@ struct Buffer {
   vk::DeviceMemory mMemory;
   vk::DeviceSize mDeviceSize;
   uint32_t mPointSize;
+  uint32_t mCapacity = 0;
+  uint64_t mGeneration = 0;
+  glm::vec3 mMin{0.0f};
+  glm::vec3 mMax{0.0f};
+  // Binds the buffer as splat input, allocated the first time it is splatted
+  vk::DescriptorSet mSplatSet;
+  // Level of detail, the vertices are stored in the octree's order
+  std::shared_ptr<const PointOctree> mOctree;
+  // Header slot in the indirect tables, the nodes follow it
+  uint32_t mLodSlot = std::numeric_limits<uint32_t>::max();
+  // Pick id of the first vertex
+  uint32_t mPickBase = 0;
+};
+
+// Segments of one model. The set binds the model's vertex buffer and the
+// segment buffer, both read as storage buffers by the line shader.
+struct LineSet {
+  Buffer mSegments;
+  vk::DescriptorSet mSet;
+  // Pick id of the first segment
+  uint32_t mPickBase = 0;
+};
+
+struct LinePush {
+  glm::vec2 viewport;
+  float width;
+  uint32_t segmentCount;
+  uint32_t firstView;
+  uint32_t idBase;
+};
+
+struct SplatPush {
+  glm::uvec2 extent;
+  uint32_t pointCount;
+  uint32_t firstView;
+  // Reads the points from the node ranges at this slot when set
+  uint32_t lodSlot;
+};
+
+// Imported cloud, one device buffer per streamed chunk
+struct PointCloud {
+
+  std::unique_ptr<PointCloudImporter> mImporter;
+  std::vector<Buffer> mChunks;
+  glm::vec3 mMin{0.0f};
+  glm::vec3 mMax{0.0f};
+
+  size_t pointCount() const {
+    size_t count = 0;
+    for (const auto &chunk : mChunks)
+      count += chunk.mPointSize;
+    return count;
+  }
+};
+
+struct OffscreenTarget {
+
+  vk::Extent2D mExtent;
+
+  vk::Image mColorImage;
+  vk::DeviceMemory mColorMemory;
+  vk::ImageView mColorView;
+
+  vk::Image mDepthImage;
+  vk::DeviceMemory mDepthMemory;
+  vk::ImageView mDepthView;
+
+  // Only with picking, the render pass has the id attachment either way
+  vk::Image mIdImage;
+  vk::DeviceMemory mIdMemory;
+  vk::ImageView mIdView;
+
+  vk::Framebuffer mFramebuffer;
+};
+
+// Descriptor set with its own ubo and view table, for renders outside the
+// swapchain frames.
+struct ViewBatch {
+  vk::Buffer mUboBuffer;
+  vk::DeviceMemory mUboMemory;
+  vk::Buffer mViewBuffer;
+  vk::DeviceMemory mViewMemory;
+  ViewData *mViews = nullptr;
+  vk::DescriptorPool mPool;
+  vk::DescriptorSet mSet;
+};
+
+// RGBA8 atlas page, tiles maps model id to its rectangle in the page.
+struct ThumbnailAtlas {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<uint8_t> pixels;
+  std::map<uint32_t, vk::Rect2D> tiles;
+};
+
+struct ReadbackSlot {
+
+  enum State : uint32_t { free, pending, held };
+
+  Buffer mBuffer;
+  void *mMapped = nullptr;
+  vk::CommandBuffer mCommandBuffer;
+  uint64_t mFrame = 0;
+  size_t mFence = 0;
+  std::atomic<uint32_t> mState{free};
+};
+
+enum class PickKind : uint32_t { none, point, segment, cloudPoint };
+
+// What was under the cursor, resolved a frame after it was drawn
+struct PickResult {
+  PickKind kind = PickKind::none;
+  // Model or cloud id
+  uint32_t id = 0;
+  // Point or segment of the model, for clouds counted across the chunks
+  uint32_t index = 0;
+  // Value in the id buffer, 0 where nothing pickable was drawn
+  uint32_t pickId = 0;
+  uint64_t frame = 0;
+};
+
+// Ids [first, first + count) were drawn for one buffer
+struct PickRange {
+  uint32_t first;
+  uint32_t count;
+  PickKind kind;
+  uint32_t id;
+  // Added to the index, cloud chunks continue where the last one ended
+  uint32_t offset;
+  // Octree buffers are drawn in node order, order() maps back to points
+  std::shared_ptr<const PointOctree> octree;
+};
+
+// Points [first, first + count) of one draw, a buffer or cloud chunk
+struct ProgressiveRange {
+  uint32_t draw;
+  uint32_t first;
+  uint32_t count;
+};
+
+// Ids around the cursor for one frame in flight
+struct PickSlot {
+  Buffer mBuffer;
+  const uint32_t *mMapped = nullptr;
+  vk::CommandBuffer mCommandBuffer;
+  vk::Rect2D mRegion;
+  vk::Offset2D mCursor;
+  uint64_t mFrame = 0;
+  uint64_t mGeneration = 0;
+  bool mPending = false;
+};
+
+// Something the GPU may still use, destroyed once frame has finished
+struct Retired {
+  uint64_t frame;
+  std::function<void()> destroy;
 };
 
 enum RenderFlags { render_update_sketch, render_num_flags };
@@ -65,6 +240,8 @@ private:
     vk::Pipeline SketchPoint;
     vk::Pipeline SketchLine;
     vk::Pipeline SketchGrid;
+    vk::Pipeline SketchSplat;
+    vk::Pipeline SketchSplatResolve;
 
   } Pipelines;
 
@@ -100,7 +277,7 @@ public:
   int mWidth = 750;
   int mHeight = 750;
 
-  bool frameBufferResized;
+  bool frameBufferResized = false;
 
   std::vector<vk::Image> mImages;
   std::vector<vk::ImageView> mImageViews;
@@ -118,20 +295,140 @@ public:
 
   vk::PipelineLayout mPipelineLayout;
 
+  // Set 0 plus the per model line set (set 1) and LinePush
+  vk::PipelineLayout mLinePipelineLayout;
+
   vk::Pipeline mTextPipeline;
 
   // Buffers
   vk::CommandPool mCommandPool;
   std::vector<vk::CommandBuffer> mCommandBuffers;
+  // Recorded before the draws last changed, each is recorded again when its
+  // image comes up next
+  std::vector<bool> mOutdatedCommandBuffers;
+  // Buffers, counts or line sets changed since the last createCommandBuffers
+  bool mDrawsChanged = false;
   std::vector<vk::Framebuffer> mFramebuffers;
 
   std::vector<vk::Buffer> mUniformBuffers;
   std::vector<vk::DeviceMemory> mUniformBufferMemories;
 
+  std::vector<vk::Buffer> mViewBuffers;
+  std::vector<vk::DeviceMemory> mViewBufferMemories;
+
   vk::DescriptorPool mDescriptorPool;
   std::vector<vk::DescriptorSet> mDescriptorSets;
 
   std::map<uint32_t, Buffer> mBuffers;
+  std::map<uint32_t, PointCloud> mPointClouds;
+
+  vk::DescriptorSetLayout mLineSetLayout;
+  vk::DescriptorPool mLineDescriptorPool;
+  std::map<uint32_t, LineSet> mLineSets;
+  // Two triangles over the four corners of a segment quad
+  Buffer mQuadIndices;
+
+  bool mShowGrid = true;
+
+  // In pixels
+  float mLineWidth = 2.0f;
+
+  // Point splatting. Models with at least mSplatThreshold points are drawn by
+  // a compute pass that keeps the nearest point per pixel with 64-bit
+  // atomics, then resolved into the render pass. Needs shaderInt64 and
+  // shaderBufferInt64Atomics, otherwise everything is rasterized.
+  bool mSplatSupported = false;
+  uint32_t mSplatThreshold = 1 << 22;
+  vk::DescriptorSetLayout mSplatSourceLayout;
+  vk::DescriptorSetLayout mSplatTargetLayout;
+  vk::PipelineLayout mSplatPipelineLayout;
+  vk::DescriptorPool mSplatDescriptorPool;
+  // One per swapchain image, a uint64 per pixel
+  std::vector<Buffer> mSplatBuffers;
+  std::vector<vk::DescriptorSet> mSplatTargets;
+
+  // Level of detail. Models with at least mLodThreshold points and no
+  // segments, and every streamed cloud chunk, get an octree on upload. Their
+  // nodes are drawn through indirect commands updateLod rewrites each frame,
+  // picking the largest nodes on screen within the point budget. The budget
+  // doubles every frame the cameras hold still, up to mLodMaxBudget.
+  bool mLodEnabled = true;
+  bool mLodSupported = false;
+  bool mDrawIndirectCount = false;
+  uint32_t mLodThreshold = 1 << 20;
+  size_t mLodBudget = 1 << 22;
+  // Keeps a splatted buffer within one dispatch
+  size_t mLodMaxBudget = 1 << 24;
+  // Nodes smaller than this on screen are not refined
+  float mLodMinPixels = 48.0f;
+  size_t mLodFrameBudget = 0;
+  std::vector<LodView> mLodViews;
+  // One table of 16 byte slots per swapchain image, kept mapped
+  uint32_t mLodSlotCount = 0;
+  std::vector<Buffer> mLodTables;
+  std::vector<uint32_t *> mLodMapped;
+
+  // Views, empty means a single full screen view of the camera
+  std::vector<ViewData> mViews;
+
+  // Picking, set mPickingEnabled before setup. The scene subpass then also
+  // writes an R32_UINT id per fragment and ImGui moves to a second subpass.
+  // The ids around the cursor are copied out with every frame and looked up
+  // once its fence has signaled.
+  bool mPickingEnabled = false;
+  vk::Image mIdImage;
+  vk::DeviceMemory mIdImageMemory;
+  vk::ImageView mIdImageView;
+  vk::CommandPool mPickCommandPool;
+  std::vector<PickSlot> mPickSlots;
+  std::vector<PickRange> mPickRanges;
+  uint64_t mPickGeneration = 0;
+  PickResult mPick;
+
+  // Dynamic resolution. The scene renders into the top left of mSceneTarget
+  // at mRenderScale of the extent and is scaled up into the swapchain image,
+  // the UI then draws at full size in mUiRenderPass. Timestamps around the
+  // scene measure its GPU time, the scale follows it toward mFrameTarget.
+  bool mDynamicResolution = false;
+  // Swapchain images take blits with linear filtering
+  bool mUpscaleSupported = false;
+  // In ms
+  float mFrameTarget = 12.0f;
+  float mMinScale = 0.5f;
+  float mMaxScale = 1.0f;
+  float mRenderScale = 1.0f;
+  float mGpuFrameTime = 0.0f;
+  OffscreenTarget mSceneTarget;
+  vk::RenderPass mUiRenderPass;
+  // Two per swapchain image, none without timestamp support
+  vk::QueryPool mTimestamps;
+  // Nanoseconds per tick
+  float mTimestampPeriod = 0.0f;
+  uint64_t mTimestampMask = 0;
+  // Swapchain image each frame in flight drew last
+  std::vector<uint32_t> mFrameImages;
+
+  // Progressive refinement. The scene accumulates in mSceneTarget over
+  // several frames, recorded as they are drawn. A frame that finds the
+  // cameras or the scene changed clears it and draws the first
+  // mProgressiveBudget points, taking the buffers largest on screen first.
+  // Frames while they hold still add the next budget each without clearing,
+  // the grid and segments go in with the last one.
+  bool mProgressive = false;
+  size_t mProgressiveBudget = 1 << 22;
+  vk::RenderPass mProgressiveClearPass;
+  vk::RenderPass mProgressiveLoadPass;
+  vk::CommandPool mProgressiveCommandPool;
+  // One per frame in flight
+  std::vector<vk::CommandBuffer> mProgressiveCommandBuffers;
+  // What the accumulated image shows
+  std::vector<ViewData> mProgressiveViews;
+  uint64_t mProgressiveScene = 0;
+  std::vector<std::vector<ProgressiveRange>> mProgressiveBatches;
+  size_t mProgressiveNext = 0;
+
+  // Offscreen
+  vk::RenderPass mOffscreenRenderPass;
 
   // Textures
   vk::Image mTextureImage;
@@ -143,7 +440,40 @@ public:
   std::vector<vk::Semaphore> mImageAvailableSemaphores;
   std::vector<vk::Semaphore> mRenderFinishedSemaphores;
   std::vector<vk::Fence> mInFlightFences;
+  // Fence of the frame that last drew each swapchain image
+  std::vector<vk::Fence> mImagesInFlight;
   size_t mCurrentFrame = 0;
+  uint64_t mFrameCount = 0;
+  // mFrameCount after each frame in flight was submitted
+  std::vector<uint64_t> mSubmittedFrames;
+  // Frames known to have finished on the GPU
+  uint64_t mCompletedFrames = 0;
+  // Deletion queue, in frame order
+  std::deque<Retired> mRetired;
+
+  // On demand, frames are only drawn while some are requested
+  bool mOnDemand = false;
+  uint32_t mFramesRequested = 1;
+
+  // Model updates from other threads, applied at the start of each frame
+  Dispatcher *mDispatcher = nullptr;
+
+  // Shared by importers and other CPU side work, created on first use
+  std::unique_ptr<ThreadPool> mThreadPool;
+
+  // Readback
+  bool mReadbackEnabled = false;
+  // Swapchain images take transfer source usage
+  bool mReadbackSupported = false;
+  uint32_t mReadbackRingSize = 0;
+  vk::CommandPool mReadbackCommandPool;
+  std::vector<std::unique_ptr<ReadbackSlot>> mReadbackSlots;
+  uint32_t mReadbackNext = 0;
+  std::function<void(const ReadbackView &)> mReadbackCallback;
+  std::string mReadbackPath;
+  std::unique_ptr<ImageWriter> mImageWriter;
+  uint64_t mReadbackCompleted = 0;
+  uint64_t mReadbackDropped = 0;
 
   // Options
   glm::vec4 bgColor;
@@ -223,6 +553,14 @@ public:
 
   void createRenderPass();
 
+  // A defined colorInitialLayout loads the color attachment instead of
+  // clearing it. keepDepth stores depth, and with a loaded color also loads
+  // depth and ids, so a pass can draw on where the last one stopped.
+  vk::RenderPass
+  makeRenderPass(vk::Format colorFormat, vk::ImageLayout colorFinalLayout,
+                 vk::ImageLayout colorInitialLayout = vk::ImageLayout::eUndefined,
+                 bool keepDepth = false);
+
   void createDescriptorSetLayout();
 
   void createPipelineLayout();
@@ -245,6 +583,15 @@ public:
 
   void createDepthResources();
 
+  // Scene attachment values, the id is cleared to 0 when picking
+  std::vector<vk::ClearValue> sceneClearValues() const;
+
+  // color for the scene attachment, plus the id attachment when picking.
+  // Without writeId the pipeline leaves the ids beneath it.
+  std::vector<vk::PipelineColorBlendAttachmentState>
+  sceneBlendAttachments(const vk::PipelineColorBlendAttachmentState &color,
+                        bool writeId = true) const;
+
   void createBuffer(vk::DeviceSize &size, const vk::BufferUsageFlags &usage,
                     const vk::MemoryPropertyFlags &properties,
                     vk::Buffer &buffer, vk::DeviceMemory &bufferMemory);
@@ -280,6 +627,15 @@ public:
 
   vk::Pipeline getSketchPointPipeline();
 
+  // Procedural ground grid, no vertex input
+  void createSketchGridPipeline();
+
+  // One instance per segment and view, each expanded into a screen space
+  // quad with round caps
+  void createSketchLinePipeline();
+
+  void createSketchSplatPipelines();
+
   void preparePipelines();
 
   void copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer,
@@ -287,54 +643,290 @@ public:
 
   void deleteBuffer(uint32_t id);
 
+  // Hands out LOD slots and pick ids and marks every command buffer outdated
   void createCommandBuffers();
 
+  void recordCommandBuffer(uint32_t imageIndex);
+
+  // Destroys once the next frame submitted has finished, every frame and
+  // transfer already on the queue comes before it
+  void retire(std::function<void()> destroy);
+
+  void retireBuffer(Buffer &buffer);
+
+  // Destroys what the finished frames no longer use, everything when the
+  // device is idle
+  void releaseRetired(bool idle = false);
+
+  // Copies regions into buffer in place from staging memory, which fill
+  // writes in region order. The frames in flight finish reading it first.
+  void writeRegions(vk::Buffer buffer,
+                    const std::vector<vk::BufferCopy> &regions,
+                    vk::DeviceSize stagingSize,
+                    const std::function<void(void *)> &fill);
+
+  // Submits copies without waiting. Draws submitted later see the writes,
+  // the command buffer and whatever release frees are retired.
+  void submitTransfer(vk::CommandBuffer &commandBuffer,
+                      std::function<void()> release);
+
+  ubo cameraUniform(float aspect);
+
   void updateUniformBuffer(uint32_t currentImage);
 
+  void setViews(const std::vector<ViewData> &views);
+
+  uint32_t getViewCount();
+
+  std::vector<ViewData> quadViews(glm::vec3 center, float radius);
+
   void drawFrame();
 
-  template <class T>
-  inline void createDeviceBuffer(uint32_t id, std::vector<T> const &points,
-                                 vk::BufferUsageFlagBits const &flag) {
+  // Main loop step. Polls window events and draws, or on demand waits for
+  // events until a frame is needed. Returns whether a frame was drawn.
+  bool runFrame();
 
-    vk::Buffer stagingBuffer;
-    vk::DeviceMemory stagingBufferMemory;
+  void setOnDemand(bool onDemand);
+  bool isOnDemand() const;
 
-    mBuffers[id].mPointSize = static_cast<uint32_t>(points.size());
-    mBuffers[id].mDeviceSize = sizeof(points[0]) * points.size();
+  // Render thread only, anything that changes the picture calls it
+  void requestFrame(uint32_t frames = 1);
+  bool frameNeeded() const;
 
-    createBuffer(mBuffers[id].mDeviceSize,
-                 vk::BufferUsageFlagBits::eTransferSrc,
-                 vk::MemoryPropertyFlagBits::eHostVisible |
-                     vk::MemoryPropertyFlagBits::eHostCoherent,
-                 stagingBuffer, stagingBufferMemory);
+  void setDispatcher(Dispatcher *dispatcher);
+  void applyPendingUpdates();
 
-    vk::MemoryMapFlags memMapFlags;
+  ThreadPool &getThreadPool();
 
-    void *data;
-    data = mDevice.mapMemory(stagingBufferMemory, 0, mBuffers[id].mDeviceSize,
-                             memMapFlags);
-    memcpy(data, points.data(), (size_t)mBuffers[id].mDeviceSize);
-    mDevice.unmapMemory(stagingBufferMemory);
+  // Point clouds
 
-    createBuffer(mBuffers[id].mDeviceSize,
-                 vk::BufferUsageFlagBits::eTransferDst | flag,
-                 vk::MemoryPropertyFlagBits::eDeviceLocal, mBuffers[id].mBuffer,
-                 mBuffers[id].mMemory);
+  bool importPointCloud(uint32_t id, const std::string &path,
+                        size_t chunkPoints = 1 << 20);
 
-    copyBuffer(stagingBuffer, mBuffers[id].mBuffer, mBuffers[id].mDeviceSize);
+  // Uploads the chunks importers have ready, a few per frame
+  void pumpImports();
 
-    mDevice.destroyBuffer(stagingBuffer);
-    mDevice.freeMemory(stagingBufferMemory);
-  };
+  ImportStats getImportStats(uint32_t id) const;
 
-  template <class T>
-  inline void updateDeviceBuffer(uint32_t id, std::vector<T> const &points,
-                                 vk::BufferUsageFlagBits const &flag) {
+  void deletePointCloud(uint32_t id);
 
-    deleteBuffer(id);
-    createDeviceBuffer(id, points, flag);
-  }
+  Buffer createVertexBuffer(const void *vertices, uint32_t count,
+                            uint32_t capacity);
+
+  // Device local buffer of size bytes, the first dataSize filled from data
+  Buffer uploadBuffer(const void *data, vk::DeviceSize dataSize,
+                      vk::DeviceSize size, vk::BufferUsageFlags usage);
+
+  // Same, fill writes the first dataSize bytes into the mapped staging memory
+  Buffer uploadBuffer(vk::DeviceSize dataSize, vk::DeviceSize size,
+                      vk::BufferUsageFlags usage,
+                      const std::function<void(void *)> &fill);
+
+  // Segments
+
+  void createQuadIndices();
+
+  // Rebuilds the segment buffer and points the set at the current vertex
+  // buffer, called whenever either changes
+  void updateLineSet(uint32_t id, std::span<const Segment> segments);
+
+  // Writes the added and modified segment ranges in place, rebuilding only
+  // when the buffer is full
+  void updateSegments(uint32_t id, std::span<const Segment> segments,
+                      const ChangeSet &changes);
+
+  void deleteLineSet(uint32_t id);
+
+  void recordLines(vk::CommandBuffer &commandBuffer,
+                   vk::DescriptorSet descriptorSet, uint32_t viewCount,
+                   uint32_t firstView, vk::Extent2D extent);
+
+  // Draws every model buffer and point cloud chunk. With an image index the
+  // buffers the splat pass covers are left out and octree buffers draw their
+  // selected nodes, otherwise everything is drawn at full detail.
+  void recordGeometry(vk::CommandBuffer &commandBuffer, uint32_t instanceCount,
+                      uint32_t firstInstance, int imageIndex = -1);
+
+  // Splatting
+
+  bool shouldSplat(size_t pointCount) const;
+
+  void createSplatTargets();
+
+  void destroySplatTargets();
+
+  vk::DescriptorSet getSplatSource(Buffer &buffer);
+
+  // Clears the image's splat buffer and splats every large model into it,
+  // outside the render pass. Returns false when nothing was splatted.
+  bool recordSplats(vk::CommandBuffer &commandBuffer, uint32_t imageIndex,
+                    uint32_t viewCount);
+
+  void recordSplatResolve(vk::CommandBuffer &commandBuffer,
+                          uint32_t imageIndex);
+
+  // Picking
+
+  void createPickTarget();
+
+  void destroyPickTarget();
+
+  void createPickResources();
+
+  void destroyPickResources();
+
+  // Hands out id ranges to every buffer and line set, called before
+  // recording so the pushed bases match mPickRanges
+  void assignPickIds();
+
+  // Copies the ids around the cursor, submitted after the frame
+  void recordPick(PickSlot &slot);
+
+  void resolvePick(PickSlot &slot);
+
+  // Non-zero id closest to (x, y) in a width by height block, 0 if none
+  static uint32_t nearestPickId(const uint32_t *ids, uint32_t width,
+                                uint32_t height, uint32_t x, uint32_t y);
+
+  PickResult lookupPick(uint32_t pickId) const;
+
+  const PickResult &getPick() const;
+
+  // Level of detail
+
+  bool useLod(size_t pointCount) const;
+
+  // Builds the octree on the thread pool and returns the vertices in its
+  // order through ordered
+  std::shared_ptr<const PointOctree> buildOctree(const Vertex *vertices,
+                                                 size_t count,
+                                                 std::vector<Vertex> &ordered);
+
+  // Writes renderables as vertices into dst, in the octree's order when
+  // given, on the thread pool. Returns the bounds of its points.
+  void fillVertices(const RenderData &renderables, const PointOctree *octree,
+                    Vertex *dst, glm::vec3 &min, glm::vec3 &max);
+
+  // Gives every octree buffer its slots and grows the tables to fit
+  void assignLodSlots();
+
+  // Points binding 1 of the splat targets at the tables
+  void writeLodTables();
+
+  void destroyLodTables();
+
+  // Selects the nodes for the current cameras and writes them into the
+  // image's table
+  void updateLod(uint32_t imageIndex);
+
+  // Dynamic resolution
+
+  // targetMs is the GPU time the scene should take, the scale stays within
+  // minScale and maxScale of the extent. maxScale is at most 1.
+  void enableDynamicResolution(float targetMs, float minScale = 0.5f,
+                               float maxScale = 1.0f);
+
+  void disableDynamicResolution();
+
+  float getRenderScale() const;
+
+  // Scene time of the last measured frame in ms
+  float getGpuFrameTime() const;
+
+  // Size the scene is drawn at
+  vk::Extent2D sceneExtent() const;
+
+  void createSceneTarget();
+
+  void destroySceneTarget();
+
+  // Scales the drawn part of the scene target up into the swapchain image
+  void recordUpscale(vk::CommandBuffer &commandBuffer, uint32_t imageIndex,
+                     vk::Extent2D extent);
+
+  // Reads the scene time of the frame whose fence has just signaled and
+  // re-records the command buffers when the scale moves
+  void updateRenderScale();
+
+  // Time follows the pixel count, the square of the scale. Steps are coarse
+  // and times near the target keep the scale, so it rarely changes.
+  static float nextRenderScale(float scale, float gpuMs, float targetMs,
+                               float minScale, float maxScale);
+
+  // Progressive refinement
+
+  // budget is the points one frame draws, 0 for no limit. Replaces dynamic
+  // resolution, both draw through the scene target.
+  void enableProgressive(size_t budget = 1 << 22);
+
+  void disableProgressive();
+
+  bool isProgressive() const;
+
+  // The accumulated image shows the whole scene
+  bool isRefined() const;
+
+  // Changes with anything in the scene that changes the picture, besides the
+  // cameras
+  uint64_t sceneSignature() const;
+
+  // Records the frame for mCurrentFrame, restarting the accumulation when
+  // the cameras or the scene changed
+  vk::CommandBuffer recordProgressive(uint32_t imageIndex);
+
+  // Cuts draws of counts points, in the order given, into batches of at most
+  // budget points. Draws larger than what is left of a batch are split.
+  static std::vector<std::vector<ProgressiveRange>>
+  progressiveBatches(const std::vector<uint32_t> &counts, size_t budget);
+
+  // Readback
+
+  void enableReadback(uint32_t ringSize = 3);
+
+  void disableReadback();
+
+  void setReadbackCallback(std::function<void(const ReadbackView &)> callback);
+
+  void setReadbackOutput(const std::string &pathPattern);
+
+  void releaseReadback(uint32_t slot);
+
+  void createReadbackResources();
+
+  void destroyReadbackResources();
+
+  void createReadbackBuffer(ReadbackSlot &slot);
+
+  void destroyReadbackBuffer(ReadbackSlot &slot);
+
+  ReadbackSlot *acquireReadbackSlot();
+
+  void recordReadback(ReadbackSlot &slot, uint32_t imageIndex);
+
+  void collectReadbacks(size_t fence);
+
+  // Offscreen
+
+  OffscreenTarget createOffscreenTarget(uint32_t width, uint32_t height);
+
+  void destroyOffscreenTarget(OffscreenTarget &target);
+
+  ViewData fitView(const Buffer &buffer, float aspect);
+
+  ViewBatch createViewBatch(const ubo &camera, uint32_t viewCount);
+
+  void destroyViewBatch(ViewBatch &batch);
+
+  void recordOffscreenScene(vk::CommandBuffer &commandBuffer,
+                            const OffscreenTarget &target,
+                            vk::DescriptorSet descriptorSet,
+                            uint32_t viewIndex);
+
+  std::vector<ThumbnailAtlas>
+  renderThumbnails(const std::vector<uint32_t> &ids, uint32_t tileSize = 128);
+
+  bool exportTiled(const std::string &path, uint32_t width, uint32_t height,
+                   uint32_t tileSize = 1024);
 
   void destroyPipelines();
 
@@ -346,5 +938,11 @@ public:
   void destroy();
 
   void onNotify(int id, const RenderData &Renderables);
+
+  // Copies the mapped vertex block straight into staging memory
+  void uploadSnapshot(uint32_t id, const Snapshot &snapshot);
+
+  void onChange(int id, const RenderData &Renderables,
+                const ChangeSet &changes);
 };
 } // namespace TRUCHAS_APP_NAMESPACE
@@ -0,0 +1,73 @@
+#include "weld.hpp"
+#include "kdtree.hpp"
+#include "pch.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+size_t weldPoints(RenderData &data, float tolerance, ThreadPool *pool) {
+
+  size_t count = data.size();
+
+  if (count < 2)
+    return 0;
+
+  std::span<const glm::vec3> positions(data.points.data(), count);
+
+  PointKdTree tree;
+  tree.build(positions, pool);
+
+  const uint32_t unset = std::numeric_limits<uint32_t>::max();
+
+  // Kept points map to their new index, welded ones to their keeper's
+  std::vector<uint32_t> remap(count, unset);
+  std::vector<PointHit> hits;
+  uint32_t kept = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+
+    if (remap[i] != unset)
+      continue;
+
+    remap[i] = kept;
+
+    tree.within(positions, positions[i], tolerance, hits);
+
+    for (const PointHit &hit : hits)
+      if (remap[hit.index] == unset)
+        remap[hit.index] = kept;
+
+    // Keepers move down in order, so the slot is free or already read
+    if (kept != i) {
+      data.points[kept] = data.points[i];
+      data.colors[kept] = data.colors[i];
+      data.flags[kept] = data.flags[i];
+      data.ids[kept] = data.ids[i];
+    }
+
+    kept++;
+  }
+
+  if (kept == count)
+    return 0;
+
+  data.points.resize(kept);
+  data.colors.resize(kept);
+  data.flags.resize(kept);
+  data.ids.resize(kept);
+
+  std::set<std::pair<uint32_t, uint32_t>> seen;
+
+  std::erase_if(data.segments, [&](Segment &segment) {
+    segment.a = remap[segment.a];
+    segment.b = remap[segment.b];
+
+    if (segment.a == segment.b)
+      return true;
+
+    return !seen.insert(std::minmax(segment.a, segment.b)).second;
+  });
+
+  return count - kept;
+}
+
+} // namespace TRUCHAS_APP_NAMESPACE
@@ -0,0 +1,15 @@
+#pragma once
+#include "observer.hpp"
+
+namespace TRUCHAS_APP_NAMESPACE {
+
+class ThreadPool;
+
+// Merges points closer than tolerance into the first of them, zero merges
+// exact duplicates only. The streams are compacted in place and segments
+// are remapped, dropping the ones that collapsed to a point or repeat an
+// earlier one. Returns the number of points removed.
+size_t weldPoints(RenderData &data, float tolerance,
+                  ThreadPool *pool = nullptr);
+
+} // namespace TRUCHAS_APP_NAMESPACE
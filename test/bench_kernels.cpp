@@ -0,0 +1,99 @@
+#include "pch.hpp"
+#include "kernels.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// Throughput of every kernel level the CPU supports against the scalar one.
+// Not a test, run by hand: Bench_Truchas_Kernels [points]
+
+using TRUCHAS_APP_NAMESPACE::KernelLevel;
+using TRUCHAS_APP_NAMESPACE::KernelTable;
+
+namespace {
+
+const int REPEATS = 20;
+
+// Best of REPEATS, in GB/s of bytes read and written
+template <typename Body> double throughput(size_t bytes, const Body &body) {
+
+  double best = std::numeric_limits<double>::max();
+
+  for (int r = 0; r < REPEATS; r++) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+
+  return bytes / best * 1e-9;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+
+  size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1 << 22;
+
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+  std::vector<glm::vec3> points(count), colors(count), moved(count);
+  for (size_t i = 0; i < count; i++) {
+    points[i] = {unit(random), unit(random), unit(random)};
+    colors[i] = {unit(random), unit(random), unit(random)};
+  }
+
+  std::vector<float> packed(6 * count);
+
+  glm::mat4 m(1.0f);
+  m[3] = glm::vec4(1.0f, 2.0f, 3.0f, 1.0f);
+
+  size_t vec3Bytes = count * sizeof(glm::vec3);
+  double base[4] = {};
+
+  std::printf("%zu points\n%-8s %21s %21s %21s %21s\n", count, "level",
+              "bounds vec3", "bounds vertex", "transform", "pack");
+
+  for (KernelLevel level :
+       {KernelLevel::scalar, KernelLevel::sse41, KernelLevel::avx2}) {
+
+    if (level > TRUCHAS_APP_NAMESPACE::supportedKernelLevel())
+      break;
+
+    const KernelTable &table = TRUCHAS_APP_NAMESPACE::kernelTable(level);
+    glm::vec3 min, max;
+
+    double rates[4] = {
+        throughput(vec3Bytes,
+                   [&] {
+                     table.bounds(points.data(), count, sizeof(glm::vec3), min,
+                                  max);
+                   }),
+        throughput(2 * vec3Bytes,
+                   [&] {
+                     table.bounds(packed.data(), count, 6 * sizeof(float), min,
+                                  max);
+                   }),
+        throughput(2 * vec3Bytes,
+                   [&] {
+                     table.transform(m, points.data(), moved.data(), count);
+                   }),
+        throughput(4 * vec3Bytes, [&] {
+          table.pack(points.data(), colors.data(), packed.data(), count);
+        })};
+
+    std::printf("%-8s", table.name);
+
+    for (int k = 0; k < 4; k++) {
+      if (level == KernelLevel::scalar)
+        base[k] = rates[k];
+      std::printf(" %9.2f GB/s %5.2fx", rates[k], rates[k] / base[k]);
+    }
+
+    std::printf("\n");
+  }
+
+  return 0;
+}
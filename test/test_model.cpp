@@ -0,0 +1,1415 @@
+#include "pch.hpp"
+#include "arena.hpp"
+#include "checksum.hpp"
+#include "depgraph.hpp"
+#include "dispatcher.hpp"
+#include "importer.hpp"
+#include "kdtree.hpp"
+#include "kernels.hpp"
+#include "log.hpp"
+#include "octree.hpp"
+#include "readback.hpp"
+#include "snapshot.hpp"
+#include "tessellation.hpp"
+#include "sketch.hpp"
+#include "thread_pool.hpp"
+#include "weld.hpp"
+#include <gtest/gtest.h>
+#include <random>
+#include <stb_image.h>
+
+class RecordingObserver : public TRUCHAS_APP_NAMESPACE::Observer {
+
+public:
+  void onNotify(int id, const TRUCHAS_APP_NAMESPACE::RenderData &renderables) {
+    snapshots++;
+    size = renderables.points.size();
+  }
+
+  void onChange(int id, const TRUCHAS_APP_NAMESPACE::RenderData &renderables,
+                const TRUCHAS_APP_NAMESPACE::ChangeSet &changes) {
+    deltas++;
+    size = renderables.points.size();
+    last = changes;
+  }
+
+  int snapshots = 0;
+  int deltas = 0;
+  size_t size = 0;
+  TRUCHAS_APP_NAMESPACE::ChangeSet last;
+};
+
+TEST(model, addPointReportsAddedRange) {
+
+  Model model(1);
+  RecordingObserver observer;
+  model.addRender(&observer);
+
+  model.addPoint({0.0f, 0.0f, 0.0f});
+  model.addPoint({1.0f, 0.0f, 0.0f});
+  model.addPoint({2.0f, 0.0f, 0.0f});
+  model.notify();
+
+  EXPECT_EQ(observer.deltas, 1);
+  EXPECT_EQ(observer.size, 3);
+  ASSERT_EQ(observer.last.added.size(), 1);
+  EXPECT_EQ(observer.last.added[0].first, 0);
+  EXPECT_EQ(observer.last.added[0].count, 3);
+  EXPECT_EQ(observer.last.base, 0);
+  EXPECT_EQ(observer.last.generation, 1);
+}
+
+TEST(model, setPointReportsOnlyModifiedIndex) {
+
+  Model model(1);
+  RecordingObserver observer;
+  model.addRender(&observer);
+
+  for (int i = 0; i < 100; i++)
+    model.addPoint({float(i), 0.0f, 0.0f});
+  model.notify();
+
+  model.setPoint(42, {0.0f, 1.0f, 0.0f});
+  model.notify();
+
+  EXPECT_EQ(observer.deltas, 2);
+  EXPECT_TRUE(observer.last.added.empty());
+  ASSERT_EQ(observer.last.modified.size(), 1);
+  EXPECT_EQ(observer.last.modified[0].first, 42);
+  EXPECT_EQ(observer.last.modified[0].count, 1);
+  EXPECT_EQ(observer.last.base, 1);
+  EXPECT_EQ(observer.last.generation, 2);
+}
+
+TEST(model, removePointSwapsWithLast) {
+
+  Model model(1);
+  RecordingObserver observer;
+  model.addRender(&observer);
+
+  for (int i = 0; i < 5; i++)
+    model.addPoint({float(i), 0.0f, 0.0f});
+  model.notify();
+
+  model.removePoint(1);
+  model.notify();
+
+  EXPECT_EQ(observer.size, 4);
+  EXPECT_EQ(model.getRenderData().points[1].x, 4.0f);
+  ASSERT_EQ(observer.last.modified.size(), 1);
+  EXPECT_EQ(observer.last.modified[0].first, 1);
+  ASSERT_EQ(observer.last.removed.size(), 1);
+  EXPECT_EQ(observer.last.removed[0].first, 4);
+}
+
+TEST(model, notifyWithoutChangesIsSkipped) {
+
+  Model model(1);
+  RecordingObserver observer;
+  model.addRender(&observer);
+
+  model.notify();
+  EXPECT_EQ(observer.deltas, 0);
+
+  model.sync(&observer);
+  EXPECT_EQ(observer.snapshots, 1);
+}
+
+TEST(model, clearRenderRequestsFullResync) {
+
+  Model model(1);
+  RecordingObserver observer;
+  model.addRender(&observer);
+
+  model.addPoint({0.0f, 0.0f, 0.0f});
+  model.notify();
+
+  model.clearRender();
+  model.notify();
+
+  EXPECT_TRUE(observer.last.full);
+  EXPECT_EQ(observer.size, 0);
+}
+
+TEST(dispatcher, coalescesNotificationsPerModel) {
+
+  TRUCHAS_APP_NAMESPACE::Dispatcher dispatcher;
+
+  Model model(1);
+  model.setDispatcher(&dispatcher);
+
+  RecordingObserver observer;
+  model.addRender(&observer);
+
+  for (int i = 0; i < 100; i++) {
+    model.addPoint({float(i), 0.0f, 0.0f});
+    model.notify();
+  }
+
+  EXPECT_EQ(observer.deltas, 0);
+  EXPECT_TRUE(dispatcher.pending());
+
+  EXPECT_EQ(dispatcher.drain(), 1);
+  EXPECT_EQ(observer.deltas, 1);
+  EXPECT_EQ(observer.size, 100);
+  EXPECT_EQ(dispatcher.received(), 100);
+  EXPECT_EQ(dispatcher.applied(), 1);
+  EXPECT_FALSE(dispatcher.pending());
+}
+
+TEST(dispatcher, skipsModelsDestroyedWhileQueued) {
+
+  TRUCHAS_APP_NAMESPACE::Dispatcher dispatcher;
+  RecordingObserver observer;
+
+  auto doomed = std::make_unique<Model>(1);
+  doomed->setDispatcher(&dispatcher);
+  doomed->addRender(&observer);
+
+  Model kept(2);
+  kept.setDispatcher(&dispatcher);
+  kept.addRender(&observer);
+
+  doomed->addPoint({0.0f, 0.0f, 0.0f});
+  doomed->notify();
+  kept.addPoint({1.0f, 0.0f, 0.0f});
+  kept.notify();
+
+  doomed.reset();
+
+  EXPECT_TRUE(dispatcher.pending());
+  EXPECT_EQ(dispatcher.drain(), 1);
+  EXPECT_EQ(observer.deltas, 1);
+  EXPECT_EQ(dispatcher.applied(), 1);
+  EXPECT_FALSE(dispatcher.pending());
+
+  // The survivor queues again as usual
+  kept.addPoint({2.0f, 0.0f, 0.0f});
+  kept.notify();
+  EXPECT_EQ(dispatcher.drain(), 1);
+  EXPECT_EQ(observer.deltas, 2);
+}
+
+TEST(dispatcher, wakesOncePerQueuedModel) {
+
+  TRUCHAS_APP_NAMESPACE::Dispatcher dispatcher;
+
+  std::atomic<int> wakes = 0;
+  dispatcher.setWake([&] { wakes++; });
+
+  Model model(1);
+  model.setDispatcher(&dispatcher);
+
+  for (int i = 0; i < 10; i++) {
+    model.addPoint({float(i), 0.0f, 0.0f});
+    model.notify();
+  }
+
+  EXPECT_EQ(wakes, 1);
+
+  dispatcher.drain();
+  model.addPoint({0.0f, 1.0f, 0.0f});
+  model.notify();
+
+  EXPECT_EQ(wakes, 2);
+}
+
+TEST(dispatcher, acceptsProducerThreads) {
+
+  TRUCHAS_APP_NAMESPACE::Dispatcher dispatcher;
+
+  std::vector<std::unique_ptr<Model>> models;
+  std::vector<RecordingObserver> observers(4);
+
+  for (int i = 0; i < 4; i++) {
+    models.push_back(std::make_unique<Model>(i));
+    models[i]->setDispatcher(&dispatcher);
+    models[i]->addRender(&observers[i]);
+  }
+
+  std::vector<std::thread> producers;
+  for (int i = 0; i < 4; i++) {
+    producers.emplace_back([&, i] {
+      for (int j = 0; j < 1000; j++) {
+        models[i]->addPoint({float(j), 0.0f, 0.0f});
+        models[i]->notify();
+      }
+    });
+  }
+
+  for (auto &producer : producers)
+    producer.join();
+
+  dispatcher.drain();
+
+  EXPECT_EQ(dispatcher.received(), 4000);
+  for (int i = 0; i < 4; i++)
+    EXPECT_EQ(observers[i].size, 1000);
+}
+
+TEST(subject, removeRenderStopsNotifications) {
+
+  Model model(1);
+  RecordingObserver first;
+  RecordingObserver second;
+  model.addRender(&first);
+  model.addRender(&second);
+
+  model.removeRender(&first);
+  model.removeRender(&first);
+  EXPECT_EQ(model.getObservers()->size(), 1);
+
+  model.addPoint({0.0f, 0.0f, 0.0f});
+  model.notify();
+
+  EXPECT_EQ(first.deltas, 0);
+  EXPECT_EQ(second.deltas, 1);
+}
+
+TEST(subject, observersChangeWhileNotifying) {
+
+  TRUCHAS_APP_NAMESPACE::ThreadPool pool(4);
+
+  Model model(1);
+  model.setThreadPool(&pool);
+
+  std::vector<RecordingObserver> fixed(16);
+  for (auto &observer : fixed)
+    model.addRender(&observer);
+
+  std::atomic<bool> stop{false};
+  std::thread churn([&] {
+    std::vector<RecordingObserver> transient(8);
+    while (!stop) {
+      for (auto &observer : transient)
+        model.addRender(&observer);
+      for (auto &observer : transient)
+        model.removeRender(&observer);
+    }
+  });
+
+  for (int i = 0; i < 200; i++) {
+    model.addPoint({float(i), 0.0f, 0.0f});
+    model.notify();
+  }
+
+  stop = true;
+  churn.join();
+
+  EXPECT_EQ(model.getObservers()->size(), 16);
+  for (auto &observer : fixed) {
+    EXPECT_EQ(observer.deltas, 200);
+    EXPECT_EQ(observer.size, 200);
+  }
+}
+
+TEST(threadPool, parallelForCoversRange) {
+
+  TRUCHAS_APP_NAMESPACE::ThreadPool pool(3);
+
+  std::vector<int> hits(10007, 0);
+  pool.parallelFor(
+      hits.size(),
+      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+          hits[i]++;
+      },
+      64);
+
+  EXPECT_EQ(std::count(hits.begin(), hits.end(), 1), int(hits.size()));
+
+  EXPECT_THROW(pool.parallelFor(100,
+                                [](size_t begin, size_t end) {
+                                  throw std::runtime_error("kernel failed");
+                                }),
+               std::runtime_error);
+}
+
+class CountingResource : public std::pmr::memory_resource {
+
+public:
+  int allocations = 0;
+
+private:
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    allocations++;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+TEST(arena, rebuildReusesStreams) {
+
+  CountingResource upstream;
+  TRUCHAS_APP_NAMESPACE::Arena arena(1 << 16, &upstream);
+  TRUCHAS_APP_NAMESPACE::RenderData data(&arena);
+
+  auto build = [&] {
+    for (uint32_t i = 0; i < 100000; i++)
+      data.append({float(i), 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, 0, i);
+  };
+
+  build();
+  int allocations = upstream.allocations;
+  EXPECT_GT(allocations, 0);
+
+  data.clear();
+  build();
+
+  EXPECT_EQ(upstream.allocations, allocations);
+  EXPECT_EQ(data.size(), 100000);
+  EXPECT_EQ(data.ids.back(), 99999);
+}
+
+TEST(arena, reusesFreedRanges) {
+
+  TRUCHAS_APP_NAMESPACE::Arena arena(4096);
+
+  void *first = arena.allocate(256, 16);
+  void *second = arena.allocate(256, 16);
+  arena.deallocate(first, 256, 16);
+
+  EXPECT_EQ(arena.allocate(128, 16), first);
+  EXPECT_EQ(arena.reserved(), 4096);
+
+  arena.deallocate(second, 256, 16);
+  arena.reset();
+  EXPECT_EQ(arena.used(), 0);
+}
+
+TEST(arena, growAndShrinkStaysBounded) {
+
+  TRUCHAS_APP_NAMESPACE::Arena arena(1 << 16);
+  size_t reserved = 0;
+
+  // A stream grows into a large range, then gives way to many small ones.
+  // The small requests split the freed range and their frees merge back
+  // into it, so every cycle fits in what the first one reserved.
+  for (int cycle = 0; cycle < 100; cycle++) {
+
+    void *stream = arena.allocate(32768, 16);
+    void *pin = arena.allocate(64, 16);
+    arena.deallocate(stream, 32768, 16);
+
+    std::vector<void *> small;
+    for (int i = 0; i < 256; i++)
+      small.push_back(arena.allocate(64, 16));
+
+    for (void *p : small)
+      arena.deallocate(p, 64, 16);
+    arena.deallocate(pin, 64, 16);
+
+    EXPECT_EQ(arena.used(), 0);
+
+    if (cycle == 0)
+      reserved = arena.reserved();
+  }
+
+  EXPECT_EQ(arena.reserved(), reserved);
+}
+
+TEST(model, removeKeepsStreamsInStep) {
+
+  Model model(1);
+  model.addPoint({0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f});
+  model.addPoint({1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f});
+  model.addPoint({2.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f});
+
+  model.removePoint(0);
+
+  const auto &data = model.getRenderData();
+  EXPECT_EQ(data.size(), 2);
+  EXPECT_EQ(data.colors.size(), 2);
+  EXPECT_EQ(data.points[0].x, 2.0f);
+  EXPECT_EQ(data.colors[0].z, 1.0f);
+  EXPECT_EQ(data.ids[0], 2);
+
+  EXPECT_THROW(model.removePoint(2), std::out_of_range);
+  EXPECT_THROW(model.setPoint(2, {0.0f, 0.0f, 0.0f}), std::out_of_range);
+  EXPECT_EQ(data.size(), 2);
+
+  Model empty(2);
+  EXPECT_THROW(empty.removePoint(0), std::out_of_range);
+}
+
+TEST(model, removeRemapsSegments) {
+
+  Model model;
+  for (int i = 0; i < 4; i++)
+    model.addPoint({float(i), 0.0f, 0.0f});
+
+  model.addSegment(0, 1);
+  model.addSegment(1, 3);
+  model.addSegment(2, 3);
+
+  // Point 3 moves into slot 1, the segments on point 1 go with it
+  model.removePoint(1);
+
+  const auto &segments = model.getRenderData().segments;
+  ASSERT_EQ(segments.size(), 1);
+  EXPECT_EQ(segments[0].a, 2);
+  EXPECT_EQ(segments[0].b, 1);
+
+  EXPECT_THROW(model.addSegment(0, 3), std::out_of_range);
+}
+
+TEST(model, segmentEditsReportRanges) {
+
+  Model model(1);
+  RecordingObserver observer;
+  model.addRender(&observer);
+
+  for (int i = 0; i < 6; i++)
+    model.addPoint({float(i), 0.0f, 0.0f});
+
+  model.addSegment(0, 1);
+  model.addSegment(1, 2);
+  model.addSegment(2, 3);
+  model.addSegment(4, 5);
+  model.notify();
+
+  ASSERT_EQ(observer.last.addedSegments.size(), 1);
+  EXPECT_EQ(observer.last.addedSegments[0].first, 0);
+  EXPECT_EQ(observer.last.addedSegments[0].count, 4);
+
+  // Both segments on point 1 go, the last two move into their slots and
+  // point 5 moves into slot 1
+  model.removePoint(1);
+  model.notify();
+
+  EXPECT_EQ(observer.deltas, 2);
+  EXPECT_TRUE(observer.last.addedSegments.empty());
+  ASSERT_EQ(observer.last.modifiedSegments.size(), 1);
+  EXPECT_EQ(observer.last.modifiedSegments[0].first, 0);
+  EXPECT_EQ(observer.last.modifiedSegments[0].count, 2);
+  ASSERT_EQ(observer.last.removedSegments.size(), 1);
+  EXPECT_EQ(observer.last.removedSegments[0].first, 2);
+  EXPECT_EQ(observer.last.removedSegments[0].count, 2);
+
+  const auto &segments = model.getRenderData().segments;
+  ASSERT_EQ(segments.size(), 2);
+  EXPECT_EQ(segments[0].a, 2);
+  EXPECT_EQ(segments[0].b, 3);
+  EXPECT_EQ(segments[1].a, 4);
+  EXPECT_EQ(segments[1].b, 1);
+
+  // Swapping a free point into a free slot touches no segment
+  model.addPoint({9.0f, 0.0f, 0.0f});
+  model.removePoint(0);
+  model.notify();
+
+  EXPECT_FALSE(observer.last.segmentsChanged());
+}
+
+TEST(logger, formatsOnDrainThread) {
+
+  TRUCHAS_APP_NAMESPACE::Logger logger;
+
+  std::vector<std::string> messages;
+  std::thread::id sinkThread;
+  logger.setSink([&](TRUCHAS_APP_NAMESPACE::LogLevel level,
+                     std::string_view message) {
+    messages.emplace_back(message);
+    sinkThread = std::this_thread::get_id();
+  });
+
+  std::string name = "sketch";
+  logger.write(TRUCHAS_APP_NAMESPACE::LogLevel::info, "{} has {} points",
+               name, 42);
+  logger.write(TRUCHAS_APP_NAMESPACE::LogLevel::warn, "{:.1f}", 1.5f);
+  logger.flush();
+
+  ASSERT_EQ(messages.size(), 2);
+  EXPECT_EQ(messages[0], "sketch has 42 points");
+  EXPECT_EQ(messages[1], "1.5");
+  EXPECT_NE(sinkThread, std::this_thread::get_id());
+}
+
+TEST(logger, copiesBorrowedStrings) {
+
+  TRUCHAS_APP_NAMESPACE::Logger logger;
+
+  std::vector<std::string> messages;
+  std::mutex gate;
+
+  logger.setSink([&](TRUCHAS_APP_NAMESPACE::LogLevel, std::string_view message) {
+    std::lock_guard<std::mutex> wait(gate);
+    messages.emplace_back(message);
+  });
+
+  // The drain thread sits in the sink while the caller's strings change
+  gate.lock();
+  logger.write(TRUCHAS_APP_NAMESPACE::LogLevel::info, "first");
+
+  {
+    char buffer[] = "points";
+    std::string owner = "sketch";
+    std::string_view view = owner;
+    const char *pointer = buffer;
+
+    logger.write(TRUCHAS_APP_NAMESPACE::LogLevel::info, "{} {}", view,
+                 pointer);
+    logger.write(TRUCHAS_APP_NAMESPACE::LogLevel::info, "{}",
+                 static_cast<char *>(buffer));
+
+    buffer[0] = 'X';
+    owner.assign(owner.size(), 'X');
+  }
+
+  gate.unlock();
+  logger.flush();
+
+  ASSERT_EQ(messages.size(), 3);
+  EXPECT_EQ(messages[1], "sketch points");
+  EXPECT_EQ(messages[2], "points");
+}
+
+TEST(logger, dropsInsteadOfBlocking) {
+
+  TRUCHAS_APP_NAMESPACE::Logger logger;
+
+  std::atomic<int> received{0};
+  std::mutex gate;
+
+  logger.setSink([&](TRUCHAS_APP_NAMESPACE::LogLevel, std::string_view) {
+    std::lock_guard<std::mutex> wait(gate);
+    received++;
+  });
+
+  gate.lock();
+
+  std::vector<std::thread> producers;
+  for (int t = 0; t < 4; t++)
+    producers.emplace_back([&] {
+      for (int i = 0; i < 5000; i++)
+        logger.write(TRUCHAS_APP_NAMESPACE::LogLevel::debug, "{}", i);
+    });
+
+  for (auto &producer : producers)
+    producer.join();
+
+  gate.unlock();
+  logger.flush();
+
+  EXPECT_GT(logger.dropped(), 0);
+  EXPECT_EQ(received + logger.dropped(), 20000);
+}
+
+TEST(snapshot, roundTripsRenderData) {
+
+  std::string path = ::testing::TempDir() + "truchas_snapshot.bin";
+
+  TRUCHAS_APP_NAMESPACE::RenderData data;
+  for (uint32_t i = 0; i < 5000; i++)
+    data.append({float(i), -float(i), 0.5f}, {0.0f, 1.0f, 0.0f}, i & 1,
+                i + 7);
+  data.segments.push_back({3, 4, 0xFF0000FF, 0});
+  data.generation = 12;
+
+  ASSERT_TRUE(TRUCHAS_APP_NAMESPACE::SnapshotWriter::write(path, data));
+
+  TRUCHAS_APP_NAMESPACE::Snapshot snapshot;
+  ASSERT_TRUE(snapshot.open(path));
+  EXPECT_TRUE(snapshot.verify());
+
+  EXPECT_EQ(snapshot.size(), 5000);
+  EXPECT_EQ(snapshot.header().generation, 12);
+  EXPECT_EQ(snapshot.header().boundsMax[0], 4999.0f);
+  EXPECT_EQ(snapshot.header().boundsMin[1], -4999.0f);
+
+  auto vertices = snapshot.vertices();
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(vertices.data()) %
+                TRUCHAS_APP_NAMESPACE::SNAPSHOT_ALIGNMENT,
+            0);
+  EXPECT_EQ(vertices[42].pos.x, 42.0f);
+  EXPECT_EQ(vertices[42].col.y, 1.0f);
+  EXPECT_EQ(snapshot.ids()[42], 49);
+
+  Model model(3);
+  model.load(snapshot);
+  EXPECT_EQ(model.getRenderData().size(), 5000);
+  EXPECT_EQ(model.getRenderData().flags[41], 1);
+  ASSERT_EQ(model.getRenderData().segments.size(), 1);
+  EXPECT_EQ(model.getRenderData().segments[0].color, 0xFF0000FF);
+
+  std::remove(path.c_str());
+}
+
+TEST(snapshot, rejectsCorruption) {
+
+  std::string path = ::testing::TempDir() + "truchas_corrupt.bin";
+
+  Model model(1);
+  model.addPoint({1.0f, 2.0f, 3.0f});
+  ASSERT_TRUE(model.save(path));
+
+  // Flip a byte inside the vertex block
+  {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(TRUCHAS_APP_NAMESPACE::SNAPSHOT_ALIGNMENT + 2);
+    file.put(0x5A);
+  }
+
+  TRUCHAS_APP_NAMESPACE::Snapshot snapshot;
+  ASSERT_TRUE(snapshot.open(path));
+  EXPECT_FALSE(snapshot.verify());
+
+  // And one inside the header
+  {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(20);
+    file.put(0x5A);
+  }
+
+  snapshot.close();
+  EXPECT_FALSE(snapshot.open(path));
+
+  std::remove(path.c_str());
+}
+
+TEST(snapshot, rejectsWrongElementSize) {
+
+  using namespace TRUCHAS_APP_NAMESPACE;
+
+  std::string path = ::testing::TempDir() + "truchas_element.bin";
+
+  RenderData data;
+  data.append({1.0f, 2.0f, 3.0f}, {1.0f, 1.0f, 1.0f}, 0, 0);
+  ASSERT_TRUE(SnapshotWriter::write(path, data));
+
+  // Vertices claiming 4 byte elements, with valid checksums
+  {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+
+    SnapshotHeader header;
+    std::array<SnapshotBlock, 4> blocks;
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    file.read(reinterpret_cast<char *>(blocks.data()), sizeof(blocks));
+
+    blocks[0].elementSize = 4;
+    header.pointCount = 6;
+    header.tableChecksum = crc32(
+        0, reinterpret_cast<const uint8_t *>(blocks.data()), sizeof(blocks));
+    header.headerChecksum = 0;
+    header.headerChecksum =
+        crc32(0, reinterpret_cast<const uint8_t *>(&header), sizeof(header));
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(blocks.data()), sizeof(blocks));
+  }
+
+  Snapshot snapshot;
+  EXPECT_FALSE(snapshot.open(path));
+
+  std::remove(path.c_str());
+}
+
+TEST(png, streamsRowsWiderThanABlock) {
+
+  using namespace TRUCHAS_APP_NAMESPACE;
+
+  std::string path = ::testing::TempDir() + "truchas_stream.png";
+
+  // Each row is larger than one stored block, so rows straddle blocks
+  const uint32_t width = 30000;
+  const uint32_t height = 5;
+
+  std::vector<uint8_t> rgb(size_t(width) * height * 3);
+  for (size_t i = 0; i < rgb.size(); i++)
+    rgb[i] = static_cast<uint8_t>((i * 7 + i / 251) & 0xFF);
+
+  PngStreamWriter writer;
+  ASSERT_TRUE(writer.open(path, width, height));
+  EXPECT_TRUE(writer.writeRows(rgb.data(), 2));
+  EXPECT_TRUE(
+      writer.writeRows(rgb.data() + size_t(width) * 2 * 3, height - 2));
+  EXPECT_EQ(writer.rowsWritten(), height);
+  ASSERT_TRUE(writer.close());
+
+  std::ifstream file(path, std::ios::binary);
+  std::vector<uint8_t> encoded((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+
+  int x = 0, y = 0, channels = 0;
+  uint8_t *pixels = stbi_load_from_memory(
+      encoded.data(), static_cast<int>(encoded.size()), &x, &y, &channels, 3);
+  ASSERT_NE(pixels, nullptr) << stbi_failure_reason();
+
+  EXPECT_EQ(x, int(width));
+  EXPECT_EQ(y, int(height));
+  EXPECT_EQ(channels, 3);
+  EXPECT_TRUE(std::equal(rgb.begin(), rgb.end(), pixels));
+
+  stbi_image_free(pixels);
+  std::remove(path.c_str());
+}
+
+TEST(png, reportsFailedWrites) {
+
+  using namespace TRUCHAS_APP_NAMESPACE;
+
+  // Opens fine, every write fails with no space left
+  if (!std::filesystem::exists("/dev/full"))
+    GTEST_SKIP();
+
+  const uint32_t width = 4096;
+  const uint32_t height = 64;
+  std::vector<uint8_t> rgb(size_t(width) * height * 3, 0x80);
+
+  PngStreamWriter writer;
+  ASSERT_TRUE(writer.open("/dev/full", width, height));
+  EXPECT_FALSE(writer.writeRows(rgb.data(), height));
+  EXPECT_FALSE(writer.close());
+}
+
+TEST(snapshot, saveKeepsMappedReaders) {
+
+  std::string path = ::testing::TempDir() + "truchas_replaced.bin";
+
+  TRUCHAS_APP_NAMESPACE::RenderData data;
+  data.append({1.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, 0, 0);
+  ASSERT_TRUE(TRUCHAS_APP_NAMESPACE::SnapshotWriter::write(path, data));
+
+  TRUCHAS_APP_NAMESPACE::Snapshot snapshot;
+  ASSERT_TRUE(snapshot.open(path));
+
+  // Replaced, not rewritten in place, the mapping still sees the old file
+  data.points[0].x = 2.0f;
+  data.append({3.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, 0, 1);
+  ASSERT_TRUE(TRUCHAS_APP_NAMESPACE::SnapshotWriter::write(path, data));
+
+  EXPECT_EQ(snapshot.size(), 1);
+  EXPECT_EQ(snapshot.vertices()[0].pos.x, 1.0f);
+  EXPECT_TRUE(snapshot.verify());
+
+  TRUCHAS_APP_NAMESPACE::Snapshot replaced;
+  ASSERT_TRUE(replaced.open(path));
+  EXPECT_EQ(replaced.size(), 2);
+  EXPECT_EQ(replaced.vertices()[0].pos.x, 2.0f);
+  EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+
+  snapshot.close();
+  replaced.close();
+  std::remove(path.c_str());
+}
+
+namespace {
+
+std::vector<TRUCHAS_APP_NAMESPACE::SnapshotVertex>
+importAll(TRUCHAS_APP_NAMESPACE::PointCloudImporter &importer) {
+
+  std::vector<TRUCHAS_APP_NAMESPACE::SnapshotVertex> vertices;
+  TRUCHAS_APP_NAMESPACE::PointCloudImporter::Chunk chunk;
+
+  while (!importer.done()) {
+    if (!importer.poll(chunk)) {
+      std::this_thread::yield();
+      continue;
+    }
+    vertices.insert(vertices.end(), chunk.vertices.begin(),
+                    chunk.vertices.end());
+    importer.recycle(std::move(chunk));
+  }
+
+  return vertices;
+}
+
+} // namespace
+
+TEST(importer, streamsXyzInChunks) {
+
+  std::string path = ::testing::TempDir() + "truchas_cloud.xyz";
+  {
+    std::ofstream file(path);
+    file << "# scan\n";
+    for (int i = 0; i < 10000; i++)
+      file << i << " " << -i << ", 0.5 255 0 0\n";
+    file << "1 2 3";
+  }
+
+  TRUCHAS_APP_NAMESPACE::ThreadPool pool(3);
+  TRUCHAS_APP_NAMESPACE::PointCloudImporter importer(&pool, 1000, 2);
+  ASSERT_TRUE(importer.start(path));
+
+  auto vertices = importAll(importer);
+
+  EXPECT_FALSE(importer.failed());
+  ASSERT_EQ(vertices.size(), 10001);
+  EXPECT_EQ(vertices[1234].pos.x, 1234.0f);
+  EXPECT_EQ(vertices[1234].pos.y, -1234.0f);
+  EXPECT_EQ(vertices[1234].col.x, 1.0f);
+  EXPECT_EQ(vertices[1234].col.y, 0.0f);
+  EXPECT_EQ(vertices.back().pos.z, 3.0f);
+  EXPECT_EQ(vertices.back().col.y, 1.0f);
+
+  auto stats = importer.stats();
+  EXPECT_EQ(stats.points, 10001);
+  EXPECT_EQ(stats.bytes, stats.totalBytes);
+
+  std::remove(path.c_str());
+}
+
+TEST(importer, readsAsciiPly) {
+
+  std::string path = ::testing::TempDir() + "truchas_ascii.ply";
+  {
+    std::ofstream file(path);
+    file << "ply\nformat ascii 1.0\nelement vertex 3\n"
+            "property float x\nproperty float y\nproperty float z\n"
+            "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+            "element face 1\nproperty list uchar int vertex_indices\n"
+            "end_header\n"
+            "0 0 0 255 0 0\n1 0 0 0 255 0\n0 1 0 0 0 255\n3 0 1 2\n";
+  }
+
+  TRUCHAS_APP_NAMESPACE::PointCloudImporter importer;
+  ASSERT_TRUE(importer.start(path));
+
+  auto vertices = importAll(importer);
+
+  ASSERT_EQ(vertices.size(), 3);
+  EXPECT_EQ(vertices[1].pos.x, 1.0f);
+  EXPECT_EQ(vertices[2].col.z, 1.0f);
+
+  std::remove(path.c_str());
+}
+
+TEST(importer, readsBinaryPly) {
+
+  std::string path = ::testing::TempDir() + "truchas_binary.ply";
+  const int count = 5000;
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "ply\nformat binary_big_endian 1.0\ncomment test\n"
+         << "element vertex " << count << "\n"
+         << "property double x\nproperty float y\nproperty float z\n"
+            "property float intensity\n"
+            "end_header\n";
+
+    auto put = [&](auto value) {
+      char bytes[sizeof(value)];
+      memcpy(bytes, &value, sizeof(value));
+      std::reverse(bytes, bytes + sizeof(value));
+      file.write(bytes, sizeof(value));
+    };
+
+    for (int i = 0; i < count; i++) {
+      put(double(i));
+      put(float(2 * i));
+      put(float(-i));
+      put(0.0f);
+    }
+  }
+
+  TRUCHAS_APP_NAMESPACE::ThreadPool pool(2);
+  TRUCHAS_APP_NAMESPACE::PointCloudImporter importer(&pool, 700, 1);
+  ASSERT_TRUE(importer.start(path));
+
+  auto vertices = importAll(importer);
+
+  ASSERT_EQ(vertices.size(), count);
+  EXPECT_EQ(vertices[4321].pos.x, 4321.0f);
+  EXPECT_EQ(vertices[4321].pos.y, 8642.0f);
+  EXPECT_EQ(vertices[4321].pos.z, -4321.0f);
+  EXPECT_EQ(vertices[4321].col.x, 1.0f);
+
+  std::remove(path.c_str());
+}
+
+std::vector<glm::vec3> randomPoints(size_t count) {
+
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  std::vector<glm::vec3> points(count);
+  for (auto &p : points)
+    p = {unit(random), unit(random), unit(random)};
+
+  return points;
+}
+
+TEST(octree, leavesHoldEveryPointOnce) {
+
+  auto points = randomPoints(200000);
+
+  TRUCHAS_APP_NAMESPACE::ThreadPool pool(3);
+  TRUCHAS_APP_NAMESPACE::PointOctree octree;
+  octree.build(points.data(), points.size(), sizeof(glm::vec3), &pool);
+
+  const auto &nodes = octree.nodes();
+  const auto &order = octree.order();
+
+  ASSERT_GT(nodes.size(), 1);
+
+  std::vector<int> seen(points.size(), 0);
+  uint32_t next = 0;
+
+  for (const auto &node : nodes) {
+
+    // Node-contiguous, breadth first
+    EXPECT_EQ(node.first, next);
+    next += node.count;
+
+    if (node.childCount > 0) {
+      EXPECT_EQ(node.count, octree.NODE_POINTS);
+      continue;
+    }
+
+    EXPECT_LE(node.count, octree.MAX_LEAF_POINTS);
+
+    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+      const glm::vec3 &p = points[order[i]];
+      EXPECT_TRUE(p.x >= node.min.x && p.x <= node.max.x);
+      EXPECT_TRUE(p.y >= node.min.y && p.y <= node.max.y);
+      EXPECT_TRUE(p.z >= node.min.z && p.z <= node.max.z);
+      seen[order[i]]++;
+    }
+  }
+
+  EXPECT_EQ(next, octree.size());
+  EXPECT_EQ(std::count(seen.begin(), seen.end(), 1), int(points.size()));
+
+  // The pool only changes how fast it is built
+  TRUCHAS_APP_NAMESPACE::PointOctree serial;
+  serial.build(points.data(), points.size(), sizeof(glm::vec3));
+  EXPECT_EQ(serial.order(), order);
+}
+
+TEST(octree, selectionRespectsBudget) {
+
+  auto points = randomPoints(200000);
+
+  TRUCHAS_APP_NAMESPACE::PointOctree octree;
+  octree.build(points.data(), points.size(), sizeof(glm::vec3));
+
+  // Clip space is the unit cube, everything is in view
+  TRUCHAS_APP_NAMESPACE::LodView view{glm::mat4(1.0f), 1000.0f};
+
+  std::vector<const TRUCHAS_APP_NAMESPACE::PointOctree *> trees = {&octree};
+  std::vector<std::vector<uint8_t>> selected;
+
+  size_t drawn = TRUCHAS_APP_NAMESPACE::selectLod(trees, {&view, 1}, 50000,
+                                                  0.0f, selected);
+
+  EXPECT_LE(drawn, 50000);
+  EXPECT_GT(drawn, octree.NODE_POINTS);
+
+  size_t counted = 0;
+  for (size_t n = 0; n < selected[0].size(); n++)
+    if (selected[0][n])
+      counted += octree.nodes()[n].count;
+  EXPECT_EQ(counted, drawn);
+
+  // Unlimited, the cut ends at the leaves
+  drawn = TRUCHAS_APP_NAMESPACE::selectLod(trees, {&view, 1}, SIZE_MAX, 0.0f,
+                                           selected);
+  EXPECT_EQ(drawn, points.size());
+
+  // Out of view, nothing is selected
+  TRUCHAS_APP_NAMESPACE::LodView away = view;
+  away.viewProj[3] = glm::vec4(5.0f, 0.0f, 0.0f, 1.0f);
+  drawn = TRUCHAS_APP_NAMESPACE::selectLod(trees, {&away, 1}, SIZE_MAX, 0.0f,
+                                           selected);
+  EXPECT_EQ(drawn, 0);
+}
+
+TEST(kdtree, matchesBruteForce) {
+
+  auto points = randomPoints(100000);
+
+  TRUCHAS_APP_NAMESPACE::ThreadPool pool(3);
+  TRUCHAS_APP_NAMESPACE::PointKdTree tree;
+  tree.build(points, &pool);
+
+  std::vector<TRUCHAS_APP_NAMESPACE::PointHit> hits;
+  std::vector<float> distances(points.size());
+
+  auto sortedDistances = [&](auto distance) {
+    for (size_t i = 0; i < points.size(); i++)
+      distances[i] = distance(points[i]);
+    std::sort(distances.begin(), distances.end());
+  };
+
+  for (const glm::vec3 &query : randomPoints(20)) {
+
+    sortedDistances([&](const glm::vec3 &p) { return glm::distance(p, query); });
+
+    tree.nearest(points, query, 8, std::numeric_limits<float>::max(), hits);
+    ASSERT_EQ(hits.size(), 8);
+    for (size_t i = 0; i < hits.size(); i++) {
+      EXPECT_FLOAT_EQ(hits[i].distance, distances[i]);
+      EXPECT_FLOAT_EQ(glm::distance(points[hits[i].index], query),
+                      distances[i]);
+    }
+
+    // Halfway between two points, clear of rounding at the boundary
+    float radius = (distances[50] + distances[51]) * 0.5f;
+    tree.within(points, query, radius, hits);
+    EXPECT_EQ(hits.size(), 51);
+    EXPECT_TRUE(std::is_sorted(
+        hits.begin(), hits.end(),
+        [](const auto &a, const auto &b) { return a.distance < b.distance; }));
+  }
+
+  // Clip space is the unit cube, seen on a 1000 x 1000 viewport
+  TRUCHAS_APP_NAMESPACE::ScreenView view{glm::mat4(1.0f),
+                                         glm::vec2(1000.0f, 1000.0f)};
+  glm::vec2 cursor(420.0f, 610.0f);
+
+  sortedDistances([&](const glm::vec3 &p) {
+    glm::vec2 pixel((p.x * 0.5f + 0.5f) * 1000.0f,
+                    (p.y * 0.5f + 0.5f) * 1000.0f);
+    return glm::distance(pixel, cursor);
+  });
+
+  tree.nearestOnScreen(points, view, cursor, 4, 100.0f, hits);
+  ASSERT_EQ(hits.size(), 4);
+  for (size_t i = 0; i < hits.size(); i++)
+    EXPECT_NEAR(hits[i].distance, distances[i], 1e-3f);
+}
+
+TEST(model, snappingFollowsEdits) {
+
+  Sketch sketch;
+
+  for (int i = 0; i < 2000; i++)
+    sketch.addPoint(glm::vec3(static_cast<float>(i), 0.0f, 0.0f));
+
+  sketch.buildIndex();
+
+  std::vector<TRUCHAS_APP_NAMESPACE::PointHit> hits;
+  sketch.nearestPoints(glm::vec3(10.2f, 0.0f, 0.0f), 1, 1.0f, hits);
+  ASSERT_EQ(hits.size(), 1);
+  EXPECT_EQ(hits[0].index, 10);
+
+  // Moved away, the old spot answers with its neighbour
+  sketch.setPoint(10, glm::vec3(-50.0f, 0.0f, 0.0f));
+  sketch.nearestPoints(glm::vec3(10.2f, 0.0f, 0.0f), 1, 1.0f, hits);
+  ASSERT_EQ(hits.size(), 1);
+  EXPECT_EQ(hits[0].index, 11);
+
+  sketch.nearestPoints(glm::vec3(-50.0f, 0.0f, 0.0f), 1, 1.0f, hits);
+  ASSERT_EQ(hits.size(), 1);
+  EXPECT_EQ(hits[0].index, 10);
+
+  // The last point moves into the removed slot
+  sketch.removePoint(20);
+  sketch.nearestPoints(glm::vec3(1999.0f, 0.0f, 0.0f), 1, 0.5f, hits);
+  ASSERT_EQ(hits.size(), 1);
+  EXPECT_EQ(hits[0].index, 20);
+
+  sketch.addPoint(glm::vec3(0.0f, 5.0f, 0.0f));
+  sketch.pointsWithin(glm::vec3(0.0f, 5.0f, 0.0f), 0.5f, hits);
+  ASSERT_EQ(hits.size(), 1);
+  EXPECT_EQ(hits[0].index, 1999);
+
+  sketch.clearRender();
+  sketch.nearestPoints(glm::vec3(0.0f), 1, 1e9f, hits);
+  EXPECT_TRUE(hits.empty());
+}
+
+TEST(model, connectedEdgesShareVertices) {
+
+  Sketch sketch;
+
+  // A closed square as four separate edges
+  std::array<glm::vec3, 4> corners = {
+      glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f),
+      glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)};
+
+  for (size_t i = 0; i < corners.size(); i++) {
+    Edge edge = sketch.addEdge(corners[i], corners[(i + 1) % corners.size()]);
+    EXPECT_EQ(edge.a, i);
+    EXPECT_EQ(edge.b, (i + 1) % corners.size());
+  }
+
+  const auto &data = sketch.getRenderData();
+  EXPECT_EQ(data.size(), 4);
+  EXPECT_EQ(data.segments.size(), 4);
+
+  // Close enough only with a tolerance
+  Edge edge = sketch.addEdge(glm::vec3(1.001f, 1.0f, 0.0f),
+                             glm::vec3(2.0f, 2.0f, 0.0f), 0, 0.01f);
+  EXPECT_EQ(edge.a, 2);
+  EXPECT_EQ(edge.b, 4);
+}
+
+TEST(weld, mergesCoincidentPoints) {
+
+  TRUCHAS_APP_NAMESPACE::RenderData data;
+
+  // Two polylines drawn with their own copies of the shared points
+  for (int i = 0; i < 3; i++)
+    for (float x : {0.0f, 1.0f, 2.0f})
+      data.append(glm::vec3(x, 0.0f, 0.0f), glm::vec3(1.0f), 0,
+                  static_cast<uint32_t>(data.size()));
+
+  data.segments = {{0, 1, 0, 0}, {1, 2, 0, 0}, {3, 4, 0, 0},
+                   {5, 4, 0, 0}, {6, 7, 0, 0}, {0, 3, 0, 0}};
+
+  EXPECT_EQ(TRUCHAS_APP_NAMESPACE::weldPoints(data, 0.0f), 6);
+
+  ASSERT_EQ(data.size(), 3);
+  EXPECT_EQ(data.colors.size(), 3);
+  EXPECT_EQ(data.ids[1], 1);
+  EXPECT_EQ(data.points[2].x, 2.0f);
+
+  // Repeats and the collapsed segment are gone
+  ASSERT_EQ(data.segments.size(), 2);
+  EXPECT_EQ(data.segments[0].a, 0);
+  EXPECT_EQ(data.segments[0].b, 1);
+  EXPECT_EQ(data.segments[1].a, 1);
+  EXPECT_EQ(data.segments[1].b, 2);
+
+  EXPECT_EQ(TRUCHAS_APP_NAMESPACE::weldPoints(data, 0.0f), 0);
+}
+
+TEST(depgraph, evaluatesDirtyNodesInOrder) {
+
+  // a -> b -> d, c -> d, e stands alone
+  TRUCHAS_APP_NAMESPACE::DependencyGraph graph;
+  uint32_t a = graph.addNode();
+  uint32_t b = graph.addNode();
+  uint32_t c = graph.addNode();
+  uint32_t d = graph.addNode();
+  uint32_t e = graph.addNode();
+
+  graph.addEdge(a, b);
+  graph.addEdge(b, d);
+  graph.addEdge(c, d);
+
+  EXPECT_THROW(graph.addEdge(d, a), std::invalid_argument);
+
+  graph.markDirty(a);
+  EXPECT_TRUE(graph.isDirty(d));
+  EXPECT_FALSE(graph.isDirty(c));
+  EXPECT_FALSE(graph.isDirty(e));
+
+  std::vector<uint32_t> evaluated;
+  graph.evaluate([](uint32_t) {}, evaluated);
+  EXPECT_EQ(evaluated, (std::vector<uint32_t>{a, b, d}));
+  EXPECT_EQ(graph.dirtyCount(), 0);
+
+  // Both inputs dirty, d still runs once and last
+  graph.markDirty(c);
+  graph.markDirty(a);
+
+  TRUCHAS_APP_NAMESPACE::ThreadPool pool(3);
+  std::atomic<int> runs{0};
+  graph.evaluate([&](uint32_t) { runs++; }, evaluated, &pool);
+  EXPECT_EQ(runs, 4);
+  EXPECT_EQ(evaluated.back(), d);
+}
+
+TEST(sketch, dragReevaluatesDependentsOnly) {
+
+  Sketch sketch;
+  RecordingObserver observer;
+  sketch.addRender(&observer);
+
+  // Many independent pairs with their midpoints
+  std::vector<uint32_t> points;
+  for (int i = 0; i < 1000; i++) {
+    uint32_t a = sketch.addFreePoint(glm::vec3(float(i), 0.0f, 0.0f));
+    uint32_t b = sketch.addFreePoint(glm::vec3(float(i), 2.0f, 0.0f));
+    points.push_back(sketch.addMidpoint(a, b));
+    sketch.addLine(a, b);
+  }
+
+  TRUCHAS_APP_NAMESPACE::ThreadPool pool(3);
+  EXPECT_EQ(sketch.update(&pool), 3000);
+
+  // The midpoint of pair 10 is the chain's only dependent
+  sketch.movePoint(30, glm::vec3(10.0f, 6.0f, 0.0f));
+
+  int deltas = observer.deltas;
+  EXPECT_EQ(sketch.update(&pool), 2);
+  EXPECT_EQ(observer.deltas, deltas + 1);
+
+  glm::vec3 mid = sketch.getPosition(points[10]);
+  EXPECT_FLOAT_EQ(mid.y, 4.0f);
+  // Every entity added one model point, so the ids line up
+  EXPECT_FLOAT_EQ(sketch.getRenderData().points[points[10]].y, 4.0f);
+
+  EXPECT_EQ(observer.last.modified.size(), 2);
+
+  EXPECT_EQ(sketch.update(&pool), 0);
+  EXPECT_THROW(sketch.movePoint(points[0], glm::vec3(0.0f)),
+               std::invalid_argument);
+}
+
+TEST(tessellation, staysWithinTolerance) {
+
+  auto circle = TRUCHAS_APP_NAMESPACE::Curve::circle(
+      glm::vec3(1.0f, 2.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f),
+      glm::vec3(0.0f, 1.0f, 0.0f), 10.0f);
+
+  std::vector<glm::vec3> coarse, fine;
+  TRUCHAS_APP_NAMESPACE::CurveTessellator::tessellate(circle, 0.1f, coarse);
+  TRUCHAS_APP_NAMESPACE::CurveTessellator::tessellate(circle, 0.001f, fine);
+
+  EXPECT_GT(fine.size(), 4 * coarse.size());
+
+  // Chords are furthest from the arc in their middle
+  for (size_t i = 0; i + 1 < fine.size(); i++) {
+    glm::vec3 mid = (fine[i] + fine[i + 1]) * 0.5f;
+    EXPECT_LE(10.0f - glm::length(mid - circle.center), 0.001f);
+  }
+
+  auto spline = TRUCHAS_APP_NAMESPACE::Curve::spline(
+      {glm::vec3(0.0f), glm::vec3(1.0f, 2.0f, 0.0f),
+       glm::vec3(3.0f, 2.0f, 0.0f), glm::vec3(4.0f, 0.0f, 0.0f),
+       glm::vec3(5.0f, -2.0f, 0.0f), glm::vec3(7.0f, -2.0f, 0.0f),
+       glm::vec3(8.0f, 0.0f, 0.0f)});
+
+  TRUCHAS_APP_NAMESPACE::CurveTessellator::tessellate(spline, 0.01f, fine);
+  ASSERT_GT(fine.size(), 8);
+  EXPECT_EQ(fine.front().x, 0.0f);
+  EXPECT_FLOAT_EQ(fine.back().x, 8.0f);
+}
+
+TEST(tessellation, zoomOnlyRetessellatesChangedBuckets) {
+
+  TRUCHAS_APP_NAMESPACE::CurveTessellator tessellator;
+
+  // Clip w is the z coordinate
+  glm::mat4 viewProj(1.0f);
+  viewProj[2][3] = 1.0f;
+  viewProj[3][3] = 0.0f;
+
+  for (float z : {10.0f, 1500.0f})
+    tessellator.addCurve(TRUCHAS_APP_NAMESPACE::Curve::circle(
+        glm::vec3(0.0f, 0.0f, z), glm::vec3(1.0f, 0.0f, 0.0f),
+        glm::vec3(0.0f, 1.0f, 0.0f), 1.0f));
+
+  TRUCHAS_APP_NAMESPACE::TessellationView view{viewProj, 1000.0f, 0.5f};
+  TRUCHAS_APP_NAMESPACE::ThreadPool pool(3);
+
+  EXPECT_EQ(tessellator.update(view, &pool), 2);
+  EXPECT_GT(tessellator.points(0).size(), tessellator.points(1).size());
+
+  EXPECT_EQ(tessellator.update(view, &pool), 0);
+  EXPECT_TRUE(tessellator.changed().empty());
+
+  // A small zoom stays in both buckets
+  view.pixelScale = 1100.0f;
+  EXPECT_EQ(tessellator.update(view, &pool), 0);
+
+  view.pixelScale = 4000.0f;
+  int bucket = tessellator.bucket(0);
+  EXPECT_EQ(tessellator.update(view, &pool), 2);
+  EXPECT_EQ(tessellator.bucket(0), bucket - 2);
+
+  // Zooming back out finds both in the cache
+  view.pixelScale = 1000.0f;
+  EXPECT_EQ(tessellator.update(view, &pool), 0);
+  EXPECT_EQ(tessellator.changed().size(), 2);
+  EXPECT_EQ(tessellator.bucket(0), bucket);
+}
+
+TEST(tessellation, degenerateViewsStayInRange) {
+
+  TRUCHAS_APP_NAMESPACE::CurveTessellator tessellator;
+
+  glm::mat4 viewProj(1.0f);
+  viewProj[2][3] = 1.0f;
+  viewProj[3][3] = 0.0f;
+
+  tessellator.addCurve(TRUCHAS_APP_NAMESPACE::Curve::circle(
+      glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(1.0f, 0.0f, 0.0f),
+      glm::vec3(0.0f, 1.0f, 0.0f), 1.0f));
+
+  const float inf = std::numeric_limits<float>::infinity();
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+
+  // Coarsest first, then finest for a zero or broken tolerance
+  for (auto [pixelScale, tolerance] :
+       {std::pair{0.0f, 0.5f}, std::pair{1000.0f, inf},
+        std::pair{1000.0f, 0.0f}, std::pair{0.0f, 0.0f},
+        std::pair{nan, 0.5f}, std::pair{1000.0f, -1.0f}}) {
+
+    tessellator.update({viewProj, pixelScale, tolerance});
+
+    int bucket = tessellator.bucket(0);
+    EXPECT_GE(bucket, -30);
+    EXPECT_LE(bucket, 30);
+    EXPECT_GE(tessellator.points(0).size(), 2);
+    EXPECT_LE(tessellator.points(0).size(),
+              TRUCHAS_APP_NAMESPACE::CurveTessellator::MAX_SEGMENTS + 1);
+  }
+}
+
+TEST(kernels, matchScalar) {
+
+  using TRUCHAS_APP_NAMESPACE::KernelLevel;
+
+  // Odd counts leave a tail behind every vector loop
+  auto points = randomPoints(1003);
+  auto colors = randomPoints(1003);
+
+  glm::mat4 m(1.0f);
+  m[0] = glm::vec4(0.5f, 2.0f, -1.0f, 0.0f);
+  m[1] = glm::vec4(1.5f, -0.25f, 3.0f, 0.0f);
+  m[2] = glm::vec4(-2.0f, 1.0f, 0.75f, 0.0f);
+  m[3] = glm::vec4(10.0f, -5.0f, 2.0f, 1.0f);
+
+  const auto &scalar = TRUCHAS_APP_NAMESPACE::kernelTable(KernelLevel::scalar);
+
+  std::vector<float> expectedPacked(6 * points.size());
+  scalar.pack(points.data(), colors.data(), expectedPacked.data(),
+              points.size());
+
+  std::vector<glm::vec3> expectedMoved(points.size());
+  scalar.transform(m, points.data(), expectedMoved.data(), points.size());
+
+  glm::vec3 expectedMin, expectedMax, vertexMin, vertexMax;
+  scalar.bounds(points.data(), points.size(), sizeof(glm::vec3), expectedMin,
+                expectedMax);
+  // Colors are skipped in Vertex records
+  scalar.bounds(expectedPacked.data(), points.size(), 6 * sizeof(float),
+                vertexMin, vertexMax);
+  EXPECT_EQ(vertexMin, expectedMin);
+  EXPECT_EQ(vertexMax, expectedMax);
+
+  for (KernelLevel level :
+       {KernelLevel::scalar, KernelLevel::sse41, KernelLevel::avx2}) {
+
+    if (level > TRUCHAS_APP_NAMESPACE::supportedKernelLevel())
+      continue;
+
+    const auto &table = TRUCHAS_APP_NAMESPACE::kernelTable(level);
+    SCOPED_TRACE(table.name);
+
+    glm::vec3 min, max;
+    table.bounds(points.data(), points.size(), sizeof(glm::vec3), min, max);
+    EXPECT_EQ(min, expectedMin);
+    EXPECT_EQ(max, expectedMax);
+
+    table.bounds(expectedPacked.data(), points.size(), 6 * sizeof(float), min,
+                 max);
+    EXPECT_EQ(min, expectedMin);
+    EXPECT_EQ(max, expectedMax);
+
+    table.bounds(points.data(), 0, sizeof(glm::vec3), min, max);
+    EXPECT_EQ(min, glm::vec3(0.0f));
+
+    std::vector<float> packed(expectedPacked.size());
+    table.pack(points.data(), colors.data(), packed.data(), points.size());
+    EXPECT_EQ(packed, expectedPacked);
+
+    // In place, fused multiply-adds may round differently
+    std::vector<glm::vec3> moved = points;
+    table.transform(m, moved.data(), moved.data(), moved.size());
+
+    for (size_t i = 0; i < moved.size(); i++)
+      ASSERT_LT(glm::distance(moved[i], expectedMoved[i]), 1e-4f) << i;
+  }
+}
@@ -219,9 +219,15 @@ TEST(render, createDescriptorSetLayout) {
   render.createDescriptorSetLayout();
 
   EXPECT_NE(render.mDescriptorSetLayout, nullptr);
+  EXPECT_NE(render.mLineSetLayout, nullptr);
 
   vkDestroyDescriptorSetLayout(render.mDevice, render.mDescriptorSetLayout,
                                nullptr);
+  vkDestroyDescriptorSetLayout(render.mDevice, render.mLineSetLayout, nullptr);
+  vkDestroyDescriptorSetLayout(render.mDevice, render.mSplatSourceLayout,
+                               nullptr);
+  vkDestroyDescriptorSetLayout(render.mDevice, render.mSplatTargetLayout,
+                               nullptr);
   vkDestroyRenderPass(render.mDevice, render.mRenderPass, nullptr);
   vkDestroySwapchainKHR(render.mDevice, render.mSwapchain, nullptr);
   vkDestroyDevice(render.mDevice, nullptr);
@@ -250,10 +256,18 @@ TEST(render, createPipelineLayout) {
   render.createPipelineLayout();
 
   EXPECT_NE(render.mPipelineLayout, nullptr);
+  EXPECT_NE(render.mLinePipelineLayout, nullptr);
 
   vkDestroyPipelineLayout(render.mDevice, render.mPipelineLayout, nullptr);
+  vkDestroyPipelineLayout(render.mDevice, render.mLinePipelineLayout, nullptr);
+  vkDestroyPipelineLayout(render.mDevice, render.mSplatPipelineLayout, nullptr);
   vkDestroyDescriptorSetLayout(render.mDevice, render.mDescriptorSetLayout,
                                nullptr);
+  vkDestroyDescriptorSetLayout(render.mDevice, render.mLineSetLayout, nullptr);
+  vkDestroyDescriptorSetLayout(render.mDevice, render.mSplatSourceLayout,
+                               nullptr);
+  vkDestroyDescriptorSetLayout(render.mDevice, render.mSplatTargetLayout,
+                               nullptr);
   vkDestroyRenderPass(render.mDevice, render.mRenderPass, nullptr);
   vkDestroySwapchainKHR(render.mDevice, render.mSwapchain, nullptr);
   vkDestroyDevice(render.mDevice, nullptr);
@@ -285,9 +299,17 @@ TEST(render, preparePipelines) {
   EXPECT_NE(pipeline, nullptr);
 
   // vkDestroyPipeline(render.mDevice, render.Pipelines.SketchPoint, nullptr);
+  render.destroyPipelines();
   vkDestroyPipelineLayout(render.mDevice, render.mPipelineLayout, nullptr);
+  vkDestroyPipelineLayout(render.mDevice, render.mLinePipelineLayout, nullptr);
+  vkDestroyPipelineLayout(render.mDevice, render.mSplatPipelineLayout, nullptr);
   vkDestroyDescriptorSetLayout(render.mDevice, render.mDescriptorSetLayout,
                                nullptr);
+  vkDestroyDescriptorSetLayout(render.mDevice, render.mLineSetLayout, nullptr);
+  vkDestroyDescriptorSetLayout(render.mDevice, render.mSplatSourceLayout,
+                               nullptr);
+  vkDestroyDescriptorSetLayout(render.mDevice, render.mSplatTargetLayout,
+                               nullptr);
   vkDestroyRenderPass(render.mDevice, render.mRenderPass, nullptr);
   vkDestroySwapchainKHR(render.mDevice, render.mSwapchain, nullptr);
   vkDestroyDevice(render.mDevice, nullptr);
@@ -410,6 +432,7 @@ TEST(render, createUniformBuffer) {
 
   EXPECT_NE(render.mUniformBuffers.size(), 0);
   EXPECT_NE(render.mUniformBufferMemories.size(), 0);
+  EXPECT_EQ(render.mViewBuffers.size(), render.mUniformBuffers.size());
 
   for (auto buffer : render.mUniformBuffers) {
     vkDestroyBuffer(render.mDevice, buffer, nullptr);
@@ -419,6 +442,14 @@ TEST(render, createUniformBuffer) {
     vkFreeMemory(render.mDevice, memory, nullptr);
   }
 
+  for (auto buffer : render.mViewBuffers) {
+    vkDestroyBuffer(render.mDevice, buffer, nullptr);
+  }
+
+  for (auto memory : render.mViewBufferMemories) {
+    vkFreeMemory(render.mDevice, memory, nullptr);
+  }
+
   vkDestroySwapchainKHR(render.mDevice, render.mSwapchain, nullptr);
   vkDestroyDevice(render.mDevice, nullptr);
   vkDestroySurfaceKHR(render.mInstance, render.mSurface, nullptr);
@@ -444,8 +475,11 @@ TEST(render, createDescriptorPool) {
   render.createDescriptorPool();
 
   EXPECT_NE(render.mDescriptorPool, nullptr);
+  EXPECT_NE(render.mLineDescriptorPool, nullptr);
 
   vkDestroyDescriptorPool(render.mDevice, render.mDescriptorPool, nullptr);
+  vkDestroyDescriptorPool(render.mDevice, render.mLineDescriptorPool, nullptr);
+  vkDestroyDescriptorPool(render.mDevice, render.mSplatDescriptorPool, nullptr);
 
   vkDestroySwapchainKHR(render.mDevice, render.mSwapchain, nullptr);
   vkDestroyDevice(render.mDevice, nullptr);
@@ -487,6 +521,121 @@ TEST(render, createDescriptorSets) {
     vkFreeMemory(render.mDevice, memory, nullptr);
   }
 
+  for (auto buffer : render.mViewBuffers) {
+    vkDestroyBuffer(render.mDevice, buffer, nullptr);
+  }
+
+  for (auto memory : render.mViewBufferMemories) {
+    vkFreeMemory(render.mDevice, memory, nullptr);
+  }
+
+  vkDestroySwapchainKHR(render.mDevice, render.mSwapchain, nullptr);
+  vkDestroyDevice(render.mDevice, nullptr);
+  vkDestroySurfaceKHR(render.mInstance, render.mSurface, nullptr);
+  vkDestroyInstance(render.mInstance, nullptr);
+  glfwDestroyWindow(render.mMainWindow);
+  glfwTerminate();
+}
+
+TEST(render, createSplatTargets) {
+  glfwInit();
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  TRUCHAS_APP_NAMESPACE::TruchasRender render;
+
+  render.createWindow();
+  render.createInstance();
+  render.createSurface();
+  render.pickPhysicalDevice();
+  render.createLogicalDevice();
+  render.createSwapChain();
+
+  render.createDescriptorSetLayout();
+  render.createDescriptorPool();
+
+  render.createSplatTargets();
+
+  // Devices without 64-bit atomics rasterize everything
+  size_t expected = render.mSplatSupported ? render.mImages.size() : 0;
+  EXPECT_EQ(render.mSplatBuffers.size(), expected);
+  EXPECT_EQ(render.mSplatTargets.size(), expected);
+  EXPECT_FALSE(render.shouldSplat(render.mSplatThreshold - 1));
+
+  render.destroySplatTargets();
+  EXPECT_TRUE(render.mSplatBuffers.empty());
+
+  vkDestroyDescriptorPool(render.mDevice, render.mDescriptorPool, nullptr);
+  vkDestroyDescriptorPool(render.mDevice, render.mLineDescriptorPool, nullptr);
+  vkDestroyDescriptorPool(render.mDevice, render.mSplatDescriptorPool, nullptr);
+
+  vkDestroySwapchainKHR(render.mDevice, render.mSwapchain, nullptr);
+  vkDestroyDevice(render.mDevice, nullptr);
+  vkDestroySurfaceKHR(render.mInstance, render.mSurface, nullptr);
+  vkDestroyInstance(render.mInstance, nullptr);
+  glfwDestroyWindow(render.mMainWindow);
+  glfwTerminate();
+}
+
+TEST(render, updateLod) {
+  glfwInit();
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  TRUCHAS_APP_NAMESPACE::TruchasRender render;
+
+  render.createWindow();
+  render.createInstance();
+  render.createSurface();
+  render.pickPhysicalDevice();
+  render.createLogicalDevice();
+  render.createSwapChain();
+
+  render.createDescriptorSetLayout();
+  render.createDescriptorPool();
+  render.createSplatTargets();
+
+  // A grid of points around the origin, in front of the default camera
+  std::vector<glm::vec3> points;
+  for (int x = 0; x < 40; x++)
+    for (int y = 0; y < 40; y++)
+      for (int z = 0; z < 40; z++)
+        points.emplace_back(x / 20.0f - 1.0f, y / 20.0f - 1.0f,
+                            z / 20.0f - 1.0f);
+
+  auto octree = std::make_shared<TRUCHAS_APP_NAMESPACE::PointOctree>();
+  octree->build(points.data(), points.size(), sizeof(glm::vec3));
+
+  // Slots and tables only look at the tree, no vertex buffer needed
+  render.mBuffers[0].mPointSize = static_cast<uint32_t>(octree->size());
+  render.mBuffers[0].mOctree = octree;
+
+  render.assignLodSlots();
+
+  EXPECT_EQ(render.mLodTables.size(), render.mImages.size());
+  EXPECT_EQ(render.mBuffers[0].mLodSlot, 0);
+  EXPECT_EQ(render.mLodSlotCount, octree->nodes().size() + 1);
+
+  render.u = render.cameraUniform(render.mExtent.width /
+                                  (float)render.mExtent.height);
+  render.mLodBudget = 2 * octree->NODE_POINTS;
+  render.updateLod(0);
+
+  // Header, then one draw per selected node with the view as instance
+  const uint32_t *table = render.mLodMapped[0];
+  EXPECT_GT(table[0], 0);
+  EXPECT_LE(table[0], octree->nodes().size());
+  EXPECT_EQ(table[5], 1);
+
+  uint32_t drawn = 0;
+  for (uint32_t n = 0; n < table[0]; n++)
+    drawn += table[4 * (n + 1)];
+  EXPECT_LE(drawn, render.mLodBudget);
+
+  render.mBuffers.clear();
+  render.destroyLodTables();
+  render.destroySplatTargets();
+
+  vkDestroyDescriptorPool(render.mDevice, render.mDescriptorPool, nullptr);
+  vkDestroyDescriptorPool(render.mDevice, render.mLineDescriptorPool, nullptr);
+  vkDestroyDescriptorPool(render.mDevice, render.mSplatDescriptorPool, nullptr);
+
   vkDestroySwapchainKHR(render.mDevice, render.mSwapchain, nullptr);
   vkDestroyDevice(render.mDevice, nullptr);
   vkDestroySurfaceKHR(render.mInstance, render.mSurface, nullptr);
@@ -495,6 +644,197 @@ TEST(render, createDescriptorSets) {
   glfwTerminate();
 }
 
+TEST(render, pickIds) {
+  TRUCHAS_APP_NAMESPACE::TruchasRender render;
+
+  // Ids only look at the counts, no device needed
+  render.mBuffers[3].mPointSize = 10;
+  render.mBuffers[7].mPointSize = 5;
+  render.mLineSets[2].mSegments.mPointSize = 4;
+
+  render.assignPickIds();
+
+  EXPECT_EQ(render.mBuffers[3].mPickBase, 1);
+  EXPECT_EQ(render.mBuffers[7].mPickBase, 11);
+  EXPECT_EQ(render.mLineSets[2].mPickBase, 16);
+
+  auto pick = render.lookupPick(13);
+  EXPECT_EQ(pick.kind, TRUCHAS_APP_NAMESPACE::PickKind::point);
+  EXPECT_EQ(pick.id, 7);
+  EXPECT_EQ(pick.index, 2);
+
+  pick = render.lookupPick(19);
+  EXPECT_EQ(pick.kind, TRUCHAS_APP_NAMESPACE::PickKind::segment);
+  EXPECT_EQ(pick.id, 2);
+  EXPECT_EQ(pick.index, 3);
+
+  EXPECT_EQ(render.lookupPick(0).kind, TRUCHAS_APP_NAMESPACE::PickKind::none);
+  EXPECT_EQ(render.lookupPick(20).kind, TRUCHAS_APP_NAMESPACE::PickKind::none);
+
+  // The nearest id wins, background is skipped
+  std::vector<uint32_t> ids(5 * 5, 0);
+  EXPECT_EQ(render.nearestPickId(ids.data(), 5, 5, 2, 2), 0);
+
+  ids[0] = 4;
+  ids[3 * 5 + 3] = 9;
+  EXPECT_EQ(render.nearestPickId(ids.data(), 5, 5, 2, 2), 9);
+  EXPECT_EQ(render.nearestPickId(ids.data(), 5, 5, 0, 1), 4);
+}
+
+TEST(render, fillVertices) {
+  TRUCHAS_APP_NAMESPACE::TruchasRender render;
+
+  // Several fill chunks and a partial one, filled on the pool
+  TRUCHAS_APP_NAMESPACE::RenderData data;
+  size_t count = 3 * (1 << 14) + 100;
+
+  for (size_t i = 0; i < count; i++) {
+    data.points.emplace_back(float(i % 97) - 40.0f, float((i * 7) % 113),
+                             -float((i * 13) % 89));
+    data.colors.emplace_back(float(i) / count, 0.0f, 1.0f);
+  }
+
+  glm::vec3 expectedMin = data.points[0], expectedMax = data.points[0];
+  for (const auto &point : data.points) {
+    expectedMin = glm::min(expectedMin, point);
+    expectedMax = glm::max(expectedMax, point);
+  }
+
+  // Without a tree vertices keep the model's order
+  std::vector<TRUCHAS_APP_NAMESPACE::Vertex> vertices(count);
+  glm::vec3 min, max;
+  render.fillVertices(data, nullptr, vertices.data(), min, max);
+
+  EXPECT_EQ(min, expectedMin);
+  EXPECT_EQ(max, expectedMax);
+
+  for (size_t i = 0; i < count; i++) {
+    ASSERT_EQ(vertices[i].pos, data.points[i]) << i;
+    ASSERT_EQ(vertices[i].col, data.colors[i]) << i;
+  }
+
+  // With one they follow the tree, inner node samples included
+  TRUCHAS_APP_NAMESPACE::PointOctree octree;
+  octree.build(data.points.data(), count, sizeof(glm::vec3));
+
+  vertices.assign(octree.size(), {});
+  render.fillVertices(data, &octree, vertices.data(), min, max);
+
+  EXPECT_EQ(min, expectedMin);
+  EXPECT_EQ(max, expectedMax);
+
+  const auto &order = octree.order();
+  for (size_t i = 0; i < order.size(); i++) {
+    ASSERT_EQ(vertices[i].pos, data.points[order[i]]) << i;
+    ASSERT_EQ(vertices[i].col, data.colors[order[i]]) << i;
+  }
+}
+
+TEST(render, frameNeeded) {
+  TRUCHAS_APP_NAMESPACE::TruchasRender render;
+
+  // Only looks at state, no device needed
+  render.mFramesRequested = 0;
+  EXPECT_FALSE(render.frameNeeded());
+
+  render.requestFrame();
+  EXPECT_TRUE(render.frameNeeded());
+  render.mFramesRequested = 0;
+
+  // Octrees refine until the budget is used up
+  render.mLodTables.resize(1);
+  render.mBuffers[1].mOctree =
+      std::make_shared<TRUCHAS_APP_NAMESPACE::PointOctree>();
+  render.mLodFrameBudget = render.mLodBudget;
+  EXPECT_TRUE(render.frameNeeded());
+
+  render.mLodFrameBudget = render.mLodMaxBudget;
+  EXPECT_FALSE(render.frameNeeded());
+
+  // Copies in flight are collected on a later frame
+  render.mPickSlots.resize(1);
+  render.mPickSlots[0].mPending = true;
+  EXPECT_TRUE(render.frameNeeded());
+  render.mPickSlots[0].mPending = false;
+
+  render.mReadbackSlots.push_back(
+      std::make_unique<TRUCHAS_APP_NAMESPACE::ReadbackSlot>());
+  EXPECT_FALSE(render.frameNeeded());
+
+  render.mReadbackSlots[0]->mState =
+      TRUCHAS_APP_NAMESPACE::ReadbackSlot::pending;
+  EXPECT_TRUE(render.frameNeeded());
+
+  // A held view waits for the consumer, not for a frame
+  render.mReadbackSlots[0]->mState = TRUCHAS_APP_NAMESPACE::ReadbackSlot::held;
+  EXPECT_FALSE(render.frameNeeded());
+}
+
+TEST(render, readbackOutputPattern) {
+  TRUCHAS_APP_NAMESPACE::TruchasRender render;
+
+  EXPECT_THROW(render.setReadbackOutput("frame_{:q}.png"), std::runtime_error);
+  EXPECT_THROW(render.setReadbackOutput("frame_{1}.png"), std::runtime_error);
+  EXPECT_TRUE(render.mReadbackPath.empty());
+
+  EXPECT_NO_THROW(render.setReadbackOutput("frame_{:06}.png"));
+  EXPECT_EQ(render.mReadbackPath, "frame_{:06}.png");
+}
+
+TEST(render, renderScaleTracksFrameTime) {
+
+  using TRUCHAS_APP_NAMESPACE::TruchasRender;
+
+  // Scene time grows with the pixels, the target is met at half size
+  auto sceneTime = [](float scale) { return 40.0f * scale * scale; };
+
+  for (float scale : {1.0f, 0.25f}) {
+    for (int frame = 0; frame < 10; frame++)
+      scale = TruchasRender::nextRenderScale(scale, sceneTime(scale), 10.0f,
+                                             0.25f, 1.0f);
+    EXPECT_FLOAT_EQ(scale, 0.5f);
+  }
+
+  // Near the target the scale holds, bounds always apply
+  EXPECT_FLOAT_EQ(TruchasRender::nextRenderScale(0.75f, 10.5f, 10.0f, 0.5f,
+                                                 1.0f),
+                  0.75f);
+  EXPECT_FLOAT_EQ(
+      TruchasRender::nextRenderScale(0.75f, 1000.0f, 10.0f, 0.5f, 1.0f), 0.5f);
+  EXPECT_FLOAT_EQ(
+      TruchasRender::nextRenderScale(0.75f, 1.0f, 10.0f, 0.5f, 0.875f),
+      0.875f);
+}
+
+TEST(render, progressiveBatchesSplitDraws) {
+
+  using TRUCHAS_APP_NAMESPACE::TruchasRender;
+
+  auto batches = TruchasRender::progressiveBatches({10, 3, 0, 7}, 8);
+
+  ASSERT_EQ(batches.size(), 3u);
+  ASSERT_EQ(batches[0].size(), 1u);
+  ASSERT_EQ(batches[1].size(), 3u);
+  ASSERT_EQ(batches[2].size(), 1u);
+
+  auto expectRange = [](const auto &range, uint32_t draw, uint32_t first,
+                         uint32_t count) {
+    EXPECT_EQ(range.draw, draw);
+    EXPECT_EQ(range.first, first);
+    EXPECT_EQ(range.count, count);
+  };
+
+  expectRange(batches[0][0], 0, 0, 8);
+  expectRange(batches[1][0], 0, 8, 2);
+  expectRange(batches[1][1], 1, 0, 3);
+  expectRange(batches[1][2], 3, 0, 3);
+  expectRange(batches[2][0], 3, 3, 4);
+
+  // No budget draws everything at once
+  EXPECT_EQ(TruchasRender::progressiveBatches({10, 3, 7}, 0).size(), 1u);
+  EXPECT_TRUE(TruchasRender::progressiveBatches({}, 8).empty());
+}
+
 TEST(render, allocCommandBuffers) {
 
   glfwInit();
@@ -568,4 +908,100 @@ TEST(render, createSyncObjects) {
   vkDestroyInstance(render.mInstance, nullptr);
   glfwDestroyWindow(render.mMainWindow);
   glfwTerminate();
-}
\ No newline at end of file
+}
+
+TEST(render, enableReadback) {
+
+  glfwInit();
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  TRUCHAS_APP_NAMESPACE::TruchasRender render;
+
+  render.createWindow();
+  render.createInstance();
+  render.createSurface();
+  render.pickPhysicalDevice();
+  render.createLogicalDevice();
+  render.createSwapChain();
+
+  render.enableReadback(4);
+
+  // Refused without transfer source usage on the swapchain images
+  EXPECT_EQ(render.mReadbackEnabled, render.mReadbackSupported);
+
+  if (render.mReadbackSupported) {
+
+    EXPECT_EQ(render.mReadbackSlots.size(), 4);
+
+    for (const auto &slot : render.mReadbackSlots) {
+      EXPECT_NE(slot->mMapped, nullptr);
+      EXPECT_EQ(slot->mState.load(),
+                TRUCHAS_APP_NAMESPACE::ReadbackSlot::free);
+    }
+
+    EXPECT_NE(render.acquireReadbackSlot(), nullptr);
+  }
+
+  render.disableReadback();
+
+  EXPECT_FALSE(render.mReadbackEnabled);
+  EXPECT_TRUE(render.mReadbackSlots.empty());
+
+  vkDestroySwapchainKHR(render.mDevice, render.mSwapchain, nullptr);
+  vkDestroyDevice(render.mDevice, nullptr);
+  vkDestroySurfaceKHR(render.mInstance, render.mSurface, nullptr);
+  vkDestroyInstance(render.mInstance, nullptr);
+  glfwDestroyWindow(render.mMainWindow);
+  glfwTerminate();
+}
+
+TEST(render, createOffscreenTarget) {
+
+  glfwInit();
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  TRUCHAS_APP_NAMESPACE::TruchasRender render;
+
+  render.createWindow();
+  render.createInstance();
+  render.createSurface();
+  render.pickPhysicalDevice();
+  render.createLogicalDevice();
+  render.createSwapChain();
+
+  TRUCHAS_APP_NAMESPACE::OffscreenTarget target =
+      render.createOffscreenTarget(256, 128);
+
+  EXPECT_NE(render.mOffscreenRenderPass, nullptr);
+  EXPECT_NE(target.mFramebuffer, nullptr);
+  EXPECT_EQ(target.mExtent.width, 256);
+  EXPECT_EQ(target.mExtent.height, 128);
+
+  render.destroyOffscreenTarget(target);
+
+  vkDestroyRenderPass(render.mDevice, render.mOffscreenRenderPass, nullptr);
+  vkDestroySwapchainKHR(render.mDevice, render.mSwapchain, nullptr);
+  vkDestroyDevice(render.mDevice, nullptr);
+  vkDestroySurfaceKHR(render.mInstance, render.mSurface, nullptr);
+  vkDestroyInstance(render.mInstance, nullptr);
+  glfwDestroyWindow(render.mMainWindow);
+  glfwTerminate();
+}
+
+TEST(render, setViews) {
+
+  TRUCHAS_APP_NAMESPACE::TruchasRender render;
+
+  EXPECT_EQ(render.getViewCount(), 1);
+
+  std::vector<TRUCHAS_APP_NAMESPACE::ViewData> views(
+      4, {glm::mat4(1.0f), glm::mat4(1.0f), glm::vec4(0.0f, 0.0f, 0.5f, 0.5f)});
+
+  render.setViews(views);
+  EXPECT_EQ(render.getViewCount(), 4);
+
+  views.resize(64, views[0]);
+  render.setViews(views);
+  EXPECT_EQ(render.getViewCount(), 16);
+
+  render.setViews({});
+  EXPECT_EQ(render.getViewCount(), 1);
+}